@@ -0,0 +1,240 @@
+/** @file FilterBench.cpp
+ *  @brief Checks the tiled filters give the same bytes every way, and times
+ *         them on 1 to N threads
+ *
+ *  Each filter (and a chain of them) is run on random images, from 1x1 up
+ *  to odd sizes bigger than a tile, as one whole-image tile on one thread
+ *  with scalar code. That is the reference: every other tile size, thread
+ *  count and instruction set has to give exactly the same pixels. Flat
+ *  images also have to stay flat (or go black, for Sobel), through a box
+ *  blur of every radius too. Then every filter is timed on a random 4K
+ *  frame on 1, 2, 4 ... N threads.
+ *
+ *  usage: FilterBench [--threads <n>]   (run from Assignment0_CPlusPlus)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Filters.h"
+#include "PPM.h"
+#include "ThreadPool.h"
+
+static const std::string TMP_FILE = "./FilterBench.tmp.ppm";
+
+static const size_t FRAME_WIDTH = 3840;
+static const size_t FRAME_HEIGHT = 2160;
+static const int RUNS = 3;
+
+// a width x height P6 of random pixels, loaded back
+PPM randomImage(size_t width, size_t height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<char> pixels(width * height * 3);
+    for (char& p : pixels) {
+        p = (char)(rng() & 0xff);
+    }
+
+    {
+        std::ofstream out(TMP_FILE, std::ios::binary);
+        out << PPM_MAGIC_BINARY << '\n'
+            << width << ' ' << height << '\n'
+            << PPM_MAX << '\n';
+        out.write(pixels.data(), pixels.size());
+    }
+    return PPM(TMP_FILE);
+}
+
+bool samePixels(const PPM& a, const PPM& b)
+{
+    return a.getWidth() == b.getWidth() && a.getHeight() == b.getHeight() &&
+           std::equal(a.pixelData(),
+                      a.pixelData() + a.getWidth() * a.getHeight() * 3,
+                      b.pixelData());
+}
+
+struct NamedPipeline {
+    std::string name;
+    FilterPipeline pipeline;
+};
+
+std::vector<NamedPipeline> pipelines(size_t width, size_t height)
+{
+    std::vector<NamedPipeline> all(8);
+    all[0].name = "box 1";
+    all[0].pipeline.boxBlur(1);
+    all[1].name = "box 9";
+    all[1].pipeline.boxBlur(9);
+    all[2].name = "gaussian 2";
+    all[2].pipeline.gaussianBlur(2);
+    all[3].name = "gaussian 25";
+    all[3].pipeline.gaussianBlur(25);
+    all[4].name = "sharpen 0.75";
+    all[4].pipeline.sharpen(0.75f);
+    all[5].name = "sobel";
+    all[5].pipeline.sobel();
+    all[6].name = "resize";
+    all[6].pipeline.resize(width / 2 + 1, height * 3 / 2 + 1);
+    all[7].name = "chain";
+    all[7].pipeline.gaussianBlur(1.5f).sharpen(1).resize(width * 2 / 3 + 1,
+                                                          height / 3 + 1);
+    all[7].pipeline.sobel();
+    return all;
+}
+
+bool checkImage(size_t width, size_t height, unsigned int threads)
+{
+    const PPM image = randomImage(width, height, (unsigned int)(width * 7 + height));
+    bool ok = true;
+
+    for (NamedPipeline& named : pipelines(width, height)) {
+        FilterPipeline& pipeline = named.pipeline;
+
+        pipeline.setTileSize(width, height);
+        const PPM expected = pipeline.run(image, nullptr, ImageOps::SCALAR);
+
+        const size_t tiles[][2] = {
+            {FILTER_TILE_WIDTH, FILTER_TILE_HEIGHT}, {37, 19}, {1, 1}, {7, 300}};
+        for (const size_t* tile : tiles) {
+            // 1x1 tiles are slow; the small images are enough for them
+            if (tile[0] * tile[1] == 1 && width * height > 5000) {
+                continue;
+            }
+            pipeline.setTileSize(tile[0], tile[1]);
+
+            for (unsigned int t = 1; t <= threads; t++) {
+                ThreadPool pool(t);
+                for (int isa = ImageOps::SCALAR; isa <= ImageOps::bestIsa();
+                     isa++) {
+                    const PPM result =
+                        pipeline.run(image, &pool, (ImageOps::Isa)isa);
+                    if (!samePixels(result, expected)) {
+                        std::cout << "MISMATCH: " << named.name << " on "
+                                  << width << "x" << height << ", "
+                                  << tile[0] << "x" << tile[1] << " tiles, "
+                                  << t << " threads, "
+                                  << ImageOps::isaName((ImageOps::Isa)isa)
+                                  << '\n';
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+// flat images stay flat through the blurs, sharpen and resize
+bool checkFlat()
+{
+    PPM flat(61, 43);
+    flat.fill(12, 200, 255);
+
+    FilterPipeline smooth;
+    smooth.boxBlur(4).gaussianBlur(3).sharpen(2).resize(100, 20);
+    const PPM result = smooth.run(flat);
+
+    PPM expected(100, 20);
+    expected.fill(12, 200, 255);
+    bool ok = samePixels(result, expected);
+
+    FilterPipeline edges;
+    edges.sobel();
+    ok = samePixels(edges.run(flat), PPM(61, 43)) && ok;
+
+    if (!ok) {
+        std::cout << "MISMATCH: a flat image changed\n";
+    }
+
+    // a box of every radius (whose equal weights don't all round the same
+    // way) leaves a flat grey image as it was
+    PPM grey(23, 17);
+    grey.fill(100, 100, 100);
+    for (unsigned int radius = 0; radius <= FILTER_MAX_BOX_RADIUS; radius++) {
+        FilterPipeline box;
+        box.boxBlur(radius);
+        if (!samePixels(box.run(grey), grey)) {
+            std::cout << "MISMATCH: box " << radius
+                      << " changed a flat grey image\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// best of RUNS runs, in ms
+double timeRun(const FilterPipeline& pipeline, const PPM& image,
+               ThreadPool& pool)
+{
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        const PPM result = pipeline.run(image, &pool);
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, ms.count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threads = std::max(4u, std::thread::hardware_concurrency());
+    if (argc == 3 && std::string(argv[1]) == "--threads") {
+        threads = std::max(1, std::atoi(argv[2]));
+    }
+
+    bool ok = checkFlat();
+    const size_t sizes[][2] = {{1, 1}, {2, 3}, {17, 5}, {300, 151}};
+    for (const size_t* size : sizes) {
+        ok = checkImage(size[0], size[1], std::min(threads, 4u)) && ok;
+    }
+    if (ok) {
+        std::cout << "every tile size, thread count and instruction set "
+                     "matches\n";
+    }
+
+    const PPM frame = randomImage(FRAME_WIDTH, FRAME_HEIGHT, 1);
+
+    std::vector<unsigned int> counts;
+    for (unsigned int t = 1; t < threads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(threads);
+
+    std::cout << std::fixed << std::setprecision(1) << "random "
+              << FRAME_WIDTH << "x" << FRAME_HEIGHT << ", ms on "
+              << ImageOps::isaName(ImageOps::bestIsa()) << "\n"
+              << std::left << std::setw(16) << "threads" << std::right;
+    for (unsigned int t : counts) {
+        std::cout << std::setw(9) << t;
+    }
+    std::cout << '\n';
+
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    for (unsigned int t : counts) {
+        pools.emplace_back(new ThreadPool(t));
+    }
+
+    for (NamedPipeline& named : pipelines(FRAME_WIDTH, FRAME_HEIGHT)) {
+        std::cout << std::left << std::setw(16) << named.name << std::right;
+        for (std::unique_ptr<ThreadPool>& pool : pools) {
+            std::cout << std::setw(9)
+                      << timeRun(named.pipeline, frame, *pool) << std::flush;
+        }
+        std::cout << '\n';
+    }
+
+    std::remove(TMP_FILE.c_str());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,294 @@
+/** @file ImageOpsBench.cpp
+ *  @brief Checks the ImageOps kernels against plain loops and times them
+ *
+ *  Every operation is run at every instruction set this CPU has, on random
+ *  spans of every length up to a few vector widths (so every tail is
+ *  covered) and at odd offsets, and has to give exactly the bytes of the
+ *  plain loop written out here. blend is also checked for every source,
+ *  destination and alpha. Then a random 4K and 8K frame are loaded from
+ *  P6 files and each operation is timed at every instruction set, next to
+ *  the loop PPM::darken used to have.
+ *
+ *  usage: ImageOpsBench   (run from Assignment0_CPlusPlus)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ImageOps.h"
+#include "PPM.h"
+
+using namespace ImageOps;
+
+static const std::string TMP_FILE = "./ImageOpsBench.tmp.ppm";
+
+static const size_t MAX_SPAN = 200;
+static const int RUNS = 5;
+
+// how PPM::darken worked before ImageOps
+void darkenOld(unsigned char* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        data[i] = (data[i] <= PPM_DARKEN_AMT ? 0 : data[i] - 50);
+    }
+}
+
+// the plain loops every version has to match
+
+void darkenReference(unsigned char* data, size_t count, unsigned char amount)
+{
+    for (size_t i = 0; i < count; i++) {
+        data[i] = data[i] < amount ? 0 : data[i] - amount;
+    }
+}
+
+void brightenReference(unsigned char* data, size_t count,
+                       unsigned char amount)
+{
+    for (size_t i = 0; i < count; i++) {
+        data[i] = data[i] + amount > 255 ? 255 : data[i] + amount;
+    }
+}
+
+void invertReference(unsigned char* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        data[i] = 255 - data[i];
+    }
+}
+
+void grayscaleReference(unsigned char* rgb, size_t pixels)
+{
+    for (size_t i = 0; i < 3 * pixels; i += 3) {
+        const unsigned int y =
+            (77 * rgb[i] + 150 * rgb[i + 1] + 29 * rgb[i + 2] + 128) / 256;
+        rgb[i] = rgb[i + 1] = rgb[i + 2] = (unsigned char)y;
+    }
+}
+
+unsigned char blendReference(unsigned int d, unsigned int s,
+                             unsigned int alpha)
+{
+    // t / 255 rounded half up, as (2t + 255) / 510
+    const unsigned int t = s * alpha + d * (255 - alpha);
+    return (unsigned char)((2 * t + 255) / 510);
+}
+
+std::vector<unsigned char> randomBytes(size_t count, std::mt19937& rng)
+{
+    std::vector<unsigned char> bytes(count);
+    for (unsigned char& b : bytes) {
+        b = (unsigned char)(rng() & 0xff);
+    }
+    return bytes;
+}
+
+// checks one operation at isa on random spans of every length and a few
+// offsets; op(data, count) and reference(data, count) change data in place
+template <typename Op, typename Reference>
+bool checkSpans(const char* what, Isa isa, Op op, Reference reference,
+                size_t unit = 1)
+{
+    std::mt19937 rng(7);
+    for (size_t count = 0; count <= MAX_SPAN; count++) {
+        for (size_t offset = 0; offset < 4; offset++) {
+            std::vector<unsigned char> data =
+                randomBytes(offset + count * unit + 4, rng);
+            std::vector<unsigned char> expected = data;
+
+            op(data.data() + offset, count);
+            reference(expected.data() + offset, count);
+
+            if (data != expected) {
+                std::cout << "MISMATCH: " << what << " (" << isaName(isa)
+                          << ") on " << count << " at offset " << offset
+                          << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkIsa(Isa isa)
+{
+    bool ok = true;
+    for (unsigned int amount : {0u, 1u, 50u, 200u, 255u}) {
+        const unsigned char n = (unsigned char)amount;
+        ok = checkSpans(
+                 "darken", isa,
+                 [&](unsigned char* d, size_t c) { darken(d, c, n, isa); },
+                 [&](unsigned char* d, size_t c) {
+                     darkenReference(d, c, n);
+                 }) &&
+             ok;
+        ok = checkSpans(
+                 "brighten", isa,
+                 [&](unsigned char* d, size_t c) { brighten(d, c, n, isa); },
+                 [&](unsigned char* d, size_t c) {
+                     brightenReference(d, c, n);
+                 }) &&
+             ok;
+    }
+
+    ok = checkSpans("invert", isa,
+                    [&](unsigned char* d, size_t c) { invert(d, c, isa); },
+                    invertReference) &&
+         ok;
+    ok = checkSpans("grayscale", isa,
+                    [&](unsigned char* d, size_t c) { grayscale(d, c, isa); },
+                    grayscaleReference, 3) &&
+         ok;
+
+    for (float g : {0.45f, 1.0f, 2.2f}) {
+        unsigned char table[256];
+        gammaTable(g, table);
+        ok = checkSpans(
+                 "applyTable", isa,
+                 [&](unsigned char* d, size_t c) {
+                     applyTable(d, c, table, isa);
+                 },
+                 [&](unsigned char* d, size_t c) {
+                     for (size_t i = 0; i < c; i++) d[i] = table[d[i]];
+                 }) &&
+             ok;
+    }
+
+    std::mt19937 rng(11);
+    for (unsigned int alpha : {0u, 1u, 128u, 254u, 255u}) {
+        const std::vector<unsigned char> src = randomBytes(MAX_SPAN + 4, rng);
+        ok = checkSpans(
+                 "blend", isa,
+                 [&](unsigned char* d, size_t c) {
+                     blend(d, src.data(), c, (unsigned char)alpha, isa);
+                 },
+                 [&](unsigned char* d, size_t c) {
+                     for (size_t i = 0; i < c; i++)
+                         d[i] = blendReference(d[i], src[i], alpha);
+                 }) &&
+             ok;
+    }
+
+    // every source and destination under every alpha: 256 spans of 65536
+    std::vector<unsigned char> dst(65536);
+    std::vector<unsigned char> src(65536);
+    for (unsigned int alpha = 0; alpha < 256; alpha++) {
+        for (size_t i = 0; i < dst.size(); i++) {
+            dst[i] = (unsigned char)(i & 0xff);
+            src[i] = (unsigned char)(i >> 8);
+        }
+        blend(dst.data(), src.data(), dst.size(), (unsigned char)alpha, isa);
+        for (size_t i = 0; i < dst.size(); i++) {
+            if (dst[i] != blendReference(i & 0xff, i >> 8, alpha)) {
+                std::cout << "MISMATCH: blend (" << isaName(isa) << ") of "
+                          << (i >> 8) << " over " << (i & 0xff) << " at "
+                          << alpha << '\n';
+                return false;
+            }
+        }
+    }
+
+    if (ok) {
+        std::cout << isaName(isa) << ": all match\n";
+    }
+    return ok;
+}
+
+// a width x height P6 of random pixels, saved as TMP_FILE
+void writeRandom(size_t width, size_t height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    const std::vector<unsigned char> pixels =
+        randomBytes(width * height * 3, rng);
+
+    std::ofstream out(TMP_FILE, std::ios::binary);
+    out << PPM_MAGIC_BINARY << '\n'
+        << width << ' ' << height << '\n'
+        << PPM_MAX << '\n';
+    out.write((const char*)pixels.data(), pixels.size());
+}
+
+// best of RUNS runs of op, in ms
+template <typename Op>
+double bestMs(Op op)
+{
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        op();
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, ms.count());
+    }
+    return best;
+}
+
+void printTime(const std::string& what, double ms, size_t bytes)
+{
+    std::cout << "  " << std::left << std::setw(22) << what << std::right
+              << std::setw(9) << ms << " ms " << std::setw(9)
+              << bytes / (1024.0 * 1024.0) / (ms / 1000) << " MB/s\n";
+}
+
+void bench(size_t width, size_t height)
+{
+    writeRandom(width, height, 1);
+    PPM image(TMP_FILE);
+    writeRandom(width, height, 2);
+    const PPM other(TMP_FILE);
+
+    unsigned char* data = image.pixelData();
+    const size_t count = width * height * 3;
+    unsigned char table[256];
+    gammaTable(2.2f, table);
+
+    std::cout << "random " << width << "x" << height << '\n';
+    printTime("darken (old loop)",
+              bestMs([&]() { darkenOld(data, count); }), count);
+
+    for (int i = SCALAR; i <= bestIsa(); i++) {
+        const Isa isa = (Isa)i;
+        const std::string name = std::string(" ") + isaName(isa);
+        printTime("darken" + name,
+                  bestMs([&]() { darken(data, count, 50, isa); }), count);
+        printTime("brighten" + name,
+                  bestMs([&]() { brighten(data, count, 50, isa); }), count);
+        printTime("invert" + name,
+                  bestMs([&]() { invert(data, count, isa); }), count);
+        printTime("grayscale" + name,
+                  bestMs([&]() { grayscale(data, count / 3, isa); }), count);
+        printTime("blend" + name, bestMs([&]() {
+                      blend(data, other.pixelData(), count, 100, isa);
+                  }),
+                  count);
+        printTime("gamma" + name,
+                  bestMs([&]() { applyTable(data, count, table, isa); }),
+                  count);
+    }
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(2)
+              << "best instruction set: " << isaName(bestIsa()) << '\n';
+
+    bool ok = true;
+    for (int i = SCALAR; i <= bestIsa(); i++) {
+        ok = checkIsa((Isa)i) && ok;
+    }
+
+    bench(3840, 2160);
+    bench(7680, 4320);
+
+    std::remove(TMP_FILE.c_str());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,169 @@
+/** @file LoadBench.cpp
+ *  @brief Times loading the same image as P3, P6, 16 bit P6 and P5
+ *
+ *  Each image given (or the ones under textures/) is written out in every
+ *  format the PPM class reads, then loaded back a few times. The binary
+ *  loads have to give exactly the pixels the P3 parser does, including
+ *  when maxval isn't 255 and the samples get rescaled.
+ *
+ *  usage: LoadBench [image.ppm ...]   (run from Assignment0_CPlusPlus)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PPM.h"
+
+static const char* DEFAULT_IMAGES[] = {
+    "./textures/test.ppm",
+    "./textures/test1.ppm",
+};
+
+static const std::string TMP_FILE = "./LoadBench.tmp.ppm";
+static const std::string TMP_FILE_P3 = "./LoadBench.tmp.p3.ppm";
+
+// loads each image
+static const int REPEATS = 5;
+
+// maxvals that make every sample get rescaled, one 2 byte and one 1 byte
+static const unsigned int ODD_MAXES[] = {1000, 85};
+
+// writes samples (one per channel) with the given magic and maxval;
+// P3 as text, the others as 1 or 2 byte binary
+void writeImage(const std::string& fileName, const char* magic, size_t width,
+                size_t height, unsigned int max,
+                const std::vector<unsigned int>& samples)
+{
+    std::ofstream out(fileName, std::ios::binary);
+    out << magic << "\n# LoadBench\n" << width << ' ' << height << '\n'
+        << max << '\n';
+
+    if (std::strcmp(magic, PPM_MAGIC) == 0) {
+        for (size_t i = 0; i < samples.size(); i++) {
+            out << samples[i] << (i % 12 == 11 ? '\n' : ' ');
+        }
+        return;
+    }
+
+    std::vector<char> raw;
+    for (unsigned int s : samples) {
+        if (max > PPM_MAX) {
+            raw.push_back((char)(s >> 8));
+        }
+        raw.push_back((char)(s & 0xff));
+    }
+    out.write(raw.data(), raw.size());
+}
+
+// ms per load of fileName, and whether it matches expected
+double timeLoad(const std::string& fileName, const unsigned char* expected,
+                size_t bytes, bool& same)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < REPEATS; i++) {
+        PPM image(fileName);
+        if (i == 0) {
+            same = std::memcmp(image.pixelData(), expected, bytes) == 0;
+        }
+    }
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    return ms.count() / REPEATS;
+}
+
+long fileSize(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+    return in ? (long)in.tellg() : -1;
+}
+
+void report(const char* format, const std::string& fileName, double ms,
+            bool same)
+{
+    std::cout << "  " << std::left << std::setw(22) << format << std::right
+              << std::setw(9) << ms << " ms  " << std::setw(9)
+              << fileSize(fileName) / 1024 << " KB"
+              << (same ? "" : "  MISMATCH") << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty()) {
+        files.assign(DEFAULT_IMAGES, DEFAULT_IMAGES + 2);
+    }
+
+    bool ok = true;
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const std::string& file : files) {
+        PPM original(file);
+        const size_t width = original.getWidth();
+        const size_t height = original.getHeight();
+        const size_t bytes = width * height * 3;
+        const unsigned char* pixels = original.pixelData();
+
+        std::cout << file << ": " << width << "x" << height << '\n';
+
+        bool same = true;
+        double ms = timeLoad(file, pixels, bytes, same);
+        report("P3 (as given)", file, ms, same);
+        ok = ok && same;
+
+        original.savePPM(TMP_FILE, true);
+        ms = timeLoad(TMP_FILE, pixels, bytes, same);
+        report("P6", TMP_FILE, ms, same);
+        ok = ok && same;
+
+        // every 8 bit value v as v * 257 of 65535 scales back to v exactly
+        std::vector<unsigned int> samples(pixels, pixels + bytes);
+        for (unsigned int& s : samples) {
+            s *= 257;
+        }
+        writeImage(TMP_FILE, PPM_MAGIC_BINARY, width, height, PPM_MAX_WIDE,
+                   samples);
+        ms = timeLoad(TMP_FILE, pixels, bytes, same);
+        report("P6 16 bit", TMP_FILE, ms, same);
+        ok = ok && same;
+
+        // with an odd maxval the binary rescale has to match P3's
+        for (unsigned int max : ODD_MAXES) {
+            for (size_t i = 0; i < bytes; i++) {
+                samples[i] = pixels[i] * max / PPM_MAX;
+            }
+            writeImage(TMP_FILE_P3, PPM_MAGIC, width, height, max, samples);
+            PPM ascii(TMP_FILE_P3);
+
+            writeImage(TMP_FILE, PPM_MAGIC_BINARY, width, height, max,
+                       samples);
+            ms = timeLoad(TMP_FILE, ascii.pixelData(), bytes, same);
+            report(("P6 max " + std::to_string(max)).c_str(), TMP_FILE, ms,
+                   same);
+            ok = ok && same;
+        }
+
+        // greyscale from the red channel comes back as R = G = B
+        std::vector<unsigned int> grey(width * height);
+        std::vector<unsigned char> greyPixels(bytes);
+        for (size_t i = 0; i < grey.size(); i++) {
+            grey[i] = pixels[3 * i];
+            std::memset(&greyPixels[3 * i], pixels[3 * i], 3);
+        }
+        writeImage(TMP_FILE, PGM_MAGIC_BINARY, width, height, PPM_MAX, grey);
+        ms = timeLoad(TMP_FILE, greyPixels.data(), bytes, same);
+        report("P5", TMP_FILE, ms, same);
+        ok = ok && same;
+    }
+
+    std::remove(TMP_FILE.c_str());
+    std::remove(TMP_FILE_P3.c_str());
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
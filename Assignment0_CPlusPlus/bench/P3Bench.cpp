@@ -0,0 +1,210 @@
+/** @file P3Bench.cpp
+ *  @brief Checks the P3 decoder against the old istream parser and times it
+ *
+ *  Every P3 image given (or every .ppm in the repository, found from ..) is
+ *  loaded with the parser PPM used to have (operator>> and cmt for each
+ *  sample) and with the PPM class, on one thread and on several. They have
+ *  to give exactly the same pixels. A few made up files cover what the
+ *  images don't: comments between and right after samples, CRLF line
+ *  breaks, long numbers, odd maxvals, junk and text that stops early.
+ *
+ *  usage: P3Bench [--threads <n>] [image.ppm ...]
+ *         (run from Assignment0_CPlusPlus)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PPM.h"
+
+static const char* DEFAULT_ROOT = "..";
+static const std::string TMP_FILE = "./P3Bench.tmp.ppm";
+
+// what PPM's constructor did before the decoder: skip comments...
+std::istream& cmt(std::istream& is)
+{
+    is >> std::ws;
+    while (is.peek() == '#') {
+        is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        is >> std::ws;
+    }
+    return is;
+}
+
+// ...and read each sample with operator>> (r, g and b start at 0 here; the
+// old code left them uninitialized, so once a read failed it kept whatever
+// they held)
+std::vector<unsigned char> loadReference(const std::string& fileName,
+                                         size_t& width, size_t& height)
+{
+    std::ifstream infile(fileName);
+    std::string magic;
+    size_t max;
+    infile >> magic >> cmt >> width >> cmt >> height >> cmt >> max;
+
+    std::vector<unsigned char> pixels(width * height * 3);
+    for (size_t i = 0; i < pixels.size(); i += 3) {
+        size_t r = 0, g = 0, b = 0;
+        infile >> cmt >> r >> cmt >> g >> cmt >> b;
+        pixels[i] = scale(r, max, PPM_MAX);
+        pixels[i + 1] = scale(g, max, PPM_MAX);
+        pixels[i + 2] = scale(b, max, PPM_MAX);
+    }
+    return pixels;
+}
+
+bool isP3(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    char magic[2] = {0, 0};
+    in.read(magic, 2);
+    return magic[0] == 'P' && magic[1] == '3';
+}
+
+template <typename Load>
+double timeMs(Load load)
+{
+    auto start = std::chrono::steady_clock::now();
+    load();
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    return ms.count();
+}
+
+// loads fileName every way, printing the times; false on a mismatch
+bool check(const std::string& fileName, unsigned int threads, bool quiet)
+{
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<unsigned char> expected;
+    const double referenceMs =
+        timeMs([&]() { expected = loadReference(fileName, width, height); });
+
+    bool same = true;
+    double ms[2] = {0, 0};
+    const unsigned int counts[2] = {1, threads};
+
+    for (int i = 0; i < 2; i++) {
+        ms[i] = timeMs([&]() {
+            PPM image(fileName, counts[i]);
+            same = same && image.getWidth() == width &&
+                   image.getHeight() == height &&
+                   std::equal(expected.begin(), expected.end(),
+                              image.pixelData());
+        });
+    }
+
+    if (!quiet || !same) {
+        std::cout << std::left << std::setw(58) << fileName << std::right
+                  << std::setw(9) << referenceMs << std::setw(9) << ms[0]
+                  << std::setw(9) << ms[1]
+                  << (same ? "" : "  MISMATCH") << '\n';
+    }
+    return same;
+}
+
+// made up files for what the bundled images don't have
+bool checkEdgeCases(unsigned int threads)
+{
+    const char* cases[] = {
+        "P3\n2 2\n255\n0 1 2 3 4 5 6 7 8 9 10 11\n",
+        "P3 # comment\n2 2 # another\n# whole line\n255\n"
+        "1 2 3#right after a sample\n4 5\t6\r\n7 8 9 # 99 99\n10 11 12\n",
+        "P3\n2 1\n15\n0 7 15 16 3 1\n",
+        "P3\n2 1\n1000\n0 999 1000 1 500 2000\n",
+        "P3\n3 1\n255\n0000000000000000000000255 17 0018 1 2 3 4 5 6\n",
+        "P3\n2 2\n255\n1 2 3 4 5\n",
+        "P3\n2 2\n255\n1 2 3 4 x 6 7 8 9 10 11 12\n",
+        "P3\n2 2\n255\n1 2 3 4 5a 6 7 8 9 10 11 12\n",
+        "P3\n2 2\n255\n300 2 3 4 5 6 7 8 9 10 11 1200\n",
+        "P3\n1 1\n255\n# nothing but a comment, no newline",
+    };
+
+    bool ok = true;
+    for (const char* text : cases) {
+        {
+            std::ofstream out(TMP_FILE, std::ios::binary);
+            out << text;
+        }
+        ok = check(TMP_FILE, threads, true) && ok;
+    }
+
+    // a long file in one long line and in short lines, so the threads get
+    // pieces; with comments sprinkled through
+    for (int lineLength : {100000000, 7}) {
+        {
+            std::ofstream out(TMP_FILE, std::ios::binary);
+            out << "P3\n640 480\n4095\n";
+            unsigned int seed = 1;
+            for (int i = 0; i < 640 * 480 * 3; i++) {
+                seed = seed * 1103515245 + 12345;
+                out << (seed >> 8) % 4096
+                    << (i % lineLength == lineLength - 1 ? "\n" : " ");
+                if (i % 9973 == 0) {
+                    out << "# comment 1 2 3\n";
+                }
+            }
+        }
+        ok = check(TMP_FILE, threads, true) && ok;
+    }
+
+    std::remove(TMP_FILE.c_str());
+    if (ok) {
+        std::cout << "edge cases: all match\n";
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        for (const auto& entry :
+             std::filesystem::recursive_directory_iterator(DEFAULT_ROOT)) {
+            if (entry.is_regular_file() &&
+                entry.path().extension() == ".ppm" &&
+                isP3(entry.path().string())) {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+
+    std::cout << std::fixed << std::setprecision(1) << std::left
+              << std::setw(58) << "ms per load" << std::right << std::setw(9)
+              << "istream" << std::setw(9) << "decoder" << std::setw(6)
+              << threads << " thr\n";
+
+    bool ok = checkEdgeCases(threads);
+
+    for (const std::string& file : files) {
+        ok = check(file, threads, false) && ok;
+    }
+
+    std::cout << files.size() << " images, "
+              << (ok ? "all match" : "MISMATCHES") << '\n';
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,302 @@
+/** @file PixelBench.cpp
+ *  @brief Checks the PPM row and rectangle operations and times pixel loops
+ *
+ *  fill, copyRect and blit are checked against pixel by pixel copies on
+ *  small random images, with rectangles that overlap in every direction and
+ *  run off either image. Then on a random 4K frame, loops that write, read
+ *  and copy every pixel are timed three ways: with getPixel and setPixel
+ *  as they used to be (a call and an x % width per pixel), with the inline
+ *  ones, and walking rows, next to fill, copyRect and blit.
+ *
+ *  usage: PixelBench   (run from Assignment0_CPlusPlus)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PPM.h"
+
+static const std::string TMP_FILE = "./PixelBench.tmp.ppm";
+
+static const size_t FRAME_WIDTH = 3840;
+static const size_t FRAME_HEIGHT = 2160;
+static const int RUNS = 5;
+
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+// getPixel and setPixel as they were, out of line with a modulo
+NOINLINE unsigned char* getPixelOld(const PPM& ppm, size_t x, size_t y)
+{
+    return &ppm.pixelData()[3 * (y * ppm.getWidth() + x % ppm.getWidth())];
+}
+
+NOINLINE void setPixelOld(PPM& ppm, size_t x, size_t y, unsigned char R,
+                          unsigned char G, unsigned char B)
+{
+    size_t basei = 3 * (y * ppm.getWidth() + x % ppm.getWidth());
+    ppm.pixelData()[basei] = R;
+    ppm.pixelData()[basei + 1] = G;
+    ppm.pixelData()[basei + 2] = B;
+}
+
+// a width x height P6 of random pixels, saved as TMP_FILE
+void writeRandom(size_t width, size_t height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<char> pixels(width * height * 3);
+    for (char& p : pixels) {
+        p = (char)(rng() & 0xff);
+    }
+
+    std::ofstream out(TMP_FILE, std::ios::binary);
+    out << PPM_MAGIC_BINARY << '\n'
+        << width << ' ' << height << '\n'
+        << PPM_MAX << '\n';
+    out.write(pixels.data(), pixels.size());
+}
+
+std::vector<unsigned char> pixelsOf(const PPM& ppm)
+{
+    return std::vector<unsigned char>(
+        ppm.pixelData(),
+        ppm.pixelData() + ppm.getWidth() * ppm.getHeight() * 3);
+}
+
+// what copyRect should do, one pixel at a time from a copy of src
+void copyRectReference(std::vector<unsigned char>& dst, size_t dstWidth,
+                       size_t dstHeight, const std::vector<unsigned char>& src,
+                       size_t srcWidth, size_t srcHeight, size_t srcX,
+                       size_t srcY, size_t width, size_t height, size_t x,
+                       size_t y)
+{
+    for (size_t j = 0; j < height; j++) {
+        for (size_t i = 0; i < width; i++) {
+            if (srcX + i >= srcWidth || srcY + j >= srcHeight ||
+                x + i >= dstWidth || y + j >= dstHeight) {
+                continue;
+            }
+            for (size_t c = 0; c < 3; c++) {
+                dst[3 * ((y + j) * dstWidth + x + i) + c] =
+                    src[3 * ((srcY + j) * srcWidth + srcX + i) + c];
+            }
+        }
+    }
+}
+
+bool checkRects()
+{
+    std::mt19937 rng(3);
+    bool ok = true;
+
+    for (int trial = 0; trial < 2000 && ok; trial++) {
+        writeRandom(1 + rng() % 20, 1 + rng() % 20, trial);
+        PPM image(TMP_FILE);
+        writeRandom(1 + rng() % 20, 1 + rng() % 20, trial + 10000);
+        const PPM other(TMP_FILE);
+
+        const size_t w = image.getWidth();
+        const size_t h = image.getHeight();
+        const bool self = trial % 2 == 0;
+        const PPM& src = self ? image : other;
+
+        std::vector<unsigned char> expected = pixelsOf(image);
+        const std::vector<unsigned char> before = pixelsOf(src);
+
+        const size_t srcX = rng() % (src.getWidth() + 2);
+        const size_t srcY = rng() % (src.getHeight() + 2);
+        const size_t width = rng() % 24;
+        const size_t height = rng() % 24;
+        const size_t x = rng() % (w + 2);
+        const size_t y = rng() % (h + 2);
+
+        switch (trial % 6) {
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+                copyRectReference(expected, w, h, before, src.getWidth(),
+                                  src.getHeight(), srcX, srcY, width, height,
+                                  x, y);
+                image.copyRect(src, srcX, srcY, width, height, x, y);
+                break;
+            case 4:
+                copyRectReference(expected, w, h, before, src.getWidth(),
+                                  src.getHeight(), 0, 0, src.getWidth(),
+                                  src.getHeight(), x, y);
+                image.blit(src, x, y);
+                break;
+            default: {
+                const unsigned char colour[3] = {7, 8, 9};
+                for (size_t j = y; j < std::min(h, y + height); j++) {
+                    for (size_t i = x; i < std::min(w, x + width); i++) {
+                        std::copy(colour, colour + 3,
+                                  expected.begin() + 3 * (j * w + i));
+                    }
+                }
+                image.fill(x, y, width, height, 7, 8, 9);
+                break;
+            }
+        }
+
+        if (pixelsOf(image) != expected) {
+            std::cout << "MISMATCH: trial " << trial << " (" << w << "x" << h
+                      << (self ? ", same image" : "") << ")\n";
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        std::cout << "fill, copyRect and blit: all match\n";
+    }
+    return ok;
+}
+
+// best of RUNS runs of op, in ms
+template <typename Op>
+double bestMs(Op op)
+{
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        op();
+        std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, ms.count());
+    }
+    return best;
+}
+
+void printTime(const char* what, double ms)
+{
+    std::cout << "  " << std::left << std::setw(30) << what << std::right
+              << std::setw(9) << ms << " ms\n";
+}
+
+// sums every sample, so reads can't be thrown away
+size_t sumOld(const PPM& ppm)
+{
+    size_t sum = 0;
+    for (size_t y = 0; y < ppm.getHeight(); y++) {
+        for (size_t x = 0; x < ppm.getWidth(); x++) {
+            const unsigned char* p = getPixelOld(ppm, x, y);
+            sum += p[0] + p[1] + p[2];
+        }
+    }
+    return sum;
+}
+
+size_t sumGetPixel(const PPM& ppm)
+{
+    size_t sum = 0;
+    for (size_t y = 0; y < ppm.getHeight(); y++) {
+        for (size_t x = 0; x < ppm.getWidth(); x++) {
+            const unsigned char* p = ppm.getPixel(x, y);
+            sum += p[0] + p[1] + p[2];
+        }
+    }
+    return sum;
+}
+
+size_t sumRows(const PPM& ppm)
+{
+    size_t sum = 0;
+    for (size_t y = 0; y < ppm.getHeight(); y++) {
+        const PPMRow row = ppm.row(y);
+        for (const unsigned char* p = row.begin(); p != row.end(); p++) {
+            sum += *p;
+        }
+    }
+    return sum;
+}
+
+int main()
+{
+    bool ok = checkRects();
+
+    writeRandom(FRAME_WIDTH, FRAME_HEIGHT, 1);
+    PPM frame(TMP_FILE);
+    writeRandom(FRAME_WIDTH, FRAME_HEIGHT, 2);
+    const PPM other(TMP_FILE);
+    const size_t w = FRAME_WIDTH;
+    const size_t h = FRAME_HEIGHT;
+
+    std::cout << std::fixed << std::setprecision(2) << "random " << w << "x"
+              << h << '\n';
+
+    // write a gradient into every pixel
+    printTime("gradient, old setPixel", bestMs([&]() {
+                  for (size_t y = 0; y < h; y++)
+                      for (size_t x = 0; x < w; x++)
+                          setPixelOld(frame, x, y, x, y, x + y);
+              }));
+    const std::vector<unsigned char> gradient = pixelsOf(frame);
+    printTime("gradient, setPixel", bestMs([&]() {
+                  for (size_t y = 0; y < h; y++)
+                      for (size_t x = 0; x < w; x++)
+                          frame.setPixel(x, y, x, y, x + y);
+              }));
+    ok = pixelsOf(frame) == gradient && ok;
+    printTime("gradient, rows", bestMs([&]() {
+                  for (size_t y = 0; y < h; y++) {
+                      const PPMRow row = frame.row(y);
+                      for (size_t x = 0; x < w; x++) {
+                          unsigned char* p = row[x];
+                          p[0] = x;
+                          p[1] = y;
+                          p[2] = x + y;
+                      }
+                  }
+              }));
+    ok = pixelsOf(frame) == gradient && ok;
+
+    // read every pixel
+    size_t sums[3] = {0, 0, 0};
+    printTime("sum, old getPixel",
+              bestMs([&]() { sums[0] = sumOld(frame); }));
+    printTime("sum, getPixel", bestMs([&]() { sums[1] = sumGetPixel(frame); }));
+    printTime("sum, rows", bestMs([&]() { sums[2] = sumRows(frame); }));
+    ok = sums[0] == sums[1] && sums[1] == sums[2] && ok;
+
+    // one colour everywhere
+    printTime("fill, old setPixel", bestMs([&]() {
+                  for (size_t y = 0; y < h; y++)
+                      for (size_t x = 0; x < w; x++)
+                          setPixelOld(frame, x, y, 10, 20, 30);
+              }));
+    printTime("fill", bestMs([&]() { frame.fill(10, 20, 30); }));
+
+    // copy another image over this one
+    printTime("copy, old get/setPixel", bestMs([&]() {
+                  for (size_t y = 0; y < h; y++)
+                      for (size_t x = 0; x < w; x++) {
+                          const unsigned char* p = getPixelOld(other, x, y);
+                          setPixelOld(frame, x, y, p[0], p[1], p[2]);
+                      }
+              }));
+    printTime("blit", bestMs([&]() { frame.blit(other, 0, 0); }));
+    ok = pixelsOf(frame) == pixelsOf(other) && ok;
+
+    // scroll the image up by one row, over itself
+    printTime("scroll, copyRect", bestMs([&]() {
+                  frame.copyRect(frame, 0, 1, w, h - 1, 0, 0);
+              }));
+
+    if (!ok) {
+        std::cout << "MISMATCH: the pixel loops disagree\n";
+    }
+
+    std::remove(TMP_FILE.c_str());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,142 @@
+/** @file WriteBench.cpp
+ *  @brief Times writing PPMs and checks the P3 text hasn't changed
+ *
+ *  Writes a random 4K frame (and any images given) to a file the way
+ *  operator<< used to (iostream << per sample, std::endl per line), then
+ *  with PPM::write as P3 and as P6, printing the time and throughput of
+ *  each. The P3 output has to be byte for byte what the old operator
+ *  wrote, which is also checked on small images of every width around
+ *  PPM_PIXELS_PER_LINE.
+ *
+ *  usage: WriteBench [image.ppm ...]   (run from Assignment0_CPlusPlus)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PPM.h"
+
+static const std::string TMP_FILE = "./WriteBench.tmp.ppm";
+
+static const size_t FRAME_WIDTH = 3840;
+static const size_t FRAME_HEIGHT = 2160;
+
+// how operator<< wrote a PPM before PPM::write
+void writeOld(std::ostream& os, const PPM& ppm)
+{
+    os << "P3" << std::endl;
+    os << ppm.getWidth() << ' ' << ppm.getHeight() << std::endl;
+    os << PPM_MAX << std::endl;
+
+    for (int y = 0; y < (int)ppm.getHeight(); y++) {
+        for (int x = 0; x < (int)ppm.getWidth(); x++) {
+            unsigned char* pixel = ppm.getPixel(x, y);
+            os << +pixel[0] << " " << +pixel[1] << " " << +pixel[2];
+
+            if (x % PPM_PIXELS_PER_LINE == PPM_PIXELS_PER_LINE - 1)
+                os << std::endl;
+            else if (x < (int)ppm.getWidth() - 1)
+                os << "  ";
+        }
+        os << std::endl;
+    }
+}
+
+// a width x height P6 of random pixels, saved as TMP_FILE
+void writeRandom(size_t width, size_t height, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<char> pixels(width * height * 3);
+    for (char& p : pixels) {
+        p = (char)(rng() & 0xff);
+    }
+
+    std::ofstream out(TMP_FILE, std::ios::binary);
+    out << PPM_MAGIC_BINARY << '\n'
+        << width << ' ' << height << '\n'
+        << PPM_MAX << '\n';
+    out.write(pixels.data(), pixels.size());
+}
+
+// true if write gives the old operator's text
+bool sameText(const PPM& ppm)
+{
+    std::ostringstream before;
+    std::ostringstream after;
+    writeOld(before, ppm);
+    after << ppm;
+    return before.str() == after.str();
+}
+
+template <typename Write>
+void timeWrite(const char* what, Write write)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::ofstream out(TMP_FILE, std::ios::binary);
+        write(out);
+    }
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+
+    std::ifstream in(TMP_FILE, std::ios::binary | std::ios::ate);
+    const double mb = (double)in.tellg() / (1024 * 1024);
+
+    std::cout << "  " << std::left << std::setw(12) << what << std::right
+              << std::setw(10) << ms.count() << " ms " << std::setw(9)
+              << mb / (ms.count() / 1000) << " MB/s\n";
+}
+
+// times every writer on one image; false if the P3 text changed
+bool bench(const PPM& ppm)
+{
+    timeWrite("operator<<", [&](std::ostream& os) { writeOld(os, ppm); });
+    timeWrite("write P3", [&](std::ostream& os) { ppm.write(os); });
+    timeWrite("write P6", [&](std::ostream& os) { ppm.write(os, true); });
+
+    if (!sameText(ppm)) {
+        std::cout << "  MISMATCH: the P3 text changed\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool ok = true;
+    std::cout << std::fixed << std::setprecision(1);
+
+    // every line length around a full line, and partial last lines
+    for (size_t width = 1; width <= 3 * PPM_PIXELS_PER_LINE + 1; width++) {
+        writeRandom(width, 3, (unsigned int)width);
+        PPM small(TMP_FILE);
+        if (!sameText(small)) {
+            std::cout << "MISMATCH: " << width << " wide P3 text changed\n";
+            ok = false;
+        }
+    }
+
+    writeRandom(FRAME_WIDTH, FRAME_HEIGHT, 1);
+    {
+        PPM frame(TMP_FILE);
+        std::cout << "random " << FRAME_WIDTH << "x" << FRAME_HEIGHT << '\n';
+        ok = bench(frame) && ok;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        PPM image(argv[i]);
+        std::cout << argv[i] << '\n';
+        ok = bench(image) && ok;
+    }
+
+    std::remove(TMP_FILE.c_str());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
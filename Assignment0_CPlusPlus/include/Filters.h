@@ -0,0 +1,89 @@
+/** @file Filters.h
+ *  @brief Blur, sharpen, edge and resize filters run in tiles on threads
+ *
+ *  A FilterPipeline is a chain of filters, set up once and run on any
+ *  number of images. Each filter makes a new image, cut into tiles about
+ *  the size of the cache; a tile reads a border (its halo) of the pixels
+ *  around it from the image before, clamped at the edges, so tiles don't
+ *  depend on one another and run on a ThreadPool in any order.
+ *
+ *  Blurs are separable: a row pass into 16 bit sums, then a column pass,
+ *  8 samples at a time with SSE2. All the arithmetic is integer, so the
+ *  result is the same bytes whatever the tile size, thread count or
+ *  instruction set.
+ *
+ *  @author Michael Hebert
+ *  @bug Filters run one after another over the whole image; a chain is not
+ *       fused into one pass per tile.
+ */
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ImageOps.h"
+#include "PPM.h"
+
+class ThreadPool;
+
+// default tile size, in pixels
+static const size_t FILTER_TILE_WIDTH = 128;
+static const size_t FILTER_TILE_HEIGHT = 64;
+
+// largest box blur radius (its weights are 256ths)
+static const unsigned int FILTER_MAX_BOX_RADIUS = 127;
+
+class FilterPipeline {
+public:
+    // Adds a blur by the average of the (2 radius + 1)^2 square around each
+    // pixel (radius at most FILTER_MAX_BOX_RADIUS)
+    FilterPipeline& boxBlur(unsigned int radius);
+
+    // Adds a gaussian blur, to 3 sigma
+    FilterPipeline& gaussianBlur(float sigma);
+
+    // Adds an unsharp mask: each sample moves away from the average of its
+    // 4 neighbours by amount times the difference
+    FilterPipeline& sharpen(float amount);
+
+    // Adds a Sobel edge filter: each sample becomes (|gx| + |gy|) / 4 of
+    // its channel, at most PPM_MAX
+    FilterPipeline& sobel();
+
+    // Adds a bilinear resize to width x height (pixel centres line up;
+    // shrinking by more than half skips pixels)
+    FilterPipeline& resize(size_t width, size_t height);
+
+    // Sets the size of the tiles the filters are run in
+    void setTileSize(size_t width, size_t height);
+
+    // Filters src. Tiles are spread over pool, or all run on this thread
+    // if there is none; isa picks the instruction set for the blurs.
+    PPM run(const PPM& src, ThreadPool* pool = nullptr,
+            ImageOps::Isa isa = ImageOps::bestIsa()) const;
+
+    // Number of filters in the chain
+    inline size_t size() const { return m_stages.size(); }
+
+private:
+    enum Kind { SEPARABLE, SHARPEN, SOBEL, RESIZE };
+
+    struct Stage {
+        Kind kind;
+        std::vector<unsigned short> weights;  // SEPARABLE: 2 radius + 1
+        int amount;                           // SHARPEN: 256ths
+        size_t width;                         // RESIZE
+        size_t height;                        // RESIZE
+    };
+
+    // Runs one stage from src into dst (already the right size)
+    void runStage(const Stage& stage, const PPM& src, PPM& dst,
+                  ThreadPool* pool, ImageOps::Isa isa) const;
+
+    std::vector<Stage> m_stages;
+    size_t m_tileWidth{FILTER_TILE_WIDTH};
+    size_t m_tileHeight{FILTER_TILE_HEIGHT};
+};
+
+#endif
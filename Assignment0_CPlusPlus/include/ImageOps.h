@@ -0,0 +1,70 @@
+/** @file ImageOps.h
+ *  @brief Per-channel image operations on PPM pixel data
+ *
+ *  Saturating darken and brighten, invert, luma grayscale, alpha blending
+ *  and table lookups (gamma), each with a scalar, an SSE2 and an AVX2
+ *  version. By default the best one the CPU supports is picked at run
+ *  time; every version gives exactly the same bytes as the scalar one.
+ *
+ *  @author Michael Hebert
+ *  @bug No known bugs.
+ */
+#ifndef IMAGE_OPS_H
+#define IMAGE_OPS_H
+
+#include <cstddef>
+
+#include "PPM.h"
+
+namespace ImageOps {
+
+// instruction sets the operations come in, worst to best
+enum Isa { SCALAR, SSE2, AVX2 };
+
+// The best instruction set this CPU (and build) can run
+Isa bestIsa();
+
+// A name for an instruction set, for printing
+const char* isaName(Isa isa);
+
+// Subtracts amount from count bytes, stopping at 0
+void darken(unsigned char* data, size_t count, unsigned char amount,
+            Isa isa = bestIsa());
+
+// Adds amount to count bytes, stopping at 255
+void brighten(unsigned char* data, size_t count, unsigned char amount,
+              Isa isa = bestIsa());
+
+// Replaces each of count bytes v with 255 - v
+void invert(unsigned char* data, size_t count, Isa isa = bestIsa());
+
+// Sets R, G and B of each of pixels RGB pixels to its luma,
+// (77 R + 150 G + 29 B + 128) / 256 (BT.601 weights in 8 bit fixed point)
+void grayscale(unsigned char* rgb, size_t pixels, Isa isa = bestIsa());
+
+// Blends src over dst: dst = (src * alpha + dst * (255 - alpha)) / 255,
+// rounded to nearest, for count bytes
+void blend(unsigned char* dst, const unsigned char* src, size_t count,
+           unsigned char alpha, Isa isa = bestIsa());
+
+// Replaces each of count bytes v with table[v]
+void applyTable(unsigned char* data, size_t count,
+                const unsigned char table[256], Isa isa = bestIsa());
+
+// Fills table with 255 * (v / 255)^gamma, rounded, for every byte v
+void gammaTable(float gamma, unsigned char table[256]);
+
+// The same on whole images
+void darken(PPM& image, unsigned char amount);
+void brighten(PPM& image, unsigned char amount);
+void invert(PPM& image);
+void grayscale(PPM& image);
+void gamma(PPM& image, float gamma);
+
+// Blends src over image; returns EXIT_FAILURE (and leaves image alone) if
+// they aren't the same size
+int blend(PPM& image, const PPM& src, unsigned char alpha);
+
+}  // namespace ImageOps
+
+#endif
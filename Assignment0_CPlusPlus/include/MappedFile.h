@@ -0,0 +1,42 @@
+/** @file MappedFile.h
+ *  @brief Read-only memory mapping of a whole file
+ *
+ *  The mapping lives as long as the object does. Empty files map to a null
+ *  pointer with size 0.
+ *
+ *  @author Michael Hebert
+ *  @bug No known bugs.
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps a file and unmaps the old one. Returns EXIT_SUCCESS on success.
+    int open(const std::string& fileName);
+
+    // Unmaps the file (safe to call more than once)
+    void close();
+
+    inline bool isOpen() const { return m_open; }
+
+    inline const char* data() const { return m_data; }
+    inline const char* end() const { return m_data + m_size; }
+    inline size_t size() const { return m_size; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_open;
+};
+
+#endif
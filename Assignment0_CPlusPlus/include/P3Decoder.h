@@ -0,0 +1,27 @@
+/** @file P3Decoder.h
+ *  @brief Decoder for the ASCII raster of a P3 image
+ *
+ *  Parses the samples of a P3 file straight out of memory (a mapped file)
+ *  into an RGB buffer, 16 bytes at a time where SSE2 is available.
+ *  Optionally splits the text across threads at line breaks.
+ *
+ *  The result is the same as reading each sample with istream >> and
+ *  scaling it with scale(), comments included: a sample that can't be read
+ *  stops the decode, and it and every sample after it become 0.
+ *
+ *  @author Michael Hebert
+ *  @bug Signs ('+' or '-') in front of a sample are not accepted.
+ */
+#ifndef P3_DECODER_H
+#define P3_DECODER_H
+
+#include <cstddef>
+
+// Decodes samples values from [begin, end), which starts right after the
+// maxval of a P3 header, scaling each from [0, max] to [0, PPM_MAX] into
+// out. Uses up to threads threads. Returns how many samples were read
+// before the text ran out or went bad; the rest of out is set to 0.
+size_t decodeP3(const char* begin, const char* end, size_t max,
+                unsigned char* out, size_t samples, unsigned int threads = 1);
+
+#endif
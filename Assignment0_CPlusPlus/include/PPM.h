@@ -1,7 +1,8 @@
 /** @file PPM.h
  *  @brief Class for working with PPM images
  *
- *  Class for working with P3 PPM images specifically.
+ *  Class for working with PPM images: ASCII P3, binary P6 and binary
+ *  greyscale P5 (loaded as RGB), with 8 or 16 bit samples.
  *
  *  @author Michael Hebert
  *  @bug No known bugs.
@@ -13,42 +14,76 @@
 #include <string>
 
 static const char* PPM_MAGIC = "P3";
+static const char* PPM_MAGIC_BINARY = "P6";
+static const char* PGM_MAGIC_BINARY = "P5";
 static const size_t PPM_MAX = 255;
+// largest maxval a file may have; above PPM_MAX binary samples are 2 bytes
+static const size_t PPM_MAX_WIDE = 65535;
 static const int PPM_PIXELS_PER_LINE = 8;
 static const unsigned char PPM_DARKEN_AMT = 50;
 
+// scales x from range [0, a] to range [0, b]
+size_t scale(const size_t x, const size_t a, size_t b);
+
+// One row of a PPM: width R,G,B triples, back to back. It points into the
+// image, so it is only good while the image is.
+class PPMRow {
+public:
+    PPMRow(unsigned char* data, size_t width) : m_data(data), m_width(width)
+    {
+    }
+
+    // The R,G,B of pixel x (no bounds check)
+    inline unsigned char* operator[](size_t x) const { return m_data + 3 * x; }
+
+    // The bytes of the row, to loop over 3 at a time
+    inline unsigned char* begin() const { return m_data; }
+    inline unsigned char* end() const { return m_data + 3 * m_width; }
+
+    // Pixels in the row
+    inline size_t size() const { return m_width; }
+
+    // Bytes in the row (3 per pixel)
+    inline size_t bytes() const { return 3 * m_width; }
+
+private:
+    unsigned char* m_data;
+    size_t m_width;
+};
+
 class PPM {
 public:
-    // Constructor loads a filename with the .ppm extension
-    PPM(std::string fileName);
+    // Constructor loads a filename with the .ppm extension. A P3 raster is
+    // decoded on up to threads threads.
+    PPM(std::string fileName, unsigned int threads = 1);
+
+    // Constructor makes a black width x height image
+    PPM(size_t width, size_t height);
+
+    // Images own their pixels, so they can be moved but not copied
+    PPM(PPM&& other);
+    PPM& operator=(PPM&& other);
+    PPM(const PPM&) = delete;
+    PPM& operator=(const PPM&) = delete;
 
     // Destructor clears any memory that has been allocated
     ~PPM();
 
-    // overload << operator to print to streams
+    // overload << operator to print to streams (as P3)
     inline friend std::ostream& operator<<(std::ostream& os, const PPM& ppm)
     {
-        os << "P3" << std::endl;
-        os << ppm.getWidth() << ' ' << ppm.getHeight() << std::endl;
-        os << PPM_MAX << std::endl;
-
-        for (int y = 0; y < ppm.getHeight(); y++) {
-            for (int x = 0; x < ppm.getWidth(); x++) {
-                unsigned char* pixel = ppm.getPixel(x, y);
-                os << +pixel[0] << " " << +pixel[1] << " " << +pixel[2];
-
-                // add newline if at max, or space between them
-                if (x % PPM_PIXELS_PER_LINE == PPM_PIXELS_PER_LINE - 1) os << std::endl;
-                else if (x < ppm.getWidth() - 1) os << "  ";
-            }
-            os << std::endl;
-        }
-
+        ppm.write(os);
         return os;
     }
 
-    // Saves a PPM Image to a new file.
-    void savePPM(std::string outputFileName) const;
+    // Writes the image to a stream as binary P6 if binary is set, otherwise
+    // as ASCII P3 with PPM_PIXELS_PER_LINE pixels to a line. Rows are
+    // formatted into a buffer that goes out in large writes.
+    void write(std::ostream& os, bool binary = false) const;
+
+    // Saves a PPM Image to a new file, as binary P6 if binary is set
+    // (otherwise ASCII P3).
+    void savePPM(std::string outputFileName, bool binary = false) const;
 
     // Darken subtracts 50 from each of the red, green
     // and blue color components of all of the pixels
@@ -56,11 +91,45 @@ public:
     // 0 in a ppm.
     void darken();
 
-    // Sets a pixel to a specific R,G,B value
-    void setPixel(size_t x, size_t y, unsigned char R, unsigned char G,
-                  unsigned char B);
+    // Row y of the image (y must be less than the height). Loops over many
+    // pixels should walk rows rather than call getPixel for each one.
+    inline PPMRow row(size_t y) const
+    {
+        return PPMRow(m_PixelData + 3 * m_width * y, m_width);
+    }
+
+    // Sets a pixel to a specific R,G,B value (x and y must be in the image)
+    inline void setPixel(size_t x, size_t y, unsigned char R, unsigned char G,
+                         unsigned char B)
+    {
+        unsigned char* pixel = row(y)[x];
+        pixel[0] = R;
+        pixel[1] = G;
+        pixel[2] = B;
+    }
+
+    // The R,G,B of a pixel (x and y must be in the image)
+    inline unsigned char* getPixel(size_t x, size_t y) const
+    {
+        return row(y)[x];
+    }
+
+    // Sets every pixel to R,G,B
+    void fill(unsigned char R, unsigned char G, unsigned char B);
 
-    unsigned char* getPixel(size_t x, size_t y) const;
+    // Sets every pixel of the width x height rectangle at x, y to R,G,B.
+    // The part outside the image is left out.
+    void fill(size_t x, size_t y, size_t width, size_t height,
+              unsigned char R, unsigned char G, unsigned char B);
+
+    // Copies the width x height rectangle at srcX, srcY in src to x, y in
+    // this image, a row at a time. src may be this image, and the two
+    // rectangles may overlap. What falls outside either image is left out.
+    void copyRect(const PPM& src, size_t srcX, size_t srcY, size_t width,
+                  size_t height, size_t x, size_t y);
+
+    // Copies all of src to x, y (clipped like copyRect)
+    void blit(const PPM& src, size_t x, size_t y);
 
     // Returns the raw pixel data in an array.
     // You may research what 'inline' does.
@@ -75,6 +144,11 @@ public:
     // NOTE:    You may add any helper functions you like in the
     //          private section.
 private:
+    // Copies the binary raster of a P6 (channels = 3) or P5 (channels = 1)
+    // file from [p, end), right after its maxval, and scales it to PPM_MAX.
+    void readRaster(const char* p, const char* end, size_t channels,
+                    size_t max);
+
     // Store the raw pixel data here
     // Data is R,G,B format row-major order
     unsigned char* m_PixelData;
@@ -0,0 +1,77 @@
+/** @file ThreadPool.h
+ *  @brief A fixed set of threads that run batches of numbered tasks
+ *
+ *  run() hands each thread (the calling one included) an even, contiguous
+ *  share of the task numbers. A thread works from the front of its own
+ *  share and, once that is empty, steals from the back of the others', so
+ *  uneven tasks still keep every thread busy. run() returns once every
+ *  task is done and every thread is idle again.
+ *
+ *  @author Michael Hebert
+ *  @bug run() must not be called from inside a task, or from two threads
+ *       at once.
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // Starts threads - 1 threads; the one calling run() is the last.
+    // 0 means one per hardware thread.
+    explicit ThreadPool(unsigned int threads = 0);
+
+    // Stops and joins the threads
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run tasks, the calling one included
+    inline unsigned int size() const { return (unsigned int)m_shares.size(); }
+
+    // Runs task(i) for every i in [0, count), spread over the threads, and
+    // returns when they are all done
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    // the task numbers [next, end) one thread has left
+    struct Share {
+        std::mutex lock;
+        size_t next{0};
+        size_t end{0};
+    };
+
+    // Takes a task for thread self: its own next one, or else another
+    // thread's last one. Returns false when there are none left.
+    bool take(size_t self, size_t& task);
+
+    // Runs tasks for thread self until there are none left
+    void work(size_t self);
+
+    // What each started thread does: wait for a batch, work, repeat
+    void loop(size_t self);
+
+    std::vector<std::unique_ptr<Share>> m_shares;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;  // a batch started, or stopping
+    std::condition_variable m_done;  // a batch may be finished
+
+    const std::function<void(size_t)>* m_task{nullptr};
+    std::atomic<size_t> m_remaining{0};
+    size_t m_batch{0};  // counts batches, so threads can tell a new one
+    size_t m_idle{0};   // started threads waiting for a batch
+    bool m_stopping{false};
+};
+
+#endif
@@ -0,0 +1,456 @@
+#include "Filters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+using ImageOps::Isa;
+
+// kernel weights add up to this, so a row pass sum fits 16 bits
+static const int WEIGHT_SUM = 256;
+
+// the strongest sharpen, in 256ths
+static const int MAX_SHARPEN = 16 * 256;
+
+// i clamped to [0, n)
+static inline size_t clampIndex(ptrdiff_t i, size_t n)
+{
+    return i < 0 ? 0 : (size_t)i >= n ? n - 1 : (size_t)i;
+}
+
+static inline unsigned char clampSample(int v)
+{
+    return v < 0 ? 0 : v > (int)PPM_MAX ? PPM_MAX : (unsigned char)v;
+}
+
+// raw weights rounded to WEIGHT_SUM in total: each is rounded down, and the
+// units that leaves go to the largest remainders (the ones nearest the middle
+// first on a tie, so a symmetric kernel stays as close to it as it can)
+static std::vector<unsigned short> normalise(const std::vector<double>& raw)
+{
+    double total = 0;
+    for (double w : raw) {
+        total += w;
+    }
+
+    const size_t n = raw.size();
+    std::vector<int> floors(n);
+    std::vector<double> remainders(n);
+    int sum = 0;
+    for (size_t k = 0; k < n; k++) {
+        const double exact = raw[k] * WEIGHT_SUM / total;
+        floors[k] = (int)std::floor(exact);
+        remainders[k] = exact - floors[k];
+        sum += floors[k];
+    }
+
+    std::vector<size_t> order(n);
+    for (size_t k = 0; k < n; k++) {
+        order[k] = k;
+    }
+    const ptrdiff_t middle = (ptrdiff_t)(n / 2);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (remainders[a] != remainders[b]) {
+            return remainders[a] > remainders[b];
+        }
+        return std::abs((ptrdiff_t)a - middle) <
+               std::abs((ptrdiff_t)b - middle);
+    });
+
+    // the floors leave less than one unit per weight to hand out
+    for (int k = 0; k < WEIGHT_SUM - sum; k++) {
+        floors[order[k]]++;
+    }
+
+    return std::vector<unsigned short>(floors.begin(), floors.end());
+}
+
+FilterPipeline& FilterPipeline::boxBlur(unsigned int radius)
+{
+    radius = std::min(radius, FILTER_MAX_BOX_RADIUS);
+
+    Stage stage = {SEPARABLE, normalise(std::vector<double>(2 * radius + 1, 1)),
+                   0, 0, 0};
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::gaussianBlur(float sigma)
+{
+    const int radius = std::max(0, (int)std::ceil(3 * sigma));
+
+    std::vector<double> raw(2 * radius + 1, 1);
+    for (int k = -radius; k <= radius && sigma > 0; k++) {
+        raw[k + radius] = std::exp(-(double)k * k / (2.0 * sigma * sigma));
+    }
+
+    // weights too small to round to anything would only widen the halo
+    std::vector<unsigned short> weights = normalise(raw);
+    size_t trim = 0;
+    while (trim < weights.size() / 2 && weights[trim] == 0) {
+        trim++;
+    }
+    weights.assign(weights.begin() + trim, weights.end() - trim);
+
+    Stage stage = {SEPARABLE, weights, 0, 0, 0};
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::sharpen(float amount)
+{
+    const int fixed = (int)std::lround(amount * 256);
+    Stage stage = {SHARPEN, {}, std::max(0, std::min(fixed, MAX_SHARPEN)), 0,
+                   0};
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::sobel()
+{
+    Stage stage = {SOBEL, {}, 0, 0, 0};
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::resize(size_t width, size_t height)
+{
+    Stage stage = {RESIZE, {}, 0, width, height};
+    m_stages.push_back(stage);
+    return *this;
+}
+
+void FilterPipeline::setTileSize(size_t width, size_t height)
+{
+    m_tileWidth = std::max<size_t>(1, width);
+    m_tileHeight = std::max<size_t>(1, height);
+}
+
+// where a tile goes in the image a stage makes
+struct Tile {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+};
+
+// Row pass: sums[i] = sum over k of weights[k] * in[i + 3 k], for count
+// samples (in has the radius pixels either side already)
+static void rowPass(const std::vector<unsigned short>& weights,
+                    const unsigned char* in, unsigned short* sums,
+                    size_t count, Isa isa)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    if (isa >= ImageOps::SSE2) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8) {
+            __m128i sum = _mm_setzero_si128();
+            for (size_t k = 0; k < weights.size(); k++) {
+                const __m128i v = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i*)(in + i + 3 * k)), zero);
+                sum = _mm_add_epi16(
+                    sum, _mm_mullo_epi16(v, _mm_set1_epi16(weights[k])));
+            }
+            _mm_storeu_si128((__m128i*)(sums + i), sum);
+        }
+    }
+#else
+    (void)isa;
+#endif
+
+    for (; i < count; i++) {
+        unsigned int sum = 0;
+        for (size_t k = 0; k < weights.size(); k++) {
+            sum += weights[k] * in[i + 3 * k];
+        }
+        sums[i] = (unsigned short)sum;
+    }
+}
+
+// Column pass: out[i] = sum over k of weights[k] * sums[k * stride + i],
+// scaled back down from WEIGHT_SUM^2 and rounded, for count samples
+static void columnPass(const std::vector<unsigned short>& weights,
+                       const unsigned short* sums, size_t stride,
+                       unsigned char* out, size_t count, Isa isa)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    if (isa >= ImageOps::SSE2) {
+        const __m128i half = _mm_set1_epi32(1 << 15);
+        for (; i + 8 <= count; i += 8) {
+            // 16 x 16 bit products, put together from their low and high
+            // halves into 32 bits
+            __m128i low = half;
+            __m128i high = half;
+            for (size_t k = 0; k < weights.size(); k++) {
+                const __m128i v =
+                    _mm_loadu_si128((const __m128i*)(sums + k * stride + i));
+                const __m128i w = _mm_set1_epi16(weights[k]);
+                const __m128i productLow = _mm_mullo_epi16(v, w);
+                const __m128i productHigh = _mm_mulhi_epu16(v, w);
+                low = _mm_add_epi32(
+                    low, _mm_unpacklo_epi16(productLow, productHigh));
+                high = _mm_add_epi32(
+                    high, _mm_unpackhi_epi16(productLow, productHigh));
+            }
+            const __m128i samples = _mm_packs_epi32(_mm_srli_epi32(low, 16),
+                                                    _mm_srli_epi32(high, 16));
+            _mm_storel_epi64((__m128i*)(out + i),
+                             _mm_packus_epi16(samples, samples));
+        }
+    }
+#else
+    (void)isa;
+#endif
+
+    for (; i < count; i++) {
+        unsigned int sum = 1 << 15;
+        for (size_t k = 0; k < weights.size(); k++) {
+            sum += weights[k] * sums[k * stride + i];
+        }
+        out[i] = (unsigned char)(sum >> 16);
+    }
+}
+
+// A separable blur of one tile: row passes over the tile's rows and the
+// radius rows above and below it, then column passes into dst
+static void blurTile(const std::vector<unsigned short>& weights,
+                     const PPM& src, PPM& dst, const Tile& tile, Isa isa)
+{
+    const size_t radius = weights.size() / 2;
+    const size_t samples = 3 * tile.width;
+    const size_t rows = tile.height + 2 * radius;
+
+    // reused by every tile a thread runs
+    thread_local std::vector<unsigned char> padded;
+    thread_local std::vector<unsigned short> sums;
+    padded.resize(3 * (tile.width + 2 * radius));
+    sums.resize(rows * samples);
+
+    const ptrdiff_t left = (ptrdiff_t)tile.x - (ptrdiff_t)radius;
+    const size_t width = src.getWidth();
+
+    // the part of the padded row that is inside the image
+    const size_t first = left < 0 ? (size_t)-left : 0;
+    const size_t last = std::min(tile.width + 2 * radius,
+                                 (size_t)((ptrdiff_t)width - left));
+
+    for (size_t j = 0; j < rows; j++) {
+        const PPMRow row = src.row(clampIndex(
+            (ptrdiff_t)(tile.y + j) - (ptrdiff_t)radius, src.getHeight()));
+
+        for (size_t i = 0; i < first; i++) {
+            std::memcpy(&padded[3 * i], row[0], 3);
+        }
+        std::memcpy(&padded[3 * first], row[left + first],
+                    3 * (last - first));
+        for (size_t i = last; i < tile.width + 2 * radius; i++) {
+            std::memcpy(&padded[3 * i], row[width - 1], 3);
+        }
+
+        rowPass(weights, padded.data(), &sums[j * samples], samples, isa);
+    }
+
+    for (size_t j = 0; j < tile.height; j++) {
+        columnPass(weights, &sums[j * samples], samples,
+                   dst.row(tile.y + j)[tile.x], samples, isa);
+    }
+}
+
+// The 3 x 3 filters: op(above, here, below, left, right) gives one sample
+// from the three source rows around it, each pointing at the sample above,
+// at or below it; left and right are the offsets to its neighbours
+template <typename Op>
+static void neighbourhoodTile(const PPM& src, PPM& dst, const Tile& tile,
+                              Op op)
+{
+    const size_t width = src.getWidth();
+    const size_t height = src.getHeight();
+
+    for (size_t y = tile.y; y < tile.y + tile.height; y++) {
+        const unsigned char* above =
+            src.row(clampIndex((ptrdiff_t)y - 1, height)).begin();
+        const unsigned char* here = src.row(y).begin();
+        const unsigned char* below =
+            src.row(clampIndex((ptrdiff_t)y + 1, height)).begin();
+        unsigned char* out = dst.row(y)[tile.x];
+
+        for (size_t x = tile.x; x < tile.x + tile.width; x++) {
+            // at the edges a missing neighbour is the pixel itself
+            const ptrdiff_t left = x > 0 ? -3 : 0;
+            const ptrdiff_t right = x + 1 < width ? 3 : 0;
+
+            for (size_t i = 3 * x; i < 3 * x + 3; i++) {
+                *out++ = op(above + i, here + i, below + i, left, right);
+            }
+        }
+    }
+}
+
+static void sharpenTile(int amount, const PPM& src, PPM& dst,
+                        const Tile& tile)
+{
+    neighbourhoodTile(src, dst, tile, [amount](const unsigned char* above,
+                                               const unsigned char* here,
+                                               const unsigned char* below,
+                                               ptrdiff_t left,
+                                               ptrdiff_t right) {
+        const int p = *here;
+        const int difference =
+            4 * p - *above - *below - here[left] - here[right];
+
+        // difference * amount / 256 rounded, shifted up to stay positive
+        const int offset = 1 << 24;
+        const int change =
+            ((difference * amount + offset + 128) >> 8) - (offset >> 8);
+        return clampSample(p + change);
+    });
+}
+
+static void sobelTile(const PPM& src, PPM& dst, const Tile& tile)
+{
+    neighbourhoodTile(src, dst, tile, [](const unsigned char* above,
+                                         const unsigned char* here,
+                                         const unsigned char* below,
+                                         ptrdiff_t left, ptrdiff_t right) {
+        const int gx = (above[right] + 2 * here[right] + below[right]) -
+                       (above[left] + 2 * here[left] + below[left]);
+        const int gy = (below[left] + 2 * *below + below[right]) -
+                       (above[left] + 2 * *above + above[right]);
+        return clampSample((std::abs(gx) + std::abs(gy)) >> 2);
+    });
+}
+
+// where pixel i of n lands among from pixels, in 256ths: the source pixel
+// before it and how far it is towards the next
+struct Sample {
+    size_t first;
+    size_t second;
+    unsigned int fraction;
+};
+
+static Sample sampleAt(size_t i, size_t n, size_t from)
+{
+    // centre of pixel i, (i + 0.5) from / n - 0.5, in 65536ths
+    const int64_t position =
+        (int64_t)(((uint64_t)(2 * i + 1) * from << 15) / n) - (1 << 15);
+
+    Sample sample = {0, 0, 0};
+    if (position > 0) {
+        sample.first = std::min((size_t)(position >> 16), from - 1);
+        sample.fraction = (unsigned int)(position >> 8) & 0xff;
+    }
+    sample.second = std::min(sample.first + 1, from - 1);
+    if (sample.first == from - 1) {
+        sample.fraction = 0;
+    }
+    return sample;
+}
+
+static void resizeTile(const PPM& src, PPM& dst, const Tile& tile)
+{
+    thread_local std::vector<Sample> columns;
+    columns.resize(tile.width);
+    for (size_t i = 0; i < tile.width; i++) {
+        columns[i] = sampleAt(tile.x + i, dst.getWidth(), src.getWidth());
+    }
+
+    for (size_t y = tile.y; y < tile.y + tile.height; y++) {
+        const Sample row = sampleAt(y, dst.getHeight(), src.getHeight());
+        const PPMRow top = src.row(row.first);
+        const PPMRow bottom = src.row(row.second);
+        unsigned char* out = dst.row(y)[tile.x];
+
+        for (size_t i = 0; i < tile.width; i++, out += 3) {
+            const Sample& column = columns[i];
+            const unsigned int fx = column.fraction;
+            const unsigned int fy = row.fraction;
+            for (int c = 0; c < 3; c++) {
+                const unsigned int upper = top[column.first][c] * (256 - fx) +
+                                           top[column.second][c] * fx;
+                const unsigned int lower =
+                    bottom[column.first][c] * (256 - fx) +
+                    bottom[column.second][c] * fx;
+                out[c] = (unsigned char)((upper * (256 - fy) + lower * fy +
+                                          (1 << 15)) >> 16);
+            }
+        }
+    }
+}
+
+void FilterPipeline::runStage(const Stage& stage, const PPM& src, PPM& dst,
+                              ThreadPool* pool, Isa isa) const
+{
+    const size_t across = (dst.getWidth() + m_tileWidth - 1) / m_tileWidth;
+    const size_t down = (dst.getHeight() + m_tileHeight - 1) / m_tileHeight;
+
+    if (src.getWidth() == 0 || src.getHeight() == 0) {
+        return;
+    }
+
+    const std::function<void(size_t)> task = [&](size_t t) {
+        Tile tile;
+        tile.x = (t % across) * m_tileWidth;
+        tile.y = (t / across) * m_tileHeight;
+        tile.width = std::min(m_tileWidth, dst.getWidth() - tile.x);
+        tile.height = std::min(m_tileHeight, dst.getHeight() - tile.y);
+
+        switch (stage.kind) {
+            case SEPARABLE:
+                blurTile(stage.weights, src, dst, tile, isa);
+                break;
+            case SHARPEN:
+                sharpenTile(stage.amount, src, dst, tile);
+                break;
+            case SOBEL:
+                sobelTile(src, dst, tile);
+                break;
+            case RESIZE:
+                resizeTile(src, dst, tile);
+                break;
+        }
+    };
+
+    if (pool) {
+        pool->run(across * down, task);
+    }
+    else {
+        for (size_t t = 0; t < across * down; t++) {
+            task(t);
+        }
+    }
+}
+
+PPM FilterPipeline::run(const PPM& src, ThreadPool* pool, Isa isa) const
+{
+    PPM result(src.getWidth(), src.getHeight());
+    if (m_stages.empty()) {
+        result.blit(src, 0, 0);
+        return result;
+    }
+
+    const PPM* in = &src;
+    for (const Stage& stage : m_stages) {
+        const bool resizing = stage.kind == RESIZE;
+        PPM out(resizing ? stage.width : in->getWidth(),
+                resizing ? stage.height : in->getHeight());
+
+        runStage(stage, *in, out, pool, isa);
+
+        result = std::move(out);
+        in = &result;
+    }
+    return result;
+}
@@ -0,0 +1,467 @@
+#include "ImageOps.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the AVX2 versions are built for that target on their own, so the rest of
+// the program still runs on CPUs without it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_OPS_AVX2
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace ImageOps {
+
+// scalar versions: the reference the others have to match
+
+static inline unsigned char darkenByte(unsigned char v, unsigned char amount)
+{
+    return v <= amount ? 0 : v - amount;
+}
+
+static inline unsigned char brightenByte(unsigned char v,
+                                         unsigned char amount)
+{
+    return v >= PPM_MAX - amount ? PPM_MAX : v + amount;
+}
+
+static inline unsigned char lumaOf(const unsigned char* rgb)
+{
+    return (77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8;
+}
+
+// t / 255 rounded, for t up to 255 * 255, without dividing
+static inline unsigned char div255(unsigned int t)
+{
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline unsigned char blendByte(unsigned char d, unsigned char s,
+                                      unsigned char alpha)
+{
+    return div255(s * alpha + d * (PPM_MAX - alpha));
+}
+
+#if defined(__SSE2__)
+
+static void darkenSse2(unsigned char* data, size_t count,
+                       unsigned char amount, size_t& i)
+{
+    const __m128i n = _mm_set1_epi8((char)amount);
+    for (; i + 16 <= count; i += 16) {
+        __m128i* p = (__m128i*)(data + i);
+        _mm_storeu_si128(p, _mm_subs_epu8(_mm_loadu_si128(p), n));
+    }
+}
+
+static void brightenSse2(unsigned char* data, size_t count,
+                         unsigned char amount, size_t& i)
+{
+    const __m128i n = _mm_set1_epi8((char)amount);
+    for (; i + 16 <= count; i += 16) {
+        __m128i* p = (__m128i*)(data + i);
+        _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p), n));
+    }
+}
+
+static void invertSse2(unsigned char* data, size_t count, size_t& i)
+{
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    for (; i + 16 <= count; i += 16) {
+        __m128i* p = (__m128i*)(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), ones));
+    }
+}
+
+// 8 16 bit lanes of s * alpha + d * (255 - alpha), divided by 255
+static inline __m128i blend16(__m128i d, __m128i s, __m128i alpha,
+                              __m128i beta)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(s, alpha),
+                              _mm_mullo_epi16(d, beta));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void blendSse2(unsigned char* dst, const unsigned char* src,
+                      size_t count, unsigned char alpha, size_t& i)
+{
+    const __m128i a = _mm_set1_epi16(alpha);
+    const __m128i b = _mm_set1_epi16(PPM_MAX - alpha);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= count; i += 16) {
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+
+        const __m128i lo = blend16(_mm_unpacklo_epi8(d, zero),
+                                   _mm_unpacklo_epi8(s, zero), a, b);
+        const __m128i hi = blend16(_mm_unpackhi_epi8(d, zero),
+                                   _mm_unpackhi_epi8(s, zero), a, b);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+}
+
+#endif
+
+#if defined(IMAGE_OPS_AVX2)
+
+TARGET_AVX2 static void darkenAvx2(unsigned char* data, size_t count,
+                                   unsigned char amount, size_t& i)
+{
+    const __m256i n = _mm256_set1_epi8((char)amount);
+    for (; i + 32 <= count; i += 32) {
+        __m256i* p = (__m256i*)(data + i);
+        _mm256_storeu_si256(p, _mm256_subs_epu8(_mm256_loadu_si256(p), n));
+    }
+}
+
+TARGET_AVX2 static void brightenAvx2(unsigned char* data, size_t count,
+                                     unsigned char amount, size_t& i)
+{
+    const __m256i n = _mm256_set1_epi8((char)amount);
+    for (; i + 32 <= count; i += 32) {
+        __m256i* p = (__m256i*)(data + i);
+        _mm256_storeu_si256(p, _mm256_adds_epu8(_mm256_loadu_si256(p), n));
+    }
+}
+
+TARGET_AVX2 static void invertAvx2(unsigned char* data, size_t count,
+                                   size_t& i)
+{
+    const __m256i ones = _mm256_set1_epi8((char)0xff);
+    for (; i + 32 <= count; i += 32) {
+        __m256i* p = (__m256i*)(data + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), ones));
+    }
+}
+
+TARGET_AVX2 static inline __m256i blend16Avx2(__m256i d, __m256i s,
+                                              __m256i alpha, __m256i beta)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(s, alpha),
+                                 _mm256_mullo_epi16(d, beta));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2 static void blendAvx2(unsigned char* dst,
+                                  const unsigned char* src, size_t count,
+                                  unsigned char alpha, size_t& i)
+{
+    const __m256i a = _mm256_set1_epi16(alpha);
+    const __m256i b = _mm256_set1_epi16(PPM_MAX - alpha);
+    const __m256i zero = _mm256_setzero_si256();
+
+    // unpack and pack both work within 128 bit lanes, so the bytes come
+    // back in order
+    for (; i + 32 <= count; i += 32) {
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+
+        const __m256i lo = blend16Avx2(_mm256_unpacklo_epi8(d, zero),
+                                       _mm256_unpacklo_epi8(s, zero), a, b);
+        const __m256i hi = blend16Avx2(_mm256_unpackhi_epi8(d, zero),
+                                       _mm256_unpackhi_epi8(s, zero), a, b);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+}
+
+// byte shuffles that pull one channel of 16 RGB pixels (48 bytes, three
+// 16 byte blocks) out of each block, and that spread 16 lumas back over
+// three blocks; -1 (0x80) leaves a zero
+struct RgbShuffles {
+    char channel[3][3][16];  // [channel][block][lane]
+    char spread[3][16];      // [block][lane]
+
+    RgbShuffles()
+    {
+        for (int block = 0; block < 3; block++) {
+            for (int lane = 0; lane < 16; lane++) {
+                for (int c = 0; c < 3; c++) {
+                    const int byte = 3 * lane + c - 16 * block;
+                    channel[c][block][lane] =
+                        byte >= 0 && byte < 16 ? (char)byte : (char)0x80;
+                }
+                spread[block][lane] = (char)((16 * block + lane) / 3);
+            }
+        }
+    }
+};
+
+static const RgbShuffles RGB_SHUFFLES;
+
+// one channel of 16 pixels, from their three blocks
+TARGET_AVX2 static inline __m128i gatherChannel(const __m128i* blocks,
+                                                int c)
+{
+    const char(*masks)[16] = RGB_SHUFFLES.channel[c];
+    return _mm_or_si128(
+        _mm_or_si128(
+            _mm_shuffle_epi8(blocks[0],
+                             _mm_loadu_si128((const __m128i*)masks[0])),
+            _mm_shuffle_epi8(blocks[1],
+                             _mm_loadu_si128((const __m128i*)masks[1]))),
+        _mm_shuffle_epi8(blocks[2], _mm_loadu_si128((const __m128i*)masks[2])));
+}
+
+TARGET_AVX2 static void grayscaleAvx2(unsigned char* rgb, size_t pixels,
+                                      size_t& i)
+{
+    // 16 pixels at a time: split the channels, weigh them in 16 bits (the
+    // sum stays under 65536), then write the luma back to all three
+    const __m256i weightR = _mm256_set1_epi16(77);
+    const __m256i weightG = _mm256_set1_epi16(150);
+    const __m256i weightB = _mm256_set1_epi16(29);
+    const __m256i half = _mm256_set1_epi16(128);
+
+    for (; i + 16 <= pixels; i += 16) {
+        __m128i* p = (__m128i*)(rgb + 3 * i);
+        const __m128i blocks[3] = {_mm_loadu_si128(p), _mm_loadu_si128(p + 1),
+                                   _mm_loadu_si128(p + 2)};
+
+        const __m256i r = _mm256_cvtepu8_epi16(gatherChannel(blocks, 0));
+        const __m256i g = _mm256_cvtepu8_epi16(gatherChannel(blocks, 1));
+        const __m256i b = _mm256_cvtepu8_epi16(gatherChannel(blocks, 2));
+
+        __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, weightR),
+                                     _mm256_mullo_epi16(g, weightG));
+        y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, weightB));
+        y = _mm256_srli_epi16(_mm256_add_epi16(y, half), 8);
+
+        const __m128i luma = _mm_packus_epi16(_mm256_castsi256_si128(y),
+                                              _mm256_extracti128_si256(y, 1));
+
+        for (int block = 0; block < 3; block++) {
+            _mm_storeu_si128(
+                p + block,
+                _mm_shuffle_epi8(luma, _mm_loadu_si128(
+                                           (const __m128i*)
+                                               RGB_SHUFFLES.spread[block])));
+        }
+    }
+}
+
+TARGET_AVX2 static void applyTableAvx2(unsigned char* data, size_t count,
+                                       const unsigned char table[256],
+                                       size_t& i)
+{
+    // the table as 16 rows of 16; each byte's low nibble picks the entry in
+    // every row and its high nibble keeps the one from the right row
+    __m256i rows[16];
+    for (int r = 0; r < 16; r++) {
+        rows[r] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)(table + 16 * r)));
+    }
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    for (; i + 32 <= count; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        const __m256i low = _mm256_and_si256(v, nibble);
+        const __m256i high =
+            _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+
+        __m256i out = _mm256_setzero_si256();
+        for (int r = 0; r < 16; r++) {
+            const __m256i row =
+                _mm256_cmpeq_epi8(high, _mm256_set1_epi8((char)r));
+            out = _mm256_or_si256(
+                out,
+                _mm256_and_si256(row, _mm256_shuffle_epi8(rows[r], low)));
+        }
+        _mm256_storeu_si256((__m256i*)(data + i), out);
+    }
+}
+
+#endif
+
+// the instruction set to really use for isa in this build
+static Isa available(Isa isa)
+{
+#if !defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) isa = SSE2;
+#endif
+#if !defined(__SSE2__)
+    if (isa == SSE2) isa = SCALAR;
+#endif
+    return isa;
+}
+
+static Isa detectIsa()
+{
+#if defined(IMAGE_OPS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+#endif
+    return available(SSE2);
+}
+
+Isa bestIsa()
+{
+    static const Isa best = detectIsa();
+    return best;
+}
+
+const char* isaName(Isa isa)
+{
+    switch (isa) {
+        case AVX2:
+            return "AVX2";
+        case SSE2:
+            return "SSE2";
+        default:
+            return "scalar";
+    }
+}
+
+// Each operation runs the widest version isa allows over as much of the
+// data as it can, then the scalar loop finishes off the rest from i.
+
+void darken(unsigned char* data, size_t count, unsigned char amount,
+            Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) darkenAvx2(data, count, amount, i);
+#endif
+#if defined(__SSE2__)
+    if (isa >= SSE2) darkenSse2(data, count, amount, i);
+#endif
+    for (; i < count; i++) {
+        data[i] = darkenByte(data[i], amount);
+    }
+}
+
+void brighten(unsigned char* data, size_t count, unsigned char amount,
+              Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) brightenAvx2(data, count, amount, i);
+#endif
+#if defined(__SSE2__)
+    if (isa >= SSE2) brightenSse2(data, count, amount, i);
+#endif
+    for (; i < count; i++) {
+        data[i] = brightenByte(data[i], amount);
+    }
+}
+
+void invert(unsigned char* data, size_t count, Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) invertAvx2(data, count, i);
+#endif
+#if defined(__SSE2__)
+    if (isa >= SSE2) invertSse2(data, count, i);
+#endif
+    for (; i < count; i++) {
+        data[i] = PPM_MAX - data[i];
+    }
+}
+
+// SSE2 has no byte shuffle to split the channels with, so below AVX2 this
+// (and applyTable) stays scalar
+void grayscale(unsigned char* rgb, size_t pixels, Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) grayscaleAvx2(rgb, pixels, i);
+#endif
+    for (; i < pixels; i++) {
+        unsigned char* pixel = rgb + 3 * i;
+        pixel[0] = pixel[1] = pixel[2] = lumaOf(pixel);
+    }
+}
+
+void blend(unsigned char* dst, const unsigned char* src, size_t count,
+           unsigned char alpha, Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) blendAvx2(dst, src, count, alpha, i);
+#endif
+#if defined(__SSE2__)
+    if (isa >= SSE2) blendSse2(dst, src, count, alpha, i);
+#endif
+    for (; i < count; i++) {
+        dst[i] = blendByte(dst[i], src[i], alpha);
+    }
+}
+
+void applyTable(unsigned char* data, size_t count,
+                const unsigned char table[256], Isa isa)
+{
+    size_t i = 0;
+    isa = available(isa);
+#if defined(IMAGE_OPS_AVX2)
+    if (isa == AVX2) applyTableAvx2(data, count, table, i);
+#endif
+    for (; i < count; i++) {
+        data[i] = table[data[i]];
+    }
+}
+
+void gammaTable(float gamma, unsigned char table[256])
+{
+    for (size_t v = 0; v <= PPM_MAX; v++) {
+        const float scaled = std::pow(v / (float)PPM_MAX, gamma);
+        table[v] = (unsigned char)std::lround(scaled * PPM_MAX);
+    }
+}
+
+static inline size_t channels(const PPM& image)
+{
+    return image.getWidth() * image.getHeight() * 3;
+}
+
+void darken(PPM& image, unsigned char amount)
+{
+    darken(image.pixelData(), channels(image), amount);
+}
+
+void brighten(PPM& image, unsigned char amount)
+{
+    brighten(image.pixelData(), channels(image), amount);
+}
+
+void invert(PPM& image) { invert(image.pixelData(), channels(image)); }
+
+void grayscale(PPM& image)
+{
+    grayscale(image.pixelData(), image.getWidth() * image.getHeight());
+}
+
+void gamma(PPM& image, float gamma)
+{
+    unsigned char table[256];
+    gammaTable(gamma, table);
+    applyTable(image.pixelData(), channels(image), table);
+}
+
+int blend(PPM& image, const PPM& src, unsigned char alpha)
+{
+    if (image.getWidth() != src.getWidth() ||
+        image.getHeight() != src.getHeight()) {
+        return EXIT_FAILURE;
+    }
+
+    blend(image.pixelData(), src.pixelData(), channels(image), alpha);
+    return EXIT_SUCCESS;
+}
+
+}  // namespace ImageOps
@@ -0,0 +1,59 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_open(false) {}
+
+MappedFile::~MappedFile() { close(); }
+
+int MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return EXIT_FAILURE;
+    }
+
+    m_size = (size_t)st.st_size;
+
+    if (m_size > 0) {
+        void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            m_size = 0;
+            return EXIT_FAILURE;
+        }
+
+        // images are read front to back once
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+        m_data = (const char*)addr;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    m_open = true;
+
+    return EXIT_SUCCESS;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
@@ -0,0 +1,222 @@
+#include "P3Decoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "PPM.h"
+
+// samples up to this are scaled through a table, bigger ones by scale()
+static const size_t TABLE_MAX = PPM_MAX_WIDE;
+
+// less text than this per thread isn't worth starting one for
+static const size_t MIN_BYTES_PER_THREAD = 256 * 1024;
+
+// what istream >> treats as whitespace in the C locale
+inline bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+#if defined(__SSE2__)
+inline unsigned int lowestBit(unsigned int mask)
+{
+    return __builtin_ctz(mask);
+}
+#endif
+
+// turns a sample into its byte the way the old parser did: scale() to
+// [0, PPM_MAX], then cut down to an unsigned char
+class SampleScale {
+public:
+    explicit SampleScale(size_t max)
+        : m_max(max), m_table(std::min(max, TABLE_MAX) + 1)
+    {
+        for (size_t x = 0; x < m_table.size(); x++) {
+            m_table[x] = (unsigned char)scale(x, max, PPM_MAX);
+        }
+    }
+
+    inline unsigned char operator()(size_t x) const
+    {
+        return x < m_table.size() ? m_table[x]
+                                  : (unsigned char)scale(x, m_max, PPM_MAX);
+    }
+
+private:
+    size_t m_max;
+    std::vector<unsigned char> m_table;
+};
+
+// where one piece of the raster got to
+struct DecodeResult {
+    size_t count;  // samples read
+    bool stopped;  // ran into something that isn't a sample or a comment
+};
+
+// Reads samples from [p, end) until limit of them have been read, the text
+// runs out or a bad character turns up. With Store false it only counts
+// them (out and scaler aren't touched).
+template <bool Store>
+DecodeResult decodeRange(const char* p, const char* end,
+                         const SampleScale& scaler, unsigned char* out,
+                         size_t limit)
+{
+    DecodeResult result = {0, false};
+
+    while (result.count < limit) {
+#if defined(__SSE2__)
+        // every whole number in the next 16 bytes, found from bit masks of
+        // the digits and the whitespace in them
+        if (end - p >= 16) {
+            const __m128i block = _mm_loadu_si128((const __m128i*)p);
+            const unsigned int digits = _mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1))));
+            const unsigned int spaces = _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('\t' - 1)),
+                              _mm_cmplt_epi8(block, _mm_set1_epi8('\r' + 1)))));
+
+            // a comment or a bad character; the numbers before it are whole
+            const unsigned int other = ~(digits | spaces) & 0xffff;
+            const unsigned int stop = other ? lowestBit(other) : 16;
+
+            unsigned int starts =
+                digits & ~(digits << 1) & ((1u << stop) - 1);
+            const unsigned int ends = ~digits & (digits << 1) & 0xffff;
+
+            // a number running off the end of the block is left for the
+            // next one, which starts on it
+            unsigned int next = stop;
+            if (stop == 16 && (digits & 0x8000)) {
+                next = 31 - __builtin_clz(starts);
+                starts &= ~(1u << next);
+            }
+
+            while (starts && result.count < limit) {
+                const unsigned int first = lowestBit(starts);
+                starts &= starts - 1;
+
+                if (Store) {
+                    const unsigned int last = first + lowestBit(ends >> first);
+                    size_t value = 0;
+                    for (unsigned int i = first; i < last; i++) {
+                        value = value * 10 + (p[i] - '0');
+                    }
+                    out[result.count] = scaler(value);
+                }
+                result.count++;
+            }
+
+            if (next > 0) {
+                p += next;
+                continue;
+            }
+        }
+#endif
+
+        // one whitespace run, comment or number at a time
+        while (p < end && isSpace(*p)) {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+        if (*p == '#') {
+            const char* eol = (const char*)std::memchr(p, '\n', end - p);
+            p = eol ? eol + 1 : end;
+            continue;
+        }
+        if (!isDigit(*p)) {
+            result.stopped = true;
+            break;
+        }
+
+        size_t value = 0;
+        for (; p < end && isDigit(*p); p++) {
+            value = value * 10 + (*p - '0');
+        }
+        if (Store) {
+            out[result.count] = scaler(value);
+        }
+        result.count++;
+    }
+
+    return result;
+}
+
+size_t decodeP3(const char* begin, const char* end, size_t max,
+                unsigned char* out, size_t samples, unsigned int threads)
+{
+    const SampleScale scaler(max);
+
+    const size_t bytes = end - begin;
+    threads = (unsigned int)std::max<size_t>(
+        1, std::min<size_t>(threads, bytes / MIN_BYTES_PER_THREAD));
+
+    size_t count = 0;
+
+    if (threads == 1) {
+        count = decodeRange<true>(begin, end, scaler, out, samples).count;
+    }
+    else {
+        // pieces start right after a line break, so never inside a number
+        // or a comment
+        std::vector<const char*> cuts(threads + 1, end);
+        cuts[0] = begin;
+        for (unsigned int t = 1; t < threads; t++) {
+            const char* cut = std::max(cuts[t - 1], begin + bytes * t / threads);
+            const char* eol = (const char*)std::memchr(cut, '\n', end - cut);
+            cuts[t] = eol ? eol + 1 : end;
+        }
+
+        // count what is in each piece first, to know where its samples go
+        std::vector<DecodeResult> pieces(threads);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                pieces[t] = decodeRange<false>(cuts[t], cuts[t + 1], scaler,
+                                               nullptr, samples);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        // nothing after the first bad character counts
+        std::vector<size_t> firsts(threads);
+        for (unsigned int t = 0; t < threads; t++) {
+            firsts[t] = count;
+            pieces[t].count = std::min(pieces[t].count, samples - count);
+            count += pieces[t].count;
+            if (pieces[t].stopped) {
+                for (t++; t < threads; t++) {
+                    firsts[t] = count;
+                    pieces[t].count = 0;
+                }
+            }
+        }
+
+        workers.clear();
+        for (unsigned int t = 0; t < threads; t++) {
+            if (pieces[t].count == 0) {
+                continue;
+            }
+            workers.emplace_back([&, t]() {
+                decodeRange<true>(cuts[t], cuts[t + 1], scaler,
+                                  out + firsts[t], pieces[t].count);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::fill(out + count, out + samples, 0);
+    return count;
+}
@@ -0,0 +1,122 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int t = 0; t < threads; t++) {
+        m_shares.emplace_back(new Share());
+    }
+
+    // share 0 belongs to the thread calling run()
+    m_idle = threads - 1;
+    for (unsigned int t = 1; t < threads; t++) {
+        m_threads.emplace_back(&ThreadPool::loop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(m_lock);
+
+    const size_t threads = m_shares.size();
+    for (size_t t = 0; t < threads; t++) {
+        std::lock_guard<std::mutex> shareGuard(m_shares[t]->lock);
+        m_shares[t]->next = count * t / threads;
+        m_shares[t]->end = count * (t + 1) / threads;
+    }
+    m_task = &task;
+    m_remaining = count;
+    m_batch++;
+    m_idle = 0;
+
+    guard.unlock();
+    m_wake.notify_all();
+
+    work(0);
+
+    // the task can only go away once no thread can still be looking at it
+    guard.lock();
+    m_done.wait(guard, [&]() {
+        return m_remaining == 0 && m_idle == m_threads.size();
+    });
+    m_task = nullptr;
+}
+
+bool ThreadPool::take(size_t self, size_t& task)
+{
+    {
+        Share& own = *m_shares[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.next < own.end) {
+            task = own.next++;
+            return true;
+        }
+    }
+
+    const size_t threads = m_shares.size();
+    for (size_t i = 1; i < threads; i++) {
+        Share& other = *m_shares[(self + i) % threads];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if (other.next < other.end) {
+            task = --other.end;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t self)
+{
+    size_t task;
+    while (take(self, task)) {
+        (*m_task)(task);
+
+        if (--m_remaining == 0) {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::loop(size_t self)
+{
+    size_t seen = 0;
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (true) {
+        m_wake.wait(guard, [&]() { return m_stopping || m_batch != seen; });
+        if (m_stopping) {
+            return;
+        }
+        seen = m_batch;
+
+        guard.unlock();
+        work(self);
+        guard.lock();
+
+        m_idle++;
+        m_done.notify_all();
+    }
+}
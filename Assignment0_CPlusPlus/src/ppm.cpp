@@ -1,22 +1,53 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <limits>
 #include <sstream>
+#include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ImageOps.h"
+#include "MappedFile.h"
+#include "P3Decoder.h"
 #include "PPM.h"
 
-std::istream& cmt(std::istream& is)
+// skips whitespace and # comments up to the next token
+const char* skipComments(const char* p, const char* end)
+{
+    while (p < end) {
+        if (*p == '#') {
+            // advance to EOL or EOF
+            while (p < end && *p != '\n') p++;
+        }
+        else if (std::isspace((unsigned char)*p)) {
+            p++;
+        }
+        else {
+            break;
+        }
+    }
+
+    return p;
+}
+
+// reads a header number after any comments, or returns nullptr
+const char* readNumber(const char* p, const char* end, size_t& value)
 {
-    is >> std::ws;
-    while (is.peek() == '#') {
-        // advance to EOL or EOF
-        is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        is >> std::ws;  // skip leading whitespace
+    p = skipComments(p, end);
+    if (p == end || !std::isdigit((unsigned char)*p)) return nullptr;
+
+    value = 0;
+    for (; p < end && std::isdigit((unsigned char)*p); p++) {
+        value = value * 10 + (*p - '0');
     }
 
-    return is;
+    return p;
 }
 
 // scales x from range [0, a] to range [0, b]
@@ -25,66 +56,280 @@ size_t scale(const size_t x, const size_t a, size_t b)
     return b * ((float)x) / ((float)a);
 }
 
+// scales count samples from [0, max] to [0, PPM_MAX] the way scale() does,
+// clamping any above max. Wide samples are 2 byte big endian.
+template <bool Wide>
+void rescale(const unsigned char* in, size_t count, size_t max,
+             unsigned char* out)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // 8 samples at a time, with the same float multiply and divide
+    const __m128 top = _mm_set1_ps((float)PPM_MAX);
+    const __m128 bottom = _mm_set1_ps((float)max);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x;
+        if (Wide) {
+            x = _mm_loadu_si128((const __m128i*)(in + 2 * i));
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        }
+        else {
+            x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(in + i)),
+                                  zero);
+        }
+
+        __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero));
+        __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero));
+        lo = _mm_div_ps(_mm_mul_ps(top, lo), bottom);
+        hi = _mm_div_ps(_mm_mul_ps(top, hi), bottom);
+
+        // both packs saturate, which clamps samples above max
+        __m128i scaled =
+            _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(scaled, zero));
+    }
+#endif
+
+    for (; i < count; i++) {
+        size_t x = Wide ? (in[2 * i] << 8) | in[2 * i + 1] : in[i];
+        size_t scaled = scale(x, max, PPM_MAX);
+        out[i] = scaled > PPM_MAX ? PPM_MAX : scaled;
+    }
+}
+
 // Constructor loads a filename with the .ppm extension
-PPM::PPM(std::string fileName) : m_PixelData(nullptr)
+PPM::PPM(std::string fileName, unsigned int threads) : m_PixelData(nullptr)
 {
-    std::ifstream infile(fileName);
+    MappedFile file;
 
-    if (!infile) {
+    if (file.open(fileName) != EXIT_SUCCESS) {
         std::cout << "Error: could not open input file" << std::endl;
         exit(1);
     }
-    
+
+    const char* p = file.data();
+    const char* end = file.end();
+
     // read header
-    std::string magic;
-    infile >> magic; // TODO this won't allow things like P3#comment at the start
+    while (p < end && std::isspace((unsigned char)*p)) p++;
+    const char* magicEnd = p;
+    while (magicEnd < end && !std::isspace((unsigned char)*magicEnd)) {
+        magicEnd++;
+    }
+    std::string magic(p, magicEnd); // TODO this won't allow things like P3#comment at the start
 
-    if (magic.compare(PPM_MAGIC) != 0) {
+    size_t channels = 0;  // only set for the binary formats
+    if (magic.compare(PPM_MAGIC_BINARY) == 0) {
+        channels = 3;
+    }
+    else if (magic.compare(PGM_MAGIC_BINARY) == 0) {
+        channels = 1;
+    }
+    else if (magic.compare(PPM_MAGIC) != 0) {
         std::cout << "Error: not a supported file format" << std::endl;
         exit(1);
     }
 
-    // read width, height
-    infile >> cmt >> m_width >> cmt >> m_height;
+    // read width, height and max value
+    size_t max = 0;
+    p = readNumber(magicEnd, end, m_width);
+    if (p) p = readNumber(p, end, m_height);
+    if (p) p = readNumber(p, end, max);
+
+    if (!p || max == 0) {
+        std::cout << "Error: bad PPM header" << std::endl;
+        exit(1);
+    }
 
     m_PixelData = new unsigned char[m_width * m_height * 3];
 
-    // read max value
-    size_t max;
-    infile >> cmt >> max;
-
-    // read data
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            size_t r, g, b;
-            infile >> cmt >> r >> cmt >> g >> cmt >> b;
-            // TODO error handling when no data
-
-            // scale from maximum to PPM_MAX
-            r = scale(r, max, PPM_MAX);
-            g = scale(g, max, PPM_MAX);
-            b = scale(b, max, PPM_MAX);
-            setPixel(x, y, r, g, b);
+    if (channels) {
+        readRaster(p, end, channels, max);
+        return;
+    }
+
+    // read data, scaled from maximum to PPM_MAX
+    decodeP3(p, end, max, m_PixelData, m_width * m_height * 3, threads);
+    // TODO error handling when no data (the missing samples are 0)
+}
+
+void PPM::readRaster(const char* p, const char* end, size_t channels,
+                     size_t max)
+{
+    // exactly one whitespace byte separates maxval from the raster
+    if (max > PPM_MAX_WIDE || p == end || !std::isspace((unsigned char)*p)) {
+        std::cout << "Error: bad binary PPM header" << std::endl;
+        exit(1);
+    }
+    p++;
+
+    const size_t samples = m_width * m_height * channels;
+    const size_t sampleBytes = max > PPM_MAX ? 2 : 1;
+
+    if ((size_t)(end - p) < samples * sampleBytes) {
+        std::cout << "Error: PPM raster is cut short" << std::endl;
+        exit(1);
+    }
+
+    const unsigned char* raster = (const unsigned char*)p;
+    const bool exact = sampleBytes == 1 && max == PPM_MAX;
+
+    if (channels == 3) {
+        if (exact) {
+            std::memcpy(m_PixelData, raster, samples);
+        }
+        else if (sampleBytes == 2) {
+            rescale<true>(raster, samples, max, m_PixelData);
+        }
+        else {
+            rescale<false>(raster, samples, max, m_PixelData);
+        }
+        return;
+    }
+
+    // greyscale is scaled on its own first, then becomes R = G = B
+    std::vector<unsigned char> scaled;
+    const unsigned char* grey = raster;
+    if (!exact) {
+        scaled.resize(samples);
+        if (sampleBytes == 2) {
+            rescale<true>(raster, samples, max, scaled.data());
         }
+        else {
+            rescale<false>(raster, samples, max, scaled.data());
+        }
+        grey = scaled.data();
+    }
+
+    for (size_t y = 0; y < m_height; y++, grey += m_width) {
+        unsigned char* pixel = row(y).begin();
+        for (size_t x = 0; x < m_width; x++, pixel += 3) {
+            pixel[0] = pixel[1] = pixel[2] = grey[x];
+        }
+    }
+}
+
+PPM::PPM(size_t width, size_t height)
+    : m_PixelData(new unsigned char[width * height * 3]()),
+      m_width(width),
+      m_height(height)
+{
+}
+
+PPM::PPM(PPM&& other)
+    : m_PixelData(other.m_PixelData),
+      m_width(other.m_width),
+      m_height(other.m_height)
+{
+    other.m_PixelData = nullptr;
+    other.m_width = 0;
+    other.m_height = 0;
+}
+
+PPM& PPM::operator=(PPM&& other)
+{
+    if (this != &other) {
+        delete[] m_PixelData;
+        m_PixelData = other.m_PixelData;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        other.m_PixelData = nullptr;
+        other.m_width = 0;
+        other.m_height = 0;
     }
+    return *this;
 }
 
 // Destructor clears any memory that has been allocated
 PPM::~PPM() { delete[] m_PixelData; }
 
 // Saves a PPM Image to a new file.
-void PPM::savePPM(std::string outputFileName) const
+void PPM::savePPM(std::string outputFileName, bool binary) const
 {
     assert(m_PixelData);  // invariant
 
-    std::ofstream outfile(outputFileName);
+    std::ofstream outfile(outputFileName, std::ios::binary);
 
     if (!outfile) {
         std::cout << "Error: could not open output file" << std::endl;
         exit(1);
     }
 
-    outfile << *this;
+    write(outfile, binary);
+}
+
+// bytes the P3 writer gathers before writing them out
+static const size_t WRITE_BUFFER_SIZE = 1 << 16;
+
+// the text of every sample value, for the P3 writer
+struct DecimalTable {
+    char text[PPM_MAX + 1][4];
+    unsigned char length[PPM_MAX + 1];
+
+    DecimalTable()
+    {
+        for (size_t v = 0; v <= PPM_MAX; v++) {
+            length[v] = (unsigned char)std::snprintf(text[v], 4, "%zu", v);
+        }
+    }
+};
+
+static const DecimalTable DECIMALS;
+
+void PPM::write(std::ostream& os, bool binary) const
+{
+    os << (binary ? PPM_MAGIC_BINARY : PPM_MAGIC) << '\n'
+       << m_width << ' ' << m_height << '\n'
+       << PPM_MAX << '\n';
+
+    if (binary) {
+        os.write((const char*)m_PixelData, row(0).bytes() * m_height);
+        return;
+    }
+
+    // at most "255 255 255" and two spaces or a line break per pixel, plus
+    // the line break ending each row; rows are gathered until there are
+    // WRITE_BUFFER_SIZE bytes to write
+    const size_t maxRowChars = m_width * 13 + 1;
+    std::vector<char> buffer(std::max(WRITE_BUFFER_SIZE, maxRowChars) +
+                             maxRowChars);
+    char* out = buffer.data();
+
+    for (size_t y = 0; y < m_height; y++) {
+        const PPMRow pixels = row(y);
+        const unsigned char* pixel = pixels.begin();
+        size_t column = 0;  // position in the current line of pixels
+
+        for (; pixel != pixels.end(); pixel += 3) {
+            for (int c = 0; c < 3; c++) {
+                std::memcpy(out, DECIMALS.text[pixel[c]], 4);
+                out += DECIMALS.length[pixel[c]];
+                *out++ = ' ';
+            }
+            out--;
+
+            // add newline if at max, or space between them
+            if (++column == PPM_PIXELS_PER_LINE) {
+                *out++ = '\n';
+                column = 0;
+            }
+            else if (pixel + 3 != pixels.end()) {
+                *out++ = ' ';
+                *out++ = ' ';
+            }
+        }
+        *out++ = '\n';
+
+        if ((size_t)(out - buffer.data()) >= WRITE_BUFFER_SIZE) {
+            os.write(buffer.data(), out - buffer.data());
+            out = buffer.data();
+        }
+    }
+
+    os.write(buffer.data(), out - buffer.data());
 }
 
 // Darken subtracts 50 from each of the red, green
@@ -93,23 +338,61 @@ void PPM::savePPM(std::string outputFileName) const
 // 0 in a ppm.
 void PPM::darken()
 {
-    for (size_t i = 0; i < m_width * m_height * 3; i++) {
-        m_PixelData[i] =
-            (m_PixelData[i] <= PPM_DARKEN_AMT ? 0 : m_PixelData[i] - 50);
+    ImageOps::darken(m_PixelData, m_width * m_height * 3, PPM_DARKEN_AMT);
+}
+
+void PPM::fill(unsigned char R, unsigned char G, unsigned char B)
+{
+    fill(0, 0, m_width, m_height, R, G, B);
+}
+
+void PPM::fill(size_t x, size_t y, size_t width, size_t height,
+               unsigned char R, unsigned char G, unsigned char B)
+{
+    if (x >= m_width || y >= m_height) {
+        return;
+    }
+    width = std::min(width, m_width - x);
+    height = std::min(height, m_height - y);
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    // the first row a pixel at a time, the rest copied from it
+    unsigned char* first = row(y)[x];
+    for (size_t i = 0; i < width; i++) {
+        first[3 * i] = R;
+        first[3 * i + 1] = G;
+        first[3 * i + 2] = B;
+    }
+    for (size_t i = 1; i < height; i++) {
+        std::memcpy(row(y + i)[x], first, 3 * width);
     }
 }
 
-unsigned char* PPM::getPixel(size_t x, size_t y) const
+void PPM::copyRect(const PPM& src, size_t srcX, size_t srcY, size_t width,
+                   size_t height, size_t x, size_t y)
 {
-    return &m_PixelData[3 * (y * m_width + x % m_width)];
+    if (srcX >= src.m_width || srcY >= src.m_height || x >= m_width ||
+        y >= m_height) {
+        return;
+    }
+    width = std::min(width, std::min(src.m_width - srcX, m_width - x));
+    height = std::min(height, std::min(src.m_height - srcY, m_height - y));
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    // moving down within one image, go bottom up so no row is overwritten
+    // before it is copied; memmove takes care of overlap within a row
+    const bool upward = &src == this && y > srcY;
+    for (size_t i = 0; i < height; i++) {
+        const size_t r = upward ? height - 1 - i : i;
+        std::memmove(row(y + r)[x], src.row(srcY + r)[srcX], 3 * width);
+    }
 }
 
-// Sets a pixel to a specific R,G,B value
-void PPM::setPixel(size_t x, size_t y, unsigned char R, unsigned char G,
-                   unsigned char B)
+void PPM::blit(const PPM& src, size_t x, size_t y)
 {
-    size_t basei = 3 * (y * m_width + x % m_width);
-    m_PixelData[basei] = R;
-    m_PixelData[basei + 1] = G;
-    m_PixelData[basei + 2] = B;
+    copyRect(src, 0, 0, src.m_width, src.m_height, x, y);
 }
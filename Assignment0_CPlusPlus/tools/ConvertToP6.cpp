@@ -0,0 +1,27 @@
+/** @file ConvertToP6.cpp
+ *  @brief Converts a PPM image to binary P6
+ *
+ *  Loads any image the PPM class reads (P3, P5 or P6) and saves it as an
+ *  8 bit P6, which loads with one read instead of parsing text.
+ *
+ *  usage: ConvertToP6 <input.ppm> <output.ppm>
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include "PPM.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cout << "usage: " << argv[0] << " <input.ppm> <output.ppm>"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    PPM image(argv[1]);
+    image.savePPM(argv[2], true);
+
+    return EXIT_SUCCESS;
+}
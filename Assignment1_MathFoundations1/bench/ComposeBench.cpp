@@ -0,0 +1,334 @@
+/** @file ComposeBench.cpp
+ *  @brief Checks the fused transform builders and times them against the
+ *  full matrix multiplies they replace, and against glm
+ *
+ *  Model matrices are built from random translations, rotations and scales
+ *  three ways: the old way (every rotation, scale and translation written
+ *  out as a whole 4x4 and multiplied in with the general Matrix4f *), with
+ *  the in-place RotateX/Y/Z, Scale and Translate or ComposeTRS, and with
+ *  glm. All of them have to agree with glm before anything is timed.
+ *
+ *  usage: ComposeBench [--count <n>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Matrix4f.h"
+#include "Vector4f.h"
+
+static const size_t DEFAULT_COUNT = 4096;
+static const int RUNS = 7;
+static const int PASSES = 64;  // over the whole batch, per run
+
+// one object's transform, as Euler angles and as a quaternion
+struct Transform {
+    Vector4f translation, rotation, scale;
+    float yaw, pitch, roll;
+    glm::vec3 glmTranslation, glmScale;
+    glm::quat glmRotation;
+};
+
+std::vector<Transform> randomTransforms(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(-3.1f, 3.1f);
+    std::uniform_real_distribution<float> size(0.25f, 4.0f);
+
+    std::vector<Transform> t(count);
+    for (Transform& o : t) {
+        o.glmTranslation = glm::vec3(value(rng), value(rng), value(rng));
+        o.glmScale = glm::vec3(size(rng), size(rng), size(rng));
+        o.yaw = angle(rng);
+        o.pitch = angle(rng);
+        o.roll = angle(rng);
+        o.glmRotation = glm::angleAxis(
+            angle(rng),
+            glm::normalize(glm::vec3(value(rng), value(rng), value(rng))));
+
+        const glm::vec3& p = o.glmTranslation;
+        const glm::vec3& s = o.glmScale;
+        const glm::quat& q = o.glmRotation;
+        o.translation = Vector4f(p.x, p.y, p.z, 1);
+        o.rotation = Vector4f(q.x, q.y, q.z, q.w);
+        o.scale = Vector4f(s.x, s.y, s.z, 1);
+    }
+    return t;
+}
+
+// The whole-matrix builders the fused ones replace, multiplied in with the
+// general product like MakeRotationX/Y/Z and MakeScale used to.
+Matrix4f fullRotationX(float t)
+{
+    return Matrix4f(1, 0, 0, 0,
+                    0, cosf(t), -sinf(t), 0,
+                    0, sinf(t), cosf(t), 0,
+                    0, 0, 0, 1);
+}
+
+Matrix4f fullRotationY(float t)
+{
+    return Matrix4f(cosf(t), 0, sinf(t), 0,
+                    0, 1, 0, 0,
+                    -sinf(t), 0, cosf(t), 0,
+                    0, 0, 0, 1);
+}
+
+Matrix4f fullRotationZ(float t)
+{
+    return Matrix4f(cosf(t), -sinf(t), 0, 0,
+                    sinf(t), cosf(t), 0, 0,
+                    0, 0, 1, 0,
+                    0, 0, 0, 1);
+}
+
+Matrix4f fullScale(const Vector4f& s)
+{
+    return Matrix4f(s.x, 0, 0, 0,
+                    0, s.y, 0, 0,
+                    0, 0, s.z, 0,
+                    0, 0, 0, 1);
+}
+
+Matrix4f fullTranslation(const Vector4f& t)
+{
+    return Matrix4f(1, 0, 0, t.x,
+                    0, 1, 0, t.y,
+                    0, 0, 1, t.z,
+                    0, 0, 0, 1);
+}
+
+// the rotation a unit quaternion (x, y, z, w) stands for
+Matrix4f fullRotation(const Vector4f& q)
+{
+    const float x = q.x, y = q.y, z = q.z, w = q.w;
+    return Matrix4f(1 - 2 * (y * y + z * z), 2 * (x * y - w * z),
+                    2 * (x * z + w * y), 0,
+                    2 * (x * y + w * z), 1 - 2 * (x * x + z * z),
+                    2 * (y * z - w * x), 0,
+                    2 * (x * z - w * y), 2 * (y * z + w * x),
+                    1 - 2 * (x * x + y * y), 0,
+                    0, 0, 0, 1);
+}
+
+// T * Ry * Rx * Rz * S, three ways
+Matrix4f eulerFull(const Transform& o)
+{
+    return fullTranslation(o.translation) * fullRotationY(o.yaw) *
+           fullRotationX(o.pitch) * fullRotationZ(o.roll) *
+           fullScale(o.scale);
+}
+
+Matrix4f eulerFused(const Transform& o)
+{
+    Matrix4f m;
+    m.identity();
+    m.Translate(o.translation.x, o.translation.y, o.translation.z);
+    m.RotateY(o.yaw).RotateX(o.pitch).RotateZ(o.roll);
+    return m.Scale(o.scale.x, o.scale.y, o.scale.z);
+}
+
+glm::mat4 eulerGlm(const Transform& o)
+{
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), o.glmTranslation);
+    m = glm::rotate(m, o.yaw, glm::vec3(0, 1, 0));
+    m = glm::rotate(m, o.pitch, glm::vec3(1, 0, 0));
+    m = glm::rotate(m, o.roll, glm::vec3(0, 0, 1));
+    return glm::scale(m, o.glmScale);
+}
+
+// T * R(q) * S, three ways
+Matrix4f quatFull(const Transform& o)
+{
+    return fullTranslation(o.translation) * fullRotation(o.rotation) *
+           fullScale(o.scale);
+}
+
+Matrix4f quatFused(const Transform& o)
+{
+    return ComposeTRS(o.translation, o.rotation, o.scale);
+}
+
+glm::mat4 quatGlm(const Transform& o)
+{
+    return glm::scale(glm::translate(glm::mat4(1.0f), o.glmTranslation) *
+                          glm::mat4_cast(o.glmRotation),
+                      o.glmScale);
+}
+
+bool close(float mine, float theirs)
+{
+    return std::fabs(mine - theirs) <=
+           1e-4f * std::max(1.0f, std::fabs(theirs));
+}
+
+bool agrees(const char* what, size_t k, const Matrix4f& m, const glm::mat4& g)
+{
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            if (!close(m(i, j), g[j][i])) {
+                std::cout << "FAIL: " << what << " " << k << " (" << i << ","
+                          << j << ") is " << m(i, j) << ", glm has "
+                          << g[j][i] << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool check(const std::vector<Transform>& t)
+{
+    for (size_t k = 0; k < t.size(); k++) {
+        const glm::mat4 euler = eulerGlm(t[k]);
+        const glm::mat4 quat = quatGlm(t[k]);
+        Matrix4f before = fullTranslation(t[k].translation);
+        const glm::mat4 glmBefore =
+            glm::translate(glm::mat4(1.0f), t[k].glmTranslation);
+
+        if (!agrees("Euler, full matrices,", k, eulerFull(t[k]), euler) ||
+            !agrees("Euler, fused,", k, eulerFused(t[k]), euler) ||
+            !agrees("quaternion, full matrices,", k, quatFull(t[k]), quat) ||
+            !agrees("ComposeTRS", k, quatFused(t[k]), quat) ||
+            !agrees("MakeRotationX", k, before.MakeRotationX(t[k].pitch),
+                    glm::rotate(glm::mat4(1.0f), t[k].pitch,
+                                glm::vec3(1, 0, 0)) *
+                        glmBefore)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// best of RUNS, in ns per matrix (PASSES * count of them per run)
+template <typename F>
+double bestNs(size_t count, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        const Clock::time_point start = Clock::now();
+        for (int pass = 0; pass < PASSES; pass++) {
+            f();
+        }
+        const double ns =
+            std::chrono::duration<double, std::nano>(Clock::now() - start)
+                .count();
+        best = std::min(best, ns / (double(PASSES) * count));
+    }
+    return best;
+}
+
+// keeps results alive, so the loops can't be optimised away
+volatile float g_sink;
+
+void report(const char* label, double full, double fused, double glmNs)
+{
+    std::cout << "  " << std::left << std::setw(22) << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10) << full
+              << std::setw(10) << fused << std::setw(10) << glmNs
+              << std::setw(9) << full / fused << "x\n";
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = DEFAULT_COUNT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--count") {
+            count = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    const std::vector<Transform> t = randomTransforms(count);
+    if (!check(t)) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Matrix4f> out(count);
+    std::vector<glm::mat4> glmOut(count);
+
+    std::cout << "backend " << Simd4f::NAME << ", " << count
+              << " transforms, every way agrees with glm\n"
+              << "  " << std::left << std::setw(22) << "ns per matrix"
+              << std::right << std::setw(10) << "full" << std::setw(10)
+              << "fused" << std::setw(10) << "glm" << std::setw(10)
+              << "speedup" << '\n';
+
+    // the angles and sizes are all in t, so sin and cos are in every time
+    const double eulerFullNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = eulerFull(t[k]);
+        }
+    });
+    const double eulerFusedNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = eulerFused(t[k]);
+        }
+    });
+    const double eulerGlmNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            glmOut[k] = eulerGlm(t[k]);
+        }
+    });
+    report("T * Ry * Rx * Rz * S", eulerFullNs, eulerFusedNs, eulerGlmNs);
+
+    const double quatFullNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = quatFull(t[k]);
+        }
+    });
+    const double quatFusedNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = quatFused(t[k]);
+        }
+    });
+    const double quatGlmNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            glmOut[k] = quatGlm(t[k]);
+        }
+    });
+    report("T * R(q) * S", quatFullNs, quatFusedNs, quatGlmNs);
+
+    // rotating matrices that are already there, the way MakeRotationX is
+    // used: R * m, one rotation each
+    std::vector<Matrix4f> models(count);
+    std::vector<glm::mat4> glmModels(count);
+    for (size_t k = 0; k < count; k++) {
+        models[k] = quatFused(t[k]);
+        glmModels[k] = quatGlm(t[k]);
+    }
+    const double preFullNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = fullRotationX(t[k].pitch) * models[k];
+        }
+    });
+    const double preFusedNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = models[k].MakeRotationX(t[k].pitch);
+        }
+    });
+    const double preGlmNs = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            glmOut[k] = glm::rotate(glm::mat4(1.0f), t[k].pitch,
+                                    glm::vec3(1, 0, 0)) *
+                        glmModels[k];
+        }
+    });
+    report("Rx * m", preFullNs, preFusedNs, preGlmNs);
+
+    g_sink = out[count / 2](1, 2) + glmOut[count / 2][2][1];
+
+    return EXIT_SUCCESS;
+}
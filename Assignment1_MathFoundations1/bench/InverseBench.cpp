@@ -0,0 +1,230 @@
+/** @file InverseBench.cpp
+ *  @brief Checks Matrix4f's Inverse, InverseAffine and NormalMatrix against
+ *  glm and times them side by side
+ *
+ *  Random model matrices (rotated, scaled and moved) and view-projections
+ *  are inverted with ours and with glm::inverse, glm::affineInverse and
+ *  glm::inverseTranspose, and every result has to agree. Then each is
+ *  timed, the way a scene would call them: once per node per frame.
+ *
+ *  usage: InverseBench [--count <n>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Matrix4f.h"
+#include "Vector4f.h"
+
+static const size_t DEFAULT_COUNT = 4096;
+static const int RUNS = 7;
+static const int PASSES = 64;  // over the whole batch, per run
+
+struct Data {
+    std::vector<Matrix4f> models, projections, out;
+    std::vector<glm::mat4> glmModels, glmProjections, glmOut;
+    std::vector<glm::mat3> glmNormals;
+};
+
+glm::mat4 toGlm(const Matrix4f& m)
+{
+    glm::mat4 g;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            g[j][i] = m(i, j);
+        }
+    }
+    return g;
+}
+
+Matrix4f fromGlm(const glm::mat4& g)
+{
+    Matrix4f m;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            m(i, j) = g[j][i];
+        }
+    }
+    return m;
+}
+
+Data makeData(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(-3.1f, 3.1f);
+    std::uniform_real_distribution<float> size(0.25f, 4.0f);
+
+    Data d;
+    for (size_t k = 0; k < count; k++) {
+        const glm::vec3 axis =
+            glm::normalize(glm::vec3(value(rng), value(rng), value(rng)));
+        const glm::mat4 model =
+            glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f),
+                                                  glm::vec3(value(rng),
+                                                            value(rng),
+                                                            value(rng))),
+                                   angle(rng), axis),
+                       glm::vec3(size(rng), size(rng), size(rng)));
+        const glm::mat4 projection =
+            glm::perspective(glm::radians(40.0f + 40 * size(rng) / 4),
+                             16.0f / 9.0f, 0.1f, 100.0f) *
+            glm::lookAt(glm::vec3(value(rng), value(rng), value(rng)),
+                        glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+        d.models.push_back(fromGlm(model));
+        d.projections.push_back(fromGlm(projection));
+        d.glmModels.push_back(model);
+        d.glmProjections.push_back(projection);
+    }
+    d.out.resize(count);
+    d.glmOut.resize(count);
+    d.glmNormals.resize(count);
+    return d;
+}
+
+// relative to the biggest entry, since an inverse's small entries are
+// differences of big ones
+bool agrees(const char* what, size_t k, const Matrix4f& m, const glm::mat4& g)
+{
+    float largest = 1.0f;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            largest = std::max(largest, std::fabs(g[j][i]));
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            if (std::fabs(m(i, j) - g[j][i]) > 1e-4f * largest) {
+                std::cout << "FAIL: " << what << " " << k << " (" << i << ","
+                          << j << ") is " << m(i, j) << ", glm has "
+                          << g[j][i] << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool check(const Data& d)
+{
+    for (size_t k = 0; k < d.models.size(); k++) {
+        const glm::mat4 normal(
+            glm::inverseTranspose(glm::mat3(d.glmModels[k])));
+        if (!agrees("Inverse of model", k, d.models[k].Inverse(),
+                    glm::inverse(d.glmModels[k])) ||
+            !agrees("Inverse of view-projection", k,
+                    d.projections[k].Inverse(),
+                    glm::inverse(d.glmProjections[k])) ||
+            !agrees("InverseAffine", k, d.models[k].InverseAffine(),
+                    glm::affineInverse(d.glmModels[k])) ||
+            !agrees("NormalMatrix", k, d.models[k].NormalMatrix(), normal)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// best of RUNS, in ns per matrix (PASSES * count of them per run)
+template <typename F>
+double bestNs(size_t count, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        const Clock::time_point start = Clock::now();
+        for (int pass = 0; pass < PASSES; pass++) {
+            f();
+        }
+        const double ns =
+            std::chrono::duration<double, std::nano>(Clock::now() - start)
+                .count();
+        best = std::min(best, ns / (double(PASSES) * count));
+    }
+    return best;
+}
+
+// keeps results alive, so the loops can't be optimised away
+volatile float g_sink;
+
+void report(const char* label, double mine, double glmNs)
+{
+    std::cout << "  " << std::left << std::setw(22) << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10) << mine
+              << std::setw(10) << glmNs << std::setw(9) << glmNs / mine
+              << "x\n";
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = DEFAULT_COUNT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--count") {
+            count = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    Data d = makeData(count);
+    if (!check(d)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "backend " << Simd4f::NAME << ", " << count
+              << " matrices, all inverses agree with glm\n"
+              << "  " << std::left << std::setw(22) << "ns per matrix"
+              << std::right << std::setw(10) << "ours" << std::setw(10)
+              << "glm" << std::setw(10) << "speedup" << '\n';
+
+    const double inverse = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = d.projections[k].Inverse();
+        }
+    });
+    const double glmInverse = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.glmOut[k] = glm::inverse(d.glmProjections[k]);
+        }
+    });
+    report("Inverse", inverse, glmInverse);
+
+    const double affine = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = d.models[k].InverseAffine();
+        }
+    });
+    const double glmAffine = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.glmOut[k] = glm::affineInverse(d.glmModels[k]);
+        }
+    });
+    report("InverseAffine", affine, glmAffine);
+
+    const double normal = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = d.models[k].NormalMatrix();
+        }
+    });
+    const double glmNormal = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.glmNormals[k] = glm::inverseTranspose(glm::mat3(d.glmModels[k]));
+        }
+    });
+    report("NormalMatrix", normal, glmNormal);
+
+    g_sink = d.out[count / 2](1, 2) + d.glmOut[count / 2][2][1] +
+             d.glmNormals[count - 1][0][0];
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+/** @file MathBench.cpp
+ *  @brief Checks Vector4f and Matrix4f against glm and times them side by side
+ *
+ *  Random matrices and vectors are multiplied with our operators and with
+ *  glm's, and every result has to agree to within a few float roundings.
+ *  Then matrix times matrix (a batch of independent products, and a chain
+ *  where each product needs the one before), matrix times vector and a few
+ *  vector operations are timed both ways.
+ *
+ *  The backend is whatever Simd4f.h picked for this build; MathBenchScalar
+ *  is the same bench built with MATH_SCALAR, for the plain float numbers.
+ *
+ *  usage: MathBench [--count <n>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Matrix4f.h"
+#include "Vector4f.h"
+
+static const size_t DEFAULT_COUNT = 4096;
+static const int RUNS = 7;
+static const int PASSES = 64;  // over the whole batch, per run
+static const size_t CHAIN = 16;
+
+struct Data {
+    std::vector<Matrix4f> a, b, out;
+    std::vector<Vector4f> v, vout;
+    std::vector<glm::mat4> ga, gb, gout;
+    std::vector<glm::vec4> gv, gvout;
+};
+
+glm::mat4 toGlm(const Matrix4f& m)
+{
+    glm::mat4 g;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            g[j][i] = m(i, j);
+        }
+    }
+    return g;
+}
+
+Data makeData(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+
+    Data d;
+    for (size_t k = 0; k < count; k++) {
+        Matrix4f a, b;
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                a(i, j) = value(rng);
+                b(i, j) = value(rng);
+            }
+        }
+        Vector4f v(value(rng), value(rng), value(rng), 1.0f);
+
+        d.a.push_back(a);
+        d.b.push_back(b);
+        d.v.push_back(v);
+        d.ga.push_back(toGlm(a));
+        d.gb.push_back(toGlm(b));
+        d.gv.push_back(glm::vec4(v.x, v.y, v.z, v.w));
+    }
+    d.out.resize(count);
+    d.vout.resize(count);
+    d.gout.resize(count);
+    d.gvout.resize(count);
+    return d;
+}
+
+bool close(float mine, float theirs)
+{
+    return std::fabs(mine - theirs) <=
+           1e-5f * std::max(1.0f, std::fabs(theirs));
+}
+
+// every product against glm's; prints the first that's off
+bool check(const Data& d)
+{
+    for (size_t k = 0; k < d.a.size(); k++) {
+        const Matrix4f m = d.a[k] * d.b[k];
+        const glm::mat4 g = d.ga[k] * d.gb[k];
+        const Vector4f v = d.a[k] * d.v[k];
+        const glm::vec4 gv = d.ga[k] * d.gv[k];
+
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                if (!close(m(i, j), g[j][i])) {
+                    std::cout << "FAIL: product " << k << " (" << i << ","
+                              << j << ") is " << m(i, j) << ", glm has "
+                              << g[j][i] << '\n';
+                    return false;
+                }
+            }
+            if (!close(v[j], gv[j])) {
+                std::cout << "FAIL: transformed vector " << k << " [" << j
+                          << "] is " << v[j] << ", glm has " << gv[j] << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// best of RUNS, in ns per operation (PASSES * count of them per run)
+template <typename F>
+double bestNs(size_t count, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        const Clock::time_point start = Clock::now();
+        for (int pass = 0; pass < PASSES; pass++) {
+            f();
+        }
+        const double ns =
+            std::chrono::duration<double, std::nano>(Clock::now() - start)
+                .count();
+        best = std::min(best, ns / (double(PASSES) * count));
+    }
+    return best;
+}
+
+// keeps results alive, so the loops can't be optimised away
+volatile float g_sink;
+
+void report(const char* label, double mine, double glmNs)
+{
+    std::cout << "  " << std::left << std::setw(22) << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10) << mine
+              << std::setw(10) << glmNs << std::setw(9) << glmNs / mine
+              << "x\n";
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = DEFAULT_COUNT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--count") {
+            count = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    Data d = makeData(count);
+    if (!check(d)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "backend " << Simd4f::NAME << ", " << count
+              << " matrices, all products agree with glm\n"
+              << "  " << std::left << std::setw(22) << "ns per op"
+              << std::right << std::setw(10) << "ours" << std::setw(10)
+              << "glm" << std::setw(10) << "speedup" << '\n';
+
+    const double matBatch = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = d.a[k] * d.b[k];
+        }
+    });
+    const double glmMatBatch = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gout[k] = d.ga[k] * d.gb[k];
+        }
+    });
+    report("mat * mat (batch)", matBatch, glmMatBatch);
+
+    // each product needs the last, restarting every CHAIN so it stays finite
+    Matrix4f chain;
+    glm::mat4 glmChain(1.0f);
+    const double matChain = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            if (k % CHAIN == 0) {
+                chain.identity();
+            }
+            chain = chain * d.b[k];
+        }
+    });
+    const double glmMatChain = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            if (k % CHAIN == 0) {
+                glmChain = glm::mat4(1.0f);
+            }
+            glmChain = glmChain * d.gb[k];
+        }
+    });
+    report("mat * mat (chain)", matChain, glmMatChain);
+
+    const double matVec = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.vout[k] = d.a[0] * d.v[k];
+        }
+    });
+    const double glmMatVec = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gvout[k] = d.ga[0] * d.gv[k];
+        }
+    });
+    report("mat * vec", matVec, glmMatVec);
+
+    const double vecOps = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.vout[k] = (d.v[k] + d.vout[k]) * 0.5f - d.v[0];
+        }
+    });
+    const double glmVecOps = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gvout[k] = (d.gv[k] + d.gvout[k]) * 0.5f - d.gv[0];
+        }
+    });
+    report("(a + b) * s - c", vecOps, glmVecOps);
+
+    g_sink = d.out[count / 2](1, 2) + d.gout[count / 2][2][1] + chain(3, 3) +
+             glmChain[3][3] + d.vout[count - 1].x + d.gvout[count - 1].x;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/** @file QuatBench.cpp
+ *  @brief Checks Quaternionf against glm::quat and times them side by side
+ *
+ *  Random rotations are composed, turned into matrices and back, used to
+ *  rotate vectors, and blended with Nlerp, Slerp and the batch Slerp, with
+ *  ours and with glm's, and every result has to agree (the slerps to
+ *  within SLERP_TOLERANCE, the largest difference is printed). Then each
+ *  is timed both ways.
+ *
+ *  usage: QuatBench [--count <n>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Matrix4f.h"
+#include "Quaternionf.h"
+#include "Vector4f.h"
+
+static const size_t DEFAULT_COUNT = 4096;
+static const int RUNS = 7;
+static const int PASSES = 64;  // over the whole batch, per run
+static const float SLERP_TOLERANCE = 1e-6f;
+
+struct Data {
+    std::vector<Quaternionf> a, b, out;
+    std::vector<Vector4f> v, vout;
+    std::vector<Matrix4f> m;
+    std::vector<float> t;
+    std::vector<glm::quat> ga, gb, gout;
+    std::vector<glm::vec3> gv, gvout;
+    std::vector<glm::mat4> gm;
+};
+
+Data makeData(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+    std::uniform_real_distribution<float> fraction(0.0f, 1.0f);
+
+    Data d;
+    for (size_t k = 0; k < count; k++) {
+        const glm::quat qa = glm::angleAxis(
+            angle(rng),
+            glm::normalize(glm::vec3(value(rng), value(rng), value(rng))));
+        const glm::quat qb = glm::angleAxis(
+            angle(rng),
+            glm::normalize(glm::vec3(value(rng), value(rng), value(rng))));
+        const glm::vec3 v(value(rng), value(rng), value(rng));
+
+        d.a.push_back(Quaternionf(qa.x, qa.y, qa.z, qa.w));
+        d.b.push_back(Quaternionf(qb.x, qb.y, qb.z, qb.w));
+        d.v.push_back(Vector4f(v.x, v.y, v.z, 1));
+        d.t.push_back(fraction(rng));
+        d.ga.push_back(qa);
+        d.gb.push_back(qb);
+        d.gv.push_back(v);
+        d.m.push_back(ToMatrix(d.a.back()));
+        d.gm.push_back(glm::mat4_cast(qa));
+    }
+    d.out.resize(count);
+    d.vout.resize(count);
+    d.gout.resize(count);
+    d.gvout.resize(count);
+    return d;
+}
+
+// the largest difference between two quaternions' parts
+float difference(const Quaternionf& mine, const glm::quat& theirs)
+{
+    return std::max(std::max(std::fabs(mine.x - theirs.x),
+                             std::fabs(mine.y - theirs.y)),
+                    std::max(std::fabs(mine.z - theirs.z),
+                             std::fabs(mine.w - theirs.w)));
+}
+
+bool fail(const char* what, size_t k, float off)
+{
+    std::cout << "FAIL: " << what << " " << k << " is off by " << off
+              << '\n';
+    return false;
+}
+
+bool check(const Data& d)
+{
+    const size_t count = d.a.size();
+    std::vector<Quaternionf> batch(count);
+    Slerp(&d.a[0], &d.b[0], &d.t[0], count, &batch[0]);
+
+    float worstSlerp = 0;
+    for (size_t k = 0; k < count; k++) {
+        const glm::quat& ga = d.ga[k];
+        const glm::quat& gb = d.gb[k];
+        const float t = d.t[k];
+        const glm::quat shortB = glm::dot(ga, gb) < 0 ? -gb : gb;
+
+        float off = difference(d.a[k] * d.b[k], ga * gb);
+        if (off > 1e-6f) {
+            return fail("product", k, off);
+        }
+        const Vector4f r = Rotate(d.a[k], d.v[k]);
+        const glm::vec3 gr = ga * d.gv[k];
+        off = std::max(std::max(std::fabs(r.x - gr.x), std::fabs(r.y - gr.y)),
+                       std::fabs(r.z - gr.z));
+        if (off > 1e-5f) {
+            return fail("rotated vector", k, off);
+        }
+        const Matrix4f m = ToMatrix(d.a[k]);
+        const glm::mat4 gm = glm::mat4_cast(ga);
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                off = std::fabs(m(i, j) - gm[j][i]);
+                if (off > 1e-6f) {
+                    return fail("ToMatrix", k, off);
+                }
+            }
+        }
+        // either sign is the same rotation
+        const Quaternionf q = ToQuaternion(d.m[k]);
+        off = std::min(difference(q, ga), difference(q, -ga));
+        if (off > 1e-5f) {
+            return fail("ToQuaternion", k, off);
+        }
+        off = difference(Nlerp(d.a[k], d.b[k], t),
+                         glm::normalize(ga * (1 - t) + shortB * t));
+        if (off > 1e-6f) {
+            return fail("Nlerp", k, off);
+        }
+
+        const glm::quat slerped = glm::slerp(ga, gb, t);
+        off = std::max(difference(Slerp(d.a[k], d.b[k], t), slerped),
+                       difference(batch[k], slerped));
+        if (off > SLERP_TOLERANCE) {
+            return fail("Slerp", k, off);
+        }
+        worstSlerp = std::max(worstSlerp, off);
+    }
+    std::cout << "largest Slerp difference from glm " << worstSlerp << '\n';
+    return true;
+}
+
+// best of RUNS, in ns per operation (PASSES * count of them per run)
+template <typename F>
+double bestNs(size_t count, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        const Clock::time_point start = Clock::now();
+        for (int pass = 0; pass < PASSES; pass++) {
+            f();
+        }
+        const double ns =
+            std::chrono::duration<double, std::nano>(Clock::now() - start)
+                .count();
+        best = std::min(best, ns / (double(PASSES) * count));
+    }
+    return best;
+}
+
+// keeps results alive, so the loops can't be optimised away
+volatile float g_sink;
+
+void report(const char* label, double mine, double glmNs)
+{
+    std::cout << "  " << std::left << std::setw(22) << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10) << mine
+              << std::setw(10) << glmNs << std::setw(9) << glmNs / mine
+              << "x\n";
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = DEFAULT_COUNT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--count") {
+            count = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    Data d = makeData(count);
+    if (!check(d)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "backend " << Simd4f::NAME << ", " << count
+              << " rotations, all agree with glm\n"
+              << "  " << std::left << std::setw(22) << "ns per op"
+              << std::right << std::setw(10) << "ours" << std::setw(10)
+              << "glm" << std::setw(10) << "speedup" << '\n';
+
+    const double product = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = d.a[k] * d.b[k];
+        }
+    });
+    const double glmProduct = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gout[k] = d.ga[k] * d.gb[k];
+        }
+    });
+    report("q * p", product, glmProduct);
+
+    const double rotate = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.vout[k] = Rotate(d.a[k], d.v[k]);
+        }
+    });
+    const double glmRotate = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gvout[k] = d.ga[k] * d.gv[k];
+        }
+    });
+    report("rotate a vector", rotate, glmRotate);
+
+    std::vector<Matrix4f> m(count);
+    std::vector<glm::mat4> gm(count);
+    const double toMatrix = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            m[k] = ToMatrix(d.a[k]);
+        }
+    });
+    const double glmToMatrix = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            gm[k] = glm::mat4_cast(d.ga[k]);
+        }
+    });
+    report("to a matrix", toMatrix, glmToMatrix);
+
+    const double fromMatrix = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = ToQuaternion(d.m[k]);
+        }
+    });
+    const double glmFromMatrix = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gout[k] = glm::quat_cast(d.gm[k]);
+        }
+    });
+    report("from a matrix", fromMatrix, glmFromMatrix);
+
+    // glm has no nlerp; this is what it takes by hand
+    const double nlerp = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = Nlerp(d.a[k], d.b[k], d.t[k]);
+        }
+    });
+    const double glmNlerp = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            const glm::quat& a = d.ga[k];
+            const glm::quat b = glm::dot(a, d.gb[k]) < 0 ? -d.gb[k] : d.gb[k];
+            d.gout[k] = glm::normalize(a * (1 - d.t[k]) + b * d.t[k]);
+        }
+    });
+    report("nlerp", nlerp, glmNlerp);
+
+    const double slerp = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.out[k] = Slerp(d.a[k], d.b[k], d.t[k]);
+        }
+    });
+    const double batchSlerp = bestNs(count, [&] {
+        Slerp(&d.a[0], &d.b[0], &d.t[0], count, &d.out[0]);
+    });
+    const double glmSlerp = bestNs(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            d.gout[k] = glm::slerp(d.ga[k], d.gb[k], d.t[k]);
+        }
+    });
+    report("slerp", slerp, glmSlerp);
+    report("slerp (batch)", batchSlerp, glmSlerp);
+
+    g_sink = d.out[count / 2].x + d.gout[count / 2].y + d.vout[count - 1].z +
+             d.gvout[count - 1].x + m[count / 3](1, 2) + gm[count / 3][2][1];
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+/** @file TransformBench.cpp
+ *  @brief Checks the batch TransformPoints versions and times them per ISA
+ *
+ *  Every version this CPU has (scalar, Simd4f, AVX2, AVX-512) transforms
+ *  random points by a view-projection matrix, as separate x/y/z arrays and
+ *  as Vector4f's, with and without the perspective divide, in place and
+ *  not, on every count up to a few vector widths and from unaligned
+ *  starts, and has to agree with a double precision reference. Then a
+ *  batch of points is timed with each version, next to transforming them
+ *  one at a time with Matrix4f * Vector4f and with glm, and the rates are
+ *  printed in millions of points per second. The default batch fits in L2;
+ *  much bigger ones mostly time the memory.
+ *
+ *  usage: TransformBench [--count <n>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Matrix4f.h"
+#include "TransformPoints.h"
+#include "Vector4f.h"
+
+// small enough to stay in cache; bigger batches only measure the memory
+static const size_t DEFAULT_COUNT = 1 << 14;
+static const size_t MAX_CHECK = 70;
+static const int RUNS = 7;
+static const int PASSES = 64;  // over the whole batch, per run
+
+struct Points {
+    std::vector<float> x, y, z;
+    std::vector<Vector4f> v;
+};
+
+// somewhere in front of the camera, so w stays well away from 0
+Points randomPoints(size_t count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> side(-5.0f, 5.0f);
+    std::uniform_real_distribution<float> depth(1.0f, 50.0f);
+
+    Points p;
+    for (size_t k = 0; k < count; k++) {
+        const float x = side(rng), y = side(rng), z = -depth(rng);
+        p.x.push_back(x);
+        p.y.push_back(y);
+        p.z.push_back(z);
+        p.v.push_back(Vector4f(x, y, z, 1.0f));
+    }
+    return p;
+}
+
+Matrix4f fromGlm(const glm::mat4& g)
+{
+    Matrix4f m;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            m(i, j) = g[j][i];
+        }
+    }
+    return m;
+}
+
+// M * (x, y, z, w) in doubles, divided through if asked
+void reference(const Matrix4f& M, const Vector4f& v, bool divide, double t[4])
+{
+    for (int i = 0; i < 4; i++) {
+        t[i] = double(M(i, 0)) * v.x + double(M(i, 1)) * v.y +
+               double(M(i, 2)) * v.z + double(M(i, 3)) * v.w;
+    }
+    if (divide) {
+        t[0] /= t[3];
+        t[1] /= t[3];
+        t[2] /= t[3];
+    }
+}
+
+bool close(float mine, double exact)
+{
+    return std::fabs(mine - exact) <= 1e-5 * std::max(1.0, std::fabs(exact));
+}
+
+bool fail(const char* what, TransformIsa isa, size_t count, size_t k,
+          bool divide)
+{
+    std::cout << "FAIL: " << what << " " << TransformIsaName(isa) << ", "
+              << count << " points" << (divide ? " divided" : "")
+              << ", point " << k << '\n';
+    return false;
+}
+
+// both layouts, every count up to MAX_CHECK, starting one float in
+bool check(const Matrix4f& M, TransformIsa isa)
+{
+    const Points p = randomPoints(MAX_CHECK + 1, 7);
+
+    for (size_t count = 0; count <= MAX_CHECK; count++) {
+        for (bool divide : {false, true}) {
+            for (bool inPlace : {false, true}) {
+                std::vector<float> x(p.x), y(p.y), z(p.z);
+                std::vector<float> ox(MAX_CHECK + 1, -1.0f);
+                std::vector<float> oy(ox), oz(ox), ow(ox);
+                float* outX = inPlace ? &x[1] : &ox[1];
+                float* outY = inPlace ? &y[1] : &oy[1];
+                float* outZ = inPlace ? &z[1] : &oz[1];
+
+                TransformPoints(M, &x[1], &y[1], &z[1], count, outX, outY,
+                                outZ, &ow[1], divide, isa);
+
+                for (size_t k = 1; k <= count; k++) {
+                    double t[4];
+                    reference(M, p.v[k], divide, t);
+                    if (!close(outX[k - 1], t[0]) ||
+                        !close(outY[k - 1], t[1]) ||
+                        !close(outZ[k - 1], t[2]) || !close(ow[k], t[3])) {
+                        return fail("x/y/z", isa, count, k, divide);
+                    }
+                }
+                // nothing past the end
+                if (!inPlace && count < MAX_CHECK &&
+                    (ox[count + 1] != -1.0f || ow[count + 1] != -1.0f)) {
+                    return fail("x/y/z overrun", isa, count, count, divide);
+                }
+
+                std::vector<Vector4f> v(p.v);
+                std::vector<Vector4f> out(MAX_CHECK + 1,
+                                          Vector4f(-1, -1, -1, -1));
+                Vector4f* o = inPlace ? &v[1] : &out[1];
+                TransformPoints(M, &v[1], count, o, divide, isa);
+
+                for (size_t k = 1; k <= count; k++) {
+                    double t[4];
+                    reference(M, p.v[k], divide, t);
+                    const Vector4f& r = o[k - 1];
+                    if (!close(r.x, t[0]) || !close(r.y, t[1]) ||
+                        !close(r.z, t[2]) || !close(r.w, t[3])) {
+                        return fail("Vector4f", isa, count, k, divide);
+                    }
+                }
+                if (!inPlace && count < MAX_CHECK &&
+                    out[count + 1].x != -1.0f) {
+                    return fail("Vector4f overrun", isa, count, count,
+                                divide);
+                }
+            }
+        }
+    }
+
+    // no w wanted
+    std::vector<float> ox(MAX_CHECK), oy(MAX_CHECK), oz(MAX_CHECK);
+    TransformPoints(M, &p.x[0], &p.y[0], &p.z[0], MAX_CHECK, &ox[0], &oy[0],
+                    &oz[0], nullptr, true, isa);
+    for (size_t k = 0; k < MAX_CHECK; k++) {
+        double t[4];
+        reference(M, p.v[k], true, t);
+        if (!close(ox[k], t[0]) || !close(oy[k], t[1]) ||
+            !close(oz[k], t[2])) {
+            return fail("x/y/z without w", isa, MAX_CHECK, k, true);
+        }
+    }
+    return true;
+}
+
+// best of RUNS, in millions of points per second
+template <typename F>
+double bestRate(size_t count, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        const Clock::time_point start = Clock::now();
+        for (int pass = 0; pass < PASSES; pass++) {
+            f();
+        }
+        best = std::min(
+            best,
+            std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return double(PASSES) * count / best / 1e6;
+}
+
+// keeps results alive, so the loops can't be optimised away
+volatile float g_sink;
+
+void report(const char* label, double plain, double divided)
+{
+    std::cout << "  " << std::left << std::setw(26) << label << std::right
+              << std::fixed << std::setprecision(1) << std::setw(10)
+              << plain << std::setw(10) << divided << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = DEFAULT_COUNT;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--count") {
+            count = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    const glm::mat4 glmViewProjection =
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+        glm::lookAt(glm::vec3(1, 2, 3), glm::vec3(0, 0, -20),
+                    glm::vec3(0, 1, 0));
+    const Matrix4f viewProjection = fromGlm(glmViewProjection);
+
+    std::vector<TransformIsa> isas;
+    for (int isa = TRANSFORM_SCALAR; isa <= BestTransformIsa(); isa++) {
+        if (AvailableTransformIsa(TransformIsa(isa)) == isa) {
+            isas.push_back(TransformIsa(isa));
+        }
+    }
+
+    for (TransformIsa isa : isas) {
+        if (!check(viewProjection, isa)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    Points p = randomPoints(count, 1234);
+    std::vector<float> ox(count), oy(count), oz(count), ow(count);
+    std::vector<Vector4f> out(count);
+    std::vector<glm::vec4> glmIn, glmOut(count);
+    for (const Vector4f& v : p.v) {
+        glmIn.push_back(glm::vec4(v.x, v.y, v.z, v.w));
+    }
+
+    std::cout << count << " points, every version agrees with the "
+              << "reference\n"
+              << "  " << std::left << std::setw(26) << "Mpoints/s" << std::right
+              << std::setw(10) << "plain" << std::setw(10) << "divided"
+              << '\n';
+
+    // one at a time, the way every caller did it
+    const double oneByOne = bestRate(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = viewProjection * p.v[k];
+        }
+    });
+    const double oneByOneDivided = bestRate(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            Vector4f t = viewProjection * p.v[k];
+            const float w = t.w;
+            t /= w;
+            t.w = w;
+            out[k] = t;
+        }
+    });
+    report("Matrix4f * Vector4f", oneByOne, oneByOneDivided);
+
+    const double glmRate = bestRate(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            glmOut[k] = glmViewProjection * glmIn[k];
+        }
+    });
+    const double glmDivided = bestRate(count, [&] {
+        for (size_t k = 0; k < count; k++) {
+            const glm::vec4 t = glmViewProjection * glmIn[k];
+            glmOut[k] = glm::vec4(glm::vec3(t) / t.w, t.w);
+        }
+    });
+    report("glm::mat4 * glm::vec4", glmRate, glmDivided);
+
+    for (TransformIsa isa : isas) {
+        const double soa = bestRate(count, [&] {
+            TransformPoints(viewProjection, &p.x[0], &p.y[0], &p.z[0], count,
+                            &ox[0], &oy[0], &oz[0], &ow[0], false, isa);
+        });
+        const double soaDivided = bestRate(count, [&] {
+            TransformPoints(viewProjection, &p.x[0], &p.y[0], &p.z[0], count,
+                            &ox[0], &oy[0], &oz[0], &ow[0], true, isa);
+        });
+        const double aos = bestRate(count, [&] {
+            TransformPoints(viewProjection, &p.v[0], count, &out[0], false,
+                            isa);
+        });
+        const double aosDivided = bestRate(count, [&] {
+            TransformPoints(viewProjection, &p.v[0], count, &out[0], true,
+                            isa);
+        });
+
+        const std::string name = TransformIsaName(isa);
+        report((name + " x/y/z arrays").c_str(), soa, soaDivided);
+        report((name + " Vector4f array").c_str(), aos, aosDivided);
+    }
+
+    g_sink = ox[count / 2] + ow[count - 1] + out[count / 3].y +
+             glmOut[count / 5].z;
+
+    return EXIT_SUCCESS;
+}
@@ -19,13 +19,17 @@ std::ostream& operator<<(std::ostream& os, const Matrix4f& m);
 // Matrix 4f represents 4x4 matrices in Math
 struct Matrix4f {
 private:
-    float n[4][4];  // Store each value of the matrix
+    // Store each value of the matrix (each column 16 byte aligned, so it can
+    // be loaded as a register)
+    alignas(16) float n[4][4];
 
 public:
     Matrix4f() = default;
 
-    // copy constructor
-    Matrix4f(const Matrix4f &m) : Matrix4f(m[0], m[1], m[2], m[3]) {}
+    // copy constructor (a plain copy of the columns, so it can be done a
+    // register at a time)
+    Matrix4f(const Matrix4f &m) = default;
+    Matrix4f& operator=(const Matrix4f &m) = default;
 
     // Matrix constructor with 16 scalar values in row-major order
     Matrix4f(float n00, float n01, float n02, float n03, 
@@ -45,10 +49,10 @@ public:
     Matrix4f(const Vector4f& a, const Vector4f& b, const Vector4f& c,
              const Vector4f& d)
     {
-        n[0][0] = a.x; n[1][0] = b.x; n[2][0] = c.x; n[3][0] = d.x;
-        n[0][1] = a.y; n[1][1] = b.y; n[2][1] = c.y; n[3][1] = d.y;
-        n[0][2] = a.z; n[1][2] = b.z; n[2][2] = c.z; n[3][2] = d.z;
-        n[0][3] = a.w; n[1][3] = b.w; n[2][3] = c.w; n[3][3] = d.w;
+        Simd4f::Store(n[0], a.Load());
+        Simd4f::Store(n[1], b.Load());
+        Simd4f::Store(n[2], c.Load());
+        Simd4f::Store(n[3], d.Load());
     }
 
     // Makes the matrix an identity matrix
@@ -80,83 +84,252 @@ public:
     // from http://mathworld.wolfram.com/RotationMatrix.html
 
     // Make a matrix rotate about various axis
+    // These return R * (*this), R being
+    //   1  0  0       c  0  s       c -s  0
+    //   0  c -s  ,    0  1  0  or   s  c  0
+    //   0  s  c      -s  0  c       0  0  1
+    // which only mixes two of the rows, so rather than multiplying by all of
+    // R, each column v becomes v * keep + (v with those two rows swapped) *
+    // mix.
     Matrix4f MakeRotationX(float t)
     {
-        return Matrix4f{1, 0, 0, 0,
-            0, cosf(t), -sinf(t), 0,
-            0, sinf(t), cosf(t), 0,
-            0, 0, 0, 1} * (*this);
+        const float c = cosf(t), s = sinf(t);
+        return MixRows<0, 2, 1, 3>(Simd4f::Set(1, c, c, 1),
+                                   Simd4f::Set(0, -s, s, 0));
     }
     Matrix4f MakeRotationY(float t)
     {
-        return Matrix4f{cosf(t), 0, -sinf(t), 0,
-            0, 1, 0, 0,
-            sinf(t), 0, cosf(t), 0,
-            0, 0, 0, 1} * (*this);
+        const float c = cosf(t), s = sinf(t);
+        return MixRows<2, 1, 0, 3>(Simd4f::Set(c, 1, c, 1),
+                                   Simd4f::Set(s, 0, -s, 0));
     }
     Matrix4f MakeRotationZ(float t)
     {
-        return Matrix4f{cosf(t), sinf(t), 0, 0,
-                -sinf(t), cosf(t), 0, 0,
-                0, 0, 1, 0,
-                0, 0, 0, 1} * (*this);
+        const float c = cosf(t), s = sinf(t);
+        return MixRows<1, 0, 2, 3>(Simd4f::Set(c, c, 1, 1),
+                                   Simd4f::Set(-s, s, 0, 0));
     }
     Matrix4f MakeScale(float sx, float sy, float sz)
     {
         Matrix4f m(*this);
+        return m.Scale(sx, sy, sz);
+    }
+
+    // These change the matrix in place, to (*this) * R, S or T: the
+    // transform applied before this one, like glm::rotate(m, t, axis),
+    // glm::scale(m, s) and glm::translate(m, t). Each only works out the
+    // columns the transform changes.
+    Matrix4f& RotateX(float t) { return MixColumns(1, 2, t); }
+    Matrix4f& RotateY(float t) { return MixColumns(2, 0, t); }
+    Matrix4f& RotateZ(float t) { return MixColumns(0, 1, t); }
+    Matrix4f& Scale(float sx, float sy, float sz)
+    {
+        Simd4f::Store(n[0], Simd4f::Mul(Column(0), Simd4f::Splat(sx)));
+        Simd4f::Store(n[1], Simd4f::Mul(Column(1), Simd4f::Splat(sy)));
+        Simd4f::Store(n[2], Simd4f::Mul(Column(2), Simd4f::Splat(sz)));
+        return *this;
+    }
+    Matrix4f& Translate(float tx, float ty, float tz)
+    {
+        Simd4f::Reg t = Simd4f::MulAdd(Column(0), Simd4f::Splat(tx), Column(3));
+        t = Simd4f::MulAdd(Column(1), Simd4f::Splat(ty), t);
+        Simd4f::Store(n[3], Simd4f::MulAdd(Column(2), Simd4f::Splat(tz), t));
+        return *this;
+    }
+
+    // The inverse of any invertible matrix, by Cramer's rule written with
+    // cross products (Lengyel, Foundations of Game Engine Development 1,
+    // 1.7.5). A singular matrix gives infinities or NaNs, as glm::inverse
+    // does.
+    Matrix4f Inverse() const
+    {
+        using namespace Simd4f;
+
+        const Reg a = Column(0), b = Column(1), c = Column(2), d = Column(3);
+        // the bottom row
+        const Reg x = Broadcast<3>(a), y = Broadcast<3>(b);
+        const Reg z = Broadcast<3>(c), w = Broadcast<3>(d);
+
+        // every one of these has 0 in w
+        Reg s = Cross(a, b), t = Cross(c, d);
+        Reg u = Sub(Mul(a, y), Mul(b, x)), v = Sub(Mul(c, w), Mul(d, z));
+
+        const Reg invDet = Div(Splat(1.0f), Sum(Add(Mul(s, v), Mul(t, u))));
+        s = Mul(s, invDet);
+        t = Mul(t, invDet);
+        u = Mul(u, invDet);
+        v = Mul(v, invDet);
+
+        // the rows of the inverse, but for their last column
+        Reg r0 = MulAdd(t, y, Cross(b, v));
+        Reg r1 = Sub(Cross(v, a), Mul(t, x));
+        Reg r2 = MulAdd(s, w, Cross(d, u));
+        Reg r3 = Sub(Cross(u, c), Mul(s, z));
 
-        m[0] *= sx;
-        m[1] *= sy;
-        m[2] *= sz;
+        // the last column, -b.t, a.t, -d.s and c.s, as four dot products at
+        // once
+        Reg bt = Mul(b, t), at = Mul(a, t), ds = Mul(d, s), cs = Mul(c, s);
+        Transpose(bt, at, ds, cs);
+        const Reg last = Mul(Add(Add(bt, at), Add(ds, cs)), Set(-1, 1, -1, 1));
+
+        Transpose(r0, r1, r2, r3);
+        Matrix4f m;
+        Store(m.n[0], r0);
+        Store(m.n[1], r1);
+        Store(m.n[2], r2);
+        Store(m.n[3], last);
+        return m;
+    }
+
+    // The inverse of a matrix whose bottom row is 0 0 0 1 (any mix of
+    // rotations, scales, shears and translations): the inverse of the top
+    // left 3x3, and the translation run back through it. Much cheaper than
+    // Inverse(), but wrong for anything with a projection in it.
+    Matrix4f InverseAffine() const
+    {
+        using namespace Simd4f;
+
+        Reg r0, r1, r2;
+        InverseTranspose3(r0, r1, r2);
+        Reg r3 = Set(0, 0, 0, 1);
+        Transpose(r0, r1, r2, r3);
+
+        const Reg d = Column(3);
+        Reg t = Mul(r0, Broadcast<0>(d));
+        t = MulAdd(r1, Broadcast<1>(d), t);
+        t = MulAdd(r2, Broadcast<2>(d), t);
+
+        Matrix4f m;
+        Store(m.n[0], r0);
+        Store(m.n[1], r1);
+        Store(m.n[2], r2);
+        Store(m.n[3], Sub(r3, t));
+        return m;
+    }
+
+    // The matrix normals are transformed by, the inverse transpose of the
+    // top left 3x3 (what glm::inverseTranspose(glm::mat3(m)) gives), in a
+    // 4x4 with no translation. Normals come out unnormalised when there's
+    // any scaling.
+    Matrix4f NormalMatrix() const
+    {
+        Simd4f::Reg r0, r1, r2;
+        InverseTranspose3(r0, r1, r2);
 
+        Matrix4f m;
+        Simd4f::Store(m.n[0], r0);
+        Simd4f::Store(m.n[1], r1);
+        Simd4f::Store(m.n[2], r2);
+        Simd4f::Store(m.n[3], Simd4f::Set(0, 0, 0, 1));
         return m;
     }
+
+private:
+    Simd4f::Reg Column(int j) const { return Simd4f::Load(n[j]); }
+
+    // The columns of the inverse transpose of the top left 3x3 (so the rows
+    // of its inverse), with 0 in w: the cross products of the column pairs,
+    // over the determinant.
+    void InverseTranspose3(Simd4f::Reg& r0, Simd4f::Reg& r1,
+                           Simd4f::Reg& r2) const
+    {
+        using namespace Simd4f;
+
+        const Reg a = Column(0), b = Column(1), c = Column(2);
+        r0 = Cross(b, c);
+        r1 = Cross(c, a);
+        r2 = Cross(a, b);
+
+        const Reg invDet = Div(Splat(1.0f), Sum(Mul(a, r0)));
+        r0 = Mul(r0, invDet);
+        r1 = Mul(r1, invDet);
+        r2 = Mul(r2, invDet);
+    }
+
+    // R * (*this) for a rotation R that only mixes two rows (see above)
+    template <int i0, int i1, int i2, int i3>
+    Matrix4f MixRows(Simd4f::Reg keep, Simd4f::Reg mix) const
+    {
+        using namespace Simd4f;
+
+        Matrix4f m;
+        Store(m.n[0], MulAdd(Shuffle<i0, i1, i2, i3>(Column(0)), mix,
+                             Mul(Column(0), keep)));
+        Store(m.n[1], MulAdd(Shuffle<i0, i1, i2, i3>(Column(1)), mix,
+                             Mul(Column(1), keep)));
+        Store(m.n[2], MulAdd(Shuffle<i0, i1, i2, i3>(Column(2)), mix,
+                             Mul(Column(2), keep)));
+        Store(m.n[3], MulAdd(Shuffle<i0, i1, i2, i3>(Column(3)), mix,
+                             Mul(Column(3), keep)));
+        return m;
+    }
+
+    // (*this) * R for a rotation R by t that only mixes columns a and b:
+    // a becomes a cos t + b sin t, and b becomes b cos t - a sin t
+    Matrix4f& MixColumns(int a, int b, float t)
+    {
+        using namespace Simd4f;
+
+        const Reg c = Splat(cosf(t)), s = Splat(sinf(t));
+        const Reg ca = Column(a), cb = Column(b);
+        Store(n[a], MulAdd(cb, s, Mul(ca, c)));
+        Store(n[b], Sub(Mul(cb, c), Mul(ca, s)));
+        return *this;
+    }
 };
 
+// A's columns combined by the lanes of v: A[0] * v.x + ... + A[3] * v.w,
+// that is A * v as a register.
+SIMD4F_INLINE Simd4f::Reg CombineColumns(const Matrix4f& A, Simd4f::Reg v)
+{
+    Simd4f::Reg r = Simd4f::Mul(A[0].Load(), Simd4f::Broadcast<0>(v));
+    r = Simd4f::MulAdd(A[1].Load(), Simd4f::Broadcast<1>(v), r);
+    r = Simd4f::MulAdd(A[2].Load(), Simd4f::Broadcast<2>(v), r);
+    return Simd4f::MulAdd(A[3].Load(), Simd4f::Broadcast<3>(v), r);
+}
+
 // Matrix Multiplication
+// Each column of A * B is A's columns combined by that column of B.
 Matrix4f operator*(const Matrix4f& A, const Matrix4f& B)
 {
-    Matrix4f mat4
-    {
-        // column 0
-        A(0, 0) * B(0, 0) + A(0, 1) * B(1, 0) + A(0, 2) * B(2, 0) +
-        A(0, 3) * B(3, 0),
-        A(1, 0) * B(0, 0) + A(1, 1) * B(1, 0) + A(1, 2) * B(2, 0) + A(1, 3) * B(3, 0),
-        A(2, 0) * B(0, 0) + A(2, 1) * B(1, 0) + A(2, 2) * B(2, 0) + A(2, 3) * B(3, 0),
-        A(3, 0) * B(0, 0) + A(3, 1) * B(1, 0) + A(3, 2) * B(2, 0) + A(3, 3) * B(3, 0),
-        // column 1
-        A(0, 0) * B(0, 1) + A(0, 1) * B(1, 1) + A(0, 2) * B(2, 1) + A(0, 3) * B(3, 1),
-        A(1, 0) * B(0, 1) + A(1, 1) * B(1, 1) + A(1, 2) * B(2, 1) + A(1, 3) * B(3, 1),
-        A(2, 0) * B(0, 1) + A(2, 1) * B(1, 1) + A(2, 2) * B(2, 1) + A(2, 3) * B(3, 1),
-        A(3, 0) * B(0, 1) + A(3, 1) * B(1, 1) + A(3, 2) * B(2, 1) + A(3, 3) * B(3, 1),
-        // column 2
-        A(0, 0) * B(0, 2) + A(0, 1) * B(1, 2) + A(0, 2) * B(2, 2) + A(0, 3) * B(3, 2),
-        A(1, 0) * B(0, 2) + A(1, 1) * B(1, 2) + A(1, 2) * B(2, 2) + A(1, 3) * B(3, 2),
-        A(2, 0) * B(0, 2) + A(2, 1) * B(1, 2) + A(2, 2) * B(2, 2) + A(2, 3) * B(3, 2),
-        A(3, 0) * B(0, 2) + A(3, 1) * B(1, 2) + A(3, 2) * B(2, 2) + A(3, 3) * B(3, 2),
-        // column 3
-        A(0, 0) * B(0, 3) + A(0, 1) * B(1, 3) + A(0, 2) * B(2, 3) + A(0, 3) * B(3, 3),
-        A(1, 0) * B(0, 3) + A(1, 1) * B(1, 3) + A(1, 2) * B(2, 3) + A(1, 3) * B(3, 3),
-        A(2, 0) * B(0, 3) + A(2, 1) * B(1, 3) + A(2, 2) * B(2, 3) + A(2, 3) * B(3, 3),
-        A(3, 0) * B(0, 3) + A(3, 1) * B(1, 3) + A(3, 2) * B(2, 3) + A(3, 3) * B(3, 3)
-    };
-
-    return mat4;
+    return Matrix4f(Vector4f(CombineColumns(A, B[0].Load())),
+                    Vector4f(CombineColumns(A, B[1].Load())),
+                    Vector4f(CombineColumns(A, B[2].Load())),
+                    Vector4f(CombineColumns(A, B[3].Load())));
 }
 
 // Matrix multiply by a vector
 
 Vector4f operator*(const Matrix4f& M, const Vector4f& v)
 {
-    Vector4f vec
-    {
-        M(0, 0) * v[0] + M(0, 1) * v[1] + M(0, 2) * v[2] + M(0, 3) * v[3],
-        M(1, 0) * v[0] + M(1, 1) * v[1] + M(1, 2) * v[2] + M(1, 3) * v[3],
-        M(2, 0) * v[0] + M(2, 1) * v[1] + M(2, 2) * v[2] + M(2, 3) * v[3],
-        M(3, 0) * v[0] + M(3, 1) * v[1] + M(3, 2) * v[2] + M(3, 3) * v[3]
-    };
+    return Vector4f(CombineColumns(M, v.Load()));
+}
+
+// T * R * S, the matrix that scales by scale, then rotates by rotation and
+// moves by translation (the usual model matrix), worked out in one go.
+// rotation is a unit quaternion as (x, y, z, w), the order glm::quat keeps
+// its parts in; translation's and scale's w are ignored.
+inline Matrix4f ComposeTRS(const Vector4f& translation,
+                           const Vector4f& rotation, const Vector4f& scale)
+{
+    const float x = rotation.x, y = rotation.y, z = rotation.z;
+    const float w = rotation.w;
+    const float xx = x * x, yy = y * y, zz = z * z;
+    const float xy = x * y, xz = x * z, yz = y * z;
+    const float wx = w * x, wy = w * y, wz = w * z;
 
-    return vec;
+    // the columns of R(rotation), each scaled
+    return Matrix4f(
+        Vector4f(Simd4f::Mul(Simd4f::Set(1 - 2 * (yy + zz), 2 * (xy + wz),
+                                         2 * (xz - wy), 0),
+                             Simd4f::Splat(scale.x))),
+        Vector4f(Simd4f::Mul(Simd4f::Set(2 * (xy - wz), 1 - 2 * (xx + zz),
+                                         2 * (yz + wx), 0),
+                             Simd4f::Splat(scale.y))),
+        Vector4f(Simd4f::Mul(Simd4f::Set(2 * (xz + wy), 2 * (yz - wx),
+                                         1 - 2 * (xx + yy), 0),
+                             Simd4f::Splat(scale.z))),
+        Vector4f(translation.x, translation.y, translation.z, 1));
 }
 
 std::ostream& operator<<(std::ostream& os, const Matrix4f& M)
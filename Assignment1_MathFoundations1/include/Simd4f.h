@@ -0,0 +1,277 @@
+// The 4-wide float registers Vector4f and Matrix4f are built on.
+//
+// The backend is picked at compile time: SSE on x86 (with FMA when the
+// compiler is allowed to use it, e.g. -mfma or -march=native), NEON on
+// 64 bit ARM, and plain floats anywhere else. Defining MATH_SCALAR forces
+// the plain floats, which is handy for checking the others against.
+#ifndef SIMD4F_H
+#define SIMD4F_H
+
+#if !defined(MATH_SCALAR) &&                                            \
+    (defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) ||        \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define MATH_SSE
+#include <xmmintrin.h>
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define MATH_FMA
+#include <immintrin.h>
+#endif
+#elif !defined(MATH_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+#define MATH_NEON
+#include <arm_neon.h>
+#else
+#include <cmath>
+#endif
+
+// These are a few instructions each; they have to be inlined for the
+// registers to stay in registers (GCC won't always, on its own).
+#if defined(_MSC_VER)
+#define SIMD4F_INLINE __forceinline
+#elif defined(__GNUC__)
+#define SIMD4F_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD4F_INLINE inline
+#endif
+
+namespace Simd4f {
+
+#if defined(MATH_SSE)
+
+typedef __m128 Reg;
+
+// p has to be 16 byte aligned
+SIMD4F_INLINE Reg Load(const float* p) { return _mm_load_ps(p); }
+SIMD4F_INLINE void Store(float* p, Reg a) { _mm_store_ps(p, a); }
+
+// p can be anywhere
+SIMD4F_INLINE Reg LoadU(const float* p) { return _mm_loadu_ps(p); }
+SIMD4F_INLINE void StoreU(float* p, Reg a) { _mm_storeu_ps(p, a); }
+
+SIMD4F_INLINE Reg Set(float x, float y, float z, float w)
+{
+    return _mm_setr_ps(x, y, z, w);
+}
+SIMD4F_INLINE Reg Splat(float s) { return _mm_set1_ps(s); }
+
+SIMD4F_INLINE Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+SIMD4F_INLINE Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+SIMD4F_INLINE Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+SIMD4F_INLINE Reg Div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+SIMD4F_INLINE Reg Neg(Reg a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+SIMD4F_INLINE Reg Sqrt(Reg a) { return _mm_sqrt_ps(a); }
+
+// a's size with b's sign
+SIMD4F_INLINE Reg CopySign(Reg a, Reg b)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    return _mm_or_ps(_mm_andnot_ps(sign, a), _mm_and_ps(sign, b));
+}
+
+// a * b + c
+SIMD4F_INLINE Reg MulAdd(Reg a, Reg b, Reg c)
+{
+#if defined(MATH_FMA)
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// lane i of a in every lane
+template <int i>
+SIMD4F_INLINE Reg Broadcast(Reg a)
+{
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(i, i, i, i));
+}
+
+// lanes i0, i1, i2 and i3 of a
+template <int i0, int i1, int i2, int i3>
+SIMD4F_INLINE Reg Shuffle(Reg a)
+{
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(i3, i2, i1, i0));
+}
+
+// the rows of the 4x4 matrix whose columns are a, b, c and d, in place
+SIMD4F_INLINE void Transpose(Reg& a, Reg& b, Reg& c, Reg& d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+#if defined(MATH_FMA)
+const char* const NAME = "SSE+FMA";
+#else
+const char* const NAME = "SSE";
+#endif
+
+#elif defined(MATH_NEON)
+
+typedef float32x4_t Reg;
+
+SIMD4F_INLINE Reg Load(const float* p) { return vld1q_f32(p); }
+SIMD4F_INLINE void Store(float* p, Reg a) { vst1q_f32(p, a); }
+SIMD4F_INLINE Reg LoadU(const float* p) { return vld1q_f32(p); }
+SIMD4F_INLINE void StoreU(float* p, Reg a) { vst1q_f32(p, a); }
+
+SIMD4F_INLINE Reg Set(float x, float y, float z, float w)
+{
+    const float lanes[4] = {x, y, z, w};
+    return vld1q_f32(lanes);
+}
+SIMD4F_INLINE Reg Splat(float s) { return vdupq_n_f32(s); }
+
+SIMD4F_INLINE Reg Add(Reg a, Reg b) { return vaddq_f32(a, b); }
+SIMD4F_INLINE Reg Sub(Reg a, Reg b) { return vsubq_f32(a, b); }
+SIMD4F_INLINE Reg Mul(Reg a, Reg b) { return vmulq_f32(a, b); }
+SIMD4F_INLINE Reg Div(Reg a, Reg b) { return vdivq_f32(a, b); }
+SIMD4F_INLINE Reg Neg(Reg a) { return vnegq_f32(a); }
+SIMD4F_INLINE Reg Sqrt(Reg a) { return vsqrtq_f32(a); }
+
+// a's size with b's sign
+SIMD4F_INLINE Reg CopySign(Reg a, Reg b)
+{
+    return vbslq_f32(vdupq_n_u32(0x80000000u), b, a);
+}
+
+// a * b + c
+SIMD4F_INLINE Reg MulAdd(Reg a, Reg b, Reg c) { return vfmaq_f32(c, a, b); }
+
+// lane i of a in every lane
+template <int i>
+SIMD4F_INLINE Reg Broadcast(Reg a)
+{
+    return vdupq_laneq_f32(a, i);
+}
+
+// lanes i0, i1, i2 and i3 of a
+template <int i0, int i1, int i2, int i3>
+SIMD4F_INLINE Reg Shuffle(Reg a)
+{
+    Reg r = vdupq_laneq_f32(a, i0);
+    r = vcopyq_laneq_f32(r, 1, a, i1);
+    r = vcopyq_laneq_f32(r, 2, a, i2);
+    return vcopyq_laneq_f32(r, 3, a, i3);
+}
+
+// the rows of the 4x4 matrix whose columns are a, b, c and d, in place
+SIMD4F_INLINE void Transpose(Reg& a, Reg& b, Reg& c, Reg& d)
+{
+    const float32x4x2_t ab = vtrnq_f32(a, b);
+    const float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+const char* const NAME = "NEON";
+
+#else
+
+struct Reg {
+    float x, y, z, w;
+};
+
+SIMD4F_INLINE Reg Load(const float* p) { return Reg{p[0], p[1], p[2], p[3]}; }
+SIMD4F_INLINE void Store(float* p, Reg a)
+{
+    p[0] = a.x;
+    p[1] = a.y;
+    p[2] = a.z;
+    p[3] = a.w;
+}
+SIMD4F_INLINE Reg LoadU(const float* p) { return Load(p); }
+SIMD4F_INLINE void StoreU(float* p, Reg a) { Store(p, a); }
+
+SIMD4F_INLINE Reg Set(float x, float y, float z, float w)
+{
+    return Reg{x, y, z, w};
+}
+SIMD4F_INLINE Reg Splat(float s) { return Reg{s, s, s, s}; }
+
+SIMD4F_INLINE Reg Add(Reg a, Reg b)
+{
+    return Reg{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+SIMD4F_INLINE Reg Sub(Reg a, Reg b)
+{
+    return Reg{a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+}
+SIMD4F_INLINE Reg Mul(Reg a, Reg b)
+{
+    return Reg{a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+}
+SIMD4F_INLINE Reg Div(Reg a, Reg b)
+{
+    return Reg{a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w};
+}
+SIMD4F_INLINE Reg Neg(Reg a) { return Reg{-a.x, -a.y, -a.z, -a.w}; }
+SIMD4F_INLINE Reg Sqrt(Reg a)
+{
+    return Reg{std::sqrt(a.x), std::sqrt(a.y), std::sqrt(a.z), std::sqrt(a.w)};
+}
+
+// a's size with b's sign
+SIMD4F_INLINE Reg CopySign(Reg a, Reg b)
+{
+    return Reg{std::copysign(a.x, b.x), std::copysign(a.y, b.y),
+               std::copysign(a.z, b.z), std::copysign(a.w, b.w)};
+}
+
+// a * b + c
+SIMD4F_INLINE Reg MulAdd(Reg a, Reg b, Reg c) { return Add(Mul(a, b), c); }
+
+// lane i of a in every lane
+template <int i>
+SIMD4F_INLINE Reg Broadcast(Reg a);
+template <>
+SIMD4F_INLINE Reg Broadcast<0>(Reg a) { return Splat(a.x); }
+template <>
+SIMD4F_INLINE Reg Broadcast<1>(Reg a) { return Splat(a.y); }
+template <>
+SIMD4F_INLINE Reg Broadcast<2>(Reg a) { return Splat(a.z); }
+template <>
+SIMD4F_INLINE Reg Broadcast<3>(Reg a) { return Splat(a.w); }
+
+// lanes i0, i1, i2 and i3 of a
+template <int i0, int i1, int i2, int i3>
+SIMD4F_INLINE Reg Shuffle(Reg a)
+{
+    const float* lanes = &a.x;
+    return Reg{lanes[i0], lanes[i1], lanes[i2], lanes[i3]};
+}
+
+// the rows of the 4x4 matrix whose columns are a, b, c and d, in place
+SIMD4F_INLINE void Transpose(Reg& a, Reg& b, Reg& c, Reg& d)
+{
+    const Reg ra{a.x, b.x, c.x, d.x}, rb{a.y, b.y, c.y, d.y};
+    const Reg rc{a.z, b.z, c.z, d.z}, rd{a.w, b.w, c.w, d.w};
+    a = ra;
+    b = rb;
+    c = rc;
+    d = rd;
+}
+
+const char* const NAME = "scalar";
+
+#endif
+
+// The rest is built out of the above, so it's the same for every backend.
+
+// the sum of a's lanes, in every lane
+SIMD4F_INLINE Reg Sum(Reg a)
+{
+    a = Add(a, Shuffle<1, 0, 3, 2>(a));
+    return Add(a, Shuffle<2, 3, 0, 1>(a));
+}
+
+// a x b in x, y and z, from a's and b's x, y and z. w is a.w * b.w less
+// itself, so 0 for anything finite.
+SIMD4F_INLINE Reg Cross(Reg a, Reg b)
+{
+    return Sub(Mul(Shuffle<1, 2, 0, 3>(a), Shuffle<2, 0, 1, 3>(b)),
+               Mul(Shuffle<2, 0, 1, 3>(a), Shuffle<1, 2, 0, 3>(b)));
+}
+
+}  // namespace Simd4f
+
+#endif
@@ -0,0 +1,424 @@
+// Transforms whole arrays of points by one Matrix4f, for the software
+// rasterizer and particle systems, rather than a Matrix4f * Vector4f call
+// per point.
+//
+// Points come either as separate x, y and z arrays (structure of arrays,
+// w taken as 1) or as an array of Vector4f. Each comes in a plain float,
+// a Simd4f (SSE/NEON), an AVX2 and an AVX-512 version; by default the best
+// one the CPU supports is picked at run time. They all agree to within a
+// float rounding or two (the AVX ones fuse their multiply-adds).
+#ifndef TRANSFORM_POINTS_H
+#define TRANSFORM_POINTS_H
+
+#include <cstddef>
+
+#include "Matrix4f.h"
+#include "Simd4f.h"
+#include "Vector4f.h"
+
+// the AVX versions are built for their targets on their own, so the rest of
+// the program still runs on CPUs without them
+#if !defined(MATH_SCALAR) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define TRANSFORM_POINTS_AVX
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// instruction sets the transforms come in, worst to best
+enum TransformIsa {
+    TRANSFORM_SCALAR,
+    TRANSFORM_SIMD4,
+    TRANSFORM_AVX2,
+    TRANSFORM_AVX512
+};
+
+// the instruction set to really use for isa in this build
+inline TransformIsa AvailableTransformIsa(TransformIsa isa)
+{
+#if !defined(TRANSFORM_POINTS_AVX)
+    if (isa > TRANSFORM_SIMD4) isa = TRANSFORM_SIMD4;
+#endif
+#if !defined(MATH_SSE) && !defined(MATH_NEON)
+    if (isa == TRANSFORM_SIMD4) isa = TRANSFORM_SCALAR;
+#endif
+    return isa;
+}
+
+// The best instruction set this CPU (and build) can run
+inline TransformIsa BestTransformIsa()
+{
+    static const TransformIsa best = [] {
+#if defined(TRANSFORM_POINTS_AVX)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return TRANSFORM_AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return TRANSFORM_AVX2;
+        }
+#endif
+        return AvailableTransformIsa(TRANSFORM_SIMD4);
+    }();
+    return best;
+}
+
+// A name for an instruction set, for printing
+inline const char* TransformIsaName(TransformIsa isa)
+{
+    switch (isa) {
+        case TRANSFORM_AVX512:
+            return "AVX-512";
+        case TRANSFORM_AVX2:
+            return "AVX2";
+        case TRANSFORM_SIMD4:
+            return Simd4f::NAME;
+        default:
+            return "scalar";
+    }
+}
+
+namespace TransformDetail {
+
+// Each version transforms as many points from start on as it can, leaving
+// start at the first it didn't; the next one down carries on from there.
+// (They count in a local i: the vector stores may alias anything, so
+// counting in start itself would reload it after every one.)
+
+inline void SoAScalar(const Matrix4f& matrix, const float* xs,
+                      const float* ys, const float* zs, size_t count,
+                      float* outX, float* outY, float* outZ, float* outW,
+                      bool divide, size_t& start)
+{
+    const Matrix4f M(matrix);  // the outputs could alias matrix itself
+    size_t i = start;
+    for (; i < count; i++) {
+        const float x = xs[i], y = ys[i], z = zs[i];
+        float tx = M(0, 0) * x + M(0, 1) * y + M(0, 2) * z + M(0, 3);
+        float ty = M(1, 0) * x + M(1, 1) * y + M(1, 2) * z + M(1, 3);
+        float tz = M(2, 0) * x + M(2, 1) * y + M(2, 2) * z + M(2, 3);
+        const float tw = M(3, 0) * x + M(3, 1) * y + M(3, 2) * z + M(3, 3);
+        if (divide) {
+            tx /= tw;
+            ty /= tw;
+            tz /= tw;
+        }
+        outX[i] = tx;
+        outY[i] = ty;
+        outZ[i] = tz;
+        if (outW) outW[i] = tw;
+    }
+    start = i;
+}
+
+inline void AoSScalar(const Matrix4f& matrix, const Vector4f* in,
+                      size_t count, Vector4f* out, bool divide,
+                      size_t& start)
+{
+    const Matrix4f M(matrix);  // the outputs could alias matrix itself
+    size_t i = start;
+    for (; i < count; i++) {
+        const Vector4f v = in[i];
+        Vector4f t(
+            M(0, 0) * v.x + M(0, 1) * v.y + M(0, 2) * v.z + M(0, 3) * v.w,
+            M(1, 0) * v.x + M(1, 1) * v.y + M(1, 2) * v.z + M(1, 3) * v.w,
+            M(2, 0) * v.x + M(2, 1) * v.y + M(2, 2) * v.z + M(2, 3) * v.w,
+            M(3, 0) * v.x + M(3, 1) * v.y + M(3, 2) * v.z + M(3, 3) * v.w);
+        if (divide) {
+            t.x /= t.w;
+            t.y /= t.w;
+            t.z /= t.w;
+        }
+        out[i] = t;
+    }
+    start = i;
+}
+
+#if defined(MATH_SSE) || defined(MATH_NEON)
+
+// 4 points at a time
+inline void SoASimd4(const Matrix4f& M, const float* xs, const float* ys,
+                     const float* zs, size_t count, float* outX, float* outY,
+                     float* outZ, float* outW, bool divide, size_t& start)
+{
+    size_t i = start;
+    using namespace Simd4f;
+
+    // M(r, c) in every lane of m[r][c]
+    Reg m[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = Splat(M(r, c));
+        }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        const Reg x = LoadU(xs + i), y = LoadU(ys + i), z = LoadU(zs + i);
+        Reg t[4];
+        for (int r = 0; r < 4; r++) {
+            t[r] = MulAdd(m[r][0], x,
+                          MulAdd(m[r][1], y, MulAdd(m[r][2], z, m[r][3])));
+        }
+        if (divide) {
+            t[0] = Div(t[0], t[3]);
+            t[1] = Div(t[1], t[3]);
+            t[2] = Div(t[2], t[3]);
+        }
+        StoreU(outX + i, t[0]);
+        StoreU(outY + i, t[1]);
+        StoreU(outZ + i, t[2]);
+        if (outW) StoreU(outW + i, t[3]);
+    }
+    start = i;
+}
+
+// a point at a time, but each one in a register
+inline void AoSSimd4(const Matrix4f& M, const Vector4f* in, size_t count,
+                     Vector4f* out, bool divide, size_t& start)
+{
+    using namespace Simd4f;
+
+    const Reg c0 = M[0].Load(), c1 = M[1].Load();
+    const Reg c2 = M[2].Load(), c3 = M[3].Load();
+
+    size_t i = start;
+    for (; i < count; i++) {
+        const Reg v = in[i].Load();
+        Reg t = Mul(c0, Broadcast<0>(v));
+        t = MulAdd(c1, Broadcast<1>(v), t);
+        t = MulAdd(c2, Broadcast<2>(v), t);
+        t = MulAdd(c3, Broadcast<3>(v), t);
+        if (divide) {
+            // x, y and z over w; w stays
+            const float w = Vector4f(t).w;
+            out[i] = Vector4f(Div(t, Broadcast<3>(t)));
+            out[i].w = w;
+        }
+        else {
+            out[i] = Vector4f(t);
+        }
+    }
+    start = i;
+}
+
+#endif
+
+#if defined(TRANSFORM_POINTS_AVX)
+
+// 8 points at a time
+TARGET_AVX2 inline void SoAAvx2(const Matrix4f& M, const float* xs,
+                                const float* ys, const float* zs,
+                                size_t count, float* outX, float* outY,
+                                float* outZ, float* outW, bool divide,
+                                size_t& start)
+{
+    size_t i = start;
+    __m256 m[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = _mm256_set1_ps(M(r, c));
+        }
+    }
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        const __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 t[4];
+        for (int r = 0; r < 4; r++) {
+            t[r] = _mm256_fmadd_ps(
+                m[r][0], x,
+                _mm256_fmadd_ps(m[r][1], y,
+                                _mm256_fmadd_ps(m[r][2], z, m[r][3])));
+        }
+        if (divide) {
+            t[0] = _mm256_div_ps(t[0], t[3]);
+            t[1] = _mm256_div_ps(t[1], t[3]);
+            t[2] = _mm256_div_ps(t[2], t[3]);
+        }
+        _mm256_storeu_ps(outX + i, t[0]);
+        _mm256_storeu_ps(outY + i, t[1]);
+        _mm256_storeu_ps(outZ + i, t[2]);
+        if (outW) _mm256_storeu_ps(outW + i, t[3]);
+    }
+    start = i;
+}
+
+// 2 points at a time, one in each 128 bit half
+TARGET_AVX2 inline void AoSAvx2(const Matrix4f& M, const Vector4f* in,
+                                size_t count, Vector4f* out, bool divide,
+                                size_t& start)
+{
+    size_t i = start;
+    // M's columns, in both halves
+    const __m128* columns = reinterpret_cast<const __m128*>(&M[0].x);
+    const __m256 c0 = _mm256_broadcast_ps(columns);
+    const __m256 c1 = _mm256_broadcast_ps(columns + 1);
+    const __m256 c2 = _mm256_broadcast_ps(columns + 2);
+    const __m256 c3 = _mm256_broadcast_ps(columns + 3);
+
+    for (; i + 2 <= count; i += 2) {
+        const __m256 v = _mm256_loadu_ps(&in[i].x);
+        __m256 t = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+        t = _mm256_fmadd_ps(c1, _mm256_permute_ps(v, 0x55), t);
+        t = _mm256_fmadd_ps(c2, _mm256_permute_ps(v, 0xAA), t);
+        t = _mm256_fmadd_ps(c3, _mm256_permute_ps(v, 0xFF), t);
+        if (divide) {
+            // x, y and z over w; w stays
+            const __m256 d = _mm256_div_ps(t, _mm256_permute_ps(t, 0xFF));
+            t = _mm256_blend_ps(d, t, 0x88);
+        }
+        _mm256_storeu_ps(&out[i].x, t);
+    }
+    start = i;
+}
+
+// GCC 12's AVX-512 intrinsics start from an "undefined" register that it
+// then warns about (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// 16 points at a time, the last few masked
+TARGET_AVX512 inline void SoAAvx512(const Matrix4f& M, const float* xs,
+                                    const float* ys, const float* zs,
+                                    size_t count, float* outX, float* outY,
+                                    float* outZ, float* outW, bool divide,
+                                    size_t& start)
+{
+    size_t i = start;
+    __m512 m[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = _mm512_set1_ps(M(r, c));
+        }
+    }
+
+    for (; i < count; i += 16) {
+        const __mmask16 k = count - i >= 16
+                                ? __mmask16(0xFFFF)
+                                : __mmask16((1u << (count - i)) - 1);
+        const __m512 x = _mm512_maskz_loadu_ps(k, xs + i);
+        const __m512 y = _mm512_maskz_loadu_ps(k, ys + i);
+        const __m512 z = _mm512_maskz_loadu_ps(k, zs + i);
+        __m512 t[4];
+        for (int r = 0; r < 4; r++) {
+            t[r] = _mm512_fmadd_ps(
+                m[r][0], x,
+                _mm512_fmadd_ps(m[r][1], y,
+                                _mm512_fmadd_ps(m[r][2], z, m[r][3])));
+        }
+        if (divide) {
+            t[0] = _mm512_div_ps(t[0], t[3]);
+            t[1] = _mm512_div_ps(t[1], t[3]);
+            t[2] = _mm512_div_ps(t[2], t[3]);
+        }
+        _mm512_mask_storeu_ps(outX + i, k, t[0]);
+        _mm512_mask_storeu_ps(outY + i, k, t[1]);
+        _mm512_mask_storeu_ps(outZ + i, k, t[2]);
+        if (outW) _mm512_mask_storeu_ps(outW + i, k, t[3]);
+    }
+    start = count;
+}
+
+// 4 points at a time, one in each 128 bit lane, the last few masked
+TARGET_AVX512 inline void AoSAvx512(const Matrix4f& M, const Vector4f* in,
+                                    size_t count, Vector4f* out, bool divide,
+                                    size_t& start)
+{
+    size_t i = start;
+    // M's columns, in every lane
+    const __m512 c0 = _mm512_broadcast_f32x4(M[0].Load());
+    const __m512 c1 = _mm512_broadcast_f32x4(M[1].Load());
+    const __m512 c2 = _mm512_broadcast_f32x4(M[2].Load());
+    const __m512 c3 = _mm512_broadcast_f32x4(M[3].Load());
+
+    for (; i < count; i += 4) {
+        const __mmask16 k = count - i >= 4
+                                ? __mmask16(0xFFFF)
+                                : __mmask16((1u << (4 * (count - i))) - 1);
+        const __m512 v = _mm512_maskz_loadu_ps(k, &in[i].x);
+        __m512 t = _mm512_mul_ps(c0, _mm512_permute_ps(v, 0x00));
+        t = _mm512_fmadd_ps(c1, _mm512_permute_ps(v, 0x55), t);
+        t = _mm512_fmadd_ps(c2, _mm512_permute_ps(v, 0xAA), t);
+        t = _mm512_fmadd_ps(c3, _mm512_permute_ps(v, 0xFF), t);
+        if (divide) {
+            // x, y and z over w; w stays
+            const __m512 d = _mm512_div_ps(t, _mm512_permute_ps(t, 0xFF));
+            t = _mm512_mask_blend_ps(0x8888, d, t);
+        }
+        _mm512_mask_storeu_ps(&out[i].x, k, t);
+    }
+    start = count;
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+}  // namespace TransformDetail
+
+// Transforms count points (xs[k], ys[k], zs[k], 1) by M, into outX, outY,
+// outZ and (unless it's null) outW. With perspectiveDivide, x, y and z come
+// out divided by w, and w is kept as it is. The outputs may be the inputs
+// (transforming in place), but mustn't overlap them otherwise.
+inline void TransformPoints(const Matrix4f& M, const float* xs,
+                            const float* ys, const float* zs, size_t count,
+                            float* outX, float* outY, float* outZ,
+                            float* outW = nullptr,
+                            bool perspectiveDivide = false,
+                            TransformIsa isa = BestTransformIsa())
+{
+    using namespace TransformDetail;
+
+    size_t i = 0;
+    isa = AvailableTransformIsa(isa);
+#if defined(TRANSFORM_POINTS_AVX)
+    if (isa == TRANSFORM_AVX512) {
+        SoAAvx512(M, xs, ys, zs, count, outX, outY, outZ, outW,
+                  perspectiveDivide, i);
+    }
+    if (isa >= TRANSFORM_AVX2) {
+        SoAAvx2(M, xs, ys, zs, count, outX, outY, outZ, outW,
+                perspectiveDivide, i);
+    }
+#endif
+#if defined(MATH_SSE) || defined(MATH_NEON)
+    if (isa >= TRANSFORM_SIMD4) {
+        SoASimd4(M, xs, ys, zs, count, outX, outY, outZ, outW,
+                 perspectiveDivide, i);
+    }
+#endif
+    SoAScalar(M, xs, ys, zs, count, outX, outY, outZ, outW,
+              perspectiveDivide, i);
+}
+
+// Transforms count vectors by M, from in to out (which may be in). With
+// perspectiveDivide, x, y and z come out divided by w, and w is kept.
+inline void TransformPoints(const Matrix4f& M, const Vector4f* in,
+                            size_t count, Vector4f* out,
+                            bool perspectiveDivide = false,
+                            TransformIsa isa = BestTransformIsa())
+{
+    using namespace TransformDetail;
+
+    size_t i = 0;
+    isa = AvailableTransformIsa(isa);
+#if defined(TRANSFORM_POINTS_AVX)
+    if (isa == TRANSFORM_AVX512) {
+        AoSAvx512(M, in, count, out, perspectiveDivide, i);
+    }
+    if (isa >= TRANSFORM_AVX2) {
+        AoSAvx2(M, in, count, out, perspectiveDivide, i);
+    }
+#endif
+#if defined(MATH_SSE) || defined(MATH_NEON)
+    if (isa >= TRANSFORM_SIMD4) {
+        AoSSimd4(M, in, count, out, perspectiveDivide, i);
+    }
+#endif
+    AoSScalar(M, in, count, out, perspectiveDivide, i);
+}
+
+#endif
@@ -4,10 +4,14 @@
 #include <cmath>
 #include <iostream>
 
+#include "Simd4f.h"
+
 // Vector4f performs vector operations with 4-dimensions
 // The purpose of this class is primarily for 3D graphics
 // applications.
-struct Vector4f {
+// It is aligned so that it can be loaded as one 128 bit register (see
+// Simd4f.h), which is how the arithmetic below is done.
+struct alignas(16) Vector4f {
     // Note: x,y,z,w are a convention
     // x,y,z,w could be position, but also any 4-component value.
     float x, y, z, w;
@@ -21,6 +25,10 @@ struct Vector4f {
     // This initializes the values x,y,z
     Vector4f(float a, float b, float c, float d) : x(a), y(b), z(c), w(d) {}
 
+    // A vector from a register, and back
+    explicit Vector4f(Simd4f::Reg r) { Simd4f::Store(&x, r); }
+    Simd4f::Reg Load() const { return Simd4f::Load(&x); }
+
     // Index operator, allowing us to access the individual
     // x,y,z,w components of our vector.
     float& operator[](int i)
@@ -43,10 +51,7 @@ struct Vector4f {
     // Multiply vector by a uniform-scalar.
     Vector4f& operator*=(float s)
     {
-        x *= s;
-        y *= s;
-        z *= s;
-        w *= s;
+        Simd4f::Store(&x, Simd4f::Mul(Load(), Simd4f::Splat(s)));
 
         return (*this);
     }
@@ -54,10 +59,7 @@ struct Vector4f {
     // Division Operator
     Vector4f& operator/=(float s)
     {
-        x /= s;
-        y /= s;
-        z /= s;
-        w /= s;
+        Simd4f::Store(&x, Simd4f::Div(Load(), Simd4f::Splat(s)));
 
         return (*this);
     }
@@ -65,10 +67,7 @@ struct Vector4f {
     // Addition operator
     Vector4f& operator+=(const Vector4f& v)
     {
-        x += v.x;
-        y += v.y;
-        z += v.z;
-        w += v.w;
+        Simd4f::Store(&x, Simd4f::Add(Load(), v.Load()));
 
         return (*this);
     }
@@ -76,10 +75,7 @@ struct Vector4f {
     // Subtraction operator
     Vector4f& operator-=(const Vector4f& v)
     {
-        x -= v.x;
-        y -= v.y;
-        z -= v.z;
-        w -= v.w;
+        Simd4f::Store(&x, Simd4f::Sub(Load(), v.Load()));
 
         return (*this);
     }
@@ -94,38 +90,20 @@ inline float Dot(const Vector4f& a, const Vector4f& b)
 // Multiplication of a vector by a scalar values
 inline Vector4f operator*(const Vector4f& v, float s)
 {
-    Vector4f vec;
-    vec.x = v.x * s;
-    vec.y = v.y * s;
-    vec.z = v.z * s;
-    vec.w = v.w * s;
-
-    return vec;
+    return Vector4f(Simd4f::Mul(v.Load(), Simd4f::Splat(s)));
 }
 
 // Division of a vector by a scalar value.
 inline Vector4f operator/(const Vector4f& v, float s)
 {
-    Vector4f vec;
-    vec.x = v.x / s;
-    vec.y = v.y / s;
-    vec.z = v.z / s;
-    vec.w = v.w / s;
-
-    return vec;
+    return Vector4f(Simd4f::Div(v.Load(), Simd4f::Splat(s)));
 }
 
 // Negation of a vector
 // Use Case: Sometimes it is handy to apply a force in an opposite direction
 inline Vector4f operator-(const Vector4f& v)
 {
-    Vector4f vec;
-    vec.x = -v.x;
-    vec.y = -v.y;
-    vec.z = -v.z;
-    vec.w = -v.w;
-
-    return vec;
+    return Vector4f(Simd4f::Neg(v.Load()));
 }
 
 // Return the magnitude of a vector
@@ -137,25 +115,13 @@ inline float Magnitude(const Vector4f& v)
 // Add two vectors together
 inline Vector4f operator+(const Vector4f& a, const Vector4f& b)
 {
-    Vector4f vec;
-    vec.x = a.x + b.x;
-    vec.y = a.y + b.y;
-    vec.z = a.z + b.z;
-    vec.w = a.w + b.w;
-
-    return vec;
+    return Vector4f(Simd4f::Add(a.Load(), b.Load()));
 }
 
 // Subtract two vectors
 inline Vector4f operator-(const Vector4f& a, const Vector4f& b)
 {
-    Vector4f vec;
-    vec.x = a.x - b.x;
-    vec.y = a.y - b.y;
-    vec.z = a.z - b.z;
-    vec.w = a.w - b.w;
-
-    return vec;
+    return Vector4f(Simd4f::Sub(a.Load(), b.Load()));
 }
 
 // Print vector to ostream
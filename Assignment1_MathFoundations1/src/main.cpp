@@ -1,6 +1,9 @@
 // Includes for the assignment
 #include "Vector4f.h"
 #include "Matrix4f.h"
+#include "TransformPoints.h"
+#include "Quaternionf.h"
+#include <cmath>
 #include <iostream>
 
 // Tests for comparing our library
@@ -10,6 +13,44 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+// Our matrix and glm's agree to within a few float roundings (the SIMD
+// multiplies may fuse or reorder the additions).
+bool closeTo(const Matrix4f& mine, const glm::mat4& theirs){
+    for(int j = 0; j < 4; j++){
+        for(int i = 0; i < 4; i++){
+            float scale = std::fabs(theirs[j][i]) > 1.0f ? std::fabs(theirs[j][i]) : 1.0f;
+            if(std::fabs(mine[j][i] - theirs[j][i]) > 1e-5f * scale){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Our vector and glm's agree to within a few float roundings.
+bool closeTo(const Vector4f& mine, const glm::vec4& theirs){
+    for(int i = 0; i < 4; i++){
+        float scale = std::fabs(theirs[i]) > 1.0f ? std::fabs(theirs[i]) : 1.0f;
+        if(std::fabs(mine[i] - theirs[i]) > 1e-5f * scale){
+            return false;
+        }
+    }
+    return true;
+}
+
+// The same matrix in glm.
+glm::mat4 toGlm(const Matrix4f& m){
+    glm::mat4 g;
+    for(int j = 0; j < 4; j++){
+        for(int i = 0; i < 4; i++){
+            g[j][i] = m[j][i];
+        }
+    }
+    return g;
+}
 
 // Sample unit test comparing against GLM.
 bool unitTest0(){
@@ -174,6 +215,234 @@ bool unitTest5(){
     return false;
 }
 
+// Matrix times matrix against GLM, including one with a translation.
+bool unitTest6(){
+    Matrix4f a(1,2,3,4,
+               5,6,7,8,
+               9,10,11,12,
+               13,14,15,16);
+    Matrix4f b(2,0,0,1,
+               0,3,0,2,
+               0,0,4,3,
+               0,0,0,1);
+    Matrix4f c(0.5f,-1.25f,3,0,
+               7,0.125f,-2,9,
+               -4,6,1,0.75f,
+               0,0,0,1);
+
+    return closeTo(a * b, toGlm(a) * toGlm(b)) &&
+           closeTo(b * a, toGlm(b) * toGlm(a)) &&
+           closeTo(a * b * c, toGlm(a) * toGlm(b) * toGlm(c));
+}
+
+// Matrix times vector against GLM.
+bool unitTest7(){
+    Matrix4f m(0.5f,-1.25f,3,10,
+               7,0.125f,-2,20,
+               -4,6,1,30,
+               0,0,0,1);
+    Vector4f point(1.5f,-2,0.25f,1);
+    Vector4f direction(1.5f,-2,0.25f,0);
+
+    glm::vec4 glmPoint(1.5f,-2,0.25f,1);
+    glm::vec4 glmDirection(1.5f,-2,0.25f,0);
+
+    return closeTo(m * point, toGlm(m) * glmPoint) &&
+           closeTo(m * direction, toGlm(m) * glmDirection);
+}
+
+// Rotations against glm::rotate, alone and applied after a scale.
+bool unitTest8(){
+    Matrix4f identity;
+    identity.identity();
+    Matrix4f scaled = identity.MakeScale(2.0f,3.0f,4.0f);
+    glm::mat4 glmScaled = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f,3.0f,4.0f));
+
+    const float t = 0.7f;
+    glm::vec3 x(1,0,0), y(0,1,0), z(0,0,1);
+
+    return closeTo(identity.MakeRotationX(t), glm::rotate(t, x)) &&
+           closeTo(identity.MakeRotationY(t), glm::rotate(t, y)) &&
+           closeTo(identity.MakeRotationZ(t), glm::rotate(t, z)) &&
+           closeTo(scaled.MakeRotationX(t), glm::rotate(t, x) * glmScaled) &&
+           closeTo(scaled.MakeRotationY(t), glm::rotate(t, y) * glmScaled) &&
+           closeTo(scaled.MakeRotationZ(t), glm::rotate(t, z) * glmScaled);
+}
+
+// Vector arithmetic against GLM (exact: it's one operation per component).
+bool unitTest9(){
+    Vector4f a(1.5f,-2,0.25f,8);
+    Vector4f b(-3,0.5f,7,2);
+    glm::vec4 ga(1.5f,-2,0.25f,8);
+    glm::vec4 gb(-3,0.5f,7,2);
+
+    Vector4f c = a;
+    c += b;
+    c *= 3.0f;
+    c -= a;
+    c /= 0.5f;
+    glm::vec4 gc = ((ga + gb) * 3.0f - ga) / 0.5f;
+
+    Vector4f d = -(a - b) * 2.0f + a / 4.0f;
+    glm::vec4 gd = -(ga - gb) * 2.0f + ga / 4.0f;
+
+    return c.x == gc.x && c.y == gc.y && c.z == gc.z && c.w == gc.w &&
+           d.x == gd.x && d.y == gd.y && d.z == gd.z && d.w == gd.w;
+}
+
+// Batch transforms (both layouts, projected) against GLM, with every
+// instruction set this CPU has.
+bool unitTest10(){
+    glm::mat4 glmProjection = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f) *
+                              glm::translate(glm::mat4(1.0f), glm::vec3(1,-2,-5));
+    Matrix4f projection;
+    for(int j = 0; j < 4; j++){
+        for(int i = 0; i < 4; i++){
+            projection[j][i] = glmProjection[j][i];
+        }
+    }
+
+    // 19 points, so every version has some left over for the next one down
+    const int count = 19;
+    float xs[count], ys[count], zs[count];
+    Vector4f points[count];
+    for(int k = 0; k < count; k++){
+        xs[k] = 0.5f * k - 4.0f;
+        ys[k] = 3.0f - 0.25f * k;
+        zs[k] = -1.0f - k;
+        points[k] = Vector4f(xs[k], ys[k], zs[k], 1.0f);
+    }
+
+    for(int isa = TRANSFORM_SCALAR; isa <= BestTransformIsa(); isa++){
+        float ox[count], oy[count], oz[count], ow[count];
+        Vector4f out[count];
+        TransformPoints(projection, xs, ys, zs, count, ox, oy, oz, ow, true,
+                        TransformIsa(isa));
+        TransformPoints(projection, points, count, out, true, TransformIsa(isa));
+
+        for(int k = 0; k < count; k++){
+            glm::vec4 t = glmProjection * glm::vec4(xs[k], ys[k], zs[k], 1.0f);
+            glm::vec4 projected(t.x / t.w, t.y / t.w, t.z / t.w, t.w);
+            if(!closeTo(Vector4f(ox[k], oy[k], oz[k], ow[k]), projected) ||
+               !closeTo(out[k], projected)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// In-place rotate/scale/translate against the same glm chain, and
+// ComposeTRS against glm's translate * mat4_cast * scale.
+bool unitTest11(){
+    Matrix4f m;
+    m.identity();
+    m.Translate(1.0f,-2.0f,3.0f).RotateY(0.4f).RotateX(-1.1f).RotateZ(2.3f);
+    m.Scale(2.0f,0.5f,3.0f).Translate(-0.5f,0.25f,4.0f);
+
+    glm::mat4 g = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f,-2.0f,3.0f));
+    g = glm::rotate(g, 0.4f, glm::vec3(0,1,0));
+    g = glm::rotate(g, -1.1f, glm::vec3(1,0,0));
+    g = glm::rotate(g, 2.3f, glm::vec3(0,0,1));
+    g = glm::scale(g, glm::vec3(2.0f,0.5f,3.0f));
+    g = glm::translate(g, glm::vec3(-0.5f,0.25f,4.0f));
+
+    glm::quat q = glm::angleAxis(0.9f, glm::normalize(glm::vec3(1,-2,0.5f)));
+    Matrix4f trs = ComposeTRS(Vector4f(4,5,-6,1), Vector4f(q.x,q.y,q.z,q.w),
+                              Vector4f(0.5f,2,-1.5f,1));
+    glm::mat4 glmTrs = glm::translate(glm::mat4(1.0f), glm::vec3(4,5,-6)) *
+                       glm::mat4_cast(q) *
+                       glm::scale(glm::mat4(1.0f), glm::vec3(0.5f,2,-1.5f));
+
+    return closeTo(m, g) && closeTo(trs, glmTrs);
+}
+
+// Inverse, InverseAffine and NormalMatrix against glm, on a projection
+// (for Inverse) and on a rotated, scaled and moved model matrix.
+bool unitTest12(){
+    glm::mat4 glmProjection = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f) *
+                              glm::lookAt(glm::vec3(1,2,3), glm::vec3(0,0,-5),
+                                          glm::vec3(0,1,0));
+    Matrix4f projection;
+    for(int j = 0; j < 4; j++){
+        for(int i = 0; i < 4; i++){
+            projection[j][i] = glmProjection[j][i];
+        }
+    }
+
+    glm::quat q = glm::angleAxis(2.1f, glm::normalize(glm::vec3(-1,3,2)));
+    Matrix4f model = ComposeTRS(Vector4f(7,-3,2,1), Vector4f(q.x,q.y,q.z,q.w),
+                                Vector4f(0.5f,4,2,1));
+    glm::mat4 glmModel = toGlm(model);
+
+    Matrix4f identity;
+    identity.identity();
+
+    return closeTo(projection.Inverse(), glm::inverse(glmProjection)) &&
+           closeTo(model.Inverse(), glm::inverse(glmModel)) &&
+           closeTo(model.InverseAffine(), glm::affineInverse(glmModel)) &&
+           closeTo(model.NormalMatrix(),
+                   glm::mat4(glm::inverseTranspose(glm::mat3(glmModel)))) &&
+           closeTo(projection * projection.Inverse(), toGlm(identity)) &&
+           closeTo(model * model.InverseAffine(), toGlm(identity));
+}
+
+// Quaternionf against glm::quat: building, composing, rotating, both
+// matrix conversions, and every kind of interpolation (including the
+// batch one, with some left over after the groups of four).
+bool closeTo(const Quaternionf& mine, const glm::quat& theirs){
+    return closeTo(Vector4f(mine.x,mine.y,mine.z,mine.w),
+                   glm::vec4(theirs.x,theirs.y,theirs.z,theirs.w));
+}
+
+bool unitTest13(){
+    glm::vec3 axisA = glm::normalize(glm::vec3(1,2,-3));
+    glm::vec3 axisB = glm::normalize(glm::vec3(-2,0.5f,1));
+    glm::quat ga = glm::angleAxis(0.8f, axisA);
+    glm::quat gb = glm::angleAxis(-2.6f, axisB);
+    Quaternionf a = AxisAngle(Vector4f(axisA.x,axisA.y,axisA.z,0), 0.8f);
+    Quaternionf b = AxisAngle(Vector4f(axisB.x,axisB.y,axisB.z,0), -2.6f);
+
+    glm::vec4 p(3,-1,2,1);
+    glm::vec3 gp = ga * glm::vec3(p);
+    Matrix4f m = ToMatrix(a * b);
+    // the same rotation, whichever sign ToQuaternion picks
+    Matrix4f back = ToMatrix(ToQuaternion(m));
+
+    if(!closeTo(a, ga) || !closeTo(a * b, ga * gb) ||
+       !closeTo(Conjugate(a), glm::conjugate(ga)) ||
+       !closeTo(Rotate(a, Vector4f(p.x,p.y,p.z,p.w)), glm::vec4(gp, 1)) ||
+       !closeTo(m, glm::mat4_cast(ga * gb)) || !closeTo(back, toGlm(m))){
+        return false;
+    }
+
+    // b is more than a quarter turn from a, so this goes the short way
+    // round to -b
+    glm::quat shortB = glm::dot(ga, gb) < 0 ? -gb : gb;
+    Quaternionf as[7], bs[7], out[7];
+    float ts[7];
+    for(int k = 0; k < 7; k++){
+        float t = k / 6.0f;
+        glm::quat slerped = glm::slerp(ga, gb, t);
+        if(!closeTo(Nlerp(a, b, t),
+                    glm::normalize(ga * (1 - t) + shortB * t)) ||
+           !closeTo(Slerp(a, b, t), slerped) ||
+           !closeTo(Slerp(a, a, t), ga)){
+            return false;
+        }
+        as[k] = a;
+        bs[k] = b;
+        ts[k] = t;
+    }
+    Slerp(as, bs, ts, 7, out);
+    for(int k = 0; k < 7; k++){
+        if(!closeTo(out[k], glm::slerp(ga, gb, ts[k]))){
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(){
     // Keep track of the tests passed
     unsigned int testsPassed = 0;
@@ -185,6 +454,14 @@ int main(){
     std::cout << "Passed 3: " << unitTest3() << " \n";
     std::cout << "Passed 4: " << unitTest4() << " \n";
     std::cout << "Passed 5: " << unitTest5() << " \n";
+    std::cout << "Passed 6: " << unitTest6() << " \n";
+    std::cout << "Passed 7: " << unitTest7() << " \n";
+    std::cout << "Passed 8: " << unitTest8() << " \n";
+    std::cout << "Passed 9: " << unitTest9() << " \n";
+    std::cout << "Passed 10: " << unitTest10() << " \n";
+    std::cout << "Passed 11: " << unitTest11() << " \n";
+    std::cout << "Passed 12: " << unitTest12() << " \n";
+    std::cout << "Passed 13: " << unitTest13() << " \n";
 
     return 0;
 }
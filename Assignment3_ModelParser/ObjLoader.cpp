@@ -2,10 +2,13 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 ObjLoader::ObjLoader() : m_normals(), m_vertices(), m_faces() {}
 
@@ -23,21 +26,163 @@ std::ostream& operator<<(std::ostream& os, const face& f)
 
 std::ostream& operator<<(std::ostream& os, const ObjLoader& loader)
 {
-  const std::vector<float> vertices = loader.get_vertices();
-  const std::vector<float> normals = loader.get_normals();
-  const std::vector<face> faces = loader.get_faces();
+  loader.write(os);
+  return os;
+}
+
+// bytes gathered before they go to the stream
+const size_t WRITE_BUFFER_SIZE = 1 << 16;
+
+// room for the longest number to_chars can write (a float is at most 15)
+const size_t MAX_NUMBER_CHARS = 32;
+
+/**
+ * @brief Formats .obj records into a buffer and hands it to the stream in
+ * large writes, instead of one flush per line
+ *
+ * Floats are written with std::to_chars, which gives the shortest text that
+ * reads back as the same float.
+ */
+class ObjWriter {
+public:
+  explicit ObjWriter(std::ostream& os)
+      : m_os(os), m_buffer(WRITE_BUFFER_SIZE), m_used(0)
+  {
+  }
+
+  ~ObjWriter() { flush(); }
+
+  void put(const char* text, size_t length)
+  {
+    if (m_used + length > m_buffer.size()) {
+      flush();
+    }
+    if (length > m_buffer.size()) {
+      m_os.write(text, length);
+      return;
+    }
+    std::copy(text, text + length, m_buffer.data() + m_used);
+    m_used += length;
+  }
+
+  void put(char c)
+  {
+    if (m_used == m_buffer.size()) {
+      flush();
+    }
+    m_buffer[m_used++] = c;
+  }
+
+  template <typename T>
+  void put_number(T value)
+  {
+    if (m_used + MAX_NUMBER_CHARS > m_buffer.size()) {
+      flush();
+    }
+    char* begin = m_buffer.data() + m_used;
+    m_used = std::to_chars(begin, begin + MAX_NUMBER_CHARS, value).ptr -
+             m_buffer.data();
+  }
+
+  // a "v" or "vn" line
+  void put_vector(const char* type, size_t type_length, const float* xyz)
+  {
+    put(type, type_length);
+    for (int i = 0; i < 3; i++) {
+      put(' ');
+      put_number(xyz[i]);
+    }
+    put('\n');
+  }
+
+  // a "f" line, with the indices already 0 based
+  void put_face(const face& f)
+  {
+    put('f');
+    for (const auto& pair : f) {
+      put(' ');
+      put_number(pair.first + 1);
+      put("//", 2);
+      put_number(pair.second + 1);
+    }
+    put('\n');
+  }
+
+  void flush()
+  {
+    m_os.write(m_buffer.data(), m_used);
+    m_used = 0;
+  }
+
+private:
+  std::ostream& m_os;
+  std::vector<char> m_buffer;
+  size_t m_used;
+};
+
+void ObjLoader::write(std::ostream& os, bool welded) const
+{
+  ObjWriter out(os);
+
+  if (!welded) {
+    for (size_t i = 0; i + 2 < m_vertices.size(); i += 3) {
+      out.put_vector("v", 1, &m_vertices[i]);
+    }
+    for (size_t i = 0; i + 2 < m_normals.size(); i += 3) {
+      out.put_vector("vn", 2, &m_normals[i]);
+    }
+    for (const face& f : m_faces) {
+      out.put_face(f);
+    }
+    return;
+  }
+
+  // one index per distinct vertex//normal pair, in the order faces use them
+  std::unordered_map<unsigned long long, unsigned int> welded_idx;
+  std::vector<std::pair<unsigned int, unsigned int>> pairs;
+  std::vector<face> faces;
+  faces.reserve(m_faces.size());
+
+  for (const face& f : m_faces) {
+    face welded_face;
+    welded_face.reserve(f.size());
+
+    for (const auto& pair : f) {
+      const unsigned long long key =
+          (static_cast<unsigned long long>(pair.first) << 32) | pair.second;
+      auto found = welded_idx.emplace(key, pairs.size());
+      if (found.second) {
+        pairs.push_back(pair);
+      }
+      welded_face.emplace_back(found.first->second, found.first->second);
+    }
+
+    faces.push_back(welded_face);
+  }
 
-  for (int i = 0; i < vertices.size(); i+=3) {
-    os << "v " << vertices.at(i) << " " << vertices.at(i+1) << " " << vertices.at(i+2) << std::endl;
+  for (const auto& pair : pairs) {
+    out.put_vector("v", 1, &m_vertices.at(3 * pair.first));
   }
-  for (int i = 0; i < normals.size(); i+=3) {
-    os << "vn " << normals.at(i) << " " << normals.at(i+1) << " " << normals.at(i+2) << std::endl;
+  for (const auto& pair : pairs) {
+    out.put_vector("vn", 2, &m_normals.at(3 * pair.second));
   }
   for (const face& f : faces) {
-    os << "f " << f << std::endl;
+    out.put_face(f);
   }
+}
 
-  return os;
+int ObjLoader::write_file(const std::string filename, bool welded) const
+{
+  std::ofstream outfile(filename, std::ios::binary);
+
+  if (!outfile.is_open()) {
+    return EXIT_FAILURE;
+  }
+
+  write(outfile, welded);
+  outfile.close();
+
+  return outfile ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int ObjLoader::parse_file(const std::string filename)
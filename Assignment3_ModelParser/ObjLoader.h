@@ -20,6 +20,24 @@ public:
    */
   int parse_file(const std::string filename);
 
+  /**
+   * Writes the model back out as .obj text.
+   *
+   * @param os  where to write it
+   * @param welded  if true, every distinct vertex//normal pair the faces use
+   * becomes one v and one vn with the same index (what the index buffer
+   * draws); otherwise the records come out as they were read
+   */
+  void write(std::ostream& os, bool welded = false) const;
+
+  /**
+   * Writes the model to a .obj file (see write).
+   *
+   * @param filename  the filename
+   * @param welded  whether to weld the vertices and normals
+   * @return  EXIT_SUCCESS on success
+   */
+  int write_file(const std::string filename, bool welded = false) const;
 
   /**
    * returns a contiguous list of floats - every triplet represents a
@@ -0,0 +1,194 @@
+/**
+ * Times writing a model back out as .obj: the old way (operator<< with one
+ * std::endl per line) against ObjLoader::write_file, plain and welded. Then
+ * reads both files back and checks they hold exactly the same geometry.
+ *
+ * Fails if a float comes back different, a face changes, or the file can't
+ * be written or read.
+ *
+ * usage: ObjWriteBench [file.obj] [repeats]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ObjLoader.h"
+
+static const std::string DEFAULT_OBJ_FILE = "../objects/bunny.obj";
+static const std::string OUT_FILE = "ObjWriteBench.obj";
+static const int DEFAULT_REPEATS = 20;
+
+// how operator<< wrote models before ObjLoader::write
+void write_flushing(std::ostream& os, const ObjLoader& loader)
+{
+  const std::vector<float> vertices = loader.get_vertices();
+  const std::vector<float> normals = loader.get_normals();
+  const std::vector<face> faces = loader.get_faces();
+
+  for (size_t i = 0; i < vertices.size(); i += 3) {
+    os << "v " << vertices.at(i) << " " << vertices.at(i + 1) << " "
+       << vertices.at(i + 2) << std::endl;
+  }
+  for (size_t i = 0; i < normals.size(); i += 3) {
+    os << "vn " << normals.at(i) << " " << normals.at(i + 1) << " "
+       << normals.at(i + 2) << std::endl;
+  }
+  for (const face& f : faces) {
+    os << "f " << f << std::endl;
+  }
+}
+
+// true if both hold the same bits (so -0 and 0 differ)
+bool same_floats(const float* a, const float* b, size_t count)
+{
+  return std::memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+// true if every face corner has the same position and normal in both
+bool same_corners(const ObjLoader& a, const ObjLoader& b)
+{
+  const std::vector<float> a_vertices = a.get_vertices();
+  const std::vector<float> a_normals = a.get_normals();
+  const std::vector<face> a_faces = a.get_faces();
+  const std::vector<float> b_vertices = b.get_vertices();
+  const std::vector<float> b_normals = b.get_normals();
+  const std::vector<face> b_faces = b.get_faces();
+
+  if (a_faces.size() != b_faces.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a_faces.size(); i++) {
+    if (a_faces[i].size() != b_faces[i].size()) {
+      return false;
+    }
+
+    for (size_t c = 0; c < a_faces[i].size(); c++) {
+      const auto& pa = a_faces[i][c];
+      const auto& pb = b_faces[i][c];
+
+      if (3 * pb.first + 2 >= b_vertices.size() ||
+          3 * pb.second + 2 >= b_normals.size() ||
+          !same_floats(&a_vertices.at(3 * pa.first),
+                       &b_vertices[3 * pb.first], 3) ||
+          !same_floats(&a_normals.at(3 * pa.second),
+                       &b_normals[3 * pb.second], 3)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// writes the model repeats times, returning the ms per write (or -1)
+template <typename Write>
+double time_writes(int repeats, Write write)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < repeats; i++) {
+    std::ofstream outfile(OUT_FILE, std::ios::binary);
+    if (!outfile.is_open()) {
+      return -1;
+    }
+    write(outfile);
+    outfile.close();
+    if (!outfile) {
+      return -1;
+    }
+  }
+
+  std::chrono::duration<double, std::milli> ms =
+      std::chrono::steady_clock::now() - start;
+  return ms.count() / repeats;
+}
+
+int main(int argc, char** argv)
+{
+  const std::string file = argc > 1 ? argv[1] : DEFAULT_OBJ_FILE;
+  const int repeats = argc > 2 ? std::max(1, std::atoi(argv[2]))
+                               : DEFAULT_REPEATS;
+
+  ObjLoader original;
+  auto start = std::chrono::steady_clock::now();
+  if (original.parse_file(file) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << file << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::chrono::duration<double, std::milli> parse_ms =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << file << ": " << original.get_vertices().size() / 3
+            << " vertices, " << original.get_normals().size() / 3
+            << " normals, " << original.get_faces().size() << " faces\n"
+            << std::fixed << std::setprecision(2) << "  parse         "
+            << parse_ms.count() << " ms\n";
+
+  const double flushing_ms = time_writes(
+      repeats, [&](std::ostream& os) { write_flushing(os, original); });
+  const double welded_ms = time_writes(
+      repeats, [&](std::ostream& os) { original.write(os, true); });
+  const double plain_ms = time_writes(
+      repeats, [&](std::ostream& os) { original.write(os); });
+
+  if (flushing_ms < 0 || welded_ms < 0 || plain_ms < 0) {
+    std::cout << "Could not write file " << OUT_FILE << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "  std::endl     " << flushing_ms << " ms\n"
+            << "  write         " << plain_ms << " ms ("
+            << flushing_ms / plain_ms << "x)\n"
+            << "  write welded  " << welded_ms << " ms\n";
+
+  bool ok = true;
+
+  // the plain file was written last, so it is the one on disk
+  ObjLoader plain;
+  if (plain.parse_file(OUT_FILE) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << OUT_FILE << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::vector<float> vertices = original.get_vertices();
+  const std::vector<float> normals = original.get_normals();
+  if (plain.get_vertices().size() != vertices.size() ||
+      plain.get_normals().size() != normals.size() ||
+      !same_floats(plain.get_vertices().data(), vertices.data(),
+                   vertices.size()) ||
+      !same_floats(plain.get_normals().data(), normals.data(),
+                   normals.size()) ||
+      plain.get_faces() != original.get_faces()) {
+    std::cout << "  MISMATCH: the written file reads back different\n";
+    ok = false;
+  }
+
+  ObjLoader welded;
+  if (original.write_file(OUT_FILE, true) != EXIT_SUCCESS ||
+      welded.parse_file(OUT_FILE) != EXIT_SUCCESS) {
+    std::cout << "Could not round trip " << OUT_FILE << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "  welded to " << welded.get_vertices().size() / 3
+            << " vertex//normal pairs\n";
+  if (welded.get_vertices().size() != welded.get_normals().size() ||
+      !same_corners(original, welded)) {
+    std::cout << "  MISMATCH: the welded file draws other faces\n";
+    ok = false;
+  }
+
+  std::remove(OUT_FILE.c_str());
+
+  if (ok) {
+    std::cout << "  both files read back exactly\n";
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
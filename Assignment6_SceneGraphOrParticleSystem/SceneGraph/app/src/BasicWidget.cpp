@@ -62,11 +62,17 @@ BasicWidget::BasicWidget(std::string objfile, QWidget* parent)
 
 BasicWidget::~BasicWidget()
 {
+  // GL objects go on the GL thread, with the context current: the scene's
+  // buffers and textures (placeholders for any still decoding included)
+  makeCurrent();
+  m_scene.reset();
+
   for (auto& e : m_lights)
     if (e) delete e;
   // delete m_mesh
   for (auto& e : m_emitters)
     if (e) delete e;
+  doneCurrent();
 }
 
 void BasicWidget::keyReleaseEvent(QKeyEvent* keyEvent)
@@ -135,7 +141,7 @@ void BasicWidget::initializeGL()
   makeCurrent();
   initializeOpenGLFunctions();
 
-  m_scene->init();
+  m_scene->init(&m_textureLoader, &m_textureCache);
 
   glViewport(0, 0, width(), height());
   m_frameTimer.start();
@@ -181,6 +187,7 @@ void BasicWidget::paintGL()
   if (shouldUpdate) {
     m_scene->update(dt);
   }
+  m_textureLoader.begin_frame();
   m_scene->draw(m_camera.getViewMatrix(), m_camera.getProjectionMatrix(),
               m_lights);
 
@@ -9,6 +9,8 @@
 #include "Renderable.h"
 #include "Emitter.h"
 #include "Scene.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
 
 const float LOOK_SPEED = 0.5f;
 const float ZOOM_SPEED = 0.05f;
@@ -27,6 +29,10 @@ private:
   QVector<Light*> m_lights;
   QVector<Emitter*> m_emitters;
 
+  // decode and share the scene's textures (they outlive it, so they're
+  // declared first)
+  TextureLoader m_textureLoader;
+  TextureCache m_textureCache;
   std::shared_ptr<Scene> m_scene;
 
   QOpenGLDebugLogger m_logger;
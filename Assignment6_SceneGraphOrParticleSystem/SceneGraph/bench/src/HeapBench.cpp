@@ -0,0 +1,257 @@
+/**
+ * Counts the heap the CPU side of ObjMesh::init needs on the bundled chapel
+ * mesh (or the .obj files given on the command line), against what the
+ * original ObjMesh::init needed: parse, copy everything out of the loader,
+ * per-face tangents, then interleave. Also reports MeshCache::bake (what
+ * BakeMeshes runs), which now hands the loader's MeshData straight to
+ * Util::InterleaveMesh.
+ *
+ * The heap is counted by wrapping malloc and friends, so it is exact and
+ * takes in QVector's storage too. Fails unless the current ObjMesh::init path
+ * peaks at no more than half the original.
+ *
+ * No GL needed; the upload itself copies straight from these buffers.
+ *
+ * usage: HeapBench [file.obj ...]
+ */
+
+#include <malloc.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "ObjRecords.h"
+#include "ObjStreamer.h"
+#include "ObjToVboIdx.h"
+#include "Util.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const char* DEFAULT_MESHES[] = {
+    "chapel/chapel_obj.obj",
+};
+
+// the current path has to peak at no more than this share of the original
+const double MAX_PEAK_RATIO = 0.5;
+
+// heap accounting ---------------------------------------------------------
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<long long> g_heap(0);
+static std::atomic<long long> g_peak(0);
+
+static void heap_add(void* ptr)
+{
+  if (!ptr) {
+    return;
+  }
+
+  const long long now =
+      g_heap.fetch_add(malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+
+  long long peak = g_peak.load();
+  while (now > peak && !g_peak.compare_exchange_weak(peak, now)) {
+  }
+}
+
+static void heap_remove(void* ptr)
+{
+  if (ptr) {
+    g_heap.fetch_sub(malloc_usable_size(ptr));
+  }
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+  void* ptr = __libc_malloc(size);
+  heap_add(ptr);
+  return ptr;
+}
+
+void* calloc(size_t count, size_t size)
+{
+  void* ptr = __libc_calloc(count, size);
+  heap_add(ptr);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  heap_remove(ptr);
+  void* moved = __libc_realloc(ptr, size);
+  heap_add(moved ? moved : (size ? ptr : nullptr));
+  return moved;
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+  void* ptr = __libc_memalign(alignment, size);
+  heap_add(ptr);
+  return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size)
+{
+  void* ptr = memalign(alignment, size);
+  if (!ptr) {
+    return ENOMEM;
+  }
+  *out = ptr;
+  return 0;
+}
+
+void free(void* ptr)
+{
+  heap_remove(ptr);
+  __libc_free(ptr);
+}
+
+}  // extern "C"
+
+// peak heap above the current amount while f runs, in bytes
+template <typename F>
+long long peak_heap(F f)
+{
+  const long long baseline = g_heap.load();
+  g_peak = baseline;
+  f();
+  return g_peak.load() - baseline;
+}
+
+// the pipelines -------------------------------------------------------------
+
+// the original ObjMesh::init: a getline parse, the std::map welder and the
+// per-face tangent arrays, then one interleaved array and one index array
+// for the upload. (Its QVector copies were implicitly shared, so they cost
+// nothing until something wrote to them.)
+static void original_init(const std::string& filename)
+{
+  QVector<unsigned int> indices;
+  QVector<QVector3D> positions;
+  QVector<QVector2D> texCoords;
+  QVector<QVector3D> normals;
+  {
+    ObjRecords records;
+    if (read_obj_records(filename, ObjLoader::ParseMode::Stream, 1,
+                         records) != EXIT_SUCCESS) {
+      std::cout << "Could not read file " << filename << std::endl;
+      exit(1);
+    }
+
+    obj_to_vbo_map(records.vertices, records.uvs, records.normals,
+                   records.faces, indices, positions, texCoords, normals);
+  }
+
+  QVector<QVector3D> tangents;
+  QVector<QVector3D> bitangents;
+  Util::CalculateTangents(positions, normals, texCoords, indices, tangents,
+                          bitangents);
+
+  {
+    std::vector<float> data;
+    Util::InterleaveVertices(positions, normals, texCoords, tangents,
+                             bitangents, indices, data);
+  }
+
+  std::vector<unsigned int> idxAr(indices.begin(), indices.end());
+}
+
+// ObjMesh::init on a cache miss: batches from the streamer go to the vbo and
+// the cache writer, then back to the streamer
+static void current_init(const std::string& filename)
+{
+  ObjStreamer stream;
+  if (stream.start(filename) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << filename << std::endl;
+    exit(1);
+  }
+
+  // never finished, so it cleans up after itself
+  MeshCacheWriter writer;
+  bool caching = writer.begin(filename) == EXIT_SUCCESS;
+
+  while (MeshBatch* batch = stream.next()) {
+    caching = caching &&
+              writer.add(batch->vertices.data(), batch->num_vertices(),
+                         batch->indices.data(),
+                         batch->num_indices()) == EXIT_SUCCESS;
+    stream.release(batch);
+  }
+
+  if (stream.status() != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << filename << std::endl;
+    exit(1);
+  }
+}
+
+static void bake(const std::string& filename)
+{
+  BakedMesh mesh;
+  if (MeshCache::bake(filename, mesh) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << filename << std::endl;
+    exit(1);
+  }
+}
+
+static void report(const char* label, long long bytes, long long original)
+{
+  std::cout << "  " << std::left << std::setw(10) << label << std::right
+            << std::setw(10) << bytes / 1024 << " KB peak heap";
+  if (original > 0) {
+    std::cout << "  (" << std::fixed << std::setprecision(2)
+              << static_cast<double>(bytes) / original << "x)";
+  }
+  std::cout << '\n';
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files(argv + 1, argv + argc);
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  bool ok = true;
+
+  for (const std::string& file : files) {
+    std::cout << file << '\n';
+
+    const long long original = peak_heap([&] { original_init(file); });
+    const long long current = peak_heap([&] { current_init(file); });
+    const long long baked = peak_heap([&] { bake(file); });
+
+    report("original", original, 0);
+    report("ObjMesh", current, original);
+    report("bake", baked, original);
+
+    if (current > original * MAX_PEAK_RATIO) {
+      std::cout << "  ObjMesh::init peak heap is not under half the original\n";
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,521 @@
+/**
+ * Renders meshes with more than one material through ObjMesh and checks
+ * every usemtl range is drawn with its own maps, then times drawing the
+ * bundled chapel.
+ *
+ * The check writes a ring of quads into a scratch directory, each quad its
+ * own usemtl range (every material used twice, never next to itself), with
+ * solid color maps and an .mtl whose materials tell apart the diffuse map,
+ * the specular map (map_Ks), the shininess (Ns) and the normal map
+ * (map_Bump), plus one with no maps at all, drawn in its Kd and Ks (which
+ * the others have black, as the maps are to win). It's drawn into a framebuffer under one light, once streamed
+ * from the .obj and once from the .herbmesh cache the first load wrote, and
+ * the middle of every quad has to come out as frag.glsl would light its own
+ * material (to within TOLERANCE), and not as any other material would.
+ *
+ * Needs no display with the offscreen platform (the default here) and
+ * Mesa's software GL, e.g.:
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./bench/MaterialBench
+ *
+ * usage: MaterialBench [--frames <n>] [file.obj]
+ */
+
+#include <unistd.h>
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "MipPyramid.h"
+#include "ObjLoader.h"
+#include "ObjMesh.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const char* DEFAULT_MESH = "chapel/chapel_obj.obj";
+const int DEFAULT_FRAMES = 100;
+
+// per channel, out of 255
+const int TOLERANCE = 3;
+
+// the ring of quads, looked at (and lit) from straight above its middle,
+// high enough that the highlights still tell the shininesses apart
+const int QUADS = 14;
+const float RING_RADIUS = 3.0f;
+const float QUAD_SIZE = 0.8f;
+const float EYE_HEIGHT = 18.7f;
+const int VIEW_PIXELS = 400;  // square, over -4..4 in x and y
+
+// a solid color image (8x8, so it gets a few mip levels)
+struct SolidImage {
+  const char* file;
+  int r, g, b;
+};
+
+const SolidImage IMAGES[] = {
+    {"red.ppm", 255, 0, 0},
+    {"green.ppm", 0, 255, 0},
+    {"white.ppm", 255, 255, 255},
+    {"black.ppm", 0, 0, 0},
+    {"tilted.ppm", 191, 128, 238},  // a normal 30 degrees towards +x
+};
+
+// what goes in the .mtl; a null map is left out
+struct TestMaterial {
+  const char* name;
+  const char* map_Kd;
+  const char* map_Ks;
+  const char* map_Bump;
+  float Ns;
+  QVector3D Kd;
+  QVector3D Ks;
+};
+
+const QVector3D BLACK(0, 0, 0);
+const QVector3D WHITE(1, 1, 1);
+
+const TestMaterial MATERIALS[] = {
+    {"red", "red.ppm", "black.ppm", nullptr, 8, BLACK, BLACK},
+    {"green", "green.ppm", "black.ppm", nullptr, 8, BLACK, BLACK},
+    {"matte", "white.ppm", "black.ppm", nullptr, 0, BLACK, BLACK},
+    // Ns 0, so 32
+    {"glossy", "white.ppm", nullptr, nullptr, 0, BLACK, WHITE},
+    {"shiny", "white.ppm", "white.ppm", nullptr, 12, BLACK, BLACK},
+    {"bumpy", "white.ppm", "black.ppm", "tilted.ppm", 8, BLACK, BLACK},
+    {"tinted", nullptr, nullptr, nullptr, 8, QVector3D(0.8f, 0.4f, 0.2f),
+     QVector3D(0.2f, 0.6f, 1.0f)},
+};
+const int NUM_MATERIALS = sizeof(MATERIALS) / sizeof(MATERIALS[0]);
+
+// which material each quad around the ring has
+const int QUAD_MATERIAL[QUADS] = {0, 1, 2, 3, 4, 5, 6, 3, 0, 5, 1, 6, 4, 2};
+
+// a look at the draws Renderable set up
+class ProbeMesh : public ObjMesh {
+public:
+  int draws() const { return static_cast<int>(m_drawRanges.size()); }
+  int materials() const { return static_cast<int>(m_materials.size()); }
+
+  // true if every map of every material is a loaded image, not the 1x1
+  // stand in for a missing one
+  bool allMapsLoaded() const
+  {
+    for (const DrawMaterial& m : m_materials) {
+      for (int map : {m.diffuse, m.normal, m.specular}) {
+        const QOpenGLTexture* texture = m_textures[map].get();
+        if (texture->width() <= 1 && texture->height() <= 1) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+// an offscreen color + depth target, bound while it lives
+class Framebuffer {
+public:
+  Framebuffer(int width, int height)
+      : m_gl(QOpenGLContext::currentContext()->functions()),
+        m_width(width),
+        m_height(height)
+  {
+    m_gl->glGenFramebuffers(1, &m_fbo);
+    m_gl->glGenRenderbuffers(2, m_renderbuffers);
+    m_gl->glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+    m_gl->glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[0]);
+    m_gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    m_gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                    GL_RENDERBUFFER, m_renderbuffers[0]);
+
+    m_gl->glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[1]);
+    m_gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                                height);
+    m_gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                    GL_RENDERBUFFER, m_renderbuffers[1]);
+
+    m_gl->glViewport(0, 0, width, height);
+    m_gl->glEnable(GL_DEPTH_TEST);
+  }
+
+  ~Framebuffer()
+  {
+    m_gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_gl->glDeleteRenderbuffers(2, m_renderbuffers);
+    m_gl->glDeleteFramebuffers(1, &m_fbo);
+  }
+
+  bool complete() const
+  {
+    return m_gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE;
+  }
+
+  void clear()
+  {
+    m_gl->glClearColor(0, 0, 0, 1);
+    m_gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  }
+
+  // RGBA, bottom row first
+  std::vector<unsigned char> read() const
+  {
+    std::vector<unsigned char> pixels(m_width * m_height * 4);
+    m_gl->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    m_gl->glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE,
+                       pixels.data());
+    return pixels;
+  }
+
+private:
+  QOpenGLFunctions* m_gl;
+  int m_width, m_height;
+  GLuint m_fbo;
+  GLuint m_renderbuffers[2];
+};
+
+const SolidImage* find_image(const char* file)
+{
+  for (const SolidImage& image : IMAGES) {
+    if (file && std::string(image.file) == file) {
+      return &image;
+    }
+  }
+  return nullptr;
+}
+
+bool write_file(const std::string& path, const std::string& text)
+{
+  std::ofstream out(path);
+  out << text;
+  return static_cast<bool>(out);
+}
+
+// the quads, their .mtl and their maps, in dir; returns the .obj
+std::string write_ring(const std::string& dir)
+{
+  for (const SolidImage& image : IMAGES) {
+    std::string ppm = "P3\n8 8\n255\n";
+    for (int i = 0; i < 64; i++) {
+      ppm += std::to_string(image.r) + " " + std::to_string(image.g) + " " +
+             std::to_string(image.b) + "\n";
+    }
+    write_file(dir + "/" + image.file, ppm);
+  }
+
+  auto color = [](const QVector3D& c) {
+    return std::to_string(c.x()) + " " + std::to_string(c.y()) + " " +
+           std::to_string(c.z()) + "\n";
+  };
+
+  std::string mtl;
+  for (const TestMaterial& m : MATERIALS) {
+    mtl += std::string("newmtl ") + m.name + "\nNs " + std::to_string(m.Ns) +
+           "\nKd " + color(m.Kd) + "Ks " + color(m.Ks);
+    if (m.map_Kd) mtl += std::string("map_Kd ") + m.map_Kd + "\n";
+    if (m.map_Ks) mtl += std::string("map_Ks ") + m.map_Ks + "\n";
+    if (m.map_Bump) mtl += std::string("map_Bump ") + m.map_Bump + "\n";
+  }
+  write_file(dir + "/ring.mtl", mtl);
+
+  // quads facing +z, u along x and v along y
+  std::string obj = "mtllib ring.mtl\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                    "vn 0 0 1\n";
+  const float h = QUAD_SIZE / 2;
+  for (int q = 0; q < QUADS; q++) {
+    const float a = 2 * static_cast<float>(M_PI) * q / QUADS;
+    const float x = RING_RADIUS * cosf(a), y = RING_RADIUS * sinf(a);
+    obj += "v " + std::to_string(x - h) + " " + std::to_string(y - h) +
+           " 0\nv " + std::to_string(x + h) + " " + std::to_string(y - h) +
+           " 0\nv " + std::to_string(x + h) + " " + std::to_string(y + h) +
+           " 0\nv " + std::to_string(x - h) + " " + std::to_string(y + h) +
+           " 0\n";
+  }
+  for (int q = 0; q < QUADS; q++) {
+    const int v = 4 * q + 1;
+    obj += std::string("usemtl ") + MATERIALS[QUAD_MATERIAL[q]].name +
+           "\nf " + std::to_string(v) + "/1/1 " + std::to_string(v + 1) +
+           "/2/1 " + std::to_string(v + 2) + "/3/1 " +
+           std::to_string(v + 3) + "/4/1\n";
+  }
+  write_file(dir + "/ring.obj", obj);
+  return dir + "/ring.obj";
+}
+
+void remove_ring(const std::string& dir)
+{
+  for (const SolidImage& image : IMAGES) {
+    const std::string ppm = dir + "/" + image.file;
+    MipCache::remove(ppm);
+    std::remove(ppm.c_str());
+  }
+  std::remove(MeshCache::cache_path(dir + "/ring.obj").c_str());
+  std::remove((dir + "/ring.obj").c_str());
+  std::remove((dir + "/ring.mtl").c_str());
+  rmdir(dir.c_str());
+}
+
+// the light and camera both quad checks and the chapel are drawn with
+Light make_light(const QVector3D& position)
+{
+  Light light;
+  light.position = position;
+  light.ambientIntensity = 0.1f;
+  light.diffuseIntensity = 0.5f;
+  light.specularIntensity = 0.4f;
+  light.constant = 1;
+  light.linear = 0;
+  light.quadratic = 0;
+  return light;
+}
+
+// what frag.glsl makes of material m at p (on a quad facing +z, with no
+// rotation between its tangent space and the world), out of 255
+QVector3D expected_color(const TestMaterial& m, const QVector3D& p,
+                         const Light& light, const QVector3D& eye)
+{
+  const SolidImage* kd = find_image(m.map_Kd);
+  const SolidImage* ks = find_image(m.map_Ks);
+  const SolidImage* bump = find_image(m.map_Bump);
+
+  const QVector3D diffuse =
+      kd ? QVector3D(kd->r, kd->g, kd->b) / 255.0f : m.Kd;
+  const QVector3D specColor =
+      ks ? QVector3D(ks->r, ks->g, ks->b) / 255.0f : m.Ks;
+  const QVector3D encoded = bump ? QVector3D(bump->r, bump->g, bump->b)
+                                 : QVector3D(128, 128, 255);
+  const QVector3D n = (encoded / 255.0f * 2.0f - QVector3D(1, 1, 1))
+                          .normalized();
+  const float shininess = m.Ns > 0 ? m.Ns : 32.0f;
+
+  const QVector3D toLight = (light.position - p).normalized();
+  const QVector3D toEye = (eye - p).normalized();
+  const QVector3D reflected =
+      -toLight + 2 * QVector3D::dotProduct(n, toLight) * n;
+
+  const float diff = std::max(QVector3D::dotProduct(n, toLight), 0.0f);
+  const float spec =
+      std::pow(std::max(QVector3D::dotProduct(toEye, reflected), 0.0f),
+               shininess);
+
+  const QVector3D lighting =
+      light.ambient * light.ambientIntensity +
+      light.diffuse * diff * light.diffuseIntensity +
+      light.specular * spec * specColor * light.specularIntensity;
+
+  QVector3D color = diffuse * lighting;
+  for (int c = 0; c < 3; c++) {
+    color[c] = std::min(std::max(color[c], 0.0f), 1.0f) * 255;
+  }
+  return color;
+}
+
+float channel_difference(const QVector3D& a, const QVector3D& b)
+{
+  return std::max(std::max(std::fabs(a.x() - b.x()), std::fabs(a.y() - b.y())),
+                  std::fabs(a.z() - b.z()));
+}
+
+// draws mesh as the ring and checks the middle of every quad; also
+// reports the closest any quad came to looking like another material
+bool check_ring(ProbeMesh& mesh, const char* label)
+{
+  const QVector3D eye(0, 0, EYE_HEIGHT);
+  QMatrix4x4 world, view, projection;
+  view.lookAt(eye, QVector3D(0, 0, 0), QVector3D(0, 1, 0));
+  projection.ortho(-4, 4, -4, 4, 1, 2 * EYE_HEIGHT);
+
+  Light light = make_light(eye);
+  const QVector<Light*> lights = {&light};
+
+  Framebuffer target(VIEW_PIXELS, VIEW_PIXELS);
+  if (!target.complete()) {
+    std::cout << "  could not make a framebuffer\n";
+    return false;
+  }
+  target.clear();
+  mesh.draw(world, view, projection, lights);
+  const std::vector<unsigned char> pixels = target.read();
+
+  float worst = 0;       // from its own material
+  float margin = 1e30f;  // from the nearest other material
+  const float unitsPerPixel = 8.0f / VIEW_PIXELS;
+  for (int q = 0; q < QUADS; q++) {
+    const float a = 2 * static_cast<float>(M_PI) * q / QUADS;
+    const int px = static_cast<int>((RING_RADIUS * cosf(a) + 4) /
+                                    unitsPerPixel);
+    const int py = static_cast<int>((RING_RADIUS * sinf(a) + 4) /
+                                    unitsPerPixel);
+    const QVector3D p((px + 0.5f) * unitsPerPixel - 4,
+                      (py + 0.5f) * unitsPerPixel - 4, 0);
+
+    const unsigned char* rgba = &pixels[(py * VIEW_PIXELS + px) * 4];
+    const QVector3D drawn(rgba[0], rgba[1], rgba[2]);
+
+    for (int m = 0; m < NUM_MATERIALS; m++) {
+      const QVector3D expected = expected_color(MATERIALS[m], p, light, eye);
+      const float off = channel_difference(drawn, expected);
+      if (m == QUAD_MATERIAL[q]) {
+        worst = std::max(worst, off);
+        if (off > TOLERANCE) {
+          std::cout << "  FAIL: " << label << " quad " << q << " ("
+                    << MATERIALS[m].name << ") is " << drawn.x() << " "
+                    << drawn.y() << " " << drawn.z() << ", off by " << off
+                    << '\n';
+          return false;
+        }
+      }
+      else {
+        margin = std::min(margin, off);
+      }
+    }
+  }
+  if (margin <= TOLERANCE) {
+    std::cout << "  FAIL: " << label
+              << " a quad also looks like another material\n";
+    return false;
+  }
+
+  std::cout << std::fixed << std::setprecision(1) << "  " << std::left
+            << std::setw(10) << label << std::right << mesh.draws()
+            << " draws, " << mesh.materials()
+            << " materials, every quad its own (off by at most " << worst
+            << ", the nearest other material " << margin << " away)\n";
+  return true;
+}
+
+// times frames of the whole mesh, framed from its bounding box
+bool time_mesh(const std::string& filename, int frames)
+{
+  ObjLoader obj;
+  if (obj.parse_file(filename) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << filename << std::endl;
+    return false;
+  }
+  QVector3D low(1e30f, 1e30f, 1e30f), high(-1e30f, -1e30f, -1e30f);
+  for (const QVector3D& v : obj.get_vertices()) {
+    for (int c = 0; c < 3; c++) {
+      low[c] = std::min(low[c], v[c]);
+      high[c] = std::max(high[c], v[c]);
+    }
+  }
+  const QVector3D middle = (low + high) / 2;
+  const float radius = (high - low).length() / 2;
+
+  ProbeMesh mesh;
+  mesh.init(filename);
+
+  const QVector3D eye = middle + QVector3D(0.6f, 0.4f, 1.0f) * 1.5f * radius;
+  QMatrix4x4 world, view, projection;
+  view.lookAt(eye, middle, QVector3D(0, 1, 0));
+  projection.perspective(60, 1, radius * 0.1f, radius * 10);
+
+  Light light = make_light(eye);
+  const QVector<Light*> lights = {&light};
+
+  Framebuffer target(VIEW_PIXELS, VIEW_PIXELS);
+  if (!target.complete()) {
+    std::cout << "  could not make a framebuffer\n";
+    return false;
+  }
+  QOpenGLFunctions* gl = QOpenGLContext::currentContext()->functions();
+
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point start = Clock::now();
+  for (int i = 0; i < frames; i++) {
+    target.clear();
+    mesh.draw(world, view, projection, lights);
+  }
+  gl->glFinish();
+  const double ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  const std::vector<unsigned char> pixels = target.read();
+  int covered = 0;
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    covered += pixels[i] || pixels[i + 1] || pixels[i + 2];
+  }
+
+  std::cout << filename << "\n  " << mesh.draws() << " draws, "
+            << mesh.materials() << " materials"
+            << (mesh.allMapsLoaded() ? ", every map loaded" : "")
+            << ", covers " << std::fixed << std::setprecision(1)
+            << 100.0 * covered / (VIEW_PIXELS * VIEW_PIXELS)
+            << "% of the view, "
+            << std::setprecision(2) << ms / frames << " ms per frame\n";
+  return covered > 0;
+}
+
+int main(int argc, char** argv)
+{
+  int frames = DEFAULT_FRAMES;
+  std::string mesh = std::string(OBJECTS_DIR) + "/" + DEFAULT_MESH;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--frames" && i + 1 < argc) {
+      frames = std::max(1, std::atoi(argv[++i]));
+    }
+    else {
+      mesh = arg;
+    }
+  }
+
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QGuiApplication app(argc, argv);
+
+  QSurfaceFormat fmt;
+  fmt.setVersion(3, 3);
+  fmt.setProfile(QSurfaceFormat::CoreProfile);
+
+  QOpenGLContext context;
+  context.setFormat(fmt);
+  QOffscreenSurface surface;
+  surface.setFormat(fmt);
+  surface.create();
+
+  if (!context.create() || !context.makeCurrent(&surface)) {
+    std::cout << "could not make a GL context" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  char dir[] = "/tmp/MaterialBench.XXXXXX";
+  if (!mkdtemp(dir)) {
+    std::cout << "could not make a scratch directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string ring = write_ring(dir);
+
+  std::cout << QUADS << " quads, " << NUM_MATERIALS << " materials\n";
+  bool ok;
+  {
+    // the first load streams the .obj and writes the cache the second reads
+    ProbeMesh streamed;
+    streamed.init(ring);
+    ok = check_ring(streamed, "streamed");
+  }
+  if (ok) {
+    ProbeMesh cached;
+    cached.init(ring);
+    ok = check_ring(cached, "cached");
+  }
+  remove_ring(dir);
+
+  return ok && time_mesh(mesh, frames) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
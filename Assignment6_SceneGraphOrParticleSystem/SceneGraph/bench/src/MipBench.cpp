@@ -0,0 +1,448 @@
+/**
+ * Checks the CPU mip chains Renderable uploads (build_mip_chain) and times
+ * them on the bundled textures, or the images given on the command line:
+ * the old path (load, then QImage::mirrored before the upload, the GPU
+ * making the rest), a cold load (load and build every level) and a warm one
+ * (map the .herbmip cache, which this writes next to each image).
+ *
+ * Level 0 has to be exactly the mirrored image, every level the size GL
+ * expects, and what comes back from the cache exactly what was built (each
+ * kind and filter from its own cache, all of them written first). Flat
+ * images have to stay flat, normals unit length, and a black and white
+ * checkerboard has to go to linear mid grey (188) as a color and to 128 as
+ * data.
+ *
+ * Every chain is then uploaded with Renderable::createTexture and read back
+ * level by level from GL, which has to give back exactly what was built,
+ * and compared with what the old path got from the GPU (QOpenGLTexture's
+ * GenerateMipMaps on the mirrored image): the same number of levels, the
+ * same level 0, and the levels below it within MAX_MEAN_GPU_DIFFERENCE on
+ * average (they aren't filtered the same, so not equal). Needs no display
+ * with the offscreen platform (the default here) and Mesa's software GL,
+ * e.g.:
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./bench/MipBench
+ *
+ * usage: MipBench [image ...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QGuiApplication>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <QSurfaceFormat>
+
+#include "MipPyramid.h"
+#include "Renderable.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const int BENCH_RUNS = 5;
+
+// how far apart (per channel, on average) the levels below 0 can be from
+// the ones the GPU made: more than filtering differences, less than an
+// upside down or shifted level
+const double MAX_MEAN_GPU_DIFFERENCE = 8;
+
+const MipFilter FILTERS[] = {MipFilter::BOX, MipFilter::KAISER};
+const char* FILTER_NAMES[] = {"box", "kaiser"};
+
+struct Texture {
+  const char* file;
+  MipKind kind;
+};
+
+const Texture DEFAULT_TEXTURES[] = {
+    {"chapel/chapel_diffuse.ppm", MipKind::COLOR},
+    {"chapel/chapel_normal.ppm", MipKind::NORMAL},
+    {"chapel/chapel_spec.ppm", MipKind::DATA},
+    {"house/house_diffuse.ppm", MipKind::COLOR},
+    {"windmill/windmill_normal.ppm", MipKind::NORMAL},
+};
+
+// as Renderable loads it: 0xAARRGGBB words
+QImage load_image(const std::string& file)
+{
+  QImage img(QString::fromStdString(file));
+  if (!img.isNull() && img.format() != QImage::Format_RGB32 &&
+      img.format() != QImage::Format_ARGB32) {
+    img = img.convertToFormat(QImage::Format_ARGB32);
+  }
+  return img;
+}
+
+void build(const QImage& img, MipKind kind, MipFilter filter,
+           std::vector<MipLevel>& levels)
+{
+  build_mip_chain(reinterpret_cast<const uint32_t*>(img.constBits()),
+                  img.width(), img.height(), img.bytesPerLine() / 4, kind,
+                  filter, levels);
+}
+
+// level 0 is what setData(img.mirrored(true, true)) uploaded, and the rest
+// are the sizes GL expects
+bool check_chain(const QImage& img, const std::vector<MipLevel>& levels)
+{
+  const QImage expected =
+      img.mirrored(true, true).convertToFormat(QImage::Format_RGBA8888);
+  bool ok = !levels.empty();
+
+  for (int y = 0; ok && y < expected.height(); y++) {
+    ok = memcmp(expected.constScanLine(y),
+                &levels[0].rgba[size_t(y) * expected.width() * 4],
+                size_t(expected.width()) * 4) == 0;
+  }
+
+  uint32_t width = img.width();
+  uint32_t height = img.height();
+  for (size_t i = 0; ok && i < levels.size(); i++) {
+    ok = levels[i].width == width && levels[i].height == height &&
+         levels[i].rgba.size() == size_t(width) * height * 4 &&
+         ((width == 1 && height == 1) == (i + 1 == levels.size()));
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+
+  return ok;
+}
+
+bool same_levels(const std::vector<MipLevel>& built,
+                 const std::vector<MipCache::Level>& cached)
+{
+  if (built.size() != cached.size()) return false;
+  for (size_t i = 0; i < built.size(); i++) {
+    if (built[i].width != cached[i].width ||
+        built[i].height != cached[i].height ||
+        memcmp(built[i].rgba.data(), cached[i].rgba, built[i].rgba.size()))
+      return false;
+  }
+  return true;
+}
+
+// true if the image cached as every kind with every filter gives each chain
+// back, none of them having overwritten another
+bool check_cache_variants(const std::string& file, const QImage& img)
+{
+  const MipKind kinds[] = {MipKind::COLOR, MipKind::NORMAL, MipKind::DATA};
+  std::vector<std::vector<MipLevel>> built;
+
+  for (MipKind kind : kinds) {
+    for (MipFilter filter : FILTERS) {
+      built.emplace_back();
+      build(img, kind, filter, built.back());
+      if (MipCache::write(file, kind, filter, built.back()) != EXIT_SUCCESS) {
+        return false;
+      }
+    }
+  }
+
+  size_t i = 0;
+  for (MipKind kind : kinds) {
+    for (MipFilter filter : FILTERS) {
+      MipCache cache;
+      if (cache.open(file, kind, filter) != EXIT_SUCCESS ||
+          !same_levels(built[i++], cache.levels())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// the worst distance from unit length of any normal below level 0
+double worst_normal(const std::vector<MipLevel>& levels)
+{
+  double worst = 0;
+  for (size_t i = 1; i < levels.size(); i++) {
+    const std::vector<unsigned char>& rgba = levels[i].rgba;
+    for (size_t t = 0; t < rgba.size(); t += 4) {
+      double length = 0;
+      for (int c = 0; c < 3; c++) {
+        const double v = rgba[t + c] / 127.5 - 1;
+        length += v * v;
+      }
+      worst = std::max(worst, std::abs(std::sqrt(length) - 1));
+    }
+  }
+  return worst;
+}
+
+// flat images stay flat and the checkerboard averages in the right space
+bool check_synthetic()
+{
+  bool ok = true;
+
+  const QRgb flat_colors[] = {qRgb(12, 200, 255), qRgb(128, 128, 255),
+                              qRgba(16, 32, 48, 128), qRgb(0, 0, 0)};
+  for (QRgb color : flat_colors) {
+    QImage flat(45, 30, QImage::Format_ARGB32);
+    flat.fill(color);
+
+    for (MipFilter filter : FILTERS) {
+      for (MipKind kind : {MipKind::COLOR, MipKind::DATA}) {
+        std::vector<MipLevel> levels;
+        build(flat, kind, filter, levels);
+        for (const MipLevel& level : levels) {
+          for (size_t t = 0; t < level.rgba.size(); t += 4) {
+            ok = ok && memcmp(&level.rgba[t], &levels[0].rgba[0], 4) == 0;
+          }
+        }
+      }
+    }
+  }
+  if (!ok) std::cout << "FAIL: a flat image changed\n";
+
+  QImage checker(64, 64, QImage::Format_RGB32);
+  for (int y = 0; y < checker.height(); y++) {
+    for (int x = 0; x < checker.width(); x++) {
+      const int level = (x + y) % 2 ? 255 : 0;
+      checker.setPixel(x, y, qRgb(level, level, level));
+    }
+  }
+
+  std::vector<MipLevel> levels;
+  build(checker, MipKind::COLOR, MipFilter::BOX, levels);
+  const int color = levels[1].rgba[0];
+  build(checker, MipKind::DATA, MipFilter::BOX, levels);
+  const int data = levels[1].rgba[0];
+  std::cout << "checkerboard level 1: " << color << " as color, " << data
+            << " as data\n";
+  if (color != 188 || data != 128) {
+    std::cout << "FAIL: the checkerboard should be 188 and 128\n";
+    ok = false;
+  }
+
+  return ok;
+}
+
+// to get at Renderable::createTexture
+struct TextureUpload : Renderable {
+  using Renderable::createTexture;
+};
+
+// one level of a texture, read back through a framebuffer (RGBA, bottom
+// row first); empty if it can't be
+std::vector<unsigned char> read_level(const QOpenGLTexture& tex, int level)
+{
+  QOpenGLFunctions* gl = QOpenGLContext::currentContext()->functions();
+  const int width = std::max(1, tex.width() >> level);
+  const int height = std::max(1, tex.height() >> level);
+
+  GLuint fbo;
+  gl->glGenFramebuffers(1, &fbo);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, tex.textureId(), level);
+
+  std::vector<unsigned char> pixels;
+  if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+      GL_FRAMEBUFFER_COMPLETE) {
+    pixels.resize(size_t(width) * height * 4);
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    gl->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                     pixels.data());
+  }
+
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  gl->glDeleteFramebuffers(1, &fbo);
+  return pixels;
+}
+
+// Uploads levels through Renderable::createTexture and img the old way,
+// and compares them level by level; the mean difference of the levels
+// below 0 from the GPU's goes in gpu_difference.
+bool check_upload(const QImage& img, const std::vector<MipLevel>& levels,
+                  double& gpu_difference)
+{
+  std::vector<MipCache::Level> chain;
+  for (const MipLevel& level : levels) {
+    chain.push_back({level.width, level.height, level.rgba.data()});
+  }
+
+  std::unique_ptr<QOpenGLTexture> ours(TextureUpload::createTexture(chain));
+  QOpenGLTexture theirs(img.mirrored(true, true),
+                        QOpenGLTexture::GenerateMipMaps);
+
+  if (ours->mipLevels() != static_cast<int>(levels.size()) ||
+      theirs.mipLevels() != ours->mipLevels()) {
+    std::cout << "FAIL: " << ours->mipLevels() << " levels uploaded, "
+              << theirs.mipLevels() << " from the GPU, " << levels.size()
+              << " built\n";
+    return false;
+  }
+
+  bool ok = true;
+  double sum = 0;
+  size_t count = 0;
+  for (int i = 0; ok && i < ours->mipLevels(); i++) {
+    const std::vector<unsigned char> mine = read_level(*ours, i);
+    const std::vector<unsigned char> gpu = read_level(theirs, i);
+
+    if (mine != levels[i].rgba || gpu.size() != mine.size()) {
+      std::cout << "FAIL: level " << i << " didn't come back from GL\n";
+      ok = false;
+    }
+    else if (i == 0 && gpu != mine) {
+      std::cout << "FAIL: level 0 isn't what the old path uploaded\n";
+      ok = false;
+    }
+    else if (i > 0) {
+      for (size_t t = 0; t < mine.size(); t++) {
+        sum += std::abs(int(mine[t]) - int(gpu[t]));
+      }
+      count += mine.size();
+    }
+  }
+
+  gpu_difference = count ? sum / count : 0;
+  if (ok && gpu_difference > MAX_MEAN_GPU_DIFFERENCE) {
+    std::cout << "FAIL: the levels are " << gpu_difference
+              << " off the GPU's on average\n";
+    ok = false;
+  }
+  return ok;
+}
+
+template <typename Load>
+double best_ms(Load load)
+{
+  double best = 1e30;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    load();
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, ms.count());
+  }
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  // images from the command line are taken to be colors
+  std::vector<Texture> textures;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    textures.push_back({argv[i], MipKind::COLOR});
+    files.push_back(argv[i]);
+  }
+  if (textures.empty()) {
+    for (const Texture& texture : DEFAULT_TEXTURES) {
+      textures.push_back(texture);
+      files.push_back(std::string(OBJECTS_DIR) + "/" + texture.file);
+    }
+  }
+
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QGuiApplication app(argc, argv);
+
+  QSurfaceFormat fmt;
+  fmt.setVersion(3, 3);
+  fmt.setProfile(QSurfaceFormat::CoreProfile);
+
+  QOpenGLContext context;
+  context.setFormat(fmt);
+  QOffscreenSurface surface;
+  surface.setFormat(fmt);
+  surface.create();
+
+  if (!context.create() || !context.makeCurrent(&surface)) {
+    std::cout << "could not make a GL context" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool ok = check_synthetic();
+
+  std::cout << std::fixed << std::setprecision(2) << std::left
+            << std::setw(32) << "image" << std::setw(8) << "filter"
+            << std::right << std::setw(11) << "size" << std::setw(10)
+            << "old ms" << std::setw(10) << "cold ms" << std::setw(10)
+            << "warm ms" << std::setw(10) << "vs GPU" << '\n';
+
+  for (size_t i = 0; i < files.size(); i++) {
+    const std::string& file = files[i];
+    const MipKind kind = textures[i].kind;
+
+    const QImage img = load_image(file);
+    if (img.isNull()) {
+      std::cout << "can't load " << file << '\n';
+      ok = false;
+      continue;
+    }
+
+    if (!check_cache_variants(file, img)) {
+      std::cout << "FAIL: " << file
+                << " cached one way overwrote it cached another\n";
+      ok = false;
+    }
+
+    for (size_t f = 0; f < 2; f++) {
+      const MipFilter filter = FILTERS[f];
+
+      std::vector<MipLevel> levels;
+      build(img, kind, filter, levels);
+      if (!check_chain(img, levels)) {
+        std::cout << "FAIL: wrong chain for " << file << '\n';
+        ok = false;
+      }
+      if (kind == MipKind::NORMAL && worst_normal(levels) > 0.02) {
+        std::cout << "FAIL: normals off unit length by "
+                  << worst_normal(levels) << " in " << file << '\n';
+        ok = false;
+      }
+
+      MipCache cache;
+      if (MipCache::write(file, kind, filter, levels) != EXIT_SUCCESS ||
+          cache.open(file, kind, filter) != EXIT_SUCCESS ||
+          !same_levels(levels, cache.levels())) {
+        std::cout << "FAIL: the cache didn't give back " << file << '\n';
+        ok = false;
+      }
+      cache.close();
+
+      double gpu_difference = 0;
+      if (!check_upload(img, levels, gpu_difference)) {
+        std::cout << "FAIL: uploading " << file << '\n';
+        ok = false;
+      }
+
+      const double old_ms = best_ms([&] {
+        QImage mirrored = load_image(file).mirrored(true, true);
+        (void)mirrored;
+      });
+      const double cold_ms = best_ms([&] {
+        std::vector<MipLevel> cold;
+        build(load_image(file), kind, filter, cold);
+      });
+      const double warm_ms = best_ms([&] {
+        MipCache warm;
+        warm.open(file, kind, filter);
+      });
+
+      const std::string name = file.substr(file.find_last_of('/') + 1);
+      std::cout << std::left << std::setw(32) << name << std::setw(8)
+                << FILTER_NAMES[f] << std::right << std::setw(11)
+                << (std::to_string(img.width()) + "x" +
+                    std::to_string(img.height()))
+                << std::setw(10) << old_ms << std::setw(10) << cold_ms
+                << std::setw(10) << warm_ms << std::setw(10)
+                << gpu_difference << '\n';
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
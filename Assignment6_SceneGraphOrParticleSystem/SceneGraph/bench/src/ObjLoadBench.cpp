@@ -0,0 +1,208 @@
+/**
+ * Times ObjLoader::parse_file on the bundled meshes (or the .obj files given
+ * on the command line) and reports throughput for each ParseMode.
+ * ParseMode::Parallel is timed at 1, 2, 4, ... threads up to the core count.
+ *
+ * usage: ObjLoadBench [--quads] [--synthetic <triangles>] [file.obj ...]
+ *
+ * --synthetic writes a grid mesh with about that many triangles (using
+ * relative indices) to a temporary file and benchmarks it too. With --quads
+ * (given first) the grid is written as quads, which the loader has to split.
+ */
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ObjLoader.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const int BENCH_RUNS = 10;
+
+// meshes with both uvs and normals
+const char* DEFAULT_MESHES[] = {
+    "capsule/capsule.obj",
+    "chapel/chapel_obj.obj",
+    "house/house_obj.obj",
+    "windmill/windmill.obj",
+};
+
+double file_megabytes(const std::string& filename)
+{
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) return 0;
+  return st.st_size / (1024.0 * 1024.0);
+}
+
+// best wall time of BENCH_RUNS parses, in milliseconds
+double time_parse(const std::string& filename, ObjLoader::ParseMode mode,
+                  ObjLoader& loader)
+{
+  double best = 1e300;
+
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (loader.parse_file(filename, mode) != EXIT_SUCCESS) {
+      std::cout << "Could not read file " << filename << std::endl;
+      exit(1);
+    }
+
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, ms.count());
+  }
+
+  return best;
+}
+
+bool same_buffers(const ObjLoader& a, const ObjLoader& b)
+{
+  return a.get_vertices() == b.get_vertices() && a.get_uvs() == b.get_uvs() &&
+         a.get_normals() == b.get_normals() &&
+         a.get_indices() == b.get_indices();
+}
+
+void report(const std::string& label, double ms, double mb)
+{
+  std::cout << "  " << std::left << std::setw(12) << label << std::right
+            << std::fixed << std::setprecision(2) << std::setw(9) << ms
+            << " ms " << std::setw(9) << mb / (ms / 1000.0) << " MB/s\n";
+}
+
+/**
+ * @brief Writes an n x n grid of quads (2 * n * n triangles) as an .obj
+ *
+ * Each row of vertices is followed by the faces joining it to the row
+ * before, all of them written with relative (negative) indices, either as
+ * two triangles or as one quad per grid cell.
+ */
+bool write_synthetic_obj(const std::string& filename, long triangles,
+                         bool quads)
+{
+  std::ofstream out(filename);
+  if (!out) return false;
+
+  const long n = std::max(1L, (long)std::sqrt(triangles / 2.0));
+  const long row = n + 1;  // vertices per row
+
+  out << "# synthetic grid, " << 2 * n * n << " triangles\n";
+
+  for (long r = 0; r <= n; r++) {
+    for (long c = 0; c <= n; c++) {
+      out << "v " << c << ' ' << r << " 0\n";
+      out << "vt " << (float)c / n << ' ' << (float)r / n << '\n';
+      out << "vn 0 0 1\n";
+    }
+
+    if (r == 0) continue;
+
+    for (long c = 0; c < n; c++) {
+      // relative index of (r - 1, c), (r - 1, c + 1), (r, c) and (r, c + 1)
+      const long a = -(2 * row - c);
+      const long b = a + 1;
+      const long d = -(row - c);
+      const long e = d + 1;
+
+      if (quads) {
+        out << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b
+            << '/' << b << ' ' << e << '/' << e << '/' << e << ' ' << d << '/'
+            << d << '/' << d << '\n';
+        continue;
+      }
+
+      out << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/'
+          << b << ' ' << e << '/' << e << '/' << e << '\n';
+      out << "f " << a << '/' << a << '/' << a << ' ' << e << '/' << e << '/'
+          << e << ' ' << d << '/' << d << '/' << d << '\n';
+    }
+  }
+
+  return static_cast<bool>(out);
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files;
+  std::string synthetic;
+  bool quads = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--quads") {
+      quads = true;
+    }
+    else if (arg == "--synthetic" && i + 1 < argc) {
+      synthetic = "/tmp/ObjLoadBench_synthetic.obj";
+      if (!write_synthetic_obj(synthetic, std::atol(argv[++i]), quads)) {
+        std::cout << "Could not write " << synthetic << std::endl;
+        return EXIT_FAILURE;
+      }
+      files.push_back(synthetic);
+    }
+    else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  bool ok = true;
+
+  for (const std::string& file : files) {
+    const double mb = file_megabytes(file);
+    std::cout << file << " (" << std::setprecision(2) << std::fixed << mb
+              << " MB)\n";
+
+    ObjLoader stream;
+    ObjLoader mapped;
+
+    report("stream", time_parse(file, ObjLoader::ParseMode::Stream, stream),
+           mb);
+    report("mapped", time_parse(file, ObjLoader::ParseMode::Mapped, mapped),
+           mb);
+
+    if (!same_buffers(stream, mapped)) {
+      std::cout << "  MISMATCH between stream and mapped buffers\n";
+      ok = false;
+    }
+
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+      ObjLoader parallel;
+      parallel.set_parse_threads(threads);
+
+      report("parallel x" + std::to_string(threads),
+             time_parse(file, ObjLoader::ParseMode::Parallel, parallel), mb);
+
+      if (!same_buffers(mapped, parallel)) {
+        std::cout << "  MISMATCH between mapped and parallel buffers\n";
+        ok = false;
+      }
+
+      if (threads == cores) break;
+    }
+  }
+
+  if (!synthetic.empty()) {
+    std::remove(synthetic.c_str());
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,33 @@
+/**
+ * @brief Peak RSS helpers for the benchmarks (Linux /proc only)
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// reads a "Name:   1234 kB" line of /proc/self/status, in KB
+inline long proc_status_kb(const std::string& name)
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+
+  while (std::getline(status, line)) {
+    if (line.compare(0, name.size() + 1, name + ":") == 0) {
+      return std::atol(line.c_str() + name.size() + 1);
+    }
+  }
+
+  return 0;
+}
+
+// restarts the peak RSS (VmHWM) count from the current RSS
+inline bool reset_peak_rss()
+{
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+  clear_refs.close();
+  return static_cast<bool>(clear_refs);
+}
@@ -0,0 +1,508 @@
+/**
+ * Times getting a scene of textured spheres up: with every texture decoded
+ * on the GL thread during init (the old way), against decoding them on a
+ * TextureLoader and uploading them a frame at a time. Reports how long
+ * until the first frame can be drawn (init returns) and until every texture
+ * is on the GPU (after a glFinish), plus the frames the uploads took.
+ *
+ * The spheres cycle through the bundled planet and model textures, each
+ * loading its own copy, and then again sharing them through a TextureCache
+ * (like the app). Runs cold (no .herbmip caches to begin with, so the first
+ * load of each image decodes it and builds its mip chain) and warm (with the
+ * caches the cold run wrote).
+ *
+ * Then loads a scene of rocks (all the same image) through a TextureCache
+ * and reports its hit rate and the GPU memory sharing saved; it fails unless
+ * the whole scene draws with one placeholder per color while loading, and
+ * ends up with three GL textures in all: the rock, the normal map and the
+ * white 1x1 for the missing specular map.
+ *
+ * Last, destroys a scene of spheres while their textures are still
+ * decoding (cold, on one worker). Their placeholders have to be gone from
+ * GL right then, the decodes have to finish with nothing but their futures
+ * holding what they made, and a scene made afterwards on the same loader
+ * has to get every texture up as a live texture of the GL thread's context.
+ *
+ * And two spheres of one image through a TextureCache have to draw with
+ * the same GL textures (1x1 ones included), which have to outlive the first sphere and go, from
+ * GL and from the cache, with the second (on the GL thread).
+ *
+ * Needs no display with the offscreen platform (the default here) and
+ * Mesa's software GL, e.g.:
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./bench/StartupBench
+ *
+ * usage: StartupBench [--spheres <n>] [--rocks <n>] [--threads <n>]
+ *                     [--budget <KB>]
+ */
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MipPyramid.h"
+#include "Sphere.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"    // CMAKE: OBJECTS_DIR
+#define TEXTURES_DIR "@TEXTURES_DIR@"  // CMAKE: TEXTURES_DIR
+#define DEFAULT_NORMAL_MAP "@DEFAULT_NORMAL_MAP@"  // CMake var
+
+const int DEFAULT_SPHERES = 24;
+const int DEFAULT_ROCKS = 1000;
+
+// stands in for the rest of a frame, between one upload step and the next
+const std::chrono::milliseconds FRAME_TIME(1);
+
+// where rock.ppm is in PLANET_TEXTURES
+const size_t ROCK_TEXTURE = 3;
+
+const char* PLANET_TEXTURES[] = {
+    "sun.ppm",
+    "mercury.ppm",
+    "planet.ppm",
+    "rock.ppm",
+};
+
+const char* MODEL_TEXTURES[] = {
+    "bumpySphere/bumpySphere_diffuse.ppm",
+    "chapel/chapel_diffuse.ppm",
+    "house/house_diffuse.ppm",
+    "windmill/windmill_diffuse.ppm",
+};
+
+// a Sphere that shows what it's waiting on and what it draws with
+class ProbeSphere : public Sphere {
+public:
+  explicit ProbeSphere(const std::string& texture) : Sphere(texture) {}
+
+  std::vector<TextureLoader::Future> decodes() const
+  {
+    std::vector<TextureLoader::Future> futures;
+    for (const PendingTexture& pending : m_pending) {
+      futures.push_back(pending.decoded);
+    }
+    return futures;
+  }
+
+  // what's drawn while they decode
+  std::vector<GLuint> placeholderIds() const
+  {
+    std::vector<GLuint> ids;
+    for (const PendingTexture& pending : m_pending) {
+      ids.push_back(m_textures[pending.slot]->textureId());
+    }
+    return ids;
+  }
+
+  std::vector<std::weak_ptr<QOpenGLTexture>> textures() const
+  {
+    return std::vector<std::weak_ptr<QOpenGLTexture>>(m_textures.begin(),
+                                                      m_textures.end());
+  }
+
+  std::vector<GLuint> textureIds() const
+  {
+    std::vector<GLuint> ids;
+    for (const TextureCache::Texture& texture : m_textures) {
+      ids.push_back(texture->textureId());
+    }
+    return ids;
+  }
+};
+
+struct StartupStats {
+  double first_frame_ms;  // until init returned for every sphere
+  double textured_ms;     // until every texture was on the GPU
+  int frames;             // frames the uploads were spread over
+  size_t loading_textures;  // GL textures the scene drew with after init
+  size_t textures;          // ... and once every texture was up
+  TextureCache::Stats cache;
+};
+
+// how many GL textures the spheres draw with between them
+size_t scene_textures(const std::vector<std::unique_ptr<ProbeSphere>>& scene)
+{
+  std::vector<GLuint> ids;
+  for (const std::unique_ptr<ProbeSphere>& sphere : scene) {
+    for (GLuint id : sphere->textureIds()) {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  return std::unique(ids.begin(), ids.end()) - ids.begin();
+}
+
+// drops the .herbmip caches, so the next load decodes everything again
+void remove_caches(const std::vector<std::string>& textures)
+{
+  for (const std::string& texture : textures) {
+    MipCache::remove(texture);
+  }
+}
+
+StartupStats start_scene(QOpenGLContext& context,
+                         const std::vector<std::string>& textures, int spheres,
+                         TextureLoader* loader, TextureCache* cache,
+                         size_t budget)
+{
+  typedef std::chrono::steady_clock Clock;
+  std::vector<std::unique_ptr<ProbeSphere>> scene;
+
+  StartupStats stats = {0, 0, 0, 0, 0, TextureCache::Stats()};
+  const Clock::time_point start = Clock::now();
+
+  for (int i = 0; i < spheres; i++) {
+    scene.emplace_back(new ProbeSphere(textures[i % textures.size()]));
+    scene.back()->setTextureLoader(loader);
+    scene.back()->setTextureCache(cache);
+    scene.back()->init();
+  }
+  context.functions()->glFinish();
+  stats.first_frame_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  stats.loading_textures = scene_textures(scene);
+
+  // what draw() does at the start of each frame, until nothing's pending
+  bool pending = loader != nullptr;
+  while (pending) {
+    loader->begin_frame(budget);
+    pending = false;
+    for (const std::unique_ptr<ProbeSphere>& sphere : scene) {
+      sphere->uploadTextures();
+      pending = pending || sphere->texturesPending();
+    }
+    stats.frames++;
+
+    if (pending) {
+      std::this_thread::sleep_for(FRAME_TIME);
+    }
+  }
+  context.functions()->glFinish();
+  stats.textured_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  stats.textures = scene_textures(scene);
+
+  if (cache) {
+    stats.cache = cache->stats();
+  }
+  return stats;
+}
+
+// true if the spheres, destroyed with their textures still decoding, leave
+// nothing behind, and the loader still serves the spheres after them
+bool check_abandoned(QOpenGLContext& context,
+                     const std::vector<std::string>& textures,
+                     const std::vector<std::string>& cached)
+{
+  QOpenGLFunctions* gl = context.functions();
+  TextureLoader loader(1);
+  remove_caches(cached);
+
+  std::vector<TextureLoader::Future> decodes;
+  std::vector<GLuint> placeholders;
+  size_t unfinished = 0;
+  {
+    std::vector<std::unique_ptr<ProbeSphere>> scene;
+    for (const std::string& texture : textures) {
+      scene.emplace_back(new ProbeSphere(texture));
+      scene.back()->setTextureLoader(&loader);
+      scene.back()->init();
+
+      for (const TextureLoader::Future& decode : scene.back()->decodes()) {
+        decodes.push_back(decode);
+      }
+      for (GLuint id : scene.back()->placeholderIds()) {
+        placeholders.push_back(id);
+      }
+    }
+
+    for (const TextureLoader::Future& decode : decodes) {
+      if (decode.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        unfinished++;
+      }
+    }
+  }  // gone, on this (the GL) thread
+
+  size_t live_placeholders = 0;
+  for (GLuint id : placeholders) {
+    if (gl->glIsTexture(id)) {
+      live_placeholders++;
+    }
+  }
+
+  // the futures were all the spheres gave the loader, and now only these
+  // copies hold what it decoded for them
+  size_t still_held = 0;
+  for (const TextureLoader::Future& decode : decodes) {
+    if (decode.get().use_count() > 1) {
+      still_held++;
+    }
+  }
+
+  std::vector<std::unique_ptr<ProbeSphere>> scene;
+  for (const std::string& texture : textures) {
+    scene.emplace_back(new ProbeSphere(texture));
+    scene.back()->setTextureLoader(&loader);
+    scene.back()->init();
+  }
+  bool pending = true;
+  while (pending) {
+    loader.begin_frame();
+    pending = false;
+    for (const std::unique_ptr<ProbeSphere>& sphere : scene) {
+      sphere->uploadTextures();
+      pending = pending || sphere->texturesPending();
+    }
+  }
+
+  size_t uploaded = 0;
+  size_t dead = 0;
+  for (const std::unique_ptr<ProbeSphere>& sphere : scene) {
+    for (GLuint id : sphere->textureIds()) {
+      uploaded++;
+      if (id == 0 || !gl->glIsTexture(id)) {
+        dead++;
+      }
+    }
+  }
+
+  std::cout << textures.size() << " spheres destroyed with " << unfinished
+            << " of " << decodes.size()
+            << " textures still decoding: " << live_placeholders
+            << " placeholders left, " << still_held
+            << " decodes held past them; " << uploaded
+            << " textures up afterwards, " << dead << " not live on GL\n";
+  decodes.clear();
+
+  bool ok = true;
+  if (unfinished == 0) {
+    std::cout << "FAIL: every texture decoded before the spheres went\n";
+    ok = false;
+  }
+  if (live_placeholders > 0 || still_held > 0) {
+    std::cout << "FAIL: the spheres left something behind\n";
+    ok = false;
+  }
+  if (dead > 0) {
+    std::cout << "FAIL: a texture didn't make it onto the GL context\n";
+    ok = false;
+  }
+  return ok;
+}
+
+// how many of ids are live textures
+size_t live_textures(QOpenGLContext& context, const std::vector<GLuint>& ids)
+{
+  size_t live = 0;
+  for (GLuint id : ids) {
+    if (context.functions()->glIsTexture(id)) {
+      live++;
+    }
+  }
+  return live;
+}
+
+// true if two spheres of one image share its textures through a cache until
+// the second lets go of them, and no longer
+bool check_shared(QOpenGLContext& context, const std::string& texture)
+{
+  TextureCache cache;
+  std::unique_ptr<ProbeSphere> first(new ProbeSphere(texture));
+  std::unique_ptr<ProbeSphere> second(new ProbeSphere(texture));
+  for (ProbeSphere* sphere : {first.get(), second.get()}) {
+    sphere->setTextureCache(&cache);
+    sphere->init();
+  }
+
+  // what both draw with: the image, the normal map and the 1x1 for the
+  // missing specular map
+  std::vector<GLuint> ids;
+  const std::vector<GLuint> others = second->textureIds();
+  for (GLuint id : first->textureIds()) {
+    if (std::find(others.begin(), others.end(), id) != others.end()) {
+      ids.push_back(id);
+    }
+  }
+  const size_t unshared = first->textureIds().size() - ids.size();
+  const std::vector<std::weak_ptr<QOpenGLTexture>> textures =
+      first->textures();
+  const size_t cached = cache.stats().textures;
+
+  first.reset();
+  const size_t after_first = live_textures(context, ids);
+  const size_t cached_after_first = cache.stats().textures;
+
+  second.reset();
+  const size_t after_second = live_textures(context, ids);
+  size_t held = 0;
+  for (const std::weak_ptr<QOpenGLTexture>& weak : textures) {
+    if (!weak.expired()) {
+      held++;
+    }
+  }
+
+  std::cout << "2 spheres of one image: " << ids.size()
+            << " textures shared (" << cached << " cached), " << after_first
+            << " live after the first went (" << cached_after_first
+            << " cached), " << after_second << " after the second ("
+            << cache.stats().textures << " cached, " << held << " held)\n";
+
+  if (unshared != 0 || ids.size() != 3 || cached != 3 || after_first != 3 ||
+      cached_after_first != 3) {
+    std::cout << "FAIL: the spheres didn't share their textures to the end\n";
+    return false;
+  }
+  if (after_second != 0 || cache.stats().textures != 0 || held != 0) {
+    std::cout << "FAIL: the shared textures outlived the spheres\n";
+    return false;
+  }
+  return true;
+}
+
+void report(const char* label, const StartupStats& stats)
+{
+  std::cout << "  " << std::left << std::setw(16) << label << std::right
+            << std::fixed << std::setprecision(1) << std::setw(10)
+            << stats.first_frame_ms << std::setw(12) << stats.textured_ms
+            << std::setw(8) << stats.frames << '\n';
+}
+
+int main(int argc, char** argv)
+{
+  int spheres = DEFAULT_SPHERES;
+  int rocks = DEFAULT_ROCKS;
+  unsigned threads = 0;
+  size_t budget = TextureLoader::DEFAULT_UPLOAD_BUDGET;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (arg == "--spheres") {
+      spheres = std::max(1, std::atoi(argv[i + 1]));
+    }
+    else if (arg == "--rocks") {
+      rocks = std::max(1, std::atoi(argv[i + 1]));
+    }
+    else if (arg == "--threads") {
+      threads = static_cast<unsigned>(std::max(0, std::atoi(argv[i + 1])));
+    }
+    else if (arg == "--budget") {
+      budget =
+          static_cast<size_t>(std::max(1, std::atoi(argv[i + 1]))) * 1024;
+    }
+  }
+
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QGuiApplication app(argc, argv);
+
+  QSurfaceFormat fmt;
+  fmt.setVersion(3, 3);
+  fmt.setProfile(QSurfaceFormat::CoreProfile);
+
+  QOpenGLContext context;
+  context.setFormat(fmt);
+  QOffscreenSurface surface;
+  surface.setFormat(fmt);
+  surface.create();
+
+  if (!context.create() || !context.makeCurrent(&surface)) {
+    std::cout << "could not make a GL context" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> textures;
+  for (const char* texture : PLANET_TEXTURES) {
+    textures.push_back(std::string(TEXTURES_DIR) + "/" + texture);
+  }
+  for (const char* texture : MODEL_TEXTURES) {
+    textures.push_back(std::string(OBJECTS_DIR) + "/" + texture);
+  }
+
+  std::vector<std::string> cached = textures;
+  cached.push_back(DEFAULT_NORMAL_MAP);
+
+  std::cout << spheres << " spheres, " << textures.size()
+            << " textures, upload budget " << budget / 1024 << " KB/frame\n"
+            << "  " << std::left << std::setw(16) << "" << std::right
+            << std::setw(10) << "first ms" << std::setw(12) << "textured ms"
+            << std::setw(8) << "frames" << '\n';
+
+  for (bool cold : {true, false}) {
+    std::cout << (cold ? "cold" : "warm") << '\n';
+
+    if (cold) {
+      remove_caches(cached);
+    }
+    report("on GL thread",
+           start_scene(context, textures, spheres, nullptr, nullptr, budget));
+
+    if (cold) {
+      remove_caches(cached);
+    }
+    TextureLoader loader(threads);
+    report("TextureLoader",
+           start_scene(context, textures, spheres, &loader, nullptr, budget));
+
+    if (cold) {
+      remove_caches(cached);
+    }
+    TextureCache cache;
+    report("+ TextureCache",
+           start_scene(context, textures, spheres, &loader, &cache, budget));
+  }
+
+  // every rock shares one texture, the normal map another and the 1x1 for
+  // the missing specular map a third (and while they load, one placeholder
+  // per color: white, which is the missing specular's too, and flat normal)
+  TextureLoader loader(threads);
+  TextureCache cache;
+  const StartupStats stats =
+      start_scene(context, {textures[ROCK_TEXTURE]}, rocks, &loader, &cache,
+                  budget);
+
+  const double hit_rate =
+      100.0 * stats.cache.hits / std::max<size_t>(1, stats.cache.requests);
+
+  std::cout << rocks << " rocks\n";
+  report("+ TextureCache", stats);
+  std::cout << "  " << stats.cache.hits << " of " << stats.cache.requests
+            << " lookups hit (" << std::setprecision(1) << hit_rate << "%), "
+            << stats.cache.textures << " textures, "
+            << stats.cache.bytes / 1024 << " KB on the GPU, "
+            << stats.cache.bytes_saved / (1024 * 1024) << " MB saved; "
+            << stats.loading_textures << " GL textures while loading, "
+            << stats.textures << " after\n";
+
+  bool ok = true;
+  if (stats.loading_textures != 2 || stats.textures != 3 ||
+      stats.cache.textures != 3) {
+    std::cout << "FAIL: the rocks should draw with 2 textures while loading"
+                 " and share 3 after\n";
+    ok = false;
+  }
+
+  if (!check_abandoned(context, textures, cached)) {
+    ok = false;
+  }
+  if (!check_shared(context, textures[ROCK_TEXTURE])) {
+    ok = false;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
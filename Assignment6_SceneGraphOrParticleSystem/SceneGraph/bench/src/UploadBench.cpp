@@ -0,0 +1,583 @@
+/**
+ * Compares getting a mesh onto the GPU the old way (parse everything, copy
+ * it out of the loader, compute tangents, interleave, then upload) against
+ * streaming it with ObjStreamer, on the bundled meshes or the .obj files
+ * given on the command line. Reports the time until the buffers are filled
+ * (after a glFinish) and the peak RSS each way added, and reads the streamed
+ * buffers back to check they match MeshCache::bake (packed the way
+ * Renderable uploads it), whichever index width they ended up with. Does
+ * the same for a warm load from the .herbmesh cache (of a copy of the mesh
+ * in a scratch directory), whose vertices go up straight from the mapped
+ * file.
+ *
+ * Then runs every streamed vertex through vert.glsl, capturing what it hands
+ * on with transform feedback: the uvs and tangent frame have to agree with
+ * Util::UnpackVertex (to within MAX_UNPACK_DIFFERENCE) and with the bake's
+ * floats as closely as VertexFormatBench allows, with no bitangent on the
+ * wrong side.
+ *
+ * Every run is a forked child with its own Qt app and GL context. Needs no
+ * display with the offscreen platform (the default here) and Mesa's
+ * software GL, e.g.:
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./bench/UploadBench
+ *
+ * usage: UploadBench [--batch <triangles>] [file.obj ...]
+ */
+
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "ObjStreamer.h"
+#include "PeakRss.h"
+#include "Renderable.h"
+#include "Util.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const char* DEFAULT_MESHES[] = {
+    "bunny.obj",
+    "capsule/capsule.obj",
+    "chapel/chapel_obj.obj",
+};
+
+// worst errors allowed in what vert.glsl makes of the vertices, against the
+// bake's floats (the same bounds as VertexFormatBench) and against
+// Util::UnpackVertex, which it should agree with but for float rounding
+const double MAX_NORMAL_ERROR_DEG = 0.01;
+const double MAX_TANGENT_ERROR_DEG = 0.02;
+const double MAX_UV_RELATIVE_ERROR = 1.0 / 2048;
+const double MAX_UV_ABSOLUTE_ERROR = 1.0 / (1 << 25);
+const double MAX_UNPACK_DIFFERENCE = 1e-5;
+
+const double RAD_TO_DEG = 180.0 / 3.14159265358979323846;
+
+// what vert.glsl hands on per vertex: texCoords, fragPos, TBN
+const int CAPTURED_FLOATS = 2 + 3 + 9;
+
+enum class UploadPath { Baked, Streamed, Cached };
+
+// worst differences between vert.glsl's outputs and what they should be
+struct ShaderErrors {
+  double uv;  // as a share of what MAX_UV_*_ERROR allows
+  double normal_deg;
+  double tangent_deg;
+  int flipped;    // bitangents on the wrong side
+  double unpack;  // largest difference from Util::UnpackVertex
+};
+
+// what a child process reports back
+struct UploadStats {
+  double ready_ms;   // until the buffers were filled on the GPU
+  long peak_rss_kb;  // peak RSS above what the child started with
+  int batches;
+  int index_bits;  // how wide the indices ended up
+  bool match;  // streamed buffers read back the same as MeshCache::bake
+  bool shaded;  // vert.glsl's outputs were captured into shader
+  ShaderErrors shader;
+};
+
+// angle between a direction and a unit vector, or 0 if the direction is
+// zero or not a number (as VertexFormatBench measures it)
+double angle_deg(const QVector3D& original, const QVector3D& decoded)
+{
+  const double a[3] = {original.x(), original.y(), original.z()};
+  const double b[3] = {decoded.x(), decoded.y(), decoded.z()};
+
+  const double cross[3] = {a[1] * b[2] - a[2] * b[1],
+                           a[2] * b[0] - a[0] * b[2],
+                           a[0] * b[1] - a[1] * b[0]};
+  const double sin = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] +
+                               cross[2] * cross[2]);
+  const double cos = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+
+  if (!(sin > 0 || cos > 0)) {
+    return 0;
+  }
+  return std::atan2(sin, cos) * RAD_TO_DEG;
+}
+
+double largest_difference(const QVector3D& a, const QVector3D& b)
+{
+  return std::max(std::max(std::fabs(a.x() - b.x()), std::fabs(a.y() - b.y())),
+                  std::fabs(a.z() - b.z()));
+}
+
+// Renderable with both ways in and a way to look at its buffers
+class ProbeMesh : public Renderable {
+public:
+  // what ObjMesh used to do: four copies out of the loader, tangents, one
+  // interleaved copy, upload
+  void initBaked(const std::string& filename)
+  {
+    ObjLoader obj;
+    if (obj.parse_file(filename) != EXIT_SUCCESS) {
+      std::cout << "Could not read file " << filename << std::endl;
+      exit(1);
+    }
+
+    QVector<QVector3D> positions = obj.get_vertices();
+    QVector<QVector3D> normals = obj.get_normals();
+    QVector<QVector2D> texCoords = obj.get_uvs();
+    QVector<unsigned int> indices = obj.get_indices();
+
+    QVector<QVector3D> tangents;
+    QVector<QVector3D> bitangents;
+    Util::CalculateTangents(positions, normals, texCoords, indices, tangents,
+                            bitangents);
+
+    std::vector<float> data;
+    Util::InterleaveVertices(positions, normals, texCoords, tangents,
+                             bitangents, indices, data);
+
+    std::vector<Util::CompactVertex> packed(positions.size());
+    Util::PackVertices(data.data(), positions.size(), packed.data());
+
+    m_numTris = indices.size() / 3;
+    m_numVerts = positions.size();
+    initBuffers(packed.data(), positions.size(), indices.constData(),
+                indices.size());
+
+    m_vao.bind();
+    m_vbo.bind();
+    setAttributes();
+    m_vao.release();
+    m_vbo.release();
+  }
+
+  // returns the number of batches
+  int initStreamed(const std::string& filename, int batchTriangles)
+  {
+    ObjStreamer stream(batchTriangles);
+    int batches = 0;
+
+    if (stream.start(filename) != EXIT_SUCCESS ||
+        Renderable::init(stream, [&](const MeshBatch&) { batches++; }) !=
+            EXIT_SUCCESS) {
+      std::cout << "Could not read file " << filename << std::endl;
+      exit(1);
+    }
+
+    m_numVerts = stream.num_vertices();
+    return batches;
+  }
+
+  // what ObjMesh does with a good .herbmesh
+  void initCached(const std::string& filename)
+  {
+    MeshCache cache;
+    if (cache.open(filename) != EXIT_SUCCESS) {
+      std::cout << "Could not open " << MeshCache::cache_path(filename)
+                << std::endl;
+      exit(1);
+    }
+
+    initGeometry(cache.vertices(), cache.num_vertices(), cache.indices(),
+                 cache.num_indices());
+    m_numVerts = cache.num_vertices();
+  }
+
+  int indexBits() const { return indexSize() * 8; }
+
+  // Reads the buffers back into vertices, and true if they hold exactly
+  // what MeshCache::bake made of the file (baked)
+  bool matchesBake(const BakedMesh& baked,
+                   std::vector<Util::CompactVertex>& vertices)
+  {
+    if (static_cast<int>(baked.vertices.size()) !=
+            m_numVerts * Util::VERTEX_FLOATS ||
+        baked.indices.size() != m_numTris * 3) {
+      return false;
+    }
+
+    std::vector<Util::CompactVertex> expected(m_numVerts);
+    Util::PackVertices(baked.vertices.data(), m_numVerts, expected.data());
+
+    vertices.resize(m_numVerts);
+    std::vector<char> indices(baked.indices.size() * indexSize());
+
+    m_vao.bind();
+    m_vbo.bind();
+    m_ibo.bind();
+    bool ok = m_vbo.read(0, vertices.data(),
+                         vertices.size() * sizeof(Util::CompactVertex)) &&
+              m_ibo.read(0, indices.data(), indices.size());
+    m_vao.release();
+    m_vbo.release();
+    m_ibo.release();
+
+    // the indices back at full width
+    std::vector<unsigned int> wide(baked.indices.size());
+    for (size_t i = 0; i < wide.size(); i++) {
+      if (m_indexType == GL_UNSIGNED_SHORT) {
+        unsigned short index;
+        memcpy(&index, indices.data() + i * sizeof(index), sizeof(index));
+        wide[i] = index;
+      }
+      else {
+        memcpy(&wide[i], indices.data() + i * sizeof(wide[i]),
+               sizeof(wide[i]));
+      }
+    }
+
+    return ok &&
+           memcmp(vertices.data(), expected.data(),
+                  vertices.size() * sizeof(Util::CompactVertex)) == 0 &&
+           wide == baked.indices;
+  }
+
+  // Runs every vertex through the shaders with transform feedback (and
+  // identity matrices), and measures what vert.glsl hands on against the
+  // bake and against Util::UnpackVertex of the vbo (read back in vertices).
+  // False if it couldn't capture them.
+  bool checkShader(const BakedMesh& baked,
+                   const std::vector<Util::CompactVertex>& vertices,
+                   ShaderErrors& errors)
+  {
+    QOpenGLExtraFunctions* gl =
+        QOpenGLContext::currentContext()->extraFunctions();
+
+    // (only a relink picks the varyings up)
+    const char* varyings[] = {"texCoords", "fragPos", "TBN"};
+    gl->glTransformFeedbackVaryings(m_shader.programId(), 3, varyings,
+                                    GL_INTERLEAVED_ATTRIBS);
+    if (!m_shader.link()) {
+      qDebug() << m_shader.log();
+      return false;
+    }
+
+    const QMatrix4x4 identity;
+    m_shader.bind();
+    m_shader.setUniformValue("modelMatrix", identity);
+    m_shader.setUniformValue("viewMatrix", identity);
+    m_shader.setUniformValue("projectionMatrix", identity);
+
+    const GLsizeiptr bytes =
+        static_cast<GLsizeiptr>(m_numVerts) * CAPTURED_FLOATS * sizeof(float);
+    GLuint captureBuffer;
+    gl->glGenBuffers(1, &captureBuffer);
+    gl->glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, captureBuffer);
+    gl->glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, bytes, nullptr,
+                     GL_STATIC_READ);
+    gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, captureBuffer);
+
+    gl->glEnable(GL_RASTERIZER_DISCARD);
+    m_vao.bind();
+    gl->glBeginTransformFeedback(GL_POINTS);
+    gl->glDrawArrays(GL_POINTS, 0, m_numVerts);
+    gl->glEndTransformFeedback();
+    m_vao.release();
+    gl->glDisable(GL_RASTERIZER_DISCARD);
+    m_shader.release();
+
+    std::vector<float> captured;
+    const void* mapped = gl->glMapBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+                                              bytes, GL_MAP_READ_BIT);
+    if (mapped) {
+      const float* begin = static_cast<const float*>(mapped);
+      captured.assign(begin, begin + bytes / sizeof(float));
+      gl->glUnmapBuffer(GL_TRANSFORM_FEEDBACK_BUFFER);
+    }
+    gl->glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    gl->glDeleteBuffers(1, &captureBuffer);
+
+    if (!mapped) {
+      return false;
+    }
+
+    errors = ShaderErrors();
+    for (int i = 0; i < m_numVerts; i++) {
+      const float* v = baked.vertices.data() + static_cast<size_t>(i) *
+                                                   Util::VERTEX_FLOATS;
+      const QVector3D normal(v[3], v[4], v[5]);
+      const QVector2D uv(v[6], v[7]);
+      const QVector3D tangent(v[8], v[9], v[10]);
+      const QVector3D bitangent(v[11], v[12], v[13]);
+
+      const float* out =
+          captured.data() + static_cast<size_t>(i) * CAPTURED_FLOATS;
+      const QVector2D u(out[0], out[1]);
+      const QVector3D p(out[2], out[3], out[4]);
+      const QVector3D t(out[5], out[6], out[7]);
+      const QVector3D b(out[8], out[9], out[10]);
+      const QVector3D n(out[11], out[12], out[13]);
+
+      // the shader against the CPU's unpacking of the same vertex (whose
+      // bitangent the shader normalizes)
+      QVector3D position, unpackedN, unpackedT, unpackedB;
+      QVector2D texCoord;
+      Util::UnpackVertex(vertices[i], position, unpackedN, texCoord,
+                         unpackedT, unpackedB);
+
+      errors.unpack = std::max(
+          {errors.unpack, largest_difference(p, position),
+           std::fabs(double(u.x()) - texCoord.x()),
+           std::fabs(double(u.y()) - texCoord.y()),
+           largest_difference(n, unpackedN), largest_difference(t, unpackedT),
+           largest_difference(b, unpackedB.normalized())});
+
+      // and against the bake, as VertexFormatBench measures the format
+      for (int c = 0; c < 2; c++) {
+        const double allowed =
+            std::max(MAX_UV_RELATIVE_ERROR * std::fabs(uv[c]),
+                     MAX_UV_ABSOLUTE_ERROR);
+        errors.uv = std::max(errors.uv, std::fabs(u[c] - uv[c]) / allowed);
+      }
+
+      errors.normal_deg = std::max(errors.normal_deg, angle_deg(normal, n));
+      errors.tangent_deg =
+          std::max(errors.tangent_deg, angle_deg(tangent, t));
+
+      const float side = QVector3D::dotProduct(
+          QVector3D::crossProduct(normal, tangent), bitangent);
+      if (std::fabs(side) > 1e-6f &&
+          QVector3D::dotProduct(b, bitangent) <= 0) {
+        errors.flipped++;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  int m_numVerts = 0;
+};
+
+// loads the mesh one way in a fresh GL context, in a child process
+bool measure(const std::string& filename, UploadPath path, int batchTriangles,
+             UploadStats& stats)
+{
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+
+  pid_t pid = fork();
+  if (pid < 0) return false;
+
+  if (pid == 0) {  // child
+    close(fds[0]);
+
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    int argc = 1;
+    char arg0[] = "UploadBench";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    QSurfaceFormat fmt;
+    fmt.setVersion(3, 3);
+    fmt.setProfile(QSurfaceFormat::CoreProfile);
+
+    QOpenGLContext context;
+    context.setFormat(fmt);
+    QOffscreenSurface surface;
+    surface.setFormat(fmt);
+    surface.create();
+
+    if (!context.create() || !context.makeCurrent(&surface)) {
+      std::cout << "  could not make a GL context" << std::endl;
+      _exit(1);
+    }
+
+    // the cache goes with a copy of the mesh, so the real one's is left be
+    std::string source = filename;
+    char dir[] = "/tmp/UploadBench.XXXXXX";
+    if (path == UploadPath::Cached) {
+      std::error_code ec;
+      BakedMesh baked;
+      if (!mkdtemp(dir)) {
+        std::cout << "  could not make a scratch directory" << std::endl;
+        _exit(1);
+      }
+      source = std::string(dir) + "/mesh.obj";
+      if (!std::filesystem::copy_file(filename, source, ec) ||
+          MeshCache::bake(source, baked) != EXIT_SUCCESS ||
+          MeshCache::write(source, baked) != EXIT_SUCCESS) {
+        std::cout << "  could not cache a copy of " << filename << std::endl;
+        _exit(1);
+      }
+    }
+
+    // hand free heap pages back so the load has to fault in its own, and
+    // forget the peak so far
+    malloc_trim(0);
+    reset_peak_rss();
+    const long baseline = proc_status_kb("VmRSS");
+
+    UploadStats result = UploadStats();
+    ProbeMesh mesh;
+
+    auto start = std::chrono::steady_clock::now();
+    if (path == UploadPath::Baked) {
+      mesh.initBaked(filename);
+    }
+    else if (path == UploadPath::Cached) {
+      mesh.initCached(source);
+    }
+    else {
+      result.batches = mesh.initStreamed(filename, batchTriangles);
+    }
+    context.functions()->glFinish();
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+
+    result.ready_ms = ms.count();
+    result.peak_rss_kb = proc_status_kb("VmHWM") - baseline;
+
+    if (path == UploadPath::Cached) {
+      BakedMesh baked;
+      std::vector<Util::CompactVertex> vertices;
+      result.match = MeshCache::bake(source, baked) == EXIT_SUCCESS &&
+                     mesh.matchesBake(baked, vertices);
+
+      std::remove(MeshCache::cache_path(source).c_str());
+      std::remove(source.c_str());
+      rmdir(dir);
+    }
+
+    if (path == UploadPath::Streamed) {
+      result.index_bits = mesh.indexBits();
+
+      BakedMesh baked;
+      std::vector<Util::CompactVertex> vertices;
+      result.match = MeshCache::bake(filename, baked) == EXIT_SUCCESS &&
+                     mesh.matchesBake(baked, vertices);
+      result.shaded =
+          result.match && mesh.checkShader(baked, vertices, result.shader);
+    }
+
+    bool ok = write(fds[1], &result, sizeof(result)) == sizeof(result);
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  bool ok = read(fds[0], &stats, sizeof(stats)) == sizeof(stats);
+  close(fds[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void report(const char* label, const UploadStats& stats)
+{
+  std::cout << "  " << std::left << std::setw(9) << label << std::right
+            << std::fixed << std::setprecision(2) << std::setw(9)
+            << stats.ready_ms << " ms " << std::setw(8) << stats.peak_rss_kb
+            << " KB peak RSS";
+  if (stats.batches > 0) {
+    std::cout << "  (" << stats.batches << " batches, " << stats.index_bits
+              << " bit indices)";
+  }
+  std::cout << '\n';
+}
+
+// true if vert.glsl made what it should of every vertex
+bool report(const ShaderErrors& errors)
+{
+  std::cout << std::defaultfloat << std::setprecision(3)
+            << "  vert.glsl: worst uv error "
+            << errors.uv << " of the half float bound, normal "
+            << errors.normal_deg << " deg, tangent " << errors.tangent_deg
+            << " deg, " << errors.flipped
+            << " bitangents flipped; off Util::UnpackVertex by at most "
+            << errors.unpack << '\n';
+
+  bool ok = true;
+  if (errors.uv > 1 || errors.normal_deg > MAX_NORMAL_ERROR_DEG ||
+      errors.tangent_deg > MAX_TANGENT_ERROR_DEG) {
+    std::cout << "  vert.glsl's uv/normal/tangent error past its bound\n";
+    ok = false;
+  }
+  if (errors.flipped > 0) {
+    std::cout << "  vert.glsl put a bitangent on the wrong side\n";
+    ok = false;
+  }
+  if (!(errors.unpack <= MAX_UNPACK_DIFFERENCE)) {
+    std::cout << "  vert.glsl disagrees with Util::UnpackVertex\n";
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files;
+  int batchTriangles = ObjStreamer::DEFAULT_BATCH_TRIANGLES;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--batch" && i + 1 < argc) {
+      batchTriangles = std::max(1, std::atoi(argv[++i]));
+    }
+    else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  bool ok = true;
+
+  for (const std::string& file : files) {
+    std::cout << file << '\n';
+
+    UploadStats baked;
+    UploadStats streamed;
+    UploadStats cached;
+    if (!measure(file, UploadPath::Baked, batchTriangles, baked) ||
+        !measure(file, UploadPath::Streamed, batchTriangles, streamed) ||
+        !measure(file, UploadPath::Cached, batchTriangles, cached)) {
+      std::cout << "  could not run the benchmark child" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    report("baked", baked);
+    report("streamed", streamed);
+    report("cached", cached);
+
+    if (!cached.match) {
+      std::cout << "  MISMATCH between cached buffers and MeshCache::bake\n";
+      ok = false;
+    }
+
+    if (!streamed.match) {
+      std::cout << "  MISMATCH between streamed buffers and MeshCache::bake\n";
+      ok = false;
+    }
+    else if (!streamed.shaded) {
+      std::cout << "  could not capture vert.glsl's outputs\n";
+      ok = false;
+    }
+    else if (!report(streamed.shader)) {
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+/**
+ * Runs optimize_mesh on the bundled meshes (or the .obj files given on the
+ * command line) and reports the ACMR and ATVR of a simulated FIFO
+ * post-transform cache before and after, at a few cache sizes, along with
+ * how long the optimizing took. No GPU needed.
+ *
+ * Fails if the optimized mesh doesn't draw the same triangles (same corners,
+ * same winding), if a material range lost or gained any, or if the ACMR at
+ * the size it was optimized for got worse.
+ *
+ * usage: VertexCacheBench [--cache <entries>] [file.obj ...]
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const char* DEFAULT_MESHES[] = {
+    "bunny.obj",
+    "capsule/capsule.obj",
+    "chapel/chapel_obj.obj",
+};
+
+// cache sizes reported besides the one optimized for
+const int REPORT_CACHE_SIZES[] = {8, 16, 32};
+
+// one corner's attributes, so triangles compare across vertex renumbering
+typedef std::array<float, 8> Corner;
+typedef std::array<Corner, 3> Triangle;
+
+// the triangles of [first, first + count) by value, each turned to start at
+// its smallest corner (keeps the winding) and then sorted
+std::vector<Triangle> triangles(const MeshData& mesh, size_t first,
+                                size_t count)
+{
+  std::vector<Triangle> out;
+
+  for (size_t i = first; i < first + count; i += 3) {
+    Triangle tri;
+    for (int c = 0; c < 3; c++) {
+      const unsigned int v = mesh.indices[static_cast<int>(i) + c];
+      const QVector3D& p = mesh.positions[v];
+      const QVector3D& n = mesh.normals[v];
+      const QVector2D& uv = mesh.texCoords[v];
+      tri[c] = {p.x(), p.y(), p.z(), n.x(), n.y(), n.z(), uv.x(), uv.y()};
+    }
+
+    std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()),
+                tri.end());
+    out.push_back(tri);
+  }
+
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+// true if every material range draws the same triangles in both meshes
+bool same_triangles(const MeshData& a, const MeshData& b)
+{
+  std::vector<MaterialRange> ranges = a.materials;
+  if (ranges.empty()) {
+    ranges.push_back({"", 0, static_cast<unsigned int>(a.indices.size())});
+  }
+
+  for (const MaterialRange& range : ranges) {
+    if (triangles(a, range.first_index, range.num_indices) !=
+        triangles(b, range.first_index, range.num_indices)) {
+      return false;
+    }
+  }
+
+  return a.indices.size() == b.indices.size();
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files;
+  int cacheSize = DEFAULT_VERTEX_CACHE_SIZE;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--cache" && i + 1 < argc) {
+      cacheSize = std::max(3, std::atoi(argv[++i]));
+    }
+    else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  bool ok = true;
+
+  for (const std::string& file : files) {
+    ObjLoader obj;
+    if (obj.parse_file(file) != EXIT_SUCCESS) {
+      std::cout << "Could not read file " << file << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const MeshData original = obj.get_mesh();
+    MeshData mesh = obj.take_mesh();
+
+    auto start = std::chrono::steady_clock::now();
+    const MeshOptimizeStats stats = optimize_mesh(mesh, cacheSize);
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << file << '\n'
+              << "  " << mesh.indices.size() / 3 << " triangles, "
+              << mesh.positions.size() << " vertices, optimized for "
+              << cacheSize << " entries in " << std::fixed
+              << std::setprecision(2) << ms.count() << " ms\n";
+
+    std::cout << std::setprecision(3);
+    for (int size : REPORT_CACHE_SIZES) {
+      const VertexCacheStats before = simulate_vertex_cache(
+          original.indices.constData(), original.indices.size(),
+          original.positions.size(), size);
+      const VertexCacheStats after =
+          simulate_vertex_cache(mesh.indices.constData(), mesh.indices.size(),
+                                mesh.positions.size(), size);
+
+      std::cout << "  FIFO " << std::setw(2) << size << "  ACMR "
+                << before.acmr << " -> " << after.acmr << "  ATVR "
+                << before.atvr << " -> " << after.atvr << '\n';
+    }
+
+    if (!same_triangles(original, mesh)) {
+      std::cout << "  MISMATCH: the optimized mesh draws other triangles\n";
+      ok = false;
+    }
+    if (stats.after.acmr > stats.before.acmr) {
+      std::cout << "  the ACMR got worse\n";
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,254 @@
+/**
+ * Checks the compact vertex format Renderable uploads (Util::CompactVertex)
+ * against the full float one. Packs the bundled meshes (or the .obj files
+ * given on the command line), unpacks them the way vert.glsl does and
+ * reports the worst error of each attribute, plus the bytes per vertex and
+ * per mesh each way. Also runs a million random frames and every half
+ * float through the encoders.
+ *
+ * Fails if an error goes past its bound, a bitangent flips side, or the
+ * vertices don't get more than twice as small.
+ *
+ * usage: VertexFormatBench [file.obj ...]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "Util.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const char* DEFAULT_MESHES[] = {
+    "bunny.obj",
+    "capsule/capsule.obj",
+    "chapel/chapel_obj.obj",
+    "windmill/windmill.obj",
+};
+
+const int RANDOM_DIRECTIONS = 1000000;
+
+// worst errors allowed: snorm16 octahedral normals stay well inside a
+// hundredth of a degree, the tangent gives one bit up for the bitangent side
+const double MAX_NORMAL_ERROR_DEG = 0.01;
+const double MAX_TANGENT_ERROR_DEG = 0.02;
+
+// half floats keep 11 significant bits, so rounding is off by at most 2^-11
+// relative (2^-25 absolute below the normal range)
+const double MAX_UV_RELATIVE_ERROR = 1.0 / 2048;
+const double MAX_UV_ABSOLUTE_ERROR = 1.0 / (1 << 25);
+
+// the compact vertices have to be more than this many times smaller
+const double MIN_SIZE_RATIO = 2.0;
+
+const double RAD_TO_DEG = 180.0 / 3.14159265358979323846;
+
+struct FormatErrors {
+  double position = 0;
+  double uv = 0;  // as a share of what MAX_UV_*_ERROR allows
+  double normal_deg = 0;
+  double tangent_deg = 0;
+  int flipped = 0;  // bitangents that came back on the wrong side
+};
+
+// angle between a direction and its decoded unit vector, or 0 if the
+// direction is zero or not a number (those can't be encoded). In doubles,
+// since acos of a float dot product can't tell apart angles this small.
+double angle_deg(const QVector3D& original, const QVector3D& decoded)
+{
+  const double a[3] = {original.x(), original.y(), original.z()};
+  const double b[3] = {decoded.x(), decoded.y(), decoded.z()};
+
+  const double cross[3] = {a[1] * b[2] - a[2] * b[1],
+                           a[2] * b[0] - a[0] * b[2],
+                           a[0] * b[1] - a[1] * b[0]};
+  const double sin = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] +
+                               cross[2] * cross[2]);
+  const double cos = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+
+  if (!(sin > 0 || cos > 0)) {
+    return 0;
+  }
+  return std::atan2(sin, cos) * RAD_TO_DEG;
+}
+
+// unpacks every vertex and compares it with the floats it was packed from
+FormatErrors check(const std::vector<float>& vertices)
+{
+  const int numVerts = vertices.size() / Util::VERTEX_FLOATS;
+  std::vector<Util::CompactVertex> packed(numVerts);
+  Util::PackVertices(vertices.data(), numVerts, packed.data());
+
+  FormatErrors errors;
+
+  for (int i = 0; i < numVerts; i++) {
+    const float* v = vertices.data() + static_cast<size_t>(i) *
+                                           Util::VERTEX_FLOATS;
+    const QVector3D position(v[0], v[1], v[2]);
+    const QVector3D normal(v[3], v[4], v[5]);
+    const QVector2D uv(v[6], v[7]);
+    const QVector3D tangent(v[8], v[9], v[10]);
+    const QVector3D bitangent(v[11], v[12], v[13]);
+
+    QVector3D p, n, t, b;
+    QVector2D u;
+    Util::UnpackVertex(packed[i], p, n, u, t, b);
+
+    errors.position =
+        std::max<double>(errors.position, (p - position).length());
+
+    for (int c = 0; c < 2; c++) {
+      const double allowed =
+          std::max(MAX_UV_RELATIVE_ERROR * std::fabs(uv[c]),
+                   MAX_UV_ABSOLUTE_ERROR);
+      errors.uv = std::max(errors.uv, std::fabs(u[c] - uv[c]) / allowed);
+    }
+
+    errors.normal_deg = std::max(errors.normal_deg, angle_deg(normal, n));
+    errors.tangent_deg = std::max(errors.tangent_deg, angle_deg(tangent, t));
+
+    // the rebuilt bitangent has to lean the same way as the original,
+    // wherever the original frame says which way that is
+    const float side = QVector3D::dotProduct(
+        QVector3D::crossProduct(normal, tangent), bitangent);
+    if (std::fabs(side) > 1e-6f && QVector3D::dotProduct(b, bitangent) <= 0) {
+      errors.flipped++;
+    }
+  }
+
+  return errors;
+}
+
+bool report(const FormatErrors& errors)
+{
+  std::cout << std::setprecision(6) << "  worst position error "
+            << errors.position << ", uv " << errors.uv
+            << " of the half float bound, normal " << errors.normal_deg
+            << " deg, tangent " << errors.tangent_deg << " deg, "
+            << errors.flipped << " bitangents flipped\n";
+
+  bool ok = true;
+  if (errors.position != 0 || errors.uv > 1) {
+    std::cout << "  position/uv error past its bound\n";
+    ok = false;
+  }
+  if (errors.normal_deg > MAX_NORMAL_ERROR_DEG ||
+      errors.tangent_deg > MAX_TANGENT_ERROR_DEG) {
+    std::cout << "  normal/tangent error past its bound\n";
+    ok = false;
+  }
+  if (errors.flipped > 0) {
+    std::cout << "  bitangent on the wrong side\n";
+    ok = false;
+  }
+  return ok;
+}
+
+// random frames with random sides and uvs, as interleaved floats
+std::vector<float> random_vertices(int count)
+{
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> gauss;
+  std::uniform_real_distribution<float> uv(-4, 4);
+
+  std::vector<float> vertices(static_cast<size_t>(count) *
+                              Util::VERTEX_FLOATS);
+
+  for (int i = 0; i < count; i++) {
+    float* v = vertices.data() + static_cast<size_t>(i) * Util::VERTEX_FLOATS;
+
+    const QVector3D n(gauss(rng), gauss(rng), gauss(rng));
+    const QVector3D t(gauss(rng), gauss(rng), gauss(rng));
+    const QVector3D b =
+        QVector3D::crossProduct(n, t) * (i % 2 ? 1.0f : -1.0f);
+
+    const float values[Util::VERTEX_FLOATS] = {
+        0,       0,       0,      // position
+        n.x(),   n.y(),   n.z(),  // normal
+        uv(rng), uv(rng),         // uv
+        t.x(),   t.y(),   t.z(),  // tangent
+        b.x(),   b.y(),   b.z()   // bitangent
+    };
+    std::copy(values, values + Util::VERTEX_FLOATS, v);
+  }
+
+  return vertices;
+}
+
+// every finite half comes back from a float as itself
+bool halves_round_trip()
+{
+  for (int h = 0; h < 0x10000; h++) {
+    const uint16_t half = static_cast<uint16_t>(h);
+    const float f = Util::HalfToFloat(half);
+    if (!std::isnan(f) && Util::FloatToHalf(f) != half) {
+      std::cout << "  half 0x" << std::hex << h << std::dec
+                << " doesn't round trip\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files(argv + 1, argv + argc);
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  const int floatBytes = Util::VERTEX_FLOATS * sizeof(float);
+  const int compactBytes = sizeof(Util::CompactVertex);
+  const double ratio = static_cast<double>(floatBytes) / compactBytes;
+
+  std::cout << "per vertex: " << floatBytes << " -> " << compactBytes
+            << " bytes (" << std::fixed << std::setprecision(2) << ratio
+            << "x)\n";
+
+  bool ok = ratio > MIN_SIZE_RATIO;
+
+  std::cout << "every half float\n";
+  if (halves_round_trip()) {
+    std::cout << "  all round trip\n";
+  }
+  else {
+    ok = false;
+  }
+
+  std::cout << RANDOM_DIRECTIONS << " random frames\n";
+  ok = report(check(random_vertices(RANDOM_DIRECTIONS))) && ok;
+
+  for (const std::string& file : files) {
+    BakedMesh mesh;
+    if (MeshCache::bake(file, mesh) != EXIT_SUCCESS) {
+      std::cout << "Could not read file " << file << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const size_t numVerts = mesh.vertices.size() / Util::VERTEX_FLOATS;
+    const size_t indexBytes = numVerts <= 65536 ? 2 : 4;
+    const size_t before =
+        numVerts * floatBytes + mesh.indices.size() * sizeof(unsigned int);
+    const size_t after =
+        numVerts * compactBytes + mesh.indices.size() * indexBytes;
+
+    std::cout << file << '\n'
+              << "  " << numVerts << " vertices, " << mesh.indices.size()
+              << " indices: " << before / 1024 << " -> " << after / 1024
+              << " KB (" << std::setprecision(2)
+              << static_cast<double>(before) / after << "x)\n";
+
+    ok = report(check(mesh.vertices)) && ok;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
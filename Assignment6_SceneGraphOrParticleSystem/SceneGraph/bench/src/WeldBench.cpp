@@ -0,0 +1,177 @@
+/**
+ * Compares the hash table welder (obj_to_vbo) against the original std::map
+ * one (obj_to_vbo_map) on the bundled meshes, or the .obj files given on the
+ * command line. Reports the best welding time and the peak RSS each welder
+ * added, and checks that both produce the same triangles.
+ *
+ * Every welder runs in a forked child so its peak RSS is measured on its own.
+ *
+ * usage: WeldBench [file.obj ...]
+ */
+
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ObjRecords.h"
+#include "ObjToVboIdx.h"
+#include "PeakRss.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const int BENCH_RUNS = 10;
+
+const char* DEFAULT_MESHES[] = {
+    "bunny.obj",
+    "capsule/capsule.obj",
+    "chapel/chapel_obj.obj",
+};
+
+typedef void (*Welder)(QVector<QVector3D>&, QVector<QVector2D>&,
+                       QVector<QVector3D>&, QVector<triface>&,
+                       QVector<unsigned int>&, QVector<QVector3D>&,
+                       QVector<QVector2D>&, QVector<QVector3D>&);
+
+// the welded buffers
+struct Welded {
+  QVector<unsigned int> indices;
+  QVector<QVector3D> vertices;
+  QVector<QVector2D> uvs;
+  QVector<QVector3D> normals;
+};
+
+// what a child process reports back
+struct WeldStats {
+  double best_ms;
+  long peak_rss_kb;  // peak RSS above what the child started with
+};
+
+void weld(Welder welder, ObjRecords& records, Welded& out)
+{
+  welder(records.vertices, records.uvs, records.normals, records.faces,
+         out.indices, out.vertices, out.uvs, out.normals);
+}
+
+// runs the welder BENCH_RUNS times in a child process
+bool measure(Welder welder, ObjRecords& records, WeldStats& stats)
+{
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+
+  pid_t pid = fork();
+  if (pid < 0) return false;
+
+  if (pid == 0) {  // child
+    close(fds[0]);
+
+    // hand free heap pages back so the welder has to fault in its own, and
+    // forget the peak we inherited from the parent
+    malloc_trim(0);
+    reset_peak_rss();
+    const long baseline = proc_status_kb("VmRSS");
+
+    WeldStats result = {1e300, 0};
+    for (int i = 0; i < BENCH_RUNS; i++) {
+      Welded out;
+      auto start = std::chrono::steady_clock::now();
+      weld(welder, records, out);
+      std::chrono::duration<double, std::milli> ms =
+          std::chrono::steady_clock::now() - start;
+      result.best_ms = std::min(result.best_ms, ms.count());
+    }
+
+    result.peak_rss_kb = proc_status_kb("VmHWM") - baseline;
+
+    bool ok = write(fds[1], &result, sizeof(result)) == sizeof(result);
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  bool ok = read(fds[0], &stats, sizeof(stats)) == sizeof(stats);
+  close(fds[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// true if both weldings describe the same triangles, corner by corner
+bool same_triangles(const Welded& a, const Welded& b)
+{
+  if (a.indices.size() != b.indices.size()) return false;
+
+  for (int i = 0; i < a.indices.size(); i++) {
+    const unsigned int ia = a.indices[i];
+    const unsigned int ib = b.indices[i];
+
+    if (a.vertices[ia] != b.vertices[ib] || a.uvs[ia] != b.uvs[ib] ||
+        a.normals[ia] != b.normals[ib]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void report(const char* label, const WeldStats& stats, int unique)
+{
+  std::cout << "  " << std::left << std::setw(6) << label << std::right
+            << std::fixed << std::setprecision(3) << std::setw(9)
+            << stats.best_ms << " ms " << std::setw(8) << stats.peak_rss_kb
+            << " KB peak RSS " << std::setw(8) << unique << " vertices\n";
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> files(argv + 1, argv + argc);
+  if (files.empty()) {
+    for (const char* mesh : DEFAULT_MESHES) {
+      files.push_back(std::string(OBJECTS_DIR) + "/" + mesh);
+    }
+  }
+
+  bool ok = true;
+
+  for (const std::string& file : files) {
+    ObjRecords records;
+    if (read_obj_records(file, ObjLoader::ParseMode::Mapped, 0, records) !=
+        EXIT_SUCCESS) {
+      std::cout << "Could not read file " << file << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::cout << file << " (" << records.faces.size() << " faces)\n";
+
+    WeldStats map_stats;
+    WeldStats hash_stats;
+    if (!measure(obj_to_vbo_map, records, map_stats) ||
+        !measure(obj_to_vbo, records, hash_stats)) {
+      std::cout << "  could not run the benchmark child" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    Welded by_map;
+    Welded by_hash;
+    weld(obj_to_vbo_map, records, by_map);
+    weld(obj_to_vbo, records, by_hash);
+
+    report("map", map_stats, by_map.vertices.size());
+    report("hash", hash_stats, by_hash.vertices.size());
+
+    if (!same_triangles(by_map, by_hash)) {
+      std::cout << "  MISMATCH between map and hash triangles\n";
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The mapping lives as long as the object does. Empty files map to a null
+ * pointer with size 0.
+ */
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  /**
+   * Maps a file and unmaps the old one.
+   *
+   * @param filename  the filename
+   * @return  EXIT_SUCCESS on success
+   */
+  int open(const std::string& filename);
+
+  // unmaps the file (safe to call more than once)
+  void close();
+
+  bool is_open() const { return m_open; }
+
+  const char* data() const { return m_data; }
+  const char* end() const { return m_data + m_size; }
+  size_t size() const { return m_size; }
+
+private:
+  const char* m_data;
+  size_t m_size;
+  bool m_open;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "Util.h"
+
+// fixed size start of a .herbmesh file (layout in MeshCache.cpp)
+struct HerbMeshHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t vertex_size;  // bytes per vertex
+  int64_t source_mtime_ns;
+  uint64_t source_size;
+  uint64_t source_hash;  // FNV-1a of the source file
+  uint32_t num_vertices;
+  uint32_t num_indices;
+  uint32_t source_path_len;
+  uint32_t mtllib_len;
+  uint32_t num_materials;   // material ranges
+  uint32_t materials_len;   // bytes they take up
+};
+
+/**
+ * @brief A mesh in the form Renderable uploads it: interleaved vertices
+ * (Util::VERTEX_FLOATS floats each) plus the index buffer.
+ */
+struct BakedMesh {
+  std::string mtllib;  // full path of the .mtl the .obj asked for
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<MaterialRange> materials;  // see MeshData::materials
+};
+
+/**
+ * @brief Binary cache (.herbmesh) of a baked .obj, stored next to it.
+ *
+ * The vertices are stored packed (Util::CompactVertex), the way Renderable
+ * uploads them.
+ *
+ * A cache is used only if it was written from the same source path, by the
+ * same format version and vertex layout, and the source still has the same
+ * mtime and size. If the mtime moved but the size didn't (a fresh checkout,
+ * say), a content hash of the source decides.
+ *
+ * The vertices and indices of an open cache point straight into the mapped
+ * file, so they stay valid until the cache is closed or destroyed.
+ */
+class MeshCache {
+public:
+  MeshCache();
+
+  // the cache file that goes with a source .obj
+  static std::string cache_path(const std::string& source);
+
+  /**
+   * Parses a .obj, computes its tangents and interleaves everything.
+   *
+   * @param source  the .obj filename
+   * @param out  (output) the baked mesh
+   * @param optimize  reorder it for the vertex cache first (optimize_mesh)
+   * @param stats  (output, optional) the simulated cache before and after
+   * @return  EXIT_SUCCESS on success
+   */
+  static int bake(const std::string& source, BakedMesh& out,
+                  bool optimize = false, MeshOptimizeStats* stats = nullptr);
+
+  /**
+   * Writes the cache for a source .obj (replacing any old one).
+   *
+   * @param source  the .obj filename the mesh was baked from
+   * @param mesh  the baked mesh (packed on the way)
+   * @return  EXIT_SUCCESS on success
+   */
+  static int write(const std::string& source, const BakedMesh& mesh);
+
+  /**
+   * Maps the cache for a source .obj if there is a valid one.
+   *
+   * @param source  the .obj filename
+   * @return  EXIT_SUCCESS on success, EXIT_FAILURE if missing or stale
+   */
+  int open(const std::string& source);
+
+  void close();
+
+  const std::string& mtllib() const { return m_mtllib; }
+  const std::vector<MaterialRange>& materials() const { return m_materials; }
+  const Util::CompactVertex* vertices() const { return m_vertices; }
+  const unsigned int* indices() const { return m_indices; }
+  uint32_t num_vertices() const { return m_numVertices; }
+  uint32_t num_indices() const { return m_numIndices; }
+
+private:
+  MappedFile m_file;
+  std::string m_mtllib;
+  std::vector<MaterialRange> m_materials;
+  const Util::CompactVertex* m_vertices;
+  const unsigned int* m_indices;
+  uint32_t m_numVertices;
+  uint32_t m_numIndices;
+};
+
+/**
+ * @brief Writes a cache a piece at a time, for meshes that are never whole
+ * in memory (see ObjStreamer). MeshCache::write goes through this too.
+ *
+ * Vertices go straight into the cache file and indices into a file beside
+ * it, which is appended at the end. Nothing is visible under the real cache
+ * name until finish() succeeds; a writer that is destroyed before that
+ * cleans up after itself.
+ */
+class MeshCacheWriter {
+public:
+  MeshCacheWriter();
+  ~MeshCacheWriter();
+
+  /**
+   * Starts the cache for a source .obj.
+   *
+   * @param source  the .obj filename the mesh comes from
+   * @return  EXIT_SUCCESS on success
+   */
+  int begin(const std::string& source);
+
+  /**
+   * Appends packed vertices and indices. Indices are into the whole mesh,
+   * not just the vertices passed along with them.
+   *
+   * @return  EXIT_SUCCESS on success
+   */
+  int add(const Util::CompactVertex* vertices, size_t numVertices,
+          const unsigned int* indices, size_t numIndices);
+
+  /**
+   * Puts the finished cache in place (replacing any old one).
+   *
+   * @param mtllib  full path of the .mtl the .obj asked for
+   * @param materials  its usemtl ranges (see MeshData::materials)
+   * @return  EXIT_SUCCESS on success
+   */
+  int finish(const std::string& mtllib,
+             const std::vector<MaterialRange>& materials);
+
+  // throws away everything written since begin()
+  void discard();
+
+private:
+  std::string tmp_path() const;
+  std::string indices_path() const;
+
+  std::string m_source;
+  HerbMeshHeader m_header;
+  std::ofstream m_out;
+  std::fstream m_indices;
+  bool m_open;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A run of triangles a usemtl line gave one material
+ */
+struct MaterialRange {
+  std::string material;  // its newmtl name, empty for faces before any usemtl
+  unsigned int first_index;
+  unsigned int num_indices;
+};
+
+/**
+ * @brief The one owning copy of a mesh's vertex attributes and indices
+ *
+ * ObjLoader fills it in; everything after that (Util::InterleaveMesh,
+ * Renderable::init) only reads it through a const reference. Hand it on with
+ * std::move rather than copying it.
+ */
+struct MeshData {
+  QVector<QVector3D> positions;
+  QVector<QVector3D> normals;    // lined up with positions
+  QVector<QVector2D> texCoords;  // lined up with positions
+  QVector<unsigned int> indices;  // every three make a triangle
+
+  // usemtl runs in index order, covering all of indices (empty if the .obj
+  // never said usemtl)
+  std::vector<MaterialRange> materials;
+
+  void clear()
+  {
+    positions.clear();
+    normals.clear();
+    texCoords.clear();
+    indices.clear();
+    materials.clear();
+  }
+};
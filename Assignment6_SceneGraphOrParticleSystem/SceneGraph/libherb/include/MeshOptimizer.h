@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QVector>
+#include <QVector3D>
+#include <cstddef>
+#include <vector>
+
+#include "MeshData.h"
+
+// post-transform cache entries the optimizer plans for (and the simulator
+// models unless told otherwise)
+const int DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+// how much worse than its whole fan a cluster's ACMR may get before
+// optimize_overdraw cuts it off
+const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+/**
+ * @brief How well an index buffer uses a FIFO post-transform cache
+ */
+struct VertexCacheStats {
+  double acmr;  // misses per triangle: 3 is no reuse at all, ~0.5 the best
+  double atvr;  // misses per vertex used: 1 means each is transformed once
+};
+
+struct MeshOptimizeStats {
+  VertexCacheStats before;
+  VertexCacheStats after;
+};
+
+/**
+ * Runs an index buffer through a simulated FIFO cache the way the GPU's
+ * post-transform cache sees it: a hit costs nothing and does not move the
+ * vertex, a miss transforms it and pushes out the oldest entry.
+ *
+ * @param indices  the index buffer, three per triangle
+ * @param num_indices  how many there are
+ * @param num_vertices  one more than the largest index
+ * @param cache_size  entries in the cache
+ * @return  the miss rates
+ */
+VertexCacheStats simulate_vertex_cache(
+    const unsigned int* indices, size_t num_indices, size_t num_vertices,
+    int cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+/**
+ * Reorders triangles for the post-transform cache (Tipsify: Sander, Nehab
+ * and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw", 2007). Fans around one vertex at a time, moving on to the
+ * neighbour that is still in the cache and has the fewest triangles left.
+ *
+ * @param indices  the index buffer, three per triangle
+ * @param num_indices  how many there are
+ * @param num_vertices  one more than the largest index
+ * @param cache_size  entries in the cache to plan for
+ * @param out  (output) the reordered triangles (num_indices, not indices)
+ * @param clusters  (output, optional) the first triangle after each point
+ * where the fans had to jump somewhere unrelated, starting with 0
+ */
+void optimize_vertex_cache(const unsigned int* indices, size_t num_indices,
+                           size_t num_vertices, int cache_size,
+                           unsigned int* out,
+                           std::vector<size_t>* clusters = nullptr);
+
+/**
+ * Cuts the output of optimize_vertex_cache into clusters and sorts them so
+ * the ones facing out of the mesh come first, since they are the likeliest
+ * to hide the rest (Tipsify's linear clustering). A cluster ends once its
+ * ACMR gets to within threshold of what its whole fan manages, so the cache
+ * loses little.
+ *
+ * @param indices  (in/out) the index buffer, three per triangle
+ * @param num_indices  how many there are
+ * @param positions  the vertex positions
+ * @param clusters  the hard cluster starts from optimize_vertex_cache
+ * @param cache_size  entries in the cache
+ * @param threshold  ACMR ratio at which a cluster ends
+ */
+void optimize_overdraw(unsigned int* indices, size_t num_indices,
+                       const QVector<QVector3D>& positions,
+                       const std::vector<size_t>& clusters, int cache_size,
+                       float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+/**
+ * Renumbers vertices in the order the index buffer first uses them, so the
+ * vertex fetch walks the vbo front to back. Unused vertices go at the end.
+ *
+ * @param indices  (in/out) the index buffer
+ * @param num_indices  how many there are
+ * @param num_vertices  how many vertices there are
+ * @return  for each old vertex, its new index
+ */
+std::vector<unsigned int> optimize_vertex_fetch(unsigned int* indices,
+                                                size_t num_indices,
+                                                size_t num_vertices);
+
+/**
+ * All three passes over a welded mesh: triangles are reordered inside each
+ * material range (so the ranges stay as they are), then the vertex
+ * attributes are moved to match.
+ *
+ * @param mesh  (in/out) the mesh
+ * @param cache_size  entries in the cache to plan for
+ * @return  the simulated cache before and after
+ */
+MeshOptimizeStats optimize_mesh(MeshData& mesh,
+                                int cache_size = DEFAULT_VERTEX_CACHE_SIZE);
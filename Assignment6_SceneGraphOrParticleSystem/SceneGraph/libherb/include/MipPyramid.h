@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SourceStamp.h"
+
+// how a texture's texels are averaged down to the smaller levels
+enum class MipKind : uint32_t {
+  COLOR,   // sRGB colors (diffuse): averaged in linear light
+  NORMAL,  // tangent space normals: averaged as vectors, then renormalized
+  DATA,    // anything else (specular): averaged as stored
+};
+
+// the filter each level is made from the one above with
+enum class MipFilter : uint32_t {
+  BOX,     // area average (2x2, or over 3 texels on odd sizes)
+  KAISER,  // Kaiser windowed sinc: sharper, a little ringing
+};
+
+// one level of a chain: RGBA8 rows, ready for glTexImage2D
+struct MipLevel {
+  uint32_t width;
+  uint32_t height;
+  std::vector<unsigned char> rgba;
+};
+
+/**
+ * Builds the whole mip chain of an image, down to 1x1, with the sizes GL
+ * expects (each level half the one above, rounded down).
+ *
+ * The image is mirrored both ways on the way in (what
+ * QImage::mirrored(true, true) did before upload), so level 0 is the mirrored
+ * image as RGBA8 and the rest come from it.
+ *
+ * @param argb  the pixels as 0xAARRGGBB words (QImage::Format_RGB32 or
+ *              Format_ARGB32 scanlines)
+ * @param width  width in pixels
+ * @param height  height in pixels
+ * @param stride  words from one row to the next
+ * @param kind  how to average the texels
+ * @param filter  which filter to make each level with
+ * @param levels  (output) the chain, biggest first
+ */
+void build_mip_chain(const uint32_t* argb, int width, int height, int stride,
+                     MipKind kind, MipFilter filter,
+                     std::vector<MipLevel>& levels);
+
+// fixed size start of a .herbmip file (layout in MipPyramid.cpp)
+struct HerbMipHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;    // MipKind
+  uint32_t filter;  // MipFilter
+  uint32_t num_levels;
+  int64_t source_mtime_ns;
+  uint64_t source_size;
+  uint64_t source_hash;
+  uint32_t source_path_len;
+  uint32_t reserved;
+};
+
+/**
+ * @brief Binary cache (.herbmip) of a texture's mip chain, stored next to the
+ * image it was built from.
+ *
+ * Like a .herbmesh, a cache is used only if it was written from the same
+ * source path by the same format version, with the same kind and filter, and
+ * the source hasn't changed since (see SourceStamp).
+ *
+ * The levels of an open cache point straight into the mapped file, so they
+ * stay valid until the cache is closed or destroyed.
+ */
+class MipCache {
+public:
+  // a level as it sits in the file
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    const unsigned char* rgba;
+  };
+
+  MipCache();
+
+  // the cache file that goes with a source image built as kind with filter
+  // (e.g. rock.ppm.color-kaiser.herbmip), so each way it's loaded keeps its
+  // own
+  static std::string cache_path(const std::string& source, MipKind kind,
+                                MipFilter filter);
+
+  // removes every cache of a source image, whatever it was built as
+  static void remove(const std::string& source);
+
+  /**
+   * Writes the cache for a source image (replacing any old one).
+   *
+   * @param source  the image the chain was built from
+   * @param kind  the kind it was built as
+   * @param filter  the filter it was built with
+   * @param levels  the chain
+   * @return  EXIT_SUCCESS on success
+   */
+  static int write(const std::string& source, MipKind kind, MipFilter filter,
+                   const std::vector<MipLevel>& levels);
+
+  /**
+   * Maps the cache for a source image if there is a valid one.
+   *
+   * @param source  the image
+   * @param kind  the kind the chain has to have been built as
+   * @param filter  the filter it has to have been built with
+   * @return  EXIT_SUCCESS on success, EXIT_FAILURE if missing or stale
+   */
+  int open(const std::string& source, MipKind kind, MipFilter filter);
+
+  void close();
+
+  const std::vector<Level>& levels() const { return m_levels; }
+
+private:
+  MappedFile m_file;
+  std::vector<Level> m_levels;
+};
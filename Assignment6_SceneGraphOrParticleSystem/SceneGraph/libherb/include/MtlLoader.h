@@ -1,6 +1,34 @@
 #pragma once
 
+#include <QVector3D>
 #include <string>
+#include <vector>
+
+/**
+ * @brief One newmtl block of a .mtl file (on top of any lines before the
+ * first newmtl, which every material starts from)
+ *
+ * Texture maps are full paths. A material without map_Kd or map_Ks has none
+ * (Renderable draws it in its Kd, or with Ks as its specular color: fully
+ * specular unless the .mtl says otherwise); one without map_Bump has none
+ * either (it's drawn flat). Only a missing .mtl gives the default texture.
+ */
+struct Material {
+  std::string name;
+
+  QVector3D Ka = QVector3D(0, 0, 0);  // ambient color
+  QVector3D Kd = QVector3D(1, 1, 1);  // diffuse color
+  QVector3D Ks = QVector3D(1, 1, 1);  // specular color
+  QVector3D Ke = QVector3D(0, 0, 0);  // emissive color
+  float Ns = 0;                       // specular exponent
+  float Ni = 1;                       // index of refraction
+  float d = 1;                        // opacity
+  int illum = 2;                      // illumination model
+
+  std::string map_Kd;    // diffuse texture
+  std::string map_Ks;    // specular texture
+  std::string map_Bump;  // normal map
+};
 
 /**
  * @brief Simple class for extracting data from .mtl files.
@@ -11,17 +39,24 @@ public:
   MtlLoader();
 
   /**
-   * Loads a .obj file and throws out the old one.
+   * Loads a .mtl file and throws out the old one.
    *
    * @param filename  the filename
    * @return  EXIT_SUCCESS on success
    */
   int parse_file(const std::string filename);
-  std::string get_map_Kd() const { return m_basedir + m_map_Kd; }
-  std::string get_map_Bump() const { return m_basedir + m_map_Bump; }
+
+  // every material in the file, in file order. Never empty: a file without
+  // any (or one that couldn't be read) gives a single default material.
+  const std::vector<Material>& get_materials() const { return m_materials; }
+
+  // index of the material called name, or -1
+  int find_material(const std::string& name) const;
+
+  // maps of the first material
+  std::string get_map_Kd() const { return m_materials.front().map_Kd; }
+  std::string get_map_Bump() const { return m_materials.front().map_Bump; }
 
 private:
-  std::string m_basedir;
-  std::string m_map_Kd;
-  std::string m_map_Bump;
-};
\ No newline at end of file
+  std::vector<Material> m_materials;
+};
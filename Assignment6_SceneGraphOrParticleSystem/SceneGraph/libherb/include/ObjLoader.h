@@ -11,30 +11,50 @@
 #include <QVector3D>
 #include <QVector2D>
 
+#include "MeshData.h"
+
 /**
  * @brief Simple class for extracting data from .obj files.
  *
  */
 class ObjLoader {
 public:
+  // How parse_file reads the file. All of them produce the same buffers.
+  enum class ParseMode {
+    Stream,   // std::getline + std::istringstream for every line
+    Mapped,   // mmap the file and tokenize it in place, no per-token strings
+    Parallel  // Mapped, split at line boundaries across threads
+  };
+
   ObjLoader();
 
   /**
    * Loads a .obj file and throws out the old one.
    *
    * @param filename  the filename
+   * @param mode  how to read the file
    * @return  EXIT_SUCCESS on success
    */
-  int parse_file(const std::string filename);
+  int parse_file(const std::string filename,
+                 ParseMode mode = ParseMode::Mapped);
 
   /**
    * returns a contiguous list of floats - every triplet represents a
    * vertex
    */
-  QVector<QVector3D> get_normals() const { return m_normals; }
-  QVector<QVector3D> get_vertices() const { return m_vertices; }
-  QVector<QVector2D> get_uvs() const { return m_uvs; }
-  QVector<unsigned int> get_indices() const { return m_indices; }
+  const QVector<QVector3D>& get_normals() const { return m_mesh.normals; }
+  const QVector<QVector3D>& get_vertices() const { return m_mesh.positions; }
+  const QVector<QVector2D>& get_uvs() const { return m_mesh.texCoords; }
+  const QVector<unsigned int>& get_indices() const { return m_mesh.indices; }
+
+  // the whole mesh, without copying it
+  const MeshData& get_mesh() const { return m_mesh; }
+
+  // moves the mesh out, leaving this loader empty
+  MeshData take_mesh() { return std::move(m_mesh); }
+
+  // threads ParseMode::Parallel may use (0 = one per core)
+  void set_parse_threads(unsigned num_threads) { m_parse_threads = num_threads; }
 
   std::string get_mtllib() const { return m_basedir + m_mtllib; }
 
@@ -45,12 +65,10 @@ public:
   void print();
 
 private:
-  QVector<QVector3D> m_normals;
-  QVector<QVector3D> m_vertices;
-  QVector<QVector2D> m_uvs;
-  QVector<unsigned int> m_indices;
+  MeshData m_mesh;
   std::string m_mtllib;
   std::string m_basedir;
   bool m_uses_uvs;
   bool m_uses_normals;
+  unsigned m_parse_threads;
 };
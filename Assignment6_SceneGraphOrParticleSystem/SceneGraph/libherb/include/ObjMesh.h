@@ -10,8 +10,10 @@
 #include <iostream>
 #include <string>
 
+#include "MeshCache.h"
 #include "MtlLoader.h"
 #include "ObjLoader.h"
+#include "ObjStreamer.h"
 #include "Renderable.h"
 #include "Util.h"
 
@@ -19,15 +21,13 @@ class ObjMesh : public Renderable {
 public:
   ObjMesh();
 
-  // Calls initialize on the parent Renderable
+  // Calls initialize on the parent Renderable. Loads the mesh from its
+  // .herbmesh cache when that is up to date, otherwise streams the .obj into
+  // the buffers as it's parsed and writes the cache for next time.
   void init(std::string filename);
 
 private:
-  ObjLoader m_obj;
-  QVector<QVector3D> m_pos;
-  QVector<QVector3D> m_norm;
-  QVector<QVector2D> m_texCoord;
-  QVector<QVector3D> m_tangents;
-  QVector<QVector3D> m_bitangents;
-  QVector<unsigned int> m_idx;
-};
\ No newline at end of file
+  // reads the .mtl and gives each usemtl range its material
+  void loadMaterials(const std::string& mtllib,
+                     const std::vector<MaterialRange>& ranges);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "Util.h"
+
+/**
+ * @brief One slice of a mesh coming out of ObjStreamer
+ *
+ * Holds the vertices that turned up for the first time in this slice
+ * (packed the way Renderable uploads them) and the indices of its
+ * triangles. The indices may point at vertices of any earlier batch.
+ */
+struct MeshBatch {
+  int first_vertex;  // where vertices[0] goes in the whole mesh
+  int first_index;   // where indices[0] goes in the whole mesh
+  std::vector<Util::CompactVertex> vertices;
+  std::vector<unsigned int> indices;
+
+  int num_vertices() const { return static_cast<int>(vertices.size()); }
+  int num_indices() const { return static_cast<int>(indices.size()); }
+};
+
+/**
+ * @brief Parses, welds and packs an .obj on a worker thread, handing the
+ * result over a batch at a time
+ *
+ * The caller takes finished batches with next() and gives each one back with
+ * release() when it is done with it (uploaded it, say). Only a few batches
+ * exist at once; the worker waits for release() instead of running ahead,
+ * so the mesh is never whole in memory. Put together, the batches match
+ * MeshCache::bake exactly, once that's packed.
+ */
+class ObjStreamer {
+public:
+  // most triangles in a batch unless told otherwise (smaller meshes are cut
+  // into smaller batches)
+  static const int DEFAULT_BATCH_TRIANGLES = 64 * 1024;
+
+  explicit ObjStreamer(int batch_triangles = DEFAULT_BATCH_TRIANGLES);
+  ~ObjStreamer();
+
+  ObjStreamer(const ObjStreamer&) = delete;
+  ObjStreamer& operator=(const ObjStreamer&) = delete;
+
+  /**
+   * Opens a .obj and starts reading it in the background.
+   *
+   * @param filename  the filename
+   * @return  EXIT_SUCCESS if the file could be opened
+   */
+  int start(const std::string& filename);
+
+  /**
+   * Waits for the next batch, in file order.
+   *
+   * @return  the batch, or nullptr once the whole file has been handed over
+   */
+  MeshBatch* next();
+
+  // gives a batch from next() back to be refilled
+  void release(MeshBatch* batch);
+
+  // size of the .obj in bytes (after start), to size buffers up front
+  size_t source_size() const { return m_file.size(); }
+
+  // these are only meaningful after next() has returned nullptr
+  int status() const { return m_status; }
+  std::string get_mtllib() const { return m_basedir + m_mtllib; }
+  const std::vector<MaterialRange>& get_materials() const
+  {
+    return m_materials;
+  }
+  int num_vertices() const { return m_numVertices; }
+  int num_indices() const { return m_numIndices; }
+
+private:
+  void run();
+  MeshBatch* acquire();
+  void stop();
+
+  const int m_batchTriangles;
+
+  MappedFile m_file;
+  std::thread m_worker;
+
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::vector<std::unique_ptr<MeshBatch>> m_batches;  // owns all of them
+  std::vector<MeshBatch*> m_free;
+  std::deque<MeshBatch*> m_ready;
+  bool m_done;
+  bool m_stopping;
+
+  int m_status;
+  std::string m_basedir;
+  std::string m_mtllib;
+  std::vector<MaterialRange> m_materials;
+  int m_numVertices;
+  int m_numIndices;
+};
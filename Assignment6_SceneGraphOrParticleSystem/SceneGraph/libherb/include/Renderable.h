@@ -3,8 +3,21 @@
 #include <QtCore>
 #include <QtGui>
 #include <QtOpenGL>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Light.h"
+#include "MeshData.h"
+#include "MtlLoader.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "Util.h"
+
+class ObjStreamer;
+struct MeshBatch;
 
 class Renderable {
 protected:
@@ -14,28 +27,61 @@ protected:
   // For now, we have only one shader per object
   QOpenGLShaderProgram m_shader;
 
-  QOpenGLTexture m_texture;
-  QOpenGLTexture m_normalmap;
+  // the textures and lighting terms one draw range is drawn with
+  struct DrawMaterial {
+    int diffuse;  // into m_textures
+    int normal;
+    int specular;
+    float shininess;
+  };
+
+  // a slice of the ibo drawn with one material
+  struct DrawRange {
+    int material;  // into m_materials
+    int firstIndex;
+    int numIndices;
+  };
+
+  // a texture still being decoded, and the slot its placeholder holds till
+  // then (placeholders of one color are one texture, so they're told apart
+  // by slot)
+  struct PendingTexture {
+    TextureLoader::Future decoded;
+    int slot;  // into m_textures
+    std::string file;
+    MipKind kind;
+  };
+
+  // one per image (or per placeholder); shared with other Renderables
+  // through m_textureCache
+  std::vector<TextureCache::Texture> m_textures;
+  std::vector<DrawMaterial> m_materials;
+  std::vector<DrawRange> m_drawRanges;  // grouped by material
 
   QOpenGLBuffer m_vbo;
   QOpenGLBuffer m_ibo;
   QOpenGLVertexArrayObject m_vao;
 
+  // decodes textures in the background if set; otherwise they're loaded
+  // before init returns
+  TextureLoader* m_textureLoader;
+  std::vector<PendingTexture> m_pending;
+
+  // shares textures with every Renderable using the same one, if set
+  TextureCache* m_textureCache;
+
   // Keep track of how many triangles we actually have to draw in our ibo
   unsigned int m_numTris;
-  int m_vertexSize;
+  int m_vertexSize;    // bytes per vertex in the vbo
+  GLenum m_indexType;  // GL_UNSIGNED_SHORT while every vertex fits, or INT
 
   // Define our axis of rotation for animation
   QVector3D m_rotationAxis;
   float m_rotationSpeed;
   float m_rotationAngle;
 
-  QVector<QVector3D> m_positions;
-  QVector<QVector3D> m_normals;
-  QVector<QVector2D> m_texCoords;
-  QVector<QVector3D> m_tangents;
-  QVector<QVector3D> m_bitangents;
-  QVector<unsigned int> m_indexes;
+  // what init() uploads; let go of once it's on the GPU
+  MeshData m_mesh;
   QString m_textureFile;
   QString m_normalMap;
 
@@ -47,28 +93,105 @@ protected:
   virtual void createShaders();
 
   /**
-   * @brief Draw call
+   * @brief Draw call for one range of the ibo
    *
-   * Override this to change the draw call.
+   * Override this to change the draw call. The range's textures are already
+   * bound.
    */
-  virtual void drawCall() const;
+  virtual void drawCall(int firstIndex, int numIndices) const;
+
+  // A texture with levels as its mip chain (what setData(QImage,
+  // GenerateMipMaps) set up, with the levels from the CPU).
+  static QOpenGLTexture* createTexture(
+      const std::vector<MipCache::Level>& levels);
+
+  // A 1x1 texture of one color.
+  static QOpenGLTexture* createTexture(QRgb color);
+
+  // The 1x1 texture of color, shared through m_textureCache if set (solids
+  // is what's been made so far, by color).
+  TextureCache::Texture solidTexture(
+      QRgb color, std::map<QRgb, TextureCache::Texture>& solids);
+
+  // The m_textures slot for one map (loaded is the slots so far, by file, or
+  // by missing color for a 1x1 one). With a loader, a slot of its own with
+  // a placeholder of the missing color until the image is decoded and
+  // uploaded.
+  int loadTexture(const std::string& file, QRgb missing, MipKind kind,
+                  std::map<std::string, int>& loaded,
+                  std::map<QRgb, TextureCache::Texture>& solids);
+
+  // Wraps a texture just made from file, sharing it through m_textureCache
+  // (which hands back the one it has instead, if there is one).
+  TextureCache::Texture shareTexture(const std::string& file, MipKind kind,
+                                     QOpenGLTexture* texture, size_t bytes);
+
+  // Loads the diffuse texture and normal map, for the whole mesh.
+  void initTextures(const QString& textureFile, const QString& normalMap);
+
+  // Loads the textures of every material the ranges use and sets up one draw
+  // per range, grouped by material so each material is bound only once. With
+  // no ranges the whole mesh is drawn with the first material. Needs
+  // m_numTris set.
+  void initMaterials(const std::vector<Material>& materials,
+                     const std::vector<MaterialRange>& ranges);
+
+  // Sets m_numTris, fills the buffers and hooks up the vertex layout.
+  void initGeometry(const Util::CompactVertex* vertices, int numVerts,
+                    const unsigned int* indexes, int numIndexes);
+
+  // Same, with the vertices Util::VERTEX_FLOATS each (packed on the way).
+  void initGeometry(const float* vertices, int numVerts,
+                    const unsigned int* indexes, int numIndexes);
+
+  // Creates the shaders, vao, vbo and ibo, with the buffers sized for
+  // numVerts / numIndexes. The vertices go up as they are, and the indices
+  // as 16 bit ones if numVerts allows. Null data leaves them unfilled.
+  void initBuffers(const Util::CompactVertex* vertices, int numVerts,
+                   const unsigned int* indexes, int numIndexes);
+
+  // Points the shader attributes at the bound vbo (vao must be bound).
+  void setAttributes();
+
+  // bytes per index in the ibo
+  int indexSize() const;
+
+  // Turns the bound ibo's first numIndexes 16 bit indices into 32 bit ones,
+  // leaving room for capacity. False if the ibo can't be read back.
+  bool widenIndices(int numIndexes, int capacity);
 
 public:
   Renderable();
   virtual ~Renderable();
 
-  void setPositions(const QVector<QVector3D>& positions) { m_positions = positions; }
-  void setNormals(const QVector<QVector3D>& normals) { m_normals = normals; }
-  void setTexCoords(const QVector<QVector2D>& texCoords) { m_texCoords = texCoords; }
-  void setTangents(const QVector<QVector3D>& tangents) { m_tangents = tangents; }
-  void setBitangents(const QVector<QVector3D>& bitangents) { m_bitangents = bitangents; }
-  void setIndexes(const QVector<unsigned int>& indexes) { m_indexes = indexes; }
+  // takes the mesh over; std::move it in rather than copying
+  void setMesh(MeshData mesh) { m_mesh = std::move(mesh); }
   void setTextureFile(const QString& textureFile) { m_textureFile = textureFile; }
   void setNormalMap(const QString& normalMap) { m_normalMap = normalMap; }
 
+  // textures are decoded on loader (which has to outlive this) from the next
+  // init on; null loads them right away
+  void setTextureLoader(TextureLoader* loader) { m_textureLoader = loader; }
+
+  // textures are shared through cache (which has to outlive this) from the
+  // next init on; null keeps them to this Renderable
+  void setTextureCache(TextureCache* cache) { m_textureCache = cache; }
+
+  // Uploads the textures that have finished decoding, as far as the loader's
+  // budget goes this frame. draw() calls it.
+  void uploadTextures();
+
+  // true while a texture is still drawn with its placeholder
+  bool texturesPending() const { return !m_pending.empty(); }
+
   // WARNING! if you use this method you should use all the above set methods first!
   virtual void init();
 
+  // Uploads the mesh as it is, working out the tangents from its uvs. Only
+  // reads it, so it can be freed (or reused) right after.
+  virtual void init(const MeshData& mesh, const QString& textureFile,
+                    const QString& normalMap);
+
   // When we initialize our renderable, we pass it normals.  We
   // currently don't use normals in our implementation, but the array is checked
   // for the appropriate size.  The values can be all 0, but must be the same
@@ -80,6 +203,22 @@ public:
                     const QVector<QVector3D>& bitangents,
                     const QVector<unsigned int>& indexes,
                     const QString& textureFile, const QString& normalMap);
+
+  // Same as above, but with the vertices already interleaved the way
+  // Util::InterleaveVertices packs them (Util::VERTEX_FLOATS per vertex).
+  // The data is copied to the GPU, so it only has to live through the call.
+  virtual void init(const float* vertices, int numVerts,
+                    const unsigned int* indexes, int numIndexes,
+                    const QString& textureFile, const QString& normalMap);
+
+  // Fills the buffers from a started ObjStreamer, one batch at a time while
+  // it's still parsing, so the mesh never has to be whole in memory. onBatch
+  // (if any) sees each batch after it's uploaded. Textures are left to the
+  // caller (see initTextures), since the .mtl is only known at the end.
+  // Returns the streamer's status.
+  virtual int init(ObjStreamer& stream,
+                   const std::function<void(const MeshBatch&)>& onBatch =
+                       nullptr);
   virtual void update(const qint64 msSinceLastFrame);
   virtual void draw(const QMatrix4x4& world, const QMatrix4x4& view,
                     const QMatrix4x4& projection,
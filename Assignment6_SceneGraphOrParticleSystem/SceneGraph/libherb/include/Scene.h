@@ -32,8 +32,9 @@ public:
   void draw(const QMatrix4x4& view, const QMatrix4x4& projection,
             const QVector<Light*>& lights);
 
-  // init all the renderables in the tree
-  void init();
+  // init all the renderables in the tree, decoding their textures on loader
+  // and sharing them through cache, if given
+  void init(TextureLoader* loader = nullptr, TextureCache* cache = nullptr);
 
   QMatrix4x4 localTransform() { return m_localTransform; }
 
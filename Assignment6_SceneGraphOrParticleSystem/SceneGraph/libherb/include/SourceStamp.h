@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief What the binary caches (.herbmesh, .herbmip) remember about the file
+ * they were made from, to tell whether it has changed since.
+ *
+ * A cache stays good while its source has the same size and mtime. If the
+ * mtime moved but the size didn't (a fresh checkout, say), a content hash of
+ * the source decides.
+ */
+struct SourceStamp {
+  int64_t mtime_ns;
+  uint64_t size;
+  uint64_t hash;  // FNV-1a of the source file
+};
+
+// absolute path with no symlinks or ".." in it (or the path as given)
+std::string canonical_path(const std::string& path);
+
+/**
+ * Stamps a source file.
+ *
+ * @param filename  the source
+ * @param stamp  (output) its mtime, size and hash
+ * @return  false if it can't be read
+ */
+bool stamp_source(const std::string& filename, SourceStamp& stamp);
+
+/**
+ * Checks a source file against the stamp it had when a cache was made.
+ *
+ * @param filename  the source
+ * @param stamp  what it was
+ * @return  true if it (still) has the same size and mtime or contents
+ */
+bool source_unchanged(const std::string& filename, const SourceStamp& stamp);
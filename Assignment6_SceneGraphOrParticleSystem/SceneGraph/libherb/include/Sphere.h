@@ -27,20 +27,13 @@ public:
   void init();
 
   // Getters for our data.
-  QVector<QVector3D> positions() const { return positions_; }
-  QVector<QVector3D> normals() const { return normals_; }
-  QVector<QVector2D> texCoords() const { return textureCoords_; }
-  QVector<QVector3D> tangents() const { return positions_; }
-  QVector<QVector3D> bitangents() const { return normals_; }
-  QVector<unsigned int> indexes() const { return index_; }
+  const QVector<QVector3D>& positions() const { return mesh_.positions; }
+  const QVector<QVector3D>& normals() const { return mesh_.normals; }
+  const QVector<QVector2D>& texCoords() const { return mesh_.texCoords; }
+  const QVector<unsigned int>& indexes() const { return mesh_.indices; }
 
 private:
-  QVector<QVector3D> positions_;
-  QVector<QVector3D> normals_;
-  QVector<QVector2D> textureCoords_;
-  QVector<QVector3D> tangents_;
-  QVector<QVector3D> bitangents_;
-  QVector<unsigned int> index_;
+  MeshData mesh_;
   std::string m_texture;
 
   void calculatePoints();
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "MipPyramid.h"
+#include "SourceStamp.h"
+
+class QOpenGLTexture;
+
+/**
+ * @brief GL textures shared by every Renderable that draws the same image
+ *
+ * Textures are found by the image's canonical path (so "a/../rock.ppm" and
+ * "rock.ppm" are one image) and, for a path not seen before, by content:
+ * copies of an image under other names share one texture too. A path whose
+ * file has changed since is looked up again by its new content.
+ *
+ * The 1x1 textures of one color (what maps with no image, or whose image is
+ * still decoding, are drawn with) are shared too, by color.
+ *
+ * The cache doesn't own the textures: each stays while a Renderable holds
+ * it and goes with the last one. It only hands out the live ones. Textures
+ * must be released on the GL thread, with the context current.
+ */
+class TextureCache {
+public:
+  typedef std::shared_ptr<QOpenGLTexture> Texture;
+
+  struct Stats {
+    size_t requests;     // find() calls
+    size_t hits;         // ... that found a texture (then or on find_again)
+    size_t textures;     // live textures (1x1 ones included)
+    size_t bytes;        // in the live textures
+    size_t bytes_saved;  // the copies each extra holder would have uploaded
+  };
+
+  TextureCache();
+
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  /**
+   * Looks an image up, counting it as a request (and a hit if it's there).
+   *
+   * @param file  the image
+   * @param kind  what it was loaded as (the same image averaged down another
+   *              way is another texture)
+   * @return  its texture, or null if it isn't loaded (or can't be read)
+   */
+  Texture find(const std::string& file, MipKind kind);
+
+  // Looks up an image find() missed earlier (while it was still decoding,
+  // say). A texture found now makes that request a hit after all.
+  Texture find_again(const std::string& file, MipKind kind);
+
+  /**
+   * Shares a texture just made from an image from now on.
+   *
+   * @param file  the image
+   * @param kind  what it was loaded as
+   * @param texture  its texture
+   * @param bytes  what the texture holds on the GPU
+   * @return  the texture to use: the one already there if another holder
+   *          added the image first, or texture
+   */
+  Texture add(const std::string& file, MipKind kind, Texture texture,
+              size_t bytes);
+
+  // The live 1x1 texture of color (0xAARRGGBB), or null. Not counted as a
+  // request.
+  Texture find_solid(uint32_t color);
+
+  // Shares a 1x1 texture of color from now on; returns the one already
+  // there if another holder added it first, or texture.
+  Texture add_solid(uint32_t color, Texture texture);
+
+  Stats stats() const;
+
+private:
+  // an image's contents, as loaded as one kind
+  typedef std::tuple<uint64_t, uint64_t, MipKind> ContentKey;  // size, hash
+
+  struct PathEntry {
+    SourceStamp stamp;  // of the file when it was last looked at
+    ContentKey content;
+  };
+
+  struct ContentEntry {
+    std::weak_ptr<QOpenGLTexture> texture;
+    size_t bytes;
+  };
+
+  // the content file has now (noting it for its path), false if it can't be
+  // read
+  bool content_of(const std::string& file, MipKind kind, ContentKey& content);
+
+  // the live texture with file's contents, or null
+  Texture lookup(const std::string& file, MipKind kind);
+
+  // drops the entries whose textures are gone
+  void prune();
+
+  std::map<std::pair<std::string, MipKind>, PathEntry> m_paths;
+  std::map<ContentKey, ContentEntry> m_contents;
+  std::map<uint32_t, std::weak_ptr<QOpenGLTexture>> m_solids;  // by color
+
+  size_t m_requests;
+  size_t m_hits;
+};
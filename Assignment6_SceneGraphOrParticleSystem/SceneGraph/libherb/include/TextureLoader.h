@@ -0,0 +1,108 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MipPyramid.h"
+
+// the filter texture mip chains are built with
+const MipFilter TEXTURE_MIP_FILTER = MipFilter::KAISER;
+
+/**
+ * @brief An image made ready to upload: its whole mip chain, mapped from its
+ * .herbmip cache or built from the image (and cached)
+ */
+struct DecodedTexture {
+  MipCache cache;                       // the levels, if they were cached
+  std::vector<MipLevel> built;          // the levels, if they were built
+  std::vector<MipCache::Level> levels;  // empty if the image can't be read
+
+  bool ok() const { return !levels.empty(); }
+
+  // bytes in all the levels
+  size_t bytes() const;
+};
+
+/**
+ * Reads an image's mip chain from its cache, or decodes the image and builds
+ * it (writing the cache for next time). Only touches the file system and
+ * QImage, so it's fine on any thread.
+ *
+ * @param file  the image
+ * @param kind  what the image holds, for averaging it down
+ * @param out  (output) the chain, with no levels if the image can't be read
+ */
+void decode_texture(const std::string& file, MipKind kind,
+                    DecodedTexture& out);
+
+/**
+ * @brief Decodes textures on worker threads, and meters out how much of them
+ * the GL thread uploads per frame
+ *
+ * decode() queues an image and hands back a future of its DecodedTexture;
+ * images are decoded in the order they were asked for, and one asked for
+ * again before it's done is only decoded once. Renderables given a
+ * loader draw with a placeholder until their texture is ready, then upload
+ * it on the GL thread, as long as spend_upload() lets them this frame.
+ */
+class TextureLoader {
+public:
+  typedef std::shared_future<std::shared_ptr<const DecodedTexture>> Future;
+
+  // bytes the GL thread may upload per frame unless told otherwise
+  static const size_t DEFAULT_UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+  // threads = 0 starts one worker per core
+  explicit TextureLoader(unsigned threads = 0);
+
+  // drops what's still queued (those futures get a texture with no levels)
+  // and waits for the decodes already running
+  ~TextureLoader();
+
+  TextureLoader(const TextureLoader&) = delete;
+  TextureLoader& operator=(const TextureLoader&) = delete;
+
+  // queues an image to be decoded (see decode_texture), unless it's queued
+  // or being decoded already
+  Future decode(const std::string& file, MipKind kind);
+
+  // how many images haven't started decoding yet
+  size_t queued() const;
+
+  // starts a frame: uploads may use up to budget bytes from now on
+  void begin_frame(size_t budget = DEFAULT_UPLOAD_BUDGET);
+
+  // true if bytes may go up this frame, and counts them; the first upload of
+  // a frame always may, however big
+  bool spend_upload(size_t bytes);
+
+private:
+  struct Job {
+    std::string file;
+    MipKind kind;
+    std::promise<std::shared_ptr<const DecodedTexture>> result;
+  };
+
+  void run();
+
+  std::vector<std::thread> m_workers;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::deque<Job> m_jobs;
+  std::map<std::pair<std::string, MipKind>, Future> m_unfinished;
+  bool m_stopping;
+
+  // GL thread only
+  size_t m_budget;
+  size_t m_spent;
+};
@@ -22,7 +22,7 @@ protected:
   virtual void createShaders() override;
 
   // Override to use glDrawArrayInstance
-  virtual void drawCall() const override;
+  virtual void drawCall(int firstIndex, int numIndices) const override;
 
 private:
   QVector<QVector3D> m_positions;
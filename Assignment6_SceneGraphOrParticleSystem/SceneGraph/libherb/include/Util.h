@@ -1,9 +1,82 @@
 #pragma once
 
 #include <QtGui>
+#include <cstdint>
+#include <vector>
+
+#include "MeshData.h"
 
 namespace Util {
 
+// floats per vertex in the buffer Renderable uploads:
+// position (3) + normal (3) + texCoord (2) + tangent (3) + bitangent (3)
+const int VERTEX_FLOATS = 3 + 3 + 2 + 3 + 3;
+
+/**
+ * @brief One vertex the way Renderable uploads it (vert.glsl unpacks it)
+ *
+ * 24 bytes against the 56 of VERTEX_FLOATS floats. The position stays as it
+ * is; the uv is two half floats; the normal and tangent are octahedral
+ * encoded into two snorm16 each. The bitangent is only which side of the
+ * normal/tangent plane it points to, folded into tangent[1] (see
+ * PackVertices).
+ */
+struct CompactVertex {
+  float position[3];
+  uint16_t texCoord[2];  // half floats
+  int16_t normal[2];     // octahedral, snorm16
+  int16_t tangent[2];    // octahedral, snorm16, with the bitangent sign
+};
+
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex must be packed");
+
+// IEEE half float conversions (rounding to nearest even)
+uint16_t FloatToHalf(float f);
+float HalfToFloat(uint16_t h);
+
+/**
+ * @brief Octahedral encoding of a direction into two snorm16
+ *
+ * Doesn't have to be normalized. A zero (or NaN) vector comes out as +z.
+ */
+void OctEncode(const QVector3D& v, int16_t out[2]);
+
+// the unit vector two octahedral coordinates in [-1, 1] stand for
+QVector3D OctDecode(float x, float y);
+
+/**
+ * @brief Packs vertices interleaved like InterleaveVertices does into
+ * CompactVertex
+ *
+ * @param vertices  numVerts * VERTEX_FLOATS floats
+ * @param numVerts  how many vertices
+ * @param out       (output variable) numVerts vertices
+ */
+void PackVertices(const float* vertices, int numVerts, CompactVertex* out);
+
+/**
+ * @brief Unpacks a CompactVertex the same way vert.glsl does
+ *
+ * The bitangent comes back as the cross product of the normal and the
+ * tangent, turned to the side the original pointed to.
+ */
+void UnpackVertex(const CompactVertex& v, QVector3D& position,
+                  QVector3D& normal, QVector2D& texCoord, QVector3D& tangent,
+                  QVector3D& bitangent);
+
+/**
+ * @brief Calculates the tangent and bitangent of a single triangle
+ *
+ * @param pos1, pos2, pos3  its corners
+ * @param uv1, uv2, uv3     their texture coordinates
+ * @param tangent    (output variable) normalized tangent
+ * @param bitangent  (output variable) normalized bitangent
+ */
+void CalculateTangent(const QVector3D& pos1, const QVector3D& pos2,
+                      const QVector3D& pos3, const QVector2D& uv1,
+                      const QVector2D& uv2, const QVector2D& uv3,
+                      QVector3D& tangent, QVector3D& bitangent);
+
 /**
  * @brief Calculates the tangent and bitangent vectors
  *
@@ -21,4 +94,36 @@ void CalculateTangents(const QVector<QVector3D>& vertices,
                        QVector<QVector3D>& out_tangents,
                        QVector<QVector3D>& out_bitangents);
 
-}  // namespace Util
\ No newline at end of file
+/**
+ * @brief Packs the vertex attributes into one interleaved buffer
+ *
+ * @param positions  n elements
+ * @param normals    n elements, lined up with positions
+ * @param texcoords  n elements, lined up with positions
+ * @param tangents   m / 3 elements, one per face (see CalculateTangents)
+ * @param bitangents m / 3 elements, one per face (see CalculateTangents)
+ * @param indices    m elements
+ * @param out        (output variable) n * VERTEX_FLOATS floats. A vertex
+ *                   shared by several faces gets the first face's tangents.
+ */
+void InterleaveVertices(const QVector<QVector3D>& positions,
+                        const QVector<QVector3D>& normals,
+                        const QVector<QVector2D>& texcoords,
+                        const QVector<QVector3D>& tangents,
+                        const QVector<QVector3D>& bitangents,
+                        const QVector<unsigned int>& indices,
+                        std::vector<float>& out);
+
+/**
+ * @brief Packs a mesh into one interleaved buffer, working out the tangents
+ * on the way
+ *
+ * Gives the same floats as CalculateTangents followed by InterleaveVertices,
+ * without the two per-face tangent arrays in between.
+ *
+ * @param mesh  the mesh, read in place
+ * @param out   (output variable) mesh.positions.size() * VERTEX_FLOATS floats
+ */
+void InterleaveMesh(const MeshData& mesh, std::vector<float>& out);
+
+}  // namespace Util
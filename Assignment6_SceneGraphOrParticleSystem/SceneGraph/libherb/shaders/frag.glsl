@@ -29,7 +29,8 @@ struct Light {
   vec3 specular;
 };
 
-vec3 ComputeLighting(Light light, vec3 norm, vec3 fragPos, vec3 viewDir) {
+vec3 ComputeLighting(Light light, vec3 norm, vec3 fragPos, vec3 viewDir,
+                     vec3 specColor, float shininess) {
   vec3 lightDir = normalize(light.position - fragPos);
 
   // diffuse
@@ -37,12 +38,12 @@ vec3 ComputeLighting(Light light, vec3 norm, vec3 fragPos, vec3 viewDir) {
 
   // specular
   vec3 reflectDir = reflect(-lightDir, norm);
-  float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+  float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
 
   // combine
   vec3 ambient = light.ambient * light.ambientIntensity;
   vec3 diffuse = light.diffuse * diff * light.diffuseIntensity;
-  vec3 specular = light.specular * spec * light.specularIntensity;
+  vec3 specular = light.specular * spec * specColor * light.specularIntensity;
 
   // attenuation
   float distance = length(light.position - fragPos);
@@ -55,6 +56,8 @@ vec3 ComputeLighting(Light light, vec3 norm, vec3 fragPos, vec3 viewDir) {
 // Maintain our uniforms.
 uniform sampler2D diffuseMap;              // our primary texture
 uniform sampler2D normalMap;        // normal map
+uniform sampler2D specularMap;      // specular color
+uniform float shininess;            // specular exponent of the material
 
 uniform vec3 viewPos;               // can't calculate from view
 uniform Light lights[MAX_LIGHTS];  // Our lights
@@ -68,13 +71,16 @@ void main() {
   normal = normal * 2.0 - 1.0;
   normal = normalize(TBN * normal);
 
+  vec3 specColor = texture(specularMap, texCoords).rgb;
+
   // Calculate viewDir
   vec3 viewDir = normalize(viewPos - fragPos);
 
   vec3 lighting = vec3(0.0, 0.0, 0.0);
 
   for (int i = 0; i < numLights; i++)
-    lighting += ComputeLighting(lights[i], normal, fragPos, viewDir);
+    lighting += ComputeLighting(lights[i], normal, fragPos, viewDir,
+                                specColor, shininess);
 
   // final color + how dark or light
   fragColor = vec4(diffuse * lighting, 1.0);
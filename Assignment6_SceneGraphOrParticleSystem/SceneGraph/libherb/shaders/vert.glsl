@@ -1,9 +1,10 @@
 #version 330
+// Renderable uploads Util::CompactVertex: normal and tangent are octahedral
+// encoded, and the tangent's y also carries which way the bitangent points.
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec2 normal;
 layout(location = 2) in vec2 textureCoords;
-layout(location = 3) in vec3 tanget;
-layout(location = 4) in vec3 bitangent;
+layout(location = 3) in vec2 tangent;
 
 // We now have our camera system set up.
 uniform mat4 modelMatrix;
@@ -15,6 +16,24 @@ out vec2 texCoords;
 out vec3 fragPos;
 out mat3 TBN; // for normals
 
+// one step of a snorm16, which the tangent's y is shifted off zero by
+const float SIGN_OFFSET = 1.0 / 32767.0;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// same as Util::OctDecode
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+    }
+    return normalize(v);
+}
+
 void main()
 {
     // We have our transformed position set properly now
@@ -23,13 +42,22 @@ void main()
     // Our fragment pos for lighting.
     fragPos = (modelMatrix*vec4(position, 1.0)).xyz;
 
+    // unpack the tangent frame (see Util::UnpackVertex)
+    float side = tangent.y < 0.0 ? -1.0 : 1.0;
+    vec2 tanOct = vec2(tangent.x,
+                       (abs(tangent.y) - SIGN_OFFSET) / (1.0 - SIGN_OFFSET) * 2.0 - 1.0);
+
+    vec3 n = octDecode(normal);
+    vec3 t = octDecode(tanOct);
+    vec3 b = side * cross(n, t);
+
     // calculate tbn matrix
-    vec3 T = normalize(vec3(modelMatrix * vec4(tanget,    0.0)));
-    vec3 B = normalize(vec3(modelMatrix * vec4(bitangent, 0.0)));
-    vec3 N = normalize(vec3(modelMatrix * vec4(normal,    0.0)));
+    vec3 T = normalize(vec3(modelMatrix * vec4(t, 0.0)));
+    vec3 B = normalize(vec3(modelMatrix * vec4(b, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(n, 0.0)));
 
     TBN = mat3(T, B, N);
 
     // And we map our texture coordinates as appropriate
     texCoords = textureCoords;
-}
\ No newline at end of file
+}
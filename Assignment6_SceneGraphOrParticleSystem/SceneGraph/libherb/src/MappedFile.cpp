@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <utility>
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_open(false) {}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_open(std::exchange(other.m_open, false))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    close();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_open = std::exchange(other.m_open, false);
+  }
+  return *this;
+}
+
+int MappedFile::open(const std::string& filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return EXIT_FAILURE;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return EXIT_FAILURE;
+  }
+
+  m_size = static_cast<size_t>(st.st_size);
+
+  if (m_size > 0) {
+    void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      m_size = 0;
+      return EXIT_FAILURE;
+    }
+
+    // we read front to back exactly once
+    madvise(addr, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(addr);
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  m_open = true;
+
+  return EXIT_SUCCESS;
+}
+
+void MappedFile::close()
+{
+  if (m_data) {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+  m_data = nullptr;
+  m_size = 0;
+  m_open = false;
+}
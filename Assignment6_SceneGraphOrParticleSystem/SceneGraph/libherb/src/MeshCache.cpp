@@ -0,0 +1,342 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "ObjLoader.h"
+#include "SourceStamp.h"
+#include "Util.h"
+
+const char HERBMESH_MAGIC[8] = {'H', 'E', 'R', 'B', 'M', 'E', 'S', 'H'};
+const uint32_t HERBMESH_VERSION = 4;
+const char* HERBMESH_EXTENSION = ".herbmesh";
+
+// The file is a HerbMeshHeader, the source path, zero padding up to a
+// multiple of 16 bytes, the vertices, the indices, the mtllib path and then
+// the material ranges (first index, index count and name length as uint32_t,
+// then the name). Nothing before the vertices depends on the mesh, so
+// MeshCacheWriter can write them as they come.
+
+static size_t align16(size_t n) { return (n + 15) & ~static_cast<size_t>(15); }
+
+// the material ranges as they go in the file
+static std::string write_materials(const std::vector<MaterialRange>& materials)
+{
+  std::string out;
+
+  for (const MaterialRange& range : materials) {
+    const uint32_t fields[3] = {range.first_index, range.num_indices,
+                                static_cast<uint32_t>(range.material.size())};
+    out.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+    out.append(range.material);
+  }
+
+  return out;
+}
+
+// reads count ranges back out of [data, data + size), checking that they
+// fill it exactly and stay inside num_indices
+static bool read_materials(const char* data, size_t size, uint32_t count,
+                           uint32_t num_indices,
+                           std::vector<MaterialRange>& out)
+{
+  out.clear();
+  out.reserve(count);
+
+  const char* const end = data + size;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t fields[3];
+    if (static_cast<size_t>(end - data) < sizeof(fields)) {
+      return false;
+    }
+    memcpy(fields, data, sizeof(fields));
+    data += sizeof(fields);
+
+    if (static_cast<size_t>(end - data) < fields[2] ||
+        fields[0] > num_indices || fields[1] > num_indices - fields[0]) {
+      return false;
+    }
+
+    out.push_back({std::string(data, fields[2]), fields[0], fields[1]});
+    data += fields[2];
+  }
+
+  return data == end;
+}
+
+MeshCache::MeshCache()
+    : m_file(),
+      m_mtllib(),
+      m_materials(),
+      m_vertices(nullptr),
+      m_indices(nullptr),
+      m_numVertices(0),
+      m_numIndices(0)
+{
+}
+
+std::string MeshCache::cache_path(const std::string& source)
+{
+  return source + HERBMESH_EXTENSION;
+}
+
+int MeshCache::bake(const std::string& source, BakedMesh& out, bool optimize,
+                    MeshOptimizeStats* stats)
+{
+  ObjLoader obj;
+  if (obj.parse_file(source) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  MeshData mesh = obj.take_mesh();
+  if (optimize) {
+    const MeshOptimizeStats optimized = optimize_mesh(mesh);
+    if (stats) {
+      *stats = optimized;
+    }
+  }
+
+  Util::InterleaveMesh(mesh, out.vertices);
+
+  // the attributes are all in out.vertices now
+  mesh.positions = QVector<QVector3D>();
+  mesh.normals = QVector<QVector3D>();
+  mesh.texCoords = QVector<QVector2D>();
+
+  out.indices.assign(mesh.indices.begin(), mesh.indices.end());
+  out.materials = std::move(mesh.materials);
+  out.mtllib = obj.get_mtllib();
+
+  return EXIT_SUCCESS;
+}
+
+int MeshCache::write(const std::string& source, const BakedMesh& mesh)
+{
+  const size_t numVertices = mesh.vertices.size() / Util::VERTEX_FLOATS;
+  std::vector<Util::CompactVertex> packed(numVertices);
+  Util::PackVertices(mesh.vertices.data(), static_cast<int>(numVertices),
+                     packed.data());
+
+  MeshCacheWriter writer;
+
+  if (writer.begin(source) != EXIT_SUCCESS ||
+      writer.add(packed.data(), numVertices, mesh.indices.data(),
+                 mesh.indices.size()) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  return writer.finish(mesh.mtllib, mesh.materials);
+}
+
+int MeshCache::open(const std::string& source)
+{
+  close();
+
+  if (m_file.open(cache_path(source)) != EXIT_SUCCESS ||
+      m_file.size() < sizeof(HerbMeshHeader)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  HerbMeshHeader header;
+  memcpy(&header, m_file.data(), sizeof(header));
+
+  if (memcmp(header.magic, HERBMESH_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != HERBMESH_VERSION ||
+      header.vertex_size != sizeof(Util::CompactVertex)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  // make sure everything the header promises is really in the file
+  const size_t vertices_offset =
+      align16(sizeof(header) + static_cast<size_t>(header.source_path_len));
+  const size_t indices_offset =
+      vertices_offset +
+      static_cast<size_t>(header.num_vertices) * header.vertex_size;
+  const size_t mtllib_offset =
+      indices_offset + static_cast<size_t>(header.num_indices) *
+                           sizeof(unsigned int);
+  const size_t materials_offset = mtllib_offset + header.mtllib_len;
+  const size_t file_end = materials_offset + header.materials_len;
+
+  if (file_end != m_file.size()) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  const std::string path(m_file.data() + sizeof(header),
+                         header.source_path_len);
+
+  const SourceStamp stamp = {header.source_mtime_ns, header.source_size,
+                             header.source_hash};
+  if (path != canonical_path(source) || !source_unchanged(source, stamp)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  if (!read_materials(m_file.data() + materials_offset, header.materials_len,
+                      header.num_materials, header.num_indices,
+                      m_materials)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  m_mtllib.assign(m_file.data() + mtllib_offset, header.mtllib_len);
+  m_vertices = reinterpret_cast<const Util::CompactVertex*>(m_file.data() +
+                                                            vertices_offset);
+  m_indices =
+      reinterpret_cast<const unsigned int*>(m_file.data() + indices_offset);
+  m_numVertices = header.num_vertices;
+  m_numIndices = header.num_indices;
+
+  return EXIT_SUCCESS;
+}
+
+void MeshCache::close()
+{
+  m_file.close();
+  m_mtllib.clear();
+  m_materials.clear();
+  m_vertices = nullptr;
+  m_indices = nullptr;
+  m_numVertices = 0;
+  m_numIndices = 0;
+}
+
+MeshCacheWriter::MeshCacheWriter()
+    : m_source(), m_header(), m_out(), m_indices(), m_open(false)
+{
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+  if (m_open) {
+    discard();
+  }
+}
+
+int MeshCacheWriter::begin(const std::string& source)
+{
+  if (m_open) {
+    discard();
+  }
+
+  m_source = source;
+  m_header = HerbMeshHeader();
+  memcpy(m_header.magic, HERBMESH_MAGIC, sizeof(m_header.magic));
+  m_header.version = HERBMESH_VERSION;
+  m_header.vertex_size = sizeof(Util::CompactVertex);
+
+  SourceStamp stamp;
+  if (!stamp_source(source, stamp)) {
+    return EXIT_FAILURE;
+  }
+  m_header.source_mtime_ns = stamp.mtime_ns;
+  m_header.source_size = stamp.size;
+  m_header.source_hash = stamp.hash;
+
+  const std::string path = canonical_path(source);
+  m_header.source_path_len = static_cast<uint32_t>(path.size());
+
+  // write to the side and rename, so a reader never sees half a file
+  m_out.open(tmp_path(), std::ios::binary | std::ios::trunc);
+  m_indices.open(indices_path(),
+                 std::ios::binary | std::ios::trunc | std::ios::in |
+                     std::ios::out);
+  m_open = true;
+
+  if (!m_out || !m_indices) {
+    discard();
+    return EXIT_FAILURE;
+  }
+
+  // the real header goes in at the end, once the counts are known
+  const size_t strings_end = sizeof(m_header) + path.size();
+  const char padding[16] = {};
+
+  m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  m_out.write(path.data(), path.size());
+  m_out.write(padding, align16(strings_end) - strings_end);
+
+  return m_out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int MeshCacheWriter::add(const Util::CompactVertex* vertices,
+                         size_t numVertices, const unsigned int* indices,
+                         size_t numIndices)
+{
+  if (!m_open) {
+    return EXIT_FAILURE;
+  }
+
+  m_out.write(reinterpret_cast<const char*>(vertices),
+              numVertices * sizeof(Util::CompactVertex));
+  m_indices.write(reinterpret_cast<const char*>(indices),
+                  numIndices * sizeof(unsigned int));
+
+  m_header.num_vertices += static_cast<uint32_t>(numVertices);
+  m_header.num_indices += static_cast<uint32_t>(numIndices);
+
+  return (m_out && m_indices) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int MeshCacheWriter::finish(const std::string& mtllib,
+                            const std::vector<MaterialRange>& materials)
+{
+  if (!m_open) {
+    return EXIT_FAILURE;
+  }
+
+  const std::string ranges = write_materials(materials);
+
+  m_header.mtllib_len = static_cast<uint32_t>(mtllib.size());
+  m_header.num_materials = static_cast<uint32_t>(materials.size());
+  m_header.materials_len = static_cast<uint32_t>(ranges.size());
+
+  // the indices follow the vertices, then the mtllib and the materials, then
+  // the real header
+  m_indices.flush();
+  m_indices.seekg(0);
+  if (m_header.num_indices > 0) {
+    m_out << m_indices.rdbuf();
+  }
+  m_out.write(mtllib.data(), mtllib.size());
+  m_out.write(ranges.data(), ranges.size());
+  m_out.seekp(0);
+  m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  m_out.close();
+  m_indices.close();
+  std::remove(indices_path().c_str());
+
+  const std::string final_path = MeshCache::cache_path(m_source);
+  if (!m_out || std::rename(tmp_path().c_str(), final_path.c_str()) != 0) {
+    discard();
+    return EXIT_FAILURE;
+  }
+
+  m_open = false;
+  return EXIT_SUCCESS;
+}
+
+void MeshCacheWriter::discard()
+{
+  m_out.close();
+  m_indices.close();
+  std::remove(tmp_path().c_str());
+  std::remove(indices_path().c_str());
+  m_open = false;
+}
+
+std::string MeshCacheWriter::tmp_path() const
+{
+  return MeshCache::cache_path(m_source) + ".tmp";
+}
+
+std::string MeshCacheWriter::indices_path() const
+{
+  return MeshCache::cache_path(m_source) + ".idx.tmp";
+}
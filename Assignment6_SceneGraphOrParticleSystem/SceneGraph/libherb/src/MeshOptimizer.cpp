@@ -0,0 +1,405 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+// marks a vertex that hasn't been given a new index yet
+const unsigned int UNMAPPED_VERTEX = ~0u;
+
+/**
+ * @brief A FIFO cache of vertex indices
+ *
+ * Each vertex remembers the miss that brought it in; it is still cached as
+ * long as fewer than size misses came after that one.
+ */
+class FifoCache {
+public:
+  FifoCache(size_t num_vertices, int size)
+      : m_inserted(num_vertices, 0), m_misses(0), m_size(size)
+  {
+  }
+
+  // true on a miss
+  bool access(unsigned int v)
+  {
+    if (m_inserted[v] != 0 && m_misses - m_inserted[v] < m_size) {
+      return false;
+    }
+    m_misses++;
+    m_inserted[v] = m_misses;
+    return true;
+  }
+
+  // the three corners of a triangle, returning the misses
+  int access(const unsigned int* tri)
+  {
+    return access(tri[0]) + access(tri[1]) + access(tri[2]);
+  }
+
+  // empties the cache
+  void flush() { m_misses += m_size; }
+
+private:
+  std::vector<size_t> m_inserted;
+  size_t m_misses;
+  size_t m_size;
+};
+
+VertexCacheStats simulate_vertex_cache(const unsigned int* indices,
+                                       size_t num_indices,
+                                       size_t num_vertices, int cache_size)
+{
+  VertexCacheStats stats = {0, 0};
+  if (num_indices < 3) {
+    return stats;
+  }
+
+  FifoCache cache(num_vertices, cache_size);
+  std::vector<bool> used(num_vertices, false);
+  size_t misses = 0;
+  size_t num_used = 0;
+
+  for (size_t i = 0; i < num_indices; i++) {
+    if (!used[indices[i]]) {
+      used[indices[i]] = true;
+      num_used++;
+    }
+    misses += cache.access(indices[i]);
+  }
+
+  stats.acmr = static_cast<double>(misses) / (num_indices / 3);
+  stats.atvr = static_cast<double>(misses) / num_used;
+  return stats;
+}
+
+void optimize_vertex_cache(const unsigned int* indices, size_t num_indices,
+                           size_t num_vertices, int cache_size,
+                           unsigned int* out, std::vector<size_t>* clusters)
+{
+  if (clusters) {
+    clusters->clear();
+  }
+
+  // the triangles around each vertex, packed one vertex after the other
+  std::vector<size_t> offsets(num_vertices + 1, 0);
+  for (size_t i = 0; i < num_indices; i++) {
+    offsets[indices[i] + 1]++;
+  }
+  for (size_t v = 0; v < num_vertices; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+
+  std::vector<unsigned int> adjacency(num_indices);
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < num_indices; i++) {
+    adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+  }
+
+  // triangles each vertex still has to go
+  std::vector<int> live(num_vertices);
+  for (size_t v = 0; v < num_vertices; v++) {
+    live[v] = static_cast<int>(offsets[v + 1] - offsets[v]);
+  }
+
+  // Tipsify's timestamps: a vertex is cached while time - stamp <= cache_size
+  std::vector<int> stamp(num_vertices, 0);
+  int time = cache_size + 1;
+
+  std::vector<bool> emitted(num_indices / 3, false);
+  std::vector<unsigned int> dead_ends;
+  std::vector<unsigned int> candidates;
+  size_t cursor = 0;
+  size_t num_out = 0;
+
+  // somewhere to carry on once the last fan's neighbours are all done: a
+  // vertex it touched lately, or else the next one in order with any left
+  auto skip_dead_end = [&]() -> long {
+    while (!dead_ends.empty()) {
+      const unsigned int v = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[v] > 0) {
+        return v;
+      }
+    }
+    while (cursor < num_vertices) {
+      if (live[cursor] > 0) {
+        return static_cast<long>(cursor);
+      }
+      cursor++;
+    }
+    return -1;
+  };
+
+  long fan = skip_dead_end();
+  bool jumped = true;
+
+  while (fan >= 0) {
+    if (clusters && jumped) {
+      clusters->push_back(num_out / 3);
+    }
+    jumped = false;
+    candidates.clear();
+
+    // every triangle left around the fan vertex
+    for (size_t k = offsets[fan]; k < offsets[fan + 1]; k++) {
+      const unsigned int t = adjacency[k];
+      if (emitted[t]) {
+        continue;
+      }
+      emitted[t] = true;
+
+      for (int c = 0; c < 3; c++) {
+        const unsigned int v = indices[3 * t + c];
+        out[num_out++] = v;
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+
+        if (time - stamp[v] > cache_size) {
+          stamp[v] = time++;
+        }
+      }
+    }
+
+    // the oldest of its vertices that will still be cached after its own
+    // triangles have gone through (any with triangles left if none will)
+    long next = -1;
+    int best = -1;
+    for (unsigned int v : candidates) {
+      if (live[v] <= 0) {
+        continue;
+      }
+
+      int priority = 0;
+      if (time - stamp[v] + 2 * live[v] <= cache_size) {
+        priority = time - stamp[v];
+      }
+      if (priority > best) {
+        best = priority;
+        next = v;
+      }
+    }
+
+    if (next < 0) {
+      next = skip_dead_end();
+      jumped = true;
+    }
+    fan = next;
+  }
+}
+
+void optimize_overdraw(unsigned int* indices, size_t num_indices,
+                       const QVector<QVector3D>& positions,
+                       const std::vector<size_t>& clusters, int cache_size,
+                       float threshold)
+{
+  const size_t num_tris = num_indices / 3;
+  if (num_tris == 0) {
+    return;
+  }
+
+  FifoCache cache(positions.size(), cache_size);
+
+  // split every hard cluster wherever its ACMR so far is already close to
+  // what the whole of it gets
+  std::vector<size_t> starts;
+  for (size_t h = 0; h < clusters.size(); h++) {
+    const size_t begin = clusters[h];
+    const size_t end = h + 1 < clusters.size() ? clusters[h + 1] : num_tris;
+
+    cache.flush();
+    size_t misses = 0;
+    for (size_t t = begin; t < end; t++) {
+      misses += cache.access(indices + 3 * t);
+    }
+    const double limit =
+        threshold * static_cast<double>(misses) / (end - begin);
+
+    cache.flush();
+    misses = 0;
+    size_t start = begin;
+    starts.push_back(begin);
+
+    for (size_t t = begin; t < end; t++) {
+      misses += cache.access(indices + 3 * t);
+
+      if (t + 1 < end && misses <= limit * (t + 1 - start)) {
+        starts.push_back(t + 1);
+        start = t + 1;
+        misses = 0;
+        cache.flush();
+      }
+    }
+  }
+
+  // area weighted centre and facing of each cluster, and of all of them
+  struct Cluster {
+    size_t begin;
+    size_t end;
+    float key;
+  };
+  std::vector<Cluster> sorted(starts.size());
+  std::vector<QVector3D> centers(starts.size());
+  std::vector<QVector3D> normals(starts.size());
+  QVector3D mesh_center;
+  float mesh_area = 0;
+
+  for (size_t c = 0; c < starts.size(); c++) {
+    sorted[c].begin = starts[c];
+    sorted[c].end = c + 1 < starts.size() ? starts[c + 1] : num_tris;
+
+    QVector3D center;
+    QVector3D normal;
+    float area = 0;
+
+    for (size_t t = sorted[c].begin; t < sorted[c].end; t++) {
+      const QVector3D& p0 = positions[indices[3 * t]];
+      const QVector3D& p1 = positions[indices[3 * t + 1]];
+      const QVector3D& p2 = positions[indices[3 * t + 2]];
+
+      const QVector3D cross = QVector3D::crossProduct(p1 - p0, p2 - p0);
+      const float a = cross.length();
+
+      center += (p0 + p1 + p2) * (a / 3);
+      normal += cross;
+      area += a;
+    }
+
+    mesh_center += center;
+    mesh_area += area;
+
+    centers[c] =
+        area > 0 ? center / area : positions[indices[3 * sorted[c].begin]];
+    normals[c] = normal.normalized();
+  }
+
+  if (mesh_area > 0) {
+    mesh_center /= mesh_area;
+  }
+
+  // furthest out along its own facing goes first
+  for (size_t c = 0; c < sorted.size(); c++) {
+    sorted[c].key =
+        QVector3D::dotProduct(centers[c] - mesh_center, normals[c]);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.key > b.key;
+                   });
+
+  std::vector<unsigned int> reordered;
+  reordered.reserve(num_indices);
+  for (const Cluster& c : sorted) {
+    reordered.insert(reordered.end(), indices + 3 * c.begin,
+                     indices + 3 * c.end);
+  }
+  std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+std::vector<unsigned int> optimize_vertex_fetch(unsigned int* indices,
+                                                size_t num_indices,
+                                                size_t num_vertices)
+{
+  std::vector<unsigned int> remap(num_vertices, UNMAPPED_VERTEX);
+  unsigned int next = 0;
+
+  for (size_t i = 0; i < num_indices; i++) {
+    unsigned int& mapped = remap[indices[i]];
+    if (mapped == UNMAPPED_VERTEX) {
+      mapped = next++;
+    }
+    indices[i] = mapped;
+  }
+
+  for (unsigned int& mapped : remap) {
+    if (mapped == UNMAPPED_VERTEX) {
+      mapped = next++;
+    }
+  }
+
+  return remap;
+}
+
+// moves every element to where remap says
+template <typename T>
+static void apply_remap(QVector<T>& values,
+                        const std::vector<unsigned int>& remap)
+{
+  if (static_cast<size_t>(values.size()) != remap.size()) {
+    return;
+  }
+
+  QVector<T> moved(values.size());
+  for (size_t v = 0; v < remap.size(); v++) {
+    moved[remap[v]] = values[v];
+  }
+  values.swap(moved);
+}
+
+MeshOptimizeStats optimize_mesh(MeshData& mesh, int cache_size)
+{
+  const size_t num_vertices = mesh.positions.size();
+  const size_t num_indices = mesh.indices.size();
+  unsigned int* indices = mesh.indices.data();
+
+  MeshOptimizeStats stats;
+  stats.before =
+      simulate_vertex_cache(indices, num_indices, num_vertices, cache_size);
+
+  std::vector<MaterialRange> ranges = mesh.materials;
+  if (ranges.empty()) {
+    ranges.push_back({"", 0, static_cast<unsigned int>(num_indices)});
+  }
+
+  // each range is reordered on its own, with its vertices numbered from 0
+  // so the passes only touch what the range uses
+  std::vector<unsigned int> local(num_vertices, UNMAPPED_VERTEX);
+  std::vector<unsigned int> global;
+  std::vector<unsigned int> range_indices;
+  std::vector<unsigned int> reordered;
+  std::vector<size_t> clusters;
+  QVector<QVector3D> range_positions;
+
+  for (const MaterialRange& range : ranges) {
+    unsigned int* first = indices + range.first_index;
+    const size_t count = range.num_indices;
+
+    global.clear();
+    range_indices.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      unsigned int& v = local[first[i]];
+      if (v == UNMAPPED_VERTEX) {
+        v = static_cast<unsigned int>(global.size());
+        global.push_back(first[i]);
+      }
+      range_indices[i] = v;
+    }
+
+    range_positions.resize(static_cast<int>(global.size()));
+    for (size_t v = 0; v < global.size(); v++) {
+      range_positions[static_cast<int>(v)] = mesh.positions[global[v]];
+    }
+
+    reordered.resize(count);
+    optimize_vertex_cache(range_indices.data(), count, global.size(),
+                          cache_size, reordered.data(), &clusters);
+    optimize_overdraw(reordered.data(), count, range_positions, clusters,
+                      cache_size);
+
+    for (size_t i = 0; i < count; i++) {
+      first[i] = global[reordered[i]];
+    }
+    for (unsigned int v : global) {
+      local[v] = UNMAPPED_VERTEX;
+    }
+  }
+
+  const std::vector<unsigned int> remap =
+      optimize_vertex_fetch(indices, num_indices, num_vertices);
+  apply_remap(mesh.positions, remap);
+  apply_remap(mesh.normals, remap);
+  apply_remap(mesh.texCoords, remap);
+
+  stats.after =
+      simulate_vertex_cache(indices, num_indices, num_vertices, cache_size);
+  return stats;
+}
@@ -0,0 +1,495 @@
+#include "MipPyramid.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+
+const char HERBMIP_MAGIC[8] = {'H', 'E', 'R', 'B', 'M', 'I', 'P', 'S'};
+const uint32_t HERBMIP_VERSION = 1;
+const char* HERBMIP_EXTENSION = ".herbmip";
+
+// The file is a HerbMipHeader, the source path, each level's width and height
+// (uint32_t), zero padding up to a multiple of 16 bytes, then the levels'
+// RGBA8 pixels one after the other, biggest first.
+
+// Kaiser filter: half width in texels of the smaller level, and window shape
+const double KAISER_RADIUS = 3.0;
+const double KAISER_ALPHA = 4.0;
+
+// entries in the linear light -> sRGB byte table
+const int SRGB_TABLE_SIZE = 1 << 14;
+
+const double PI = 3.14159265358979323846;
+
+static size_t align16(size_t n) { return (n + 15) & ~static_cast<size_t>(15); }
+
+static double srgb_to_linear(double c)
+{
+  return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double l)
+{
+  return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1 / 2.4) - 0.055;
+}
+
+// sRGB byte -> linear light, and back (through a table fine enough to give
+// every byte back unchanged)
+struct SrgbTables {
+  float to_linear[256];
+  unsigned char to_srgb[SRGB_TABLE_SIZE + 1];
+
+  SrgbTables()
+  {
+    for (int c = 0; c < 256; c++) {
+      to_linear[c] = static_cast<float>(srgb_to_linear(c / 255.0));
+    }
+    for (int i = 0; i <= SRGB_TABLE_SIZE; i++) {
+      to_srgb[i] = static_cast<unsigned char>(
+          std::lround(linear_to_srgb(i / double(SRGB_TABLE_SIZE)) * 255));
+    }
+  }
+};
+
+static const SrgbTables& srgb_tables()
+{
+  static const SrgbTables tables;
+  return tables;
+}
+
+static inline unsigned char unorm8(float v)
+{
+  v = std::min(1.0f, std::max(0.0f, v));
+  return static_cast<unsigned char>(v * 255 + 0.5f);
+}
+
+// Which texels of a level of `from` go into each texel of a level of `to`:
+// count taps per texel, starting at first[i] (clamped to the edge when read)
+struct Taps {
+  std::vector<int> first;
+  std::vector<float> weights;  // count per texel
+  int count;
+};
+
+// zeroth order modified Bessel function of the first kind
+static double bessel_i0(double x)
+{
+  double sum = 1;
+  double term = 1;
+  for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+static double kaiser_sinc(double x)
+{
+  const double t = x / KAISER_RADIUS;
+  if (std::abs(t) >= 1) {
+    return 0;
+  }
+  const double sinc = x == 0 ? 1 : std::sin(PI * x) / (PI * x);
+  return sinc * bessel_i0(KAISER_ALPHA * std::sqrt(1 - t * t)) /
+         bessel_i0(KAISER_ALPHA);
+}
+
+static Taps make_taps(int from, int to, MipFilter filter)
+{
+  const double scale = double(from) / to;  // texels of from per texel of to
+
+  Taps taps;
+  taps.count = filter == MipFilter::BOX
+                   ? static_cast<int>(std::ceil(scale)) + 1
+                   : static_cast<int>(std::ceil(2 * KAISER_RADIUS * scale)) + 1;
+  taps.first.resize(to);
+  taps.weights.assign(static_cast<size_t>(to) * taps.count, 0.0f);
+
+  for (int i = 0; i < to; i++) {
+    float* weights = &taps.weights[static_cast<size_t>(i) * taps.count];
+    double total = 0;
+
+    if (filter == MipFilter::BOX) {
+      // how much of each texel [i scale, (i + 1) scale) covers
+      const double start = i * scale;
+      const double end = (i + 1) * scale;
+      taps.first[i] = static_cast<int>(std::floor(start));
+      for (int k = 0; k < taps.count; k++) {
+        const double texel = taps.first[i] + k;
+        const double overlap =
+            std::min(end, texel + 1) - std::max(start, texel);
+        weights[k] = static_cast<float>(std::max(0.0, overlap));
+        total += weights[k];
+      }
+    }
+    else {
+      // centered on the texel's middle, in units of the smaller texels
+      const double center = (i + 0.5) * scale;
+      taps.first[i] =
+          static_cast<int>(std::floor(center - KAISER_RADIUS * scale));
+      for (int k = 0; k < taps.count; k++) {
+        const double texel_center = taps.first[i] + k + 0.5;
+        weights[k] =
+            static_cast<float>(kaiser_sinc((texel_center - center) / scale));
+        total += weights[k];
+      }
+    }
+
+    for (int k = 0; k < taps.count; k++) {
+      weights[k] = static_cast<float>(weights[k] / total);
+    }
+  }
+
+  return taps;
+}
+
+// Filters a from_width x from_height level down to to_width x to_height. Rows
+// of the bigger level (RGBA floats) come from source_row; the horizontally
+// filtered ones are kept only while the vertical taps still need them. Each
+// output row goes to emit.
+static void downsample(
+    int from_width, int from_height, int to_width, int to_height,
+    MipFilter filter,
+    const std::function<void(int, std::vector<float>&)>& source_row,
+    const std::function<void(int, const std::vector<float>&)>& emit)
+{
+  const Taps across = make_taps(from_width, to_width, filter);
+  const Taps down = make_taps(from_height, to_height, filter);
+
+  std::vector<float> row(static_cast<size_t>(from_width) * 4);
+  std::deque<std::pair<int, std::vector<float>>> filtered;
+
+  // row y of the bigger level, filtered across
+  auto filtered_row = [&](int y) -> const std::vector<float>& {
+    y = std::min(std::max(y, 0), from_height - 1);
+    for (const auto& kept : filtered) {
+      if (kept.first == y) {
+        return kept.second;
+      }
+    }
+
+    source_row(y, row);
+    std::vector<float> out(static_cast<size_t>(to_width) * 4, 0.0f);
+    for (int x = 0; x < to_width; x++) {
+      const float* weights = &across.weights[static_cast<size_t>(x) *
+                                             across.count];
+      for (int k = 0; k < across.count; k++) {
+        const int from_x =
+            std::min(std::max(across.first[x] + k, 0), from_width - 1);
+        for (int c = 0; c < 4; c++) {
+          out[4 * x + c] += weights[k] * row[4 * from_x + c];
+        }
+      }
+    }
+
+    if (filtered.size() > static_cast<size_t>(down.count)) {
+      filtered.pop_front();
+    }
+    filtered.emplace_back(y, std::move(out));
+    return filtered.back().second;
+  };
+
+  std::vector<float> out(static_cast<size_t>(to_width) * 4);
+  for (int y = 0; y < to_height; y++) {
+    std::fill(out.begin(), out.end(), 0.0f);
+    const float* weights = &down.weights[static_cast<size_t>(y) * down.count];
+    for (int k = 0; k < down.count; k++) {
+      if (weights[k] == 0) {
+        continue;
+      }
+      const std::vector<float>& in = filtered_row(down.first[y] + k);
+      for (size_t i = 0; i < out.size(); i++) {
+        out[i] += weights[k] * in[i];
+      }
+    }
+    emit(y, out);
+  }
+}
+
+// one texel (RGBA floats, in the space kind averages in) -> RGBA8; normals
+// are renormalized in place
+static void encode_texel(float* texel, MipKind kind, unsigned char* out)
+{
+  switch (kind) {
+  case MipKind::COLOR: {
+    const SrgbTables& tables = srgb_tables();
+    for (int c = 0; c < 3; c++) {
+      const float l = std::min(1.0f, std::max(0.0f, texel[c]));
+      out[c] = tables.to_srgb[static_cast<int>(l * SRGB_TABLE_SIZE + 0.5f)];
+    }
+    break;
+  }
+  case MipKind::NORMAL: {
+    const float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] +
+                                   texel[2] * texel[2]);
+    if (length > 1e-6f) {
+      for (int c = 0; c < 3; c++) {
+        texel[c] /= length;
+      }
+    }
+    else {
+      texel[0] = texel[1] = 0;
+      texel[2] = 1;
+    }
+    for (int c = 0; c < 3; c++) {
+      out[c] = unorm8(texel[c] * 0.5f + 0.5f);
+    }
+    break;
+  }
+  case MipKind::DATA:
+    for (int c = 0; c < 3; c++) {
+      out[c] = unorm8(texel[c]);
+    }
+    break;
+  }
+  out[3] = unorm8(texel[3]);
+}
+
+// RGBA8 -> RGBA floats in the space kind averages in
+static void decode_texel(const unsigned char* rgba, MipKind kind, float* out)
+{
+  for (int c = 0; c < 3; c++) {
+    switch (kind) {
+    case MipKind::COLOR:
+      out[c] = srgb_tables().to_linear[rgba[c]];
+      break;
+    case MipKind::NORMAL:
+      out[c] = rgba[c] / 127.5f - 1;
+      break;
+    case MipKind::DATA:
+      out[c] = rgba[c] / 255.0f;
+      break;
+    }
+  }
+  out[3] = rgba[3] / 255.0f;
+}
+
+void build_mip_chain(const uint32_t* argb, int width, int height, int stride,
+                     MipKind kind, MipFilter filter,
+                     std::vector<MipLevel>& levels)
+{
+  levels.clear();
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+
+  // level 0: the image turned round (both mirrors) and unpacked, one pass
+  levels.push_back({static_cast<uint32_t>(width),
+                    static_cast<uint32_t>(height),
+                    std::vector<unsigned char>(size_t(width) * height * 4)});
+  for (int y = 0; y < height; y++) {
+    const uint32_t* in = argb + static_cast<size_t>(height - 1 - y) * stride;
+    unsigned char* out = &levels[0].rgba[static_cast<size_t>(y) * width * 4];
+    for (int x = 0; x < width; x++, out += 4) {
+      const uint32_t p = in[width - 1 - x];
+      out[0] = static_cast<unsigned char>(p >> 16);
+      out[1] = static_cast<unsigned char>(p >> 8);
+      out[2] = static_cast<unsigned char>(p);
+      out[3] = static_cast<unsigned char>(p >> 24);
+    }
+  }
+
+  // each smaller level is filtered from the one above, kept as floats so
+  // the rounding doesn't pile up
+  std::vector<float> above;
+  int from_width = width;
+  int from_height = height;
+
+  while (from_width > 1 || from_height > 1) {
+    const int to_width = std::max(1, from_width / 2);
+    const int to_height = std::max(1, from_height / 2);
+    const bool first = levels.size() == 1;
+
+    std::vector<float> below(static_cast<size_t>(to_width) * to_height * 4);
+    MipLevel level = {static_cast<uint32_t>(to_width),
+                      static_cast<uint32_t>(to_height),
+                      std::vector<unsigned char>(below.size())};
+
+    auto source_row = [&](int y, std::vector<float>& row) {
+      if (first) {
+        const unsigned char* in =
+            &levels[0].rgba[static_cast<size_t>(y) * from_width * 4];
+        for (int x = 0; x < from_width; x++) {
+          decode_texel(in + 4 * x, kind, &row[4 * x]);
+        }
+      }
+      else {
+        std::copy_n(&above[static_cast<size_t>(y) * from_width * 4],
+                    from_width * 4, row.begin());
+      }
+    };
+    auto emit = [&](int y, const std::vector<float>& row) {
+      float* texels = &below[static_cast<size_t>(y) * to_width * 4];
+      unsigned char* out = &level.rgba[static_cast<size_t>(y) * to_width * 4];
+      std::copy(row.begin(), row.end(), texels);
+      for (int x = 0; x < to_width; x++) {
+        encode_texel(texels + 4 * x, kind, out + 4 * x);
+      }
+    };
+
+    downsample(from_width, from_height, to_width, to_height, filter,
+               source_row, emit);
+
+    levels.push_back(std::move(level));
+    above.swap(below);
+    from_width = to_width;
+    from_height = to_height;
+  }
+}
+
+// a name to write a cache under before it's renamed into place; unique to
+// the writer, so two threads caching the same image can't mix their bytes
+static std::string temp_path(const std::string& path)
+{
+  static std::atomic<unsigned> writes(0);
+  return path + ".tmp" + std::to_string(getpid()) + "." +
+         std::to_string(writes++);
+}
+
+MipCache::MipCache() : m_file(), m_levels() {}
+
+std::string MipCache::cache_path(const std::string& source, MipKind kind,
+                                 MipFilter filter)
+{
+  static const char* KIND_NAMES[] = {"color", "normal", "data"};
+  static const char* FILTER_NAMES[] = {"box", "kaiser"};
+
+  return source + "." + KIND_NAMES[static_cast<int>(kind)] + "-" +
+         FILTER_NAMES[static_cast<int>(filter)] + HERBMIP_EXTENSION;
+}
+
+void MipCache::remove(const std::string& source)
+{
+  for (MipKind kind : {MipKind::COLOR, MipKind::NORMAL, MipKind::DATA}) {
+    for (MipFilter filter : {MipFilter::BOX, MipFilter::KAISER}) {
+      std::remove(cache_path(source, kind, filter).c_str());
+    }
+  }
+}
+
+int MipCache::write(const std::string& source, MipKind kind, MipFilter filter,
+                    const std::vector<MipLevel>& levels)
+{
+  HerbMipHeader header = HerbMipHeader();
+  memcpy(header.magic, HERBMIP_MAGIC, sizeof(header.magic));
+  header.version = HERBMIP_VERSION;
+  header.kind = static_cast<uint32_t>(kind);
+  header.filter = static_cast<uint32_t>(filter);
+  header.num_levels = static_cast<uint32_t>(levels.size());
+
+  SourceStamp stamp;
+  if (!stamp_source(source, stamp)) {
+    return EXIT_FAILURE;
+  }
+  header.source_mtime_ns = stamp.mtime_ns;
+  header.source_size = stamp.size;
+  header.source_hash = stamp.hash;
+
+  const std::string path = canonical_path(source);
+  header.source_path_len = static_cast<uint32_t>(path.size());
+
+  // write to the side and rename, so a reader never sees half a file
+  const std::string final_path = cache_path(source, kind, filter);
+  const std::string tmp_path = temp_path(final_path);
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+
+  const size_t table_end = sizeof(header) + path.size() +
+                           levels.size() * 2 * sizeof(uint32_t);
+  const char padding[16] = {};
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(path.data(), path.size());
+  for (const MipLevel& level : levels) {
+    const uint32_t size[2] = {level.width, level.height};
+    out.write(reinterpret_cast<const char*>(size), sizeof(size));
+  }
+  out.write(padding, align16(table_end) - table_end);
+  for (const MipLevel& level : levels) {
+    out.write(reinterpret_cast<const char*>(level.rgba.data()),
+              level.rgba.size());
+  }
+  out.close();
+
+  if (!out || std::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int MipCache::open(const std::string& source, MipKind kind, MipFilter filter)
+{
+  close();
+
+  if (m_file.open(cache_path(source, kind, filter)) != EXIT_SUCCESS ||
+      m_file.size() < sizeof(HerbMipHeader)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  HerbMipHeader header;
+  memcpy(&header, m_file.data(), sizeof(header));
+
+  if (memcmp(header.magic, HERBMIP_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != HERBMIP_VERSION ||
+      header.kind != static_cast<uint32_t>(kind) ||
+      header.filter != static_cast<uint32_t>(filter) ||
+      header.num_levels == 0 || header.num_levels > 64) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  // make sure everything the header promises is really in the file
+  const size_t table_offset = sizeof(header) + header.source_path_len;
+  const size_t table_end =
+      table_offset + header.num_levels * 2 * sizeof(uint32_t);
+  if (table_end > m_file.size()) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  size_t offset = align16(table_end);
+  for (uint32_t i = 0; i < header.num_levels; i++) {
+    uint32_t size[2];
+    memcpy(size, m_file.data() + table_offset + i * sizeof(size),
+           sizeof(size));
+
+    const size_t bytes = static_cast<size_t>(size[0]) * size[1] * 4;
+    if (bytes == 0 || bytes > m_file.size() - std::min(offset, m_file.size())) {
+      close();
+      return EXIT_FAILURE;
+    }
+
+    m_levels.push_back({size[0], size[1],
+                        reinterpret_cast<const unsigned char*>(m_file.data() +
+                                                               offset)});
+    offset += bytes;
+  }
+
+  const std::string path(m_file.data() + sizeof(header),
+                         header.source_path_len);
+  const SourceStamp stamp = {header.source_mtime_ns, header.source_size,
+                             header.source_hash};
+
+  if (offset != m_file.size() || path != canonical_path(source) ||
+      !source_unchanged(source, stamp)) {
+    close();
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void MipCache::close()
+{
+  m_file.close();
+  m_levels.clear();
+}
@@ -1,49 +1,141 @@
 #include "MtlLoader.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 
 #define DEFAULT_TEXTURE "@DEFAULT_TEXTURE@"  // CMAKE: DEFAULT_TEXTURE
 
-MtlLoader::MtlLoader() : m_map_Kd() {}
+// what a material is before the .mtl says anything about it
+static Material default_material(const std::string& name)
+{
+  Material m;
+  m.name = name;
+  return m;
+}
+
+// the file name at the end of a map_ line (after any -options)
+static std::string map_file(std::istringstream& ss)
+{
+  std::string file;
+  std::string token;
+  while (ss >> token) {
+    file = token;
+  }
+  return file;
+}
+
+static QVector3D read_color(std::istringstream& ss)
+{
+  float r = 0;
+  float g = 0;
+  float b = 0;
+  ss >> r >> g >> b;
+  return QVector3D(r, g, b);
+}
+
+MtlLoader::MtlLoader() : m_materials(1, default_material(""))
+{
+  m_materials.front().map_Kd = DEFAULT_TEXTURE;
+}
+
+int MtlLoader::find_material(const std::string& name) const
+{
+  for (size_t i = 0; i < m_materials.size(); i++) {
+    if (m_materials[i].name == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
 
 int MtlLoader::parse_file(const std::string filename)
 {
-  m_map_Kd.clear();
+  m_materials.clear();
 
   const size_t last_slash_idx = filename.find_last_of("\\/");
-  m_basedir = filename.substr(0, last_slash_idx + 1);
+  const std::string basedir = filename.substr(0, last_slash_idx + 1);
 
   std::ifstream infile(filename);
 
-  if (!infile.is_open()) {
-    return EXIT_FAILURE;
-  }
-
   std::string line;
   std::istringstream ss;
 
-  std::string type;  // should be v, vn, f, etc.
+  std::string type;  // should be newmtl, Kd, map_Kd, etc.
+
+  // lines before the first newmtl set what every material starts out as
+  Material base = default_material("");
 
-  while (std::getline(infile, line)) {
+  while (infile.is_open() && std::getline(infile, line)) {
     ss.clear();
     ss.str(line);
 
+    type.clear();
     ss >> type;
 
-    if (type == "map_Kd") {
+    if (type.empty() || type[0] == '#') {
+      continue;
+    }
+
+    if (type == "newmtl") {
+      m_materials.push_back(base);
+      ss >> m_materials.back().name;
+      continue;
+    }
+
+    Material& m = m_materials.empty() ? base : m_materials.back();
+
+    if (type == "Ka") {
+      m.Ka = read_color(ss);
+    } else if (type == "Kd") {
+      m.Kd = read_color(ss);
+    } else if (type == "Ks") {
+      m.Ks = read_color(ss);
+    } else if (type == "Ke") {
+      m.Ke = read_color(ss);
+    } else if (type == "Ns") {
+      ss >> m.Ns;
+    } else if (type == "Ni") {
+      ss >> m.Ni;
+    } else if (type == "d") {
+      ss >> m.d;
+    } else if (type == "Tr") {
+      // transparency, the other way round from d
+      float tr = 0;
+      ss >> tr;
+      m.d = 1 - tr;
+    } else if (type == "illum") {
+      ss >> m.illum;
+    } else if (type == "map_Kd") {
       // diffuse color map file
-      ss >> m_map_Kd;
-    } else if (type == "map_Bump") {
+      m.map_Kd = map_file(ss);
+    } else if (type == "map_Ks") {
+      // specular map file
+      m.map_Ks = map_file(ss);
+    } else if (type == "map_Bump" || type == "map_bump" || type == "bump") {
       // normal map file
-      ss >> m_map_Bump;
+      m.map_Bump = map_file(ss);
     }
   }
 
-  if (m_map_Kd.empty()) {
-    m_map_Kd = DEFAULT_TEXTURE;  // use default texture if we don't find one
-    m_basedir = "";
+  if (m_materials.empty()) {
+    m_materials.push_back(base);
+  }
+
+  for (Material& m : m_materials) {
+    if (!infile.is_open()) {
+      m.map_Kd = DEFAULT_TEXTURE;  // use default texture if we don't find one
+    } else if (!m.map_Kd.empty()) {
+      m.map_Kd = basedir + m.map_Kd;
+    }
+
+    if (!m.map_Bump.empty()) {
+      m.map_Bump = basedir + m.map_Bump;
+    }
+    if (!m.map_Ks.empty()) {
+      m.map_Ks = basedir + m.map_Ks;
+    }
   }
 
-  return 0;
-}
\ No newline at end of file
+  return infile.is_open() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
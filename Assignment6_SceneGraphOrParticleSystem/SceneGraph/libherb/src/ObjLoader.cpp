@@ -2,15 +2,26 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <vector>
 
+#include "MappedFile.h"
+#include "ObjRecords.h"
 #include "ObjToVboIdx.h"
+#include "ObjTokenizer.h"
 
-ObjLoader::ObjLoader() {}
+// smallest slice of the file ParseMode::Parallel hands to a thread
+const size_t OBJ_MIN_CHUNK_BYTES = 256 * 1024;
+
+ObjLoader::ObjLoader() : m_parse_threads(0) {}
 
 /**
  * @brief Helper to parse one face vertex
@@ -26,7 +37,7 @@ ObjLoader::ObjLoader() {}
  * "1/2/3"  -> {1, 1}, {1, 2, 3}
  * "1//2"   -> {0, 1}, {1, x, 2}
  */
-void parse_face_vert(bool present[2], int vert[3], std::string str)
+void parse_face_vert(bool present[2], int vert[3], const std::string& str)
 {
   vert[0] = std::stoi(str);
 
@@ -65,23 +76,206 @@ void parse_face_vert(bool present[2], int vert[3], std::string str)
   }
 }
 
-int ObjLoader::parse_file(const std::string filename)
+/**
+ * @brief Turns relative (negative) indices of the newest face into absolute
+ * ones, counting back from the records read so far.
+ *
+ * "-1" is the last v/vt/vn before the face. Resolved slots are remembered in
+ * out.relative so a range parsed on its own can be shifted later.
+ */
+static void resolve_relative(ObjRecords& out)
 {
-  m_normals.clear();
-  m_vertices.clear();
-  m_uvs.clear();
-  m_indices.clear();
-  m_mtllib.clear();
+  triface& f = out.faces.back();
+  const int face = out.faces.size() - 1;
+  const int counts[3] = {out.vertices.size(), out.uvs.size(),
+                         out.normals.size()};
+
+  for (int i = 0; i < 3; i++) {
+    const bool used[3] = {true, f.present[2 * i], f.present[2 * i + 1]};
+
+    for (int k = 0; k < 3; k++) {
+      int& idx = f.idx[3 * i + k];
+      if (used[k] && idx < 0) {
+        idx = counts[k] + idx + 1;
+        out.relative << face * 9 + 3 * i + k;
+      }
+    }
+  }
+}
 
-  const size_t last_slash_idx = filename.find_last_of("\\/");
-  m_basedir = filename.substr(0, last_slash_idx + 1);
+/**
+ * @brief Adds corner n (counting from 0) of the face being read
+ *
+ * Faces go in as triangle fans around their first corner. The corner has
+ * already been parsed into slot min(n, 2) of fan; the first two corners just
+ * wait there, and every later one closes the triangle (first, previous, this)
+ * and then becomes the previous corner.
+ */
+static void add_fan_corner(ObjRecords& out, triface& fan, int n)
+{
+  if (n < 2) {
+    return;
+  }
 
-  // intermediary vectors read from the obj file itself
-  QVector<QVector3D> tmp_normals;
-  QVector<QVector3D> tmp_vertices;
-  QVector<QVector2D> tmp_uvs;
-  QVector<triface> tmp_faces;
+  out.faces << fan;
+  resolve_relative(out);
 
+  fan.present[2] = fan.present[4];
+  fan.present[3] = fan.present[5];
+  fan.idx[3] = fan.idx[6];
+  fan.idx[4] = fan.idx[7];
+  fan.idx[5] = fan.idx[8];
+}
+
+// Remembers a face that was split into more than one triangle
+static void add_polygon(ObjRecords& out, int first, int corners)
+{
+  if (corners > 3) {
+    out.polygons << polyface{first, corners};
+  }
+}
+
+// 2 * the signed area of triangle abc, positive when it turns left
+static float turn(const QVector2D& a, const QVector2D& b, const QVector2D& c)
+{
+  return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+// true if p is inside or on the counter clockwise triangle abc
+static bool in_triangle(const QVector2D& p, const QVector2D& a,
+                        const QVector2D& b, const QVector2D& c)
+{
+  return turn(a, b, p) >= 0 && turn(b, c, p) >= 0 && turn(c, a, p) >= 0;
+}
+
+/**
+ * @brief Ear-clips the concave faces in out.polygons
+ *
+ * The parser fans every face, which is only right for convex ones. Each
+ * polygon is flattened onto the plane its (Newell) normal is closest to; if
+ * any corner turns the wrong way there, it is ear-clipped instead. A simple
+ * polygon always clips into corners - 2 triangles, so they replace its fan in
+ * place and nothing else in out moves.
+ */
+static void triangulate_polygons(ObjRecords& out)
+{
+  struct corner {
+    bool present[2];
+    int idx[3];
+  };
+
+  std::vector<corner> corners;
+  std::vector<QVector2D> flat;
+  std::vector<int> left;
+
+  for (const polyface& poly : out.polygons) {
+    const int n = poly.corners;
+
+    // corner 0 and 1 start the first triangle, the rest end one each
+    corners.resize(n);
+    for (int k = 0; k < n; k++) {
+      const triface& f = out.faces[poly.first + std::max(0, k - 2)];
+      const int slot = std::min(k, 2);
+
+      corners[k].present[0] = f.present[2 * slot];
+      corners[k].present[1] = f.present[2 * slot + 1];
+      std::copy(f.idx + 3 * slot, f.idx + 3 * slot + 3, corners[k].idx);
+    }
+
+    bool valid = true;
+    for (const corner& c : corners) {
+      valid = valid && c.idx[0] >= 1 && c.idx[0] <= out.vertices.size();
+    }
+    if (!valid) {
+      continue;  // obj_to_vbo will complain about it anyway
+    }
+
+    // Newell's method, robust to a few concave corners
+    float normal[3] = {0, 0, 0};
+    for (int k = 0; k < n; k++) {
+      const QVector3D& a = out.vertices[corners[k].idx[0] - 1];
+      const QVector3D& b = out.vertices[corners[(k + 1) % n].idx[0] - 1];
+
+      normal[0] += (a.y() - b.y()) * (a.z() + b.z());
+      normal[1] += (a.z() - b.z()) * (a.x() + b.x());
+      normal[2] += (a.x() - b.x()) * (a.y() + b.y());
+    }
+
+    // drop the axis the normal points along the most, keeping the polygon
+    // counter clockwise in what's left
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+      if (std::abs(normal[i]) > std::abs(normal[axis])) axis = i;
+    }
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    const float flip = normal[axis] < 0 ? -1.0f : 1.0f;
+
+    flat.resize(n);
+    for (int k = 0; k < n; k++) {
+      const QVector3D& p = out.vertices[corners[k].idx[0] - 1];
+      flat[k] = QVector2D(p[u], flip * p[v]);
+    }
+
+    bool convex = true;
+    for (int k = 0; k < n && convex; k++) {
+      convex = turn(flat[k], flat[(k + 1) % n], flat[(k + 2) % n]) >= 0;
+    }
+    if (convex) {
+      continue;  // the fan is fine
+    }
+
+    left.resize(n);
+    for (int k = 0; k < n; k++) left[k] = k;
+
+    int tri = poly.first;
+    auto addTriangle = [&](int a, int b, int c) {
+      triface& f = out.faces[tri++];
+      const int ks[3] = {a, b, c};
+      for (int i = 0; i < 3; i++) {
+        f.present[2 * i] = corners[ks[i]].present[0];
+        f.present[2 * i + 1] = corners[ks[i]].present[1];
+        std::copy(corners[ks[i]].idx, corners[ks[i]].idx + 3, f.idx + 3 * i);
+      }
+    };
+
+    int i = 0;
+    int misses = 0;
+    while (left.size() > 3) {
+      const int m = left.size();
+      const int a = left[(i + m - 1) % m];
+      const int b = left[i % m];
+      const int c = left[(i + 1) % m];
+
+      bool ear = turn(flat[a], flat[b], flat[c]) > 0;
+      for (int k = 0; k < m && ear; k++) {
+        const int p = left[k];
+        if (p != a && p != b && p != c &&
+            in_triangle(flat[p], flat[a], flat[b], flat[c])) {
+          ear = false;
+        }
+      }
+
+      // went all the way around without an ear (self intersecting or
+      // degenerate), so clip the next corner regardless
+      if (ear || misses >= m) {
+        addTriangle(a, b, c);
+        left.erase(left.begin() + i % m);
+        i = (i % m + m - 2) % (m - 1);
+        misses = 0;
+      }
+      else {
+        i = (i + 1) % m;
+        misses++;
+      }
+    }
+    addTriangle(left[0], left[1], left[2]);
+  }
+}
+
+// ParseMode::Stream - one std::getline + std::istringstream per line
+static int read_records_stream(const std::string& filename, ObjRecords& out)
+{
   std::ifstream infile(filename);
 
   if (!infile.is_open()) {
@@ -92,6 +286,7 @@ int ObjLoader::parse_file(const std::string filename)
   std::istringstream ss;
 
   std::string type;  // should be v, vn, f, etc.
+  std::string vert;  // one face corner, reused so it only grows
 
   while (std::getline(infile, line)) {
     ss.clear();
@@ -107,7 +302,7 @@ int ObjLoader::parse_file(const std::string filename)
       ss >> x >> y >> z;
 
       QVector3D v(x, y, z);
-      tmp_vertices << v;
+      out.vertices << v;
     }
     else if (type == "vt") {  // vertex texture
       float u;
@@ -116,7 +311,7 @@ int ObjLoader::parse_file(const std::string filename)
       ss >> u >> v;
 
       QVector2D p(u, v);
-      tmp_uvs << p;
+      out.uvs << p;
     }
     else if (type == "vn") {  // normal
       float x;
@@ -126,28 +321,392 @@ int ObjLoader::parse_file(const std::string filename)
       ss >> x >> y >> z;
 
       QVector3D v(x, y, z);
-      tmp_normals << v;
+      out.normals << v;
     }
     else if (type == "f") {  // face
-      triface f;
+      triface fan = {};
+      int corners = 0;
+      const int first = out.faces.size();
+
+      while (ss >> vert && vert[0] != '#') {
+        const int slot = std::min(corners, 2);
+        parse_face_vert(&(fan.present[2 * slot]), &(fan.idx[3 * slot]), vert);
+        add_fan_corner(out, fan, corners++);
+      }
+
+      add_polygon(out, first, corners);
+    }
+    else if (type == "mtllib") {  // material
+      ss >> out.mtllib;
+    }
+    else if (type == "usemtl") {  // material from here on
+      usemtl use = {out.faces.size(), std::string()};
+      ss >> use.name;
+      out.materials << use;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Hands the faces read so far to flush, then forgets them
+ *
+ * Concave polygons are ear-clipped first; every vertex they use has been
+ * read already, since faces can only refer back.
+ *
+ * @return  whatever flush returned
+ */
+static bool flush_faces(ObjRecords& out, const ObjFaceFlush& flush)
+{
+  triangulate_polygons(out);
+  const bool go_on = flush(out);
+
+  out.flushed_faces += out.faces.size();
+  out.faces.clear();
+  out.relative.clear();
+  out.polygons.clear();
+
+  return go_on;
+}
 
-      std::string a;
-      std::string b;
-      std::string c;
+/**
+ * @brief Tokenizes the whole lines in [p, end) into out
+ *
+ * With a flush, the faces are passed to it (see flush_faces) whenever at
+ * least batch_faces of them have piled up. Stops early if it says so.
+ *
+ * @return  false if flush asked to stop
+ */
+static bool parse_records(const char* p, const char* const end,
+                          ObjRecords& out, int batch_faces = 0,
+                          const ObjFaceFlush& flush = nullptr)
+{
+  using namespace ObjTokenizer;
 
-      ss >> a >> b >> c;  // TODO(mike) don't assume three vertices
+  while (p < end) {
+    const char* eol = line_end(p, end);
 
-      parse_face_vert(&(f.present[0]), &(f.idx[0]), a);
-      parse_face_vert(&(f.present[2]), &(f.idx[3]), b);
-      parse_face_vert(&(f.present[4]), &(f.idx[6]), c);
+    const char* type;
+    const char* type_end;
 
-      tmp_faces << f;
+    if (!next_token(p, eol, type, type_end)) {
+      // blank line
     }
-    else if (type == "mtllib") {  // material
-      ss >> m_mtllib;
+    else if (token_is(type, type_end, "v")) {  // vertex
+      float x = 0;
+      float y = 0;
+      float z = 0;
+
+      parse_float(p, eol, x);
+      parse_float(p, eol, y);
+      parse_float(p, eol, z);
+
+      out.vertices << QVector3D(x, y, z);
+    }
+    else if (token_is(type, type_end, "vt")) {  // vertex texture
+      float u = 0;
+      float v = 0;
+
+      parse_float(p, eol, u);
+      parse_float(p, eol, v);
+
+      out.uvs << QVector2D(u, v);
+    }
+    else if (token_is(type, type_end, "vn")) {  // normal
+      float x = 0;
+      float y = 0;
+      float z = 0;
+
+      parse_float(p, eol, x);
+      parse_float(p, eol, y);
+      parse_float(p, eol, z);
+
+      out.normals << QVector3D(x, y, z);
+    }
+    else if (token_is(type, type_end, "f")) {  // face
+      triface fan = {};
+      int corners = 0;
+      const int first = out.faces.size();
+
+      const char* vert;
+      const char* vert_end;
+      while (next_token(p, eol, vert, vert_end) && *vert != '#') {
+        const int slot = std::min(corners, 2);
+        ObjTokenizer::parse_face_vert(&(fan.present[2 * slot]),
+                                      &(fan.idx[3 * slot]), vert, vert_end);
+        add_fan_corner(out, fan, corners++);
+      }
+
+      add_polygon(out, first, corners);
+
+      if (flush && out.faces.size() >= batch_faces &&
+          !flush_faces(out, flush)) {
+        return false;
+      }
+    }
+    else if (token_is(type, type_end, "mtllib")) {  // material
+      const char* name;
+      const char* name_end;
+      if (next_token(p, eol, name, name_end)) {
+        out.mtllib.assign(name, name_end);
+      }
+    }
+    else if (token_is(type, type_end, "usemtl")) {  // material from here on
+      usemtl use = {out.flushed_faces + out.faces.size(), std::string()};
+
+      const char* name;
+      const char* name_end;
+      if (next_token(p, eol, name, name_end)) {
+        use.name.assign(name, name_end);
+      }
+
+      out.materials << use;
     }
+
+    p = eol + 1;
+  }
+
+  return true;
+}
+
+// ParseMode::Mapped - mmap the file and walk it with ObjTokenizer
+static int read_records_mapped(const std::string& filename, ObjRecords& out)
+{
+  MappedFile file;
+  if (file.open(filename) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  parse_records(file.data(), file.end(), out);
+
+  return EXIT_SUCCESS;
+}
+
+// ParseMode::Parallel - mmap the file, split it at line boundaries and parse
+// every chunk on its own thread, then stitch the chunks back together in order
+static int read_records_parallel(const std::string& filename,
+                                 unsigned num_threads, ObjRecords& out)
+{
+  MappedFile file;
+  if (file.open(filename) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // not worth a thread unless it gets a decent amount of text
+  const size_t max_chunks = file.size() / OBJ_MIN_CHUNK_BYTES + 1;
+  const size_t num_chunks = std::min<size_t>(num_threads, max_chunks);
+
+  if (num_chunks <= 1) {
+    parse_records(file.data(), file.end(), out);
+    return EXIT_SUCCESS;
+  }
+
+  // chunk i is [bounds[i], bounds[i + 1]), every boundary just after a '\n'
+  std::vector<const char*> bounds(num_chunks + 1);
+  bounds[0] = file.data();
+  bounds[num_chunks] = file.end();
+
+  for (size_t i = 1; i < num_chunks; i++) {
+    const char* guess = file.data() + file.size() * i / num_chunks;
+    guess = std::max(guess, bounds[i - 1]);
+
+    const char* eol = ObjTokenizer::line_end(guess, file.end());
+    bounds[i] = (eol == file.end()) ? eol : eol + 1;
+  }
+
+  std::vector<ObjRecords> chunks(num_chunks);
+  std::vector<std::thread> workers;
+  workers.reserve(num_chunks - 1);
+
+  for (size_t i = 1; i < num_chunks; i++) {
+    workers.emplace_back([&bounds, &chunks, i] {
+      parse_records(bounds[i], bounds[i + 1], chunks[i]);
+    });
+  }
+  parse_records(bounds[0], bounds[1], chunks[0]);  // do some work ourselves
+
+  for (std::thread& t : workers) {
+    t.join();
+  }
+
+  // merge in file order. Relative indices were resolved against each chunk's
+  // own counts, so shift them by everything the earlier chunks read.
+  int totals[4] = {0, 0, 0, 0};  // vertices, uvs, normals, faces
+  for (const ObjRecords& c : chunks) {
+    totals[0] += c.vertices.size();
+    totals[1] += c.uvs.size();
+    totals[2] += c.normals.size();
+    totals[3] += c.faces.size();
+  }
+  out.vertices.reserve(totals[0]);
+  out.uvs.reserve(totals[1]);
+  out.normals.reserve(totals[2]);
+  out.faces.reserve(totals[3]);
+
+  for (ObjRecords& c : chunks) {
+    const int base[3] = {out.vertices.size(), out.uvs.size(),
+                         out.normals.size()};
+    const int face_base = out.faces.size();
+
+    for (int r : c.relative) {
+      c.faces[r / 9].idx[r % 9] += base[r % 3];
+      out.relative << face_base * 9 + r;
+    }
+    for (polyface poly : c.polygons) {
+      poly.first += face_base;
+      out.polygons << poly;
+    }
+    for (usemtl use : c.materials) {
+      use.first += face_base;
+      out.materials << use;
+    }
+
+    out.vertices << c.vertices;
+    out.uvs << c.uvs;
+    out.normals << c.normals;
+    out.faces << c.faces;
+
+    if (!c.mtllib.empty()) {
+      out.mtllib = c.mtllib;  // last one wins, same as a serial read
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int read_obj_records(const std::string& filename, ObjLoader::ParseMode mode,
+                     unsigned num_threads, ObjRecords& out)
+{
+  int result;
+
+  switch (mode) {
+    case ObjLoader::ParseMode::Stream:
+      result = read_records_stream(filename, out);
+      break;
+    case ObjLoader::ParseMode::Parallel:
+      result = read_records_parallel(filename, num_threads, out);
+      break;
+    case ObjLoader::ParseMode::Mapped:
+    default:
+      result = read_records_mapped(filename, out);
+      break;
+  }
+
+  if (result == EXIT_SUCCESS) {
+    // needs every vertex, so it waits until the whole file is in
+    triangulate_polygons(out);
+  }
+
+  return result;
+}
+
+std::vector<MaterialRange> material_ranges(const QVector<usemtl>& switches,
+                                           int num_faces)
+{
+  std::vector<MaterialRange> ranges;
+  if (switches.isEmpty()) {
+    return ranges;
   }
 
+  // faces before the first usemtl have no material
+  int start = 0;
+  std::string name;
+
+  for (int i = 0; i <= switches.size(); i++) {
+    const int end = (i < switches.size()) ? switches[i].first : num_faces;
+
+    if (end > start) {
+      if (!ranges.empty() && ranges.back().material == name) {
+        ranges.back().num_indices += 3 * (end - start);
+      }
+      else {
+        ranges.push_back({name, 3u * start, 3u * (end - start)});
+      }
+      start = end;
+    }
+
+    if (i < switches.size()) {
+      name = switches[i].name;
+    }
+  }
+
+  return ranges;
+}
+
+ObjRecordCounts count_obj_records(const MappedFile& file)
+{
+  using namespace ObjTokenizer;
+
+  ObjRecordCounts counts = {0, 0, 0, 0};
+  const char* p = file.data();
+  const char* const end = file.end();
+
+  while (p < end) {
+    const char* eol = line_end(p, end);
+
+    const char* type;
+    const char* type_end;
+
+    if (next_token(p, eol, type, type_end)) {
+      if (token_is(type, type_end, "v")) {
+        counts.vertices++;
+      }
+      else if (token_is(type, type_end, "vt")) {
+        counts.uvs++;
+      }
+      else if (token_is(type, type_end, "vn")) {
+        counts.normals++;
+      }
+      else if (token_is(type, type_end, "f")) {
+        counts.faces++;
+      }
+    }
+
+    p = eol + 1;
+  }
+
+  return counts;
+}
+
+int stream_obj_records(const MappedFile& file, int batch_faces,
+                       const ObjFaceFlush& flush, ObjRecords& out)
+{
+  if (!parse_records(file.data(), file.end(), out, batch_faces, flush)) {
+    return EXIT_FAILURE;
+  }
+
+  if (!out.faces.isEmpty() && !flush_faces(out, flush)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ObjLoader::parse_file(const std::string filename, ParseMode mode)
+{
+  m_mesh.clear();
+  m_mtllib.clear();
+
+  const size_t last_slash_idx = filename.find_last_of("\\/");
+  m_basedir = filename.substr(0, last_slash_idx + 1);
+
+  ObjRecords records;
+
+  int result = read_obj_records(filename, mode, m_parse_threads, records);
+
+  if (result != EXIT_SUCCESS) {
+    return result;
+  }
+
+  m_mtllib = records.mtllib;
+
+  QVector<triface>& tmp_faces = records.faces;
+
   if (tmp_faces.size() > 0) {
     // use the first face item to detemine if we're using normals and uvs or not
     m_uses_uvs = tmp_faces[0].present[0];
@@ -158,13 +717,16 @@ int ObjLoader::parse_file(const std::string filename)
     m_uses_normals = false;
   }
 
-  // TODO shouldn't really fail here
-  assert(m_uses_uvs && m_uses_normals);
+  // missing uvs/normals are fine, obj_to_vbo fills them in with zeros
 
   // convert the things we got from the obj to usable buffers
   // TODO(mike) maybe this should be somewhere else?
-  obj_to_vbo(tmp_vertices, tmp_uvs, tmp_normals, tmp_faces, m_indices,
-             m_vertices, m_uvs, m_normals);
+  obj_to_vbo(records.vertices, records.uvs, records.normals, tmp_faces,
+             m_mesh.indices, m_mesh.positions, m_mesh.texCoords,
+             m_mesh.normals);
+
+  // the faces came out three indices each, in file order
+  m_mesh.materials = material_ranges(records.materials, tmp_faces.size());
 
   return EXIT_SUCCESS;
 }
@@ -172,18 +734,19 @@ int ObjLoader::parse_file(const std::string filename)
 void ObjLoader::print()
 {
   // print all vertices
-  for (size_t i = 0; i < m_vertices.size(); i++) {
-    QVector3D v = m_vertices[i];
-    QVector2D vt = m_uvs[i];
-    QVector3D vn = m_normals[i];
+  for (size_t i = 0; i < m_mesh.positions.size(); i++) {
+    QVector3D v = m_mesh.positions[i];
+    QVector2D vt = m_mesh.texCoords[i];
+    QVector3D vn = m_mesh.normals[i];
     std::cout << i << ":\t(" << v.x() << ", " << v.y() << ", " << v.z() << "),\t("
               << vt.x() << ", " << vt.y() << "),\t(" << vn.x() << ", " << vn.y() << ", " << vn.z() << ")\n";
   }
 
   // print face indices
-  for (size_t i = 0; i < m_indices.size(); i += 3) {
-    std::cout << "{ " << m_indices[i] << ", " << m_indices[i + 1] << ", "
-              << m_indices[i + 2] << "}\n";
+  const QVector<unsigned int>& indices = m_mesh.indices;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    std::cout << "{ " << indices[i] << ", " << indices[i + 1] << ", "
+              << indices[i + 2] << "}\n";
   }
 
   std::cout << std::endl;
@@ -10,20 +10,14 @@
 #include <iostream>
 #include <string>
 
+#include "MeshCache.h"
 #include "MtlLoader.h"
 #include "ObjLoader.h"
+#include "ObjStreamer.h"
 #include "Renderable.h"
 #include "Util.h"
 
-ObjMesh::ObjMesh()
-    : Renderable(),
-      m_obj(),
-      m_pos(),
-      m_norm(),
-      m_texCoord(),
-      m_tangents(),
-      m_bitangents(),
-      m_idx()
+ObjMesh::ObjMesh() : Renderable()
 {
   qDebug() << QDir::currentPath();
 
@@ -31,32 +25,63 @@ ObjMesh::ObjMesh()
 
 }
 
+void ObjMesh::loadMaterials(const std::string& mtllib,
+                            const std::vector<MaterialRange>& ranges)
+{
+  // parse mtl, get the materials and their texture file names
+  MtlLoader mtl;
+  std::cout << "mtllib = " << mtllib << std::endl;
+  mtl.parse_file(mtllib);
+
+  for (const Material& m : mtl.get_materials()) {
+    std::cout << "material " << m.name << ": tex = " << m.map_Kd
+              << ", norm = " << m.map_Bump << ", spec = " << m.map_Ks
+              << std::endl;
+  }
+
+  initMaterials(mtl.get_materials(), ranges);
+}
+
 void ObjMesh::init(std::string filename)
 {
-  // parse obj, get texture file name
-  if (m_obj.parse_file(filename) != EXIT_SUCCESS) {
+  // use the baked cache if it's still good
+  MeshCache cache;
+
+  if (cache.open(filename) == EXIT_SUCCESS) {
+    initGeometry(cache.vertices(), cache.num_vertices(), cache.indices(),
+                 cache.num_indices());
+    loadMaterials(cache.mtllib(), cache.materials());
+    return;
+  }
+
+  // otherwise stream the .obj straight into our buffers, writing the cache
+  // for next time along the way
+  ObjStreamer stream;
+  if (stream.start(filename) != EXIT_SUCCESS) {
     std::cout << "Could not read file " << filename << std::endl;
     exit(1);
   }
 
-  MtlLoader mtl;
-  std::cout << "mtllib = " << m_obj.get_mtllib() << std::endl;
-  mtl.parse_file(m_obj.get_mtllib());
-  std::cout << "tex = " << mtl.get_map_Kd() << std::endl;
-  std::cout << "norm = " << mtl.get_map_Bump() << std::endl;
-
-  m_pos = m_obj.get_vertices();
-  m_norm = m_obj.get_normals();
-  m_texCoord = m_obj.get_uvs();
-  m_idx = m_obj.get_indices();
+  MeshCacheWriter writer;
+  bool caching = writer.begin(filename) == EXIT_SUCCESS;
 
-  m_tangents;
-  m_bitangents;
+  auto cacheBatch = [&](const MeshBatch& batch) {
+    caching = caching &&
+              writer.add(batch.vertices.data(), batch.num_vertices(),
+                         batch.indices.data(),
+                         batch.num_indices()) == EXIT_SUCCESS;
+  };
 
-  Util::CalculateTangents(m_pos, m_norm, m_texCoord, m_idx, m_tangents, m_bitangents);
+  if (Renderable::init(stream, cacheBatch) != EXIT_SUCCESS) {
+    std::cout << "Could not read file " << filename << std::endl;
+    exit(1);
+  }
 
-  QString diffuseMap = QString::fromStdString(mtl.get_map_Kd());
-  QString normalMap = QString::fromStdString(mtl.get_map_Bump());
+  if (!caching || writer.finish(stream.get_mtllib(),
+                                stream.get_materials()) != EXIT_SUCCESS) {
+    std::cout << "Could not write " << MeshCache::cache_path(filename)
+              << std::endl;
+  }
 
-  Renderable::init(m_pos, m_norm, m_texCoord, m_tangents, m_bitangents, m_idx, diffuseMap, normalMap);
-}
\ No newline at end of file
+  loadMaterials(stream.get_mtllib(), stream.get_materials());
+}
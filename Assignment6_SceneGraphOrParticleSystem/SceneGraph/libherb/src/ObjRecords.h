@@ -0,0 +1,118 @@
+/**
+ * @brief The raw records of an .obj file, before obj_to_vbo welds them
+ */
+
+#pragma once
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <functional>
+#include <string>
+
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "ObjToVboIdx.h"
+
+// a face with more than three corners, which went into the triangles
+// faces[first] .. faces[first + corners - 3]
+typedef struct polyface {
+  int first;
+  int corners;
+} polyface;
+
+// a usemtl line: faces[first] and on use the material called name
+typedef struct usemtl {
+  int first;
+  std::string name;
+} usemtl;
+
+// intermediary data read from the obj file itself
+struct ObjRecords {
+  QVector<QVector3D> normals;
+  QVector<QVector3D> vertices;
+  QVector<QVector2D> uvs;
+  QVector<triface> faces;
+  std::string mtllib;
+
+  // faces * 9 + slot of every index that was relative (negative) in the file
+  QVector<int> relative;
+
+  // every face that had to be split into triangles
+  QVector<polyface> polygons;
+
+  // every usemtl, in file order. Their face numbers count the faces already
+  // handed over by stream_obj_records too.
+  QVector<usemtl> materials;
+
+  // faces stream_obj_records has handed over and forgotten
+  int flushed_faces = 0;
+};
+
+/**
+ * @brief Turns the usemtl lines into index ranges
+ *
+ * Drops empty runs and joins neighbours with the same material. Faces before
+ * the first usemtl get a range with no material name.
+ *
+ * @param switches  the usemtl lines
+ * @param num_faces  how many faces (triangles) the whole file had
+ * @return  the ranges, empty if there were no usemtl lines
+ */
+std::vector<MaterialRange> material_ranges(const QVector<usemtl>& switches,
+                                           int num_faces);
+
+/**
+ * @brief Reads the v/vt/vn/f/mtllib records of an .obj file
+ *
+ * Relative face indices come back already resolved to absolute (1-based)
+ * ones. Faces with more than three corners come back as triangle fans, or
+ * ear-clipped if they are concave. This is the first half of
+ * ObjLoader::parse_file.
+ *
+ * @param filename  the filename
+ * @param mode  how to read the file
+ * @param num_threads  threads for ParseMode::Parallel (0 = one per core)
+ * @param out  (output) the records, should start out empty
+ * @return  EXIT_SUCCESS on success
+ */
+int read_obj_records(const std::string& filename, ObjLoader::ParseMode mode,
+                     unsigned num_threads, ObjRecords& out);
+
+// how many of each record an .obj has
+struct ObjRecordCounts {
+  int vertices;
+  int uvs;
+  int normals;
+  int faces;  // f lines, whatever their number of corners
+};
+
+/**
+ * @brief Counts the v/vt/vn/f lines of a mapped .obj without parsing them
+ *
+ * Cheap next to a parse, so the arrays that have to hold the whole mesh can
+ * be sized exactly instead of growing into up to twice what they need.
+ */
+ObjRecordCounts count_obj_records(const MappedFile& file);
+
+// gets a batch of faces from stream_obj_records, returns false to stop reading
+typedef std::function<bool(ObjRecords&)> ObjFaceFlush;
+
+/**
+ * @brief Reads the records of a mapped .obj, handing the faces over in batches
+ *
+ * Works like ParseMode::Mapped, but whenever at least batch_faces triangles
+ * have piled up (and once more at the end) flush gets the records read so
+ * far. Its faces are final: resolved, with concave polygons ear-clipped.
+ * They are cleared once flush returns, so only one batch of faces is ever
+ * held. Vertices, uvs and normals keep growing, since later faces may use
+ * any of them.
+ *
+ * @param file  the mapped .obj
+ * @param batch_faces  triangles per batch (a polygon is never split)
+ * @param flush  gets every batch
+ * @param out  (output) the records, should start out empty
+ * @return  EXIT_SUCCESS on success, EXIT_FAILURE if flush stopped it
+ */
+int stream_obj_records(const MappedFile& file, int batch_faces,
+                       const ObjFaceFlush& flush, ObjRecords& out);
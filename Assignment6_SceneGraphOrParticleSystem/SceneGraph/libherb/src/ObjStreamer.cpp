@@ -0,0 +1,259 @@
+#include "ObjStreamer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "ObjRecords.h"
+#include "ObjToVboIdx.h"
+#include "Util.h"
+
+// batches in flight at once: one being filled, one being uploaded, one spare
+const int STREAM_BATCHES = 3;
+
+// a mesh is cut into at least this many batches, unless that would make them
+// smaller than STREAM_MIN_BATCH_TRIANGLES
+const int STREAM_MIN_BATCHES = 16;
+const int STREAM_MIN_BATCH_TRIANGLES = 64;
+
+ObjStreamer::ObjStreamer(int batch_triangles)
+    : m_batchTriangles(batch_triangles),
+      m_file(),
+      m_worker(),
+      m_batches(),
+      m_free(),
+      m_ready(),
+      m_done(false),
+      m_stopping(false),
+      m_status(EXIT_FAILURE),
+      m_basedir(),
+      m_mtllib(),
+      m_materials(),
+      m_numVertices(0),
+      m_numIndices(0)
+{
+}
+
+ObjStreamer::~ObjStreamer() { stop(); }
+
+int ObjStreamer::start(const std::string& filename)
+{
+  stop();
+
+  if (m_file.open(filename) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+
+  const size_t last_slash_idx = filename.find_last_of("\\/");
+  m_basedir = filename.substr(0, last_slash_idx + 1);
+
+  m_ready.clear();
+  m_free.clear();
+  for (const std::unique_ptr<MeshBatch>& batch : m_batches) {
+    m_free.push_back(batch.get());
+  }
+  m_done = false;
+  m_stopping = false;
+  m_status = EXIT_FAILURE;
+  m_mtllib.clear();
+  m_materials.clear();
+  m_numVertices = 0;
+  m_numIndices = 0;
+
+  m_worker = std::thread(&ObjStreamer::run, this);
+
+  return EXIT_SUCCESS;
+}
+
+MeshBatch* ObjStreamer::next()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this] { return !m_ready.empty() || m_done; });
+
+  if (m_ready.empty()) {
+    return nullptr;
+  }
+
+  MeshBatch* batch = m_ready.front();
+  m_ready.pop_front();
+  return batch;
+}
+
+void ObjStreamer::release(MeshBatch* batch)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(batch);
+  }
+  m_changed.notify_all();
+}
+
+// a batch to fill, waiting for one to come back if they're all out
+// (nullptr if the streamer is shutting down)
+MeshBatch* ObjStreamer::acquire()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_free.empty() &&
+      m_batches.size() < static_cast<size_t>(STREAM_BATCHES)) {
+    m_batches.emplace_back(new MeshBatch());
+    return m_batches.back().get();
+  }
+
+  m_changed.wait(lock, [this] { return !m_free.empty() || m_stopping; });
+
+  if (m_stopping) {
+    return nullptr;
+  }
+
+  MeshBatch* batch = m_free.back();
+  m_free.pop_back();
+  return batch;
+}
+
+void ObjStreamer::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_changed.notify_all();
+
+  if (m_worker.joinable()) {
+    m_worker.join();
+  }
+
+  m_file.close();
+}
+
+void ObjStreamer::run()
+{
+  // size everything that has to hold the whole mesh exactly, and cut small
+  // meshes into enough batches that only a slice of them is ever interleaved
+  const ObjRecordCounts counts = count_obj_records(m_file);
+  const int batch_triangles =
+      std::min(m_batchTriangles, std::max(STREAM_MIN_BATCH_TRIANGLES,
+                                          counts.faces / STREAM_MIN_BATCHES));
+
+  ObjRecords records;
+  records.vertices.reserve(counts.vertices);
+  records.uvs.reserve(counts.uvs);
+  records.normals.reserve(counts.normals);
+
+  // nearly every mesh has at least as many corners as its biggest array
+  CornerWelder welder(
+      std::max({counts.vertices, counts.uvs, counts.normals}));
+  int numIndices = 0;
+
+  QVector2D zero2d;
+  QVector3D zero3d;
+
+  // weld a batch of faces and pack every vertex it adds
+  auto flush = [&](ObjRecords& parsed) {
+    MeshBatch* batch = acquire();
+    if (!batch) {
+      return false;
+    }
+
+    const unsigned int first_vertex = static_cast<unsigned int>(welder.size());
+    batch->first_vertex = static_cast<int>(first_vertex);
+    batch->first_index = numIndices;
+    batch->indices.resize(3 * parsed.faces.size());
+
+    // weld first, so the vertices can be sized exactly
+    unsigned int* index = batch->indices.data();
+    for (const triface& f : parsed.faces) {
+      for (int i = 0; i < 3; i++) {
+        bool added;
+        *index++ = welder.weld(corner_key(f, i), added);
+      }
+    }
+
+    batch->vertices.resize(welder.size() - first_vertex);
+
+    // new vertices were numbered in the order they first showed up, so the
+    // next one still to fill is always the next new index to come along
+    unsigned int next_vertex = first_vertex;
+    index = batch->indices.data();
+
+    for (const triface& f : parsed.faces) {
+      const unsigned int* corners = index;
+      index += 3;
+
+      if (corners[0] < next_vertex && corners[1] < next_vertex &&
+          corners[2] < next_vertex) {
+        continue;
+      }
+
+      // same attributes obj_to_vbo would have given them
+      QVector3D pos[3];
+      QVector2D uv[3];
+      QVector3D norm[3];
+      for (int i = 0; i < 3; i++) {
+        const CornerKey key = corner_key(f, i);
+        pos[i] = parsed.vertices[key.v - 1];
+        uv[i] = key.vt ? parsed.uvs[key.vt - 1] : zero2d;
+        norm[i] = key.vn ? parsed.normals[key.vn - 1] : zero3d;
+      }
+
+      // a new vertex takes the tangents of the first face it shows up in,
+      // like Util::InterleaveVertices
+      QVector3D tangent;
+      QVector3D bitangent;
+      Util::CalculateTangent(pos[0], pos[1], pos[2], uv[0], uv[1], uv[2],
+                             tangent, bitangent);
+
+      for (int i = 0; i < 3; i++) {
+        if (corners[i] != next_vertex) {
+          continue;
+        }
+
+        Util::CompactVertex& packed =
+            batch->vertices[next_vertex - first_vertex];
+        next_vertex++;
+
+        float v[Util::VERTEX_FLOATS];
+        v[0] = pos[i].x();
+        v[1] = pos[i].y();
+        v[2] = pos[i].z();
+        v[3] = norm[i].x();
+        v[4] = norm[i].y();
+        v[5] = norm[i].z();
+        v[6] = uv[i].x();
+        v[7] = uv[i].y();
+        v[8] = tangent.x();
+        v[9] = tangent.y();
+        v[10] = tangent.z();
+        v[11] = bitangent.x();
+        v[12] = bitangent.y();
+        v[13] = bitangent.z();
+        Util::PackVertices(v, 1, &packed);
+      }
+    }
+
+    numIndices += batch->num_indices();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_ready.push_back(batch);
+    }
+    m_changed.notify_all();
+
+    return true;
+  };
+
+  const int status =
+      stream_obj_records(m_file, batch_triangles, flush, records);
+  std::vector<MaterialRange> materials =
+      material_ranges(records.materials, records.flushed_faces);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_status = status;
+    m_mtllib = records.mtllib;
+    m_materials = std::move(materials);
+    m_numVertices = static_cast<int>(welder.size());
+    m_numIndices = numIndices;
+    m_done = true;
+  }
+  m_changed.notify_all();
+}
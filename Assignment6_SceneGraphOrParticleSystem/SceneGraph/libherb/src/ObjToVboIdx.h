@@ -6,10 +6,15 @@
  *
  */
 
+#pragma once
+
 #include <QVector>
 #include <QVector2D>
 #include <QVector3D>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
 #include <vector>
 #include <ostream>
 
@@ -20,7 +25,7 @@ typedef struct triface {
 } triface;
 
 
-std::ostream& operator<<(std::ostream& os, const triface& f)
+inline std::ostream& operator<<(std::ostream& os, const triface& f)
 {
   bool begin = true;
 
@@ -43,7 +48,7 @@ std::ostream& operator<<(std::ostream& os, const triface& f)
 }
 
 // floating point cmp
-bool is_near(float v1, float v2) { return fabs(v1 - v2) < 0.01f; }
+inline bool is_near(float v1, float v2) { return fabs(v1 - v2) < 0.01f; }
 
 struct PackedVertex {
   QVector3D position;
@@ -59,9 +64,9 @@ struct PackedVertex {
 };
 
 // Tries to find the same values in a map
-bool getSimilarVertexIndex(PackedVertex& packed,
-                           std::map<PackedVertex, unsigned int>& vertexToOutIdx,
-                           unsigned int& result)
+inline bool getSimilarVertexIndex(
+    PackedVertex& packed, std::map<PackedVertex, unsigned int>& vertexToOutIdx,
+    unsigned int& result)
 {
   auto it = vertexToOutIdx.find(packed);
   if (it == vertexToOutIdx.end()) {
@@ -76,6 +81,10 @@ bool getSimilarVertexIndex(PackedVertex& packed,
 /**
  * @brief Convert the file format from the obj to one gl can use
  *
+ * Welds corners whose position, uv and normal bytes match through a
+ * std::map. This was the original obj_to_vbo; it is kept as a reference
+ * for the welding benchmark.
+ *
  * @param in_verts list of vertices
  * @param in_uvs list of uvs
  * @param in_normals list of normals
@@ -86,14 +95,14 @@ bool getSimilarVertexIndex(PackedVertex& packed,
  * @param out_uvs return parameter for new uvs list
  * @param out_normals return parameter for new normals list
  */
-void obj_to_vbo(QVector<QVector3D>& in_verts,
-                QVector<QVector2D>& in_uvs,
-                QVector<QVector3D>& in_normals,
-                QVector<triface>& in_faces,
-                QVector<unsigned int>& out_indices,
-                QVector<QVector3D>& out_vertices,
-                QVector<QVector2D>& out_uvs,
-                QVector<QVector3D>& out_normals)
+inline void obj_to_vbo_map(QVector<QVector3D>& in_verts,
+                           QVector<QVector2D>& in_uvs,
+                           QVector<QVector3D>& in_normals,
+                           QVector<triface>& in_faces,
+                           QVector<unsigned int>& out_indices,
+                           QVector<QVector3D>& out_vertices,
+                           QVector<QVector2D>& out_uvs,
+                           QVector<QVector3D>& out_normals)
 {
   std::map<PackedVertex, unsigned int> vertexToOutIdx;
 
@@ -139,4 +148,175 @@ void obj_to_vbo(QVector<QVector3D>& in_verts,
       }
     }
   }
-}
\ No newline at end of file
+}
+
+// (v, vt, vn) indices of one face corner, 0 where the file left one out
+struct CornerKey {
+  int v;
+  int vt;
+  int vn;
+
+  bool operator==(const CornerKey& that) const
+  {
+    return v == that.v && vt == that.vt && vn == that.vn;
+  }
+};
+
+// spreads the three indices over all 32 bits (murmur3 finalizer at the end)
+inline uint32_t hash_corner(const CornerKey& k)
+{
+  uint32_t h = static_cast<uint32_t>(k.v) * 0x9E3779B1u;
+  h ^= static_cast<uint32_t>(k.vt) * 0x85EBCA77u + (h << 6) + (h >> 2);
+  h ^= static_cast<uint32_t>(k.vn) * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+
+  return h;
+}
+
+// marks a hash table slot nobody has claimed yet
+const unsigned int WELD_EMPTY_SLOT = ~0u;
+
+// the key of corner i (0..2) of a face, with absent vt/vn as 0
+inline CornerKey corner_key(const triface& f, int i)
+{
+  return {f.idx[3 * i], f.present[2 * i] ? f.idx[3 * i + 1] : 0,
+          f.present[2 * i + 1] ? f.idx[3 * i + 2] : 0};
+}
+
+/**
+ * @brief The open addressing (linear probing) table obj_to_vbo welds with
+ *
+ * Each slot is just the out index of the vertex that claimed it. The table
+ * doubles whenever it would pass 75% load, so it also works when the faces
+ * show up a few at a time (see ObjStreamer).
+ */
+class CornerWelder {
+public:
+  explicit CornerWelder(size_t expected_corners = 0) : m_mask(0)
+  {
+    reserve(expected_corners);
+  }
+
+  // makes room for this many unique corners without growing
+  void reserve(size_t corners)
+  {
+    size_t capacity = 16;
+    while (capacity * 3 < corners * 4) {
+      capacity <<= 1;
+    }
+    if (capacity <= m_slots.size()) {
+      return;
+    }
+
+    m_slots.assign(capacity, WELD_EMPTY_SLOT);
+    m_mask = capacity - 1;
+
+    for (size_t i = 0; i < m_keys.size(); i++) {
+      m_slots[find(m_keys[i])] = static_cast<unsigned int>(i);
+    }
+  }
+
+  /**
+   * @brief Out index of a corner, giving it the next one if it's new
+   *
+   * @param key  the corner
+   * @param added  (output) true if the corner hadn't been seen before
+   */
+  unsigned int weld(const CornerKey& key, bool& added)
+  {
+    size_t slot = find(key);
+    added = m_slots[slot] == WELD_EMPTY_SLOT;
+
+    if (added) {
+      if ((m_keys.size() + 1) * 4 > m_slots.size() * 3) {
+        reserve(2 * (m_keys.size() + 1));
+        slot = find(key);
+      }
+
+      m_slots[slot] = static_cast<unsigned int>(m_keys.size());
+      m_keys.push_back(key);
+    }
+
+    return m_slots[slot];
+  }
+
+  // unique corners so far
+  size_t size() const { return m_keys.size(); }
+
+private:
+  // the slot holding key, or the empty one it would go in
+  size_t find(const CornerKey& key) const
+  {
+    size_t slot = hash_corner(key) & m_mask;
+    while (m_slots[slot] != WELD_EMPTY_SLOT && !(m_keys[m_slots[slot]] == key)) {
+      slot = (slot + 1) & m_mask;
+    }
+    return slot;
+  }
+
+  std::vector<unsigned int> m_slots;
+  std::vector<CornerKey> m_keys;  // m_keys[i] is what made out vertex i
+  size_t m_mask;
+};
+
+/**
+ * @brief Convert the file format from the obj to one gl can use
+ *
+ * Corners are welded on their (v, vt, vn) index triple with a CornerWelder.
+ * It is sized once from the face count so that even all-unique corners stay
+ * under 75% load and it never has to grow.
+ *
+ * @param in_verts list of vertices
+ * @param in_uvs list of uvs
+ * @param in_normals list of normals
+ * @param in_faces list of faces (which index into the vertices, uvs, and
+ * normals independently)
+ * @param out_indices return parameter for new indices list
+ * @param out_vertices return parameter for new vertices list
+ * @param out_uvs return parameter for new uvs list
+ * @param out_normals return parameter for new normals list
+ */
+inline void obj_to_vbo(QVector<QVector3D>& in_verts,
+                       QVector<QVector2D>& in_uvs,
+                       QVector<QVector3D>& in_normals,
+                       QVector<triface>& in_faces,
+                       QVector<unsigned int>& out_indices,
+                       QVector<QVector3D>& out_vertices,
+                       QVector<QVector2D>& out_uvs,
+                       QVector<QVector3D>& out_normals)
+{
+  const size_t num_corners = 3 * static_cast<size_t>(in_faces.size());
+
+  CornerWelder welder(num_corners);
+
+  out_indices.reserve(static_cast<int>(num_corners));
+
+  QVector2D zero2d;
+  QVector3D zero3d;
+
+  // For each face
+  for (const triface& f : in_faces) {
+    // For each vertex
+    for (int i = 0; i < 3; i++) {
+      // Extract data from the face
+      const CornerKey key = corner_key(f, i);
+
+      bool added;
+      const unsigned int index = welder.weld(key, added);
+
+      if (added) {
+        // don't have this exact corner yet, so add all of its attributes
+        out_vertices.push_back(in_verts[key.v - 1]);
+        out_uvs.push_back(key.vt ? in_uvs[key.vt - 1] : zero2d);
+        out_normals.push_back(key.vn ? in_normals[key.vn - 1] : zero3d);
+      }
+
+      out_indices.push_back(index);
+    }
+  }
+}
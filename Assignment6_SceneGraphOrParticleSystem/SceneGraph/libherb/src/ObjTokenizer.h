@@ -0,0 +1,145 @@
+/**
+ * @brief Allocation-free helpers for tokenizing .obj text in place
+ *
+ * Everything here works on [begin, end) ranges of a buffer that outlives the
+ * call (usually a MappedFile), so nothing is copied into std::strings.
+ * Whitespace matches what std::istream extraction skips in the "C" locale,
+ * except '\n', which always ends a record.
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <system_error>
+
+namespace ObjTokenizer {
+
+inline bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// first character after any leading spaces (stops at end)
+inline const char* skip_spaces(const char* p, const char* end)
+{
+  while (p < end && is_space(*p)) p++;
+  return p;
+}
+
+// one past the last character of the token starting at p
+inline const char* token_end(const char* p, const char* end)
+{
+  while (p < end && !is_space(*p)) p++;
+  return p;
+}
+
+// position of the next '\n', or end if there isn't one
+inline const char* line_end(const char* p, const char* end)
+{
+  const void* nl = memchr(p, '\n', end - p);
+  return nl ? static_cast<const char*>(nl) : end;
+}
+
+/**
+ * @brief Pulls the next whitespace separated token out of [p, end)
+ *
+ * @param p cursor, advanced past the token
+ * @param tok (output) start of the token
+ * @param tok_end (output) one past the end of the token
+ * @return false if only whitespace was left
+ */
+inline bool next_token(const char*& p, const char* end, const char*& tok,
+                       const char*& tok_end)
+{
+  tok = skip_spaces(p, end);
+  tok_end = token_end(tok, end);
+  p = tok_end;
+  return tok != tok_end;
+}
+
+// true if [tok, tok_end) spells out the null terminated str
+inline bool token_is(const char* tok, const char* tok_end, const char* str)
+{
+  const size_t len = strlen(str);
+  return static_cast<size_t>(tok_end - tok) == len &&
+         memcmp(tok, str, len) == 0;
+}
+
+/**
+ * @brief Reads the next float in [p, end), like `stream >> f` would
+ *
+ * @param p cursor, advanced past the number on success
+ * @param out (output) the parsed value, untouched on failure
+ * @return true on success
+ */
+inline bool parse_float(const char*& p, const char* end, float& out)
+{
+  const char* start = skip_spaces(p, end);
+  if (start < end && *start == '+') start++;  // from_chars rejects '+'
+
+  std::from_chars_result res = std::from_chars(start, end, out);
+  if (res.ec != std::errc()) {
+    return false;
+  }
+
+  p = res.ptr;
+  return true;
+}
+
+// Reads a leading int from [begin, end), like std::stoi would (0 on failure)
+inline int parse_int(const char* begin, const char* end)
+{
+  if (begin < end && *begin == '+') begin++;  // from_chars rejects '+'
+
+  int value = 0;
+  std::from_chars(begin, end, value);
+  return value;
+}
+
+/**
+ * @brief Helper to parse one face vertex straight out of the buffer
+ *
+ * Same contract as parse_face_vert() in ObjLoader.cpp:
+ *
+ * "5"      -> {0, 0}, {5, x, x}
+ * "1/2"    -> {1, 0}, {1, 2, x}
+ * "1/2/3"  -> {1, 1}, {1, 2, 3}
+ * "1//2"   -> {0, 1}, {1, x, 2}
+ */
+inline void parse_face_vert(bool present[2], int vert[3], const char* begin,
+                            const char* end)
+{
+  vert[0] = parse_int(begin, end);
+
+  const char* slash =
+      static_cast<const char*>(memchr(begin, '/', end - begin));
+
+  if (!slash) {  // no first slash
+    present[0] = false;
+    present[1] = false;
+    return;
+  }
+
+  const char* slash2 =
+      static_cast<const char*>(memchr(slash + 1, '/', end - (slash + 1)));
+
+  if (!slash2) {  // no second slash, 1/2 format
+    vert[1] = parse_int(slash + 1, end);
+    present[0] = true;
+    present[1] = false;
+  }
+  else if (slash2 == slash + 1) {  // 1//2 format
+    vert[2] = parse_int(slash2 + 1, end);
+    present[0] = false;
+    present[1] = true;
+  }
+  else {  // 1/2/3 format
+    vert[1] = parse_int(slash + 1, slash2);
+    vert[2] = parse_int(slash2 + 1, end);
+    present[0] = true;
+    present[1] = true;
+  }
+}
+
+}  // namespace ObjTokenizer
@@ -2,21 +2,135 @@
 
 #include <QtGui>
 #include <QtOpenGL>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <map>
 
 #include "Light.h"
+#include "ObjStreamer.h"
+#include "Util.h"
 
 #define VERT_SHADER "@VERT_SHADER@"  // CMAKE: VERT_SHADER
 #define FRAG_SHADER "@FRAG_SHADER@"  // CMAKE: FRAG_SHADER
 
 const unsigned MAX_LIGHTS = 10;
 
+// texture units of a material's maps
+const int DIFFUSE_UNIT = 0;
+const int NORMAL_UNIT = 1;
+const int SPECULAR_UNIT = 2;
+
+// what an unreadable map (or one still decoding, or a missing normal map)
+// reads as: no change to the diffuse color, a flat normal, full specular.
+// A missing diffuse or specular map reads as the material's Kd or Ks.
+const QRgb MISSING_DIFFUSE = qRgb(255, 255, 255);
+const QRgb MISSING_NORMAL = qRgb(128, 128, 255);
+const QRgb MISSING_SPECULAR = qRgb(255, 255, 255);
+
+// exporters write Ns 0 when they mean "not set"; the shader's old exponent
+const float DEFAULT_SHININESS = 32.0f;
+
+// meshes with up to this many vertices get 16 bit indices
+const int MAX_SHORT_INDEXED_VERTICES = 65536;
+
+// first guess at how many bytes of .obj make one vertex / one index when
+// streaming; on the low side, a short buffer just grows
+const size_t OBJ_BYTES_PER_VERTEX_GUESS = 64;
+const size_t OBJ_BYTES_PER_INDEX_GUESS = 24;
+
+// QOpenGLBuffer sizes are ints, so a streamed mesh can't have more than this
+// (indices counted at 4 bytes, since they may get widened)
+const int MAX_STREAMED_VERTICES = INT_MAX / sizeof(Util::CompactVertex);
+const int MAX_STREAMED_INDICES = INT_MAX / sizeof(unsigned int);
+
+/**
+ * @brief Swaps buf for a new buffer object of newBytes, copying the first
+ * usedBytes over on the GPU
+ *
+ * Leaves the new buffer bound.
+ */
+static void growBuffer(QOpenGLBuffer& buf, int usedBytes, int newBytes)
+{
+  QOpenGLBuffer bigger(buf.type());
+  bigger.create();
+  bigger.setUsagePattern(buf.usagePattern());
+  bigger.bind();
+  bigger.allocate(newBytes);
+
+  QOpenGLExtraFunctions* gl =
+      QOpenGLContext::currentContext()->extraFunctions();
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, buf.bufferId());
+  gl->glBindBuffer(GL_COPY_WRITE_BUFFER, bigger.bufferId());
+  gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                          usedBytes);
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  buf.destroy();
+  buf = bigger;
+}
+
+QOpenGLTexture* Renderable::createTexture(
+    const std::vector<MipCache::Level>& levels)
+{
+  QOpenGLTexture* tex = new QOpenGLTexture(QOpenGLTexture::Target2D);
+  tex->setFormat(QOpenGLTexture::RGBA8_UNorm);
+  tex->setSize(levels[0].width, levels[0].height);
+  tex->setMipLevels(static_cast<int>(levels.size()));
+  tex->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+
+  QOpenGLPixelTransferOptions options;
+  options.setAlignment(1);
+  for (size_t i = 0; i < levels.size(); i++) {
+    tex->setData(static_cast<int>(i), QOpenGLTexture::RGBA,
+                 QOpenGLTexture::UInt8, levels[i].rgba, &options);
+  }
+
+  return tex;
+}
+
+QOpenGLTexture* Renderable::createTexture(QRgb color)
+{
+  const uint32_t pixel = color;
+  std::vector<MipLevel> built;
+  build_mip_chain(&pixel, 1, 1, 1, MipKind::DATA, TEXTURE_MIP_FILTER, built);
+
+  return createTexture({{built[0].width, built[0].height,
+                         built[0].rgba.data()}});
+}
+
+// a color of 0..1 channels as a texel
+static QRgb texel(const QVector3D& color)
+{
+  int channels[3];
+  for (int c = 0; c < 3; c++) {
+    const float clamped = std::min(std::max(color[c], 0.0f), 1.0f);
+    channels[c] = static_cast<int>(std::lround(clamped * 255));
+  }
+  return qRgb(channels[0], channels[1], channels[2]);
+}
+
+// binds tex to unit unless it's there already
+static void bindTexture(QOpenGLTexture* tex, int unit,
+                        QOpenGLTexture* bound[3])
+{
+  if (bound[unit] != tex) {
+    tex->bind(unit);
+    bound[unit] = tex;
+  }
+}
+
 Renderable::Renderable()
     : m_vbo(QOpenGLBuffer::VertexBuffer),
       m_ibo(QOpenGLBuffer::IndexBuffer),
-      m_texture(QOpenGLTexture::Target2D),
-      m_normalmap(QOpenGLTexture::Target2D),
+      m_textureLoader(nullptr),
+      m_textureCache(nullptr),
       m_numTris(0),
       m_vertexSize(0),
+      m_indexType(GL_UNSIGNED_INT),
       m_rotationAxis(0.0, 0.0, 1.0),
       m_rotationSpeed(0)
 {
@@ -25,12 +139,7 @@ Renderable::Renderable()
 
 Renderable::~Renderable()
 {
-  if (m_texture.isCreated()) {
-    m_texture.destroy();
-  }
-  if (m_normalmap.isCreated()) {
-    m_normalmap.destroy();
-  }
+  // (the textures go with their last holder)
   if (m_vbo.isCreated()) {
     m_vbo.destroy();
   }
@@ -59,15 +168,44 @@ void Renderable::createShaders()
   }
 }
 
-void Renderable::drawCall() const
+void Renderable::drawCall(int firstIndex, int numIndices) const
 {
-  glDrawElements(GL_TRIANGLES, m_numTris * 3, GL_UNSIGNED_INT, 0);
+  glDrawElements(
+      GL_TRIANGLES, numIndices, m_indexType,
+      reinterpret_cast<const void*>(static_cast<size_t>(firstIndex) *
+                                    indexSize()));
+}
+
+int Renderable::indexSize() const
+{
+  return m_indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short)
+                                          : sizeof(unsigned int);
 }
 
 void Renderable::init()
 {
-  init(m_positions, m_normals, m_texCoords, m_tangents, m_bitangents, m_indexes,
-       m_textureFile, m_normalMap);
+  init(m_mesh, m_textureFile, m_normalMap);
+
+  // it's on the GPU now
+  m_mesh = MeshData();
+}
+
+void Renderable::init(const MeshData& mesh, const QString& textureFile,
+                      const QString& normalMap)
+{
+  // We need to make sure our sizes all work out ok.
+  if (mesh.positions.size() != mesh.texCoords.size() ||
+      mesh.positions.size() != mesh.normals.size()) {
+    qDebug() << "[Renderable]::init() -- positions size mismatch with "
+                "normals/texture coordinates";
+    return;
+  }
+
+  std::vector<float> data;
+  Util::InterleaveMesh(mesh, data);
+
+  init(data.data(), mesh.positions.size(), mesh.indices.constData(),
+       mesh.indices.size(), textureFile, normalMap);
 }
 
 void Renderable::init(const QVector<QVector3D>& positions,
@@ -86,27 +224,384 @@ void Renderable::init(const QVector<QVector3D>& positions,
     return;
   }
 
-  // Set our model matrix to identity
-  m_modelMatrix.setToIdentity();
+  std::vector<float> data;
+  Util::InterleaveVertices(positions, normals, texCoords, tangents, bitangents,
+                           indexes, data);
 
-  // TODO got to be smarter about this mirroring somehow
+  init(data.data(), positions.size(), indexes.constData(), indexes.size(),
+       textureFile, normalMap);
+}
 
-  // Load our texture
-  QImage img(textureFile);
-  m_texture.setData(img.mirrored(true, true));
+void Renderable::init(const float* vertices, int numVerts,
+                      const unsigned int* indexes, int numIndexes,
+                      const QString& textureFile, const QString& normalMap)
+{
+  initGeometry(vertices, numVerts, indexes, numIndexes);
+  initTextures(textureFile, normalMap);
+}
 
-  // Load our normal map
-  QImage norm(normalMap);
-  m_normalmap.setData(norm.mirrored(true, true));
+void Renderable::initGeometry(const float* vertices, int numVerts,
+                              const unsigned int* indexes, int numIndexes)
+{
+  std::vector<Util::CompactVertex> packed(numVerts);
+  Util::PackVertices(vertices, numVerts, packed.data());
+
+  initGeometry(packed.data(), numVerts, indexes, numIndexes);
+}
 
+void Renderable::initGeometry(const Util::CompactVertex* vertices,
+                              int numVerts, const unsigned int* indexes,
+                              int numIndexes)
+{
   // set our number of triangles.
-  m_numTris = indexes.size() / 3;
+  m_numTris = numIndexes / 3;
+
+  initBuffers(vertices, numVerts, indexes, numIndexes);
+
+  // Hook the vertex layout up to our buffers.
+  m_vao.bind();
+  m_vbo.bind();
+  m_ibo.bind();
+  setAttributes();
+
+  // Release our vao and THEN release our buffers.
+  m_vao.release();
+  m_vbo.release();
+  m_ibo.release();
+}
+
+int Renderable::init(ObjStreamer& stream,
+                     const std::function<void(const MeshBatch&)>& onBatch)
+{
+  // room for a guess at the mesh, from the size of the file (no more than
+  // the buffers can hold, however big the file)
+  int vertCapacity = static_cast<int>(std::min<size_t>(
+      MAX_STREAMED_VERTICES,
+      std::max<size_t>(1024,
+                       stream.source_size() / OBJ_BYTES_PER_VERTEX_GUESS)));
+  int indexCapacity = static_cast<int>(std::min<size_t>(
+      MAX_STREAMED_INDICES,
+      std::max<size_t>(3 * 1024,
+                       stream.source_size() / OBJ_BYTES_PER_INDEX_GUESS)));
+
+  // (16 bit indices if the guess fits them; widened if the mesh doesn't)
+  initBuffers(nullptr, vertCapacity, nullptr, indexCapacity);
+
+  const int vertexBytes = m_vertexSize;
+  bool ok = true;
+
+  std::vector<unsigned short> shortIndexes;
+
+  // the ibo only sticks if a vao is bound, so keep ours bound throughout
+  m_vao.bind();
+  m_vbo.bind();
+  m_ibo.bind();
+
+  // upload each batch as soon as it's ready; the streamer is already working
+  // on the next one meanwhile
+  while (MeshBatch* batch = stream.next()) {
+    const int vertEnd = batch->first_vertex + batch->num_vertices();
+    const int indexEnd = batch->first_index + batch->num_indices();
+
+    if (vertEnd > MAX_STREAMED_VERTICES || indexEnd > MAX_STREAMED_INDICES) {
+      qDebug() << "[Renderable]::init() -- mesh is too big for one buffer";
+      stream.release(batch);
+      ok = false;
+      break;
+    }
+
+    if (m_indexType == GL_UNSIGNED_SHORT &&
+        vertEnd > MAX_SHORT_INDEXED_VERTICES) {
+      ok = widenIndices(batch->first_index, indexCapacity) && ok;
+    }
+
+    if (vertEnd > vertCapacity) {
+      const int bigger =
+          std::min(std::max(2 * vertCapacity, vertEnd), MAX_STREAMED_VERTICES);
+      growBuffer(m_vbo, batch->first_vertex * vertexBytes,
+                 bigger * vertexBytes);
+      vertCapacity = bigger;
+    }
+    if (indexEnd > indexCapacity) {
+      const int bigger =
+          std::min(std::max(2 * indexCapacity, indexEnd), MAX_STREAMED_INDICES);
+      growBuffer(m_ibo, batch->first_index * indexSize(),
+                 bigger * indexSize());
+      indexCapacity = bigger;
+    }
+
+    m_vbo.write(batch->first_vertex * vertexBytes, batch->vertices.data(),
+                batch->num_vertices() * vertexBytes);
+
+    const void* indexes = batch->indices.data();
+    if (m_indexType == GL_UNSIGNED_SHORT) {
+      shortIndexes.assign(batch->indices.begin(), batch->indices.end());
+      indexes = shortIndexes.data();
+    }
+    m_ibo.write(batch->first_index * indexSize(), indexes,
+                batch->num_indices() * indexSize());
+
+    if (onBatch) {
+      onBatch(*batch);
+    }
+
+    stream.release(batch);
+  }
+
+  // set our number of triangles (none if the mesh didn't fit).
+  m_numTris = ok ? stream.num_indices() / 3 : 0;
+
+  // growBuffer may have swapped the buffers, so hook up the final ones
+  m_vbo.bind();
+  m_ibo.bind();
+  setAttributes();
+
+  // Release our vao and THEN release our buffers.
+  m_vao.release();
+  m_vbo.release();
+  m_ibo.release();
 
-  // num verts (used to size our vbo)
-  int numVerts = positions.size();
-  m_vertexSize = 3 + 3 + 2 + 3 +
-                 3;  // Position + normal + texCoord + tangents + bitangents
-  int numVBOEntries = numVerts * m_vertexSize;
+  return ok ? stream.status() : EXIT_FAILURE;
+}
+
+bool Renderable::widenIndices(int numIndexes, int capacity)
+{
+  std::vector<unsigned short> narrow(numIndexes);
+  if (numIndexes > 0 &&
+      !m_ibo.read(0, narrow.data(), numIndexes * sizeof(unsigned short))) {
+    qDebug() << "[Renderable]::widenIndices() -- can't read the ibo back";
+    return false;
+  }
+
+  const std::vector<unsigned int> wide(narrow.begin(), narrow.end());
+
+  m_indexType = GL_UNSIGNED_INT;
+  m_ibo.allocate(capacity * indexSize());
+  m_ibo.write(0, wide.data(), numIndexes * indexSize());
+
+  return true;
+}
+
+TextureCache::Texture Renderable::solidTexture(
+    QRgb color, std::map<QRgb, TextureCache::Texture>& solids)
+{
+  TextureCache::Texture& texture = solids[color];
+  if (texture) {
+    return texture;
+  }
+
+  if (m_textureCache) {
+    texture = m_textureCache->find_solid(color);
+  }
+  if (!texture) {
+    texture.reset(createTexture(color));
+    if (m_textureCache) {
+      texture = m_textureCache->add_solid(color, texture);
+    }
+  }
+  return texture;
+}
+
+int Renderable::loadTexture(const std::string& file, QRgb missing,
+                            MipKind kind, std::map<std::string, int>& loaded,
+                            std::map<QRgb, TextureCache::Texture>& solids)
+{
+  // (file names can't start with a '\n', so these keys can't clash)
+  const std::string key =
+      file + "\n" + std::to_string(static_cast<int>(kind));
+  const std::string missingKey = "\n" + std::to_string(missing);
+
+  if (!file.empty()) {
+    auto found = loaded.find(key);
+    if (found != loaded.end()) {
+      return found->second;
+    }
+
+    TextureCache::Texture texture;
+    if (m_textureCache) {
+      texture = m_textureCache->find(file, kind);
+    }
+
+    const int slot = static_cast<int>(m_textures.size());
+    if (!texture && m_textureLoader) {
+      // in a slot of its own, for the image to take over when it's ready
+      texture = solidTexture(missing, solids);
+      m_pending.push_back(
+          {m_textureLoader->decode(file, kind), slot, file, kind});
+    }
+    else if (!texture) {
+      DecodedTexture decoded;
+      decode_texture(file, kind, decoded);
+      if (decoded.ok()) {
+        texture = shareTexture(file, kind, createTexture(decoded.levels),
+                               decoded.bytes());
+      }
+    }
+
+    if (texture) {
+      m_textures.push_back(texture);
+
+      loaded[key] = slot;
+      return slot;
+    }
+  }
+
+  auto found = loaded.find(missingKey);
+  if (found != loaded.end()) {
+    return found->second;
+  }
+
+  m_textures.push_back(solidTexture(missing, solids));
+
+  loaded[missingKey] = static_cast<int>(m_textures.size()) - 1;
+  return loaded[missingKey];
+}
+
+TextureCache::Texture Renderable::shareTexture(const std::string& file,
+                                               MipKind kind,
+                                               QOpenGLTexture* texture,
+                                               size_t bytes)
+{
+  TextureCache::Texture shared(texture);
+  if (m_textureCache) {
+    return m_textureCache->add(file, kind, shared, bytes);
+  }
+  return shared;
+}
+
+void Renderable::uploadTextures()
+{
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    if (it->decoded.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    // (if it couldn't be read, the placeholder is what it would have been)
+    const std::shared_ptr<const DecodedTexture> decoded = it->decoded.get();
+    if (decoded->ok()) {
+      // another Renderable sharing the cache may have put it up meanwhile
+      TextureCache::Texture texture;
+      if (m_textureCache) {
+        texture = m_textureCache->find_again(it->file, it->kind);
+      }
+
+      if (!texture) {
+        if (!m_textureLoader->spend_upload(decoded->bytes())) {
+          return;  // next frame
+        }
+        texture = shareTexture(it->file, it->kind,
+                               createTexture(decoded->levels),
+                               decoded->bytes());
+      }
+
+      m_textures[it->slot] = texture;
+    }
+
+    it = m_pending.erase(it);
+  }
+}
+
+void Renderable::initTextures(const QString& textureFile,
+                              const QString& normalMap)
+{
+  Material material = Material();
+  material.map_Kd = textureFile.toStdString();
+  material.map_Bump = normalMap.toStdString();
+
+  initMaterials({material}, {});
+}
+
+void Renderable::initMaterials(const std::vector<Material>& materials,
+                               const std::vector<MaterialRange>& ranges)
+{
+  m_textures.clear();
+  m_pending.clear();
+  m_materials.clear();
+  m_drawRanges.clear();
+
+  const std::vector<Material> none(1, Material());
+  const std::vector<Material>& mtl = materials.empty() ? none : materials;
+
+  std::map<std::string, int> loaded;
+  std::map<QRgb, TextureCache::Texture> solids;
+  std::vector<int> drawIndex(mtl.size(), -1);  // mtl index -> m_materials index
+
+  // a draw material for mtl[i], loading its textures the first time
+  auto slot = [&](size_t i) {
+    if (drawIndex[i] < 0) {
+      const Material& m = mtl[i];
+
+      DrawMaterial draw;
+      draw.diffuse = loadTexture(
+          m.map_Kd, m.map_Kd.empty() ? texel(m.Kd) : MISSING_DIFFUSE,
+          MipKind::COLOR, loaded, solids);
+      draw.normal =
+          loadTexture(m.map_Bump, MISSING_NORMAL, MipKind::NORMAL, loaded,
+                      solids);
+      draw.specular = loadTexture(
+          m.map_Ks, m.map_Ks.empty() ? texel(m.Ks) : MISSING_SPECULAR,
+          MipKind::DATA, loaded, solids);
+      draw.shininess = m.Ns > 0 ? m.Ns : DEFAULT_SHININESS;
+
+      drawIndex[i] = static_cast<int>(m_materials.size());
+      m_materials.push_back(draw);
+    }
+    return drawIndex[i];
+  };
+
+  if (ranges.empty()) {
+    m_drawRanges.push_back({slot(0), 0, static_cast<int>(m_numTris * 3)});
+  }
+
+  for (const MaterialRange& range : ranges) {
+    // names the .mtl doesn't have (and faces before any usemtl) get the
+    // first material
+    size_t i = 0;
+    while (i < mtl.size() && mtl[i].name != range.material) {
+      i++;
+    }
+    if (i == mtl.size()) {
+      i = 0;
+    }
+
+    m_drawRanges.push_back({slot(i), static_cast<int>(range.first_index),
+                            static_cast<int>(range.num_indices)});
+  }
+
+  // one material after the other, so each one is bound once; ranges that
+  // end up next to each other in the ibo too become one draw
+  std::stable_sort(m_drawRanges.begin(), m_drawRanges.end(),
+                   [](const DrawRange& a, const DrawRange& b) {
+                     return a.material < b.material;
+                   });
+
+  std::vector<DrawRange> joined;
+  for (const DrawRange& range : m_drawRanges) {
+    if (!joined.empty() && joined.back().material == range.material &&
+        joined.back().firstIndex + joined.back().numIndices ==
+            range.firstIndex) {
+      joined.back().numIndices += range.numIndices;
+    }
+    else {
+      joined.push_back(range);
+    }
+  }
+  m_drawRanges.swap(joined);
+}
+
+void Renderable::initBuffers(const Util::CompactVertex* vertices,
+                             int numVerts, const unsigned int* indexes,
+                             int numIndexes)
+{
+  // Set our model matrix to identity
+  m_modelMatrix.setToIdentity();
+
+  // Position + normal + texCoord + tangent + bitangent side, packed
+  m_vertexSize = sizeof(Util::CompactVertex);
+  m_indexType = numVerts <= MAX_SHORT_INDEXED_VERTICES ? GL_UNSIGNED_SHORT
+                                                        : GL_UNSIGNED_INT;
 
   // Setup our shader.
   createShaders();
@@ -116,104 +611,58 @@ void Renderable::init(const QVector<QVector3D>& positions,
   m_vao.create();
   m_vao.bind();
 
+  // (null data just allocates)
   m_vbo.create();
   m_vbo.setUsagePattern(QOpenGLBuffer::StaticDraw);
   m_vbo.bind();
+  m_vbo.allocate(vertices, numVerts * m_vertexSize);
 
-  // Create a temporary data array
-  float* data = new float[numVBOEntries];
-
-  // fill the first three elements
-  for (int i = 0; i < numVerts; ++i) {
-    data[i * m_vertexSize + 0] = positions.at(i).x();
-    data[i * m_vertexSize + 1] = positions.at(i).y();
-    data[i * m_vertexSize + 2] = positions.at(i).z();
-
-    data[i * m_vertexSize + 3] = normals.at(i).x();
-    data[i * m_vertexSize + 4] = normals.at(i).y();
-    data[i * m_vertexSize + 5] = normals.at(i).z();
-
-    data[i * m_vertexSize + 6] = texCoords.at(i).x();
-    data[i * m_vertexSize + 7] = texCoords.at(i).y();
+  std::vector<unsigned short> shortIndexes;
+  const void* indexData = indexes;
+  if (indexes && m_indexType == GL_UNSIGNED_SHORT) {
+    shortIndexes.assign(indexes, indexes + numIndexes);
+    indexData = shortIndexes.data();
   }
 
-  // TODO(mike) warning: really ugly stuff below
-  // fill the TN parts (this vector is a different structure - see Util.h)
-  for (unsigned int i = 0; i < m_numTris; i++) {
-    // find where in the data to put these TB parts
-    unsigned int a = indexes.at(3 * i);
-    unsigned int b = indexes.at(3 * i + 1);
-    unsigned int c = indexes.at(3 * i + 2);
-
-    // put a's TB where it belongs
-    data[a * m_vertexSize + 8] = tangents.at(i).x();
-    data[a * m_vertexSize + 9] = tangents.at(i).y();
-    data[a * m_vertexSize + 10] = tangents.at(i).z();
-    data[a * m_vertexSize + 11] = bitangents.at(i).x();
-    data[a * m_vertexSize + 12] = bitangents.at(i).y();
-    data[a * m_vertexSize + 13] = bitangents.at(i).z();
-
-    // and b's
-    data[b * m_vertexSize + 8] = tangents.at(i).x();
-    data[b * m_vertexSize + 9] = tangents.at(i).y();
-    data[b * m_vertexSize + 10] = tangents.at(i).z();
-    data[b * m_vertexSize + 11] = bitangents.at(i).x();
-    data[b * m_vertexSize + 12] = bitangents.at(i).y();
-    data[b * m_vertexSize + 13] = bitangents.at(i).z();
-
-    // and c's
-    data[c * m_vertexSize + 8] = tangents.at(i).x();
-    data[c * m_vertexSize + 9] = tangents.at(i).y();
-    data[c * m_vertexSize + 10] = tangents.at(i).z();
-    data[c * m_vertexSize + 11] = bitangents.at(i).x();
-    data[c * m_vertexSize + 12] = bitangents.at(i).y();
-    data[c * m_vertexSize + 13] = bitangents.at(i).z();
-  }
-
-  m_vbo.allocate(data, numVBOEntries * sizeof(float));
-  delete[] data;
-
   // Create our index buffer
   m_ibo.create();
   m_ibo.bind();
   m_ibo.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  m_ibo.allocate(indexData, numIndexes * indexSize());
 
-  // create a temporary array for our indexes
-  unsigned int* idxAr = new unsigned int[indexes.size()];
-  for (int i = 0; i < indexes.size(); ++i) {
-    idxAr[i] = indexes.at(i);
-  }
-  m_ibo.allocate(idxAr, indexes.size() * sizeof(unsigned int));
-  delete[] idxAr;
+  m_vao.release();
+  m_vbo.release();
+  m_ibo.release();
+}
+
+void Renderable::setAttributes()
+{
+  // (Qt always asks for normalized, which turns the shorts into [-1, 1] and
+  // does nothing to floats)
 
   // positions
   m_shader.enableAttributeArray(0);
-  m_shader.setAttributeBuffer(0, GL_FLOAT, 0, 3, m_vertexSize * sizeof(float));
+  m_shader.setAttributeBuffer(0, GL_FLOAT,
+                              offsetof(Util::CompactVertex, position), 3,
+                              m_vertexSize);
 
   // normals
   m_shader.enableAttributeArray(1);
-  m_shader.setAttributeBuffer(1, GL_FLOAT, 3 * sizeof(float), 3,
-                              m_vertexSize * sizeof(float));
+  m_shader.setAttributeBuffer(1, GL_SHORT,
+                              offsetof(Util::CompactVertex, normal), 2,
+                              m_vertexSize);
 
   // uvs
   m_shader.enableAttributeArray(2);
-  m_shader.setAttributeBuffer(2, GL_FLOAT, (3 + 3) * sizeof(float), 2,
-                              m_vertexSize * sizeof(float));
+  m_shader.setAttributeBuffer(2, GL_HALF_FLOAT,
+                              offsetof(Util::CompactVertex, texCoord), 2,
+                              m_vertexSize);
 
-  // tangents
+  // tangents, with the bitangent side
   m_shader.enableAttributeArray(3);
-  m_shader.setAttributeBuffer(3, GL_FLOAT, (3 + 3 + 2) * sizeof(float), 3,
-                              m_vertexSize * sizeof(float));
-
-  // bitangents
-  m_shader.enableAttributeArray(4);
-  m_shader.setAttributeBuffer(4, GL_FLOAT, (3 + 3 + 2 + 3) * sizeof(float), 3,
-                              m_vertexSize * sizeof(float));
-
-  // Release our vao and THEN release our buffers.
-  m_vao.release();
-  m_vbo.release();
-  m_ibo.release();
+  m_shader.setAttributeBuffer(3, GL_SHORT,
+                              offsetof(Util::CompactVertex, tangent), 2,
+                              m_vertexSize);
 }
 
 void Renderable::update(const qint64 msSinceLastFrame)
@@ -236,6 +685,10 @@ void Renderable::draw(const QMatrix4x4& world, const QMatrix4x4& view,
   rotMatrix.setToIdentity();
   rotMatrix.rotate(m_rotationAngle, m_rotationAxis);
 
+  if (!m_pending.empty()) {
+    uploadTextures();
+  }
+
   QMatrix4x4 modelMat = world * m_modelMatrix * rotMatrix;
   // qDebug() << modelMat;
   // Make sure our state is what we want
@@ -260,19 +713,36 @@ void Renderable::draw(const QMatrix4x4& world, const QMatrix4x4& view,
     lights[i]->applyToUniform(m_shader, "lights[" + std::to_string(i) + "]");
   }
 
-  m_shader.setUniformValue("diffuseMap", 0);
-  m_shader.setUniformValue("normalMap", 1);
+  m_shader.setUniformValue("diffuseMap", DIFFUSE_UNIT);
+  m_shader.setUniformValue("normalMap", NORMAL_UNIT);
+  m_shader.setUniformValue("specularMap", SPECULAR_UNIT);
 
-  // setup textures
   m_vao.bind();
 
-  m_texture.bind(0);
-  m_normalmap.bind(1);
+  // one draw per range; they're grouped by material, so only bind when the
+  // material changes, and then only the textures that differ
+  QOpenGLTexture* bound[3] = {nullptr, nullptr, nullptr};
+  int material = -1;
 
-  drawCall();
+  for (const DrawRange& range : m_drawRanges) {
+    if (range.material != material) {
+      material = range.material;
+      const DrawMaterial& m = m_materials[material];
 
-  m_normalmap.release(1);
-  m_texture.release(0);
+      bindTexture(m_textures[m.diffuse].get(), DIFFUSE_UNIT, bound);
+      bindTexture(m_textures[m.normal].get(), NORMAL_UNIT, bound);
+      bindTexture(m_textures[m.specular].get(), SPECULAR_UNIT, bound);
+      m_shader.setUniformValue("shininess", m.shininess);
+    }
+
+    drawCall(range.firstIndex, range.numIndices);
+  }
+
+  for (int unit = 0; unit < 3; unit++) {
+    if (bound[unit]) {
+      bound[unit]->release(unit);
+    }
+  }
 
   m_vao.release();
   m_shader.release();
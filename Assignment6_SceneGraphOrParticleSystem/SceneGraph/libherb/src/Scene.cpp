@@ -122,14 +122,16 @@ void Scene::draw(const QMatrix4x4& view, const QMatrix4x4& projection,
   }
 }
 
-void Scene::init()
+void Scene::init(TextureLoader* loader, TextureCache* cache)
 {
   if (m_renderable) {
+    m_renderable->setTextureLoader(loader);
+    m_renderable->setTextureCache(cache);
     m_renderable->init();
   }
   onInit();
   for (auto child : m_children) {
-    child->init();
+    child->init(loader, cache);
   }
 }
 
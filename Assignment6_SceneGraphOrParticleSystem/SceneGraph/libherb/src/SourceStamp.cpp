@@ -0,0 +1,72 @@
+#include "SourceStamp.h"
+
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <cstdlib>
+
+#include "MappedFile.h"
+
+// 64 bit FNV-1a
+static uint64_t hash_bytes(const char* data, size_t size)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// hash of a whole file's contents, false if it can't be read
+static bool hash_file(const std::string& filename, uint64_t& hash)
+{
+  MappedFile file;
+  if (file.open(filename) != EXIT_SUCCESS) {
+    return false;
+  }
+  hash = hash_bytes(file.data(), file.size());
+  return true;
+}
+
+static bool stat_source(const std::string& filename, int64_t& mtime_ns,
+                        uint64_t& size)
+{
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    return false;
+  }
+  mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+             st.st_mtim.tv_nsec;
+  size = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+std::string canonical_path(const std::string& path)
+{
+  char resolved[PATH_MAX];
+  if (realpath(path.c_str(), resolved)) {
+    return resolved;
+  }
+  return path;
+}
+
+bool stamp_source(const std::string& filename, SourceStamp& stamp)
+{
+  return stat_source(filename, stamp.mtime_ns, stamp.size) &&
+         hash_file(filename, stamp.hash);
+}
+
+bool source_unchanged(const std::string& filename, const SourceStamp& stamp)
+{
+  int64_t mtime_ns;
+  uint64_t size;
+  if (!stat_source(filename, mtime_ns, size) || size != stamp.size) {
+    return false;
+  }
+
+  // the source was touched; only trust the cache if its contents didn't move
+  uint64_t hash;
+  return mtime_ns == stamp.mtime_ns ||
+         (hash_file(filename, hash) && hash == stamp.hash);
+}
@@ -45,10 +45,10 @@ void Sphere::calculatePoints()
       float v = 1 - ((float)latNumber / (float)latitudeBands);
 
       // Setup geometry
-      positions_.push_back(
+      mesh_.positions.push_back(
           QVector3D(radius * x, radius * y, radius * z));  // Position
-      normals_.push_back(QVector3D(radius * x, radius * y, radius * z));
-      textureCoords_.push_back(QVector2D(u, v));  // Texture
+      mesh_.normals.push_back(QVector3D(radius * x, radius * y, radius * z));
+      mesh_.texCoords.push_back(QVector2D(u, v));  // Texture
     }
   }
 
@@ -62,19 +62,17 @@ void Sphere::calculatePoints()
          longNumber1++) {
       unsigned int first = (latNumber1 * (longitudeBands + 1)) + longNumber1;
       unsigned int second = first + longitudeBands + 1;
-      index_.push_back(first);
-      index_.push_back(second);
-      index_.push_back(first + 1);
+      mesh_.indices.push_back(first);
+      mesh_.indices.push_back(second);
+      mesh_.indices.push_back(first + 1);
 
-      index_.push_back(second);
-      index_.push_back(second + 1);
-      index_.push_back(first + 1);
+      mesh_.indices.push_back(second);
+      mesh_.indices.push_back(second + 1);
+      mesh_.indices.push_back(first + 1);
     }
   }
 
-  // Calculate tangents
-  Util::CalculateTangents(positions_, normals_, textureCoords_, index_,
-                          tangents_, bitangents_);
+  // the tangents get worked out when the mesh is uploaded
 }
 
 void Sphere::init()
@@ -82,6 +80,5 @@ void Sphere::init()
   QString qtexture = QString::fromStdString(m_texture);
   QString qnormalmap = QString::fromStdString(DEFAULT_NORMAL_MAP);
 
-  Renderable::init(positions_, normals_, textureCoords_, tangents_, bitangents_,
-                   index_, qtexture, qnormalmap);
+  Renderable::init(mesh_, qtexture, qnormalmap);
 }
@@ -0,0 +1,156 @@
+#include "TextureCache.h"
+
+// what a 1x1 texture holds on the GPU
+static const size_t SOLID_BYTES = 4;
+
+TextureCache::TextureCache()
+    : m_paths(), m_contents(), m_solids(), m_requests(0), m_hits(0)
+{
+}
+
+bool TextureCache::content_of(const std::string& file, MipKind kind,
+                              ContentKey& content)
+{
+  const std::pair<std::string, MipKind> key(canonical_path(file), kind);
+
+  // a path seen before only costs a stat, unless its file has changed
+  auto seen = m_paths.find(key);
+  if (seen != m_paths.end() && source_unchanged(file, seen->second.stamp)) {
+    content = seen->second.content;
+    return true;
+  }
+
+  PathEntry entry;
+  if (!stamp_source(file, entry.stamp)) {
+    return false;
+  }
+  entry.content = ContentKey(entry.stamp.size, entry.stamp.hash, kind);
+
+  m_paths[key] = entry;
+  content = entry.content;
+  return true;
+}
+
+TextureCache::Texture TextureCache::find(const std::string& file,
+                                         MipKind kind)
+{
+  m_requests++;
+  return find_again(file, kind);
+}
+
+TextureCache::Texture TextureCache::find_again(const std::string& file,
+                                               MipKind kind)
+{
+  Texture texture = lookup(file, kind);
+  if (texture) {
+    m_hits++;
+  }
+  return texture;
+}
+
+TextureCache::Texture TextureCache::lookup(const std::string& file,
+                                           MipKind kind)
+{
+  ContentKey content;
+  if (!content_of(file, kind, content)) {
+    return nullptr;
+  }
+
+  auto found = m_contents.find(content);
+  if (found == m_contents.end()) {
+    return nullptr;
+  }
+  return found->second.texture.lock();
+}
+
+TextureCache::Texture TextureCache::add(const std::string& file, MipKind kind,
+                                        Texture texture, size_t bytes)
+{
+  ContentKey content;
+  if (!content_of(file, kind, content)) {
+    return texture;  // nothing to know it by; not shared
+  }
+
+  ContentEntry& entry = m_contents[content];
+  if (Texture there = entry.texture.lock()) {
+    return there;
+  }
+
+  entry.texture = texture;
+  entry.bytes = bytes;
+
+  prune();
+  return texture;
+}
+
+TextureCache::Texture TextureCache::find_solid(uint32_t color)
+{
+  auto found = m_solids.find(color);
+  if (found == m_solids.end()) {
+    return nullptr;
+  }
+  return found->second.lock();
+}
+
+TextureCache::Texture TextureCache::add_solid(uint32_t color,
+                                              Texture texture)
+{
+  std::weak_ptr<QOpenGLTexture>& entry = m_solids[color];
+  if (Texture there = entry.lock()) {
+    return there;
+  }
+
+  entry = texture;
+
+  prune();
+  return texture;
+}
+
+TextureCache::Stats TextureCache::stats() const
+{
+  Stats stats = {m_requests, m_hits, 0, 0, 0};
+
+  for (const auto& content : m_contents) {
+    const long holders = content.second.texture.use_count();
+    if (holders > 0) {
+      stats.textures++;
+      stats.bytes += content.second.bytes;
+      stats.bytes_saved += (holders - 1) * content.second.bytes;
+    }
+  }
+
+  for (const auto& solid : m_solids) {
+    const long holders = solid.second.use_count();
+    if (holders > 0) {
+      stats.textures++;
+      stats.bytes += SOLID_BYTES;
+      stats.bytes_saved += (holders - 1) * SOLID_BYTES;
+    }
+  }
+
+  return stats;
+}
+
+void TextureCache::prune()
+{
+  for (auto it = m_contents.begin(); it != m_contents.end();) {
+    if (it->second.texture.expired()) {
+      it = m_contents.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  for (auto it = m_solids.begin(); it != m_solids.end();) {
+    if (it->second.expired()) {
+      it = m_solids.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  // paths are kept: they're small, and save hashing the file again if it
+  // comes back
+}
@@ -0,0 +1,150 @@
+#include "TextureLoader.h"
+
+#include <QImage>
+#include <algorithm>
+#include <cstdlib>
+
+size_t DecodedTexture::bytes() const
+{
+  size_t total = 0;
+  for (const MipCache::Level& level : levels) {
+    total += static_cast<size_t>(level.width) * level.height * 4;
+  }
+  return total;
+}
+
+void decode_texture(const std::string& file, MipKind kind,
+                    DecodedTexture& out)
+{
+  out.levels.clear();
+  out.built.clear();
+
+  if (out.cache.open(file, kind, TEXTURE_MIP_FILTER) == EXIT_SUCCESS) {
+    out.levels = out.cache.levels();
+    return;
+  }
+
+  QImage img;
+  if (!img.load(QString::fromStdString(file))) {
+    return;
+  }
+  if (img.format() != QImage::Format_RGB32 &&
+      img.format() != QImage::Format_ARGB32) {
+    img = img.convertToFormat(QImage::Format_ARGB32);
+  }
+
+  build_mip_chain(reinterpret_cast<const uint32_t*>(img.constBits()),
+                  img.width(), img.height(), img.bytesPerLine() / 4, kind,
+                  TEXTURE_MIP_FILTER, out.built);
+
+  // next time; if the directory is read only, every time
+  MipCache::write(file, kind, TEXTURE_MIP_FILTER, out.built);
+
+  for (const MipLevel& level : out.built) {
+    out.levels.push_back({level.width, level.height, level.rgba.data()});
+  }
+}
+
+TextureLoader::TextureLoader(unsigned threads)
+    : m_workers(),
+      m_jobs(),
+      m_unfinished(),
+      m_stopping(false),
+      m_budget(0),
+      m_spent(0)
+{
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    m_workers.emplace_back(&TextureLoader::run, this);
+  }
+}
+
+TextureLoader::~TextureLoader()
+{
+  std::deque<Job> dropped;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+    dropped.swap(m_jobs);
+    m_unfinished.clear();
+  }
+  m_changed.notify_all();
+
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+
+  // as if they couldn't be read
+  for (Job& job : dropped) {
+    job.result.set_value(std::make_shared<DecodedTexture>());
+  }
+}
+
+TextureLoader::Future TextureLoader::decode(const std::string& file,
+                                            MipKind kind)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  const std::pair<std::string, MipKind> key(file, kind);
+  auto unfinished = m_unfinished.find(key);
+  if (unfinished != m_unfinished.end()) {
+    return unfinished->second;
+  }
+
+  Job job = {file, kind, {}};
+  Future decoded = job.result.get_future().share();
+  m_jobs.push_back(std::move(job));
+  m_unfinished[key] = decoded;
+
+  lock.unlock();
+  m_changed.notify_one();
+
+  return decoded;
+}
+
+size_t TextureLoader::queued() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_jobs.size();
+}
+
+void TextureLoader::begin_frame(size_t budget)
+{
+  m_budget = budget;
+  m_spent = 0;
+}
+
+bool TextureLoader::spend_upload(size_t bytes)
+{
+  if (m_spent > 0 && m_spent + bytes > m_budget) {
+    return false;
+  }
+  m_spent += bytes;
+  return true;
+}
+
+void TextureLoader::run()
+{
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_changed.wait(lock, [this] { return !m_jobs.empty() || m_stopping; });
+      if (m_stopping) {
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    std::shared_ptr<DecodedTexture> decoded =
+        std::make_shared<DecodedTexture>();
+    decode_texture(job.file, job.kind, *decoded);
+    job.result.set_value(std::move(decoded));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_unfinished.erase(std::make_pair(job.file, job.kind));
+  }
+}
@@ -40,10 +40,10 @@ void TexturedQuad::createShaders() {
   Renderable::createShaders();
 }
 
-void TexturedQuad::drawCall() const
+void TexturedQuad::drawCall(int firstIndex, int numIndices) const
 {
   // TODO this should be glDrawElementsInstanced
-  Renderable::drawCall();
+  Renderable::drawCall(firstIndex, numIndices);
 }
 
 void TexturedQuad::init(std::string texture)
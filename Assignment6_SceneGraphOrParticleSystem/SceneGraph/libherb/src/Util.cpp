@@ -1,5 +1,43 @@
 #include "Util.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// largest snorm16 value, and the tangent's second octahedral coordinate
+// shifted off zero by one step of it so its sign can carry the bitangent's
+const float SNORM16_MAX = 32767.0f;
+const float SIGN_OFFSET = 1.0f / SNORM16_MAX;
+
+void Util::CalculateTangent(const QVector3D& pos1, const QVector3D& pos2,
+                            const QVector3D& pos3, const QVector2D& uv1,
+                            const QVector2D& uv2, const QVector2D& uv3,
+                            QVector3D& tangent, QVector3D& bitangent)
+{
+  // calculate its edges
+  QVector3D edge1 = pos2 - pos1;
+  QVector3D edge2 = pos3 - pos1;
+
+  // and delta uv coords
+  QVector2D duv1 = uv2 - uv1;
+  QVector2D duv2 = uv3 - uv1;
+
+  // finally compute with matrix magic the T and B vectors
+  // credit to https://learnopengl.com/Advanced-Lighting/Normal-Mapping for
+  // this
+  float f = 1.0f / (duv1.x() * duv2.y() - duv2.x() * duv1.y());
+
+  tangent.setX(f * (duv2.y() * edge1.x() - duv1.y() * edge2.x()));
+  tangent.setY(f * (duv2.y() * edge1.y() - duv1.y() * edge2.y()));
+  tangent.setZ(f * (duv2.y() * edge1.z() - duv1.y() * edge2.z()));
+  tangent.normalize();
+
+  bitangent.setX(f * (-duv2.x() * edge1.x() + duv1.x() * edge2.x()));
+  bitangent.setY(f * (-duv2.x() * edge1.y() + duv1.x() * edge2.y()));
+  bitangent.setZ(f * (-duv2.x() * edge1.z() + duv1.x() * edge2.z()));
+  bitangent.normalize();
+}
+
 void Util::CalculateTangents(const QVector<QVector3D>& vertices,
                              const QVector<QVector3D>& normals,
                              const QVector<QVector2D>& texcoords,
@@ -23,40 +61,325 @@ void Util::CalculateTangents(const QVector<QVector3D>& vertices,
     const QVector3D& pos2 = vertices[b];
     const QVector3D& pos3 = vertices[c];
 
-    const QVector3D& nm1 = normals[a];
-    const QVector3D& nm2 = normals[b];
-    const QVector3D& nm3 = normals[c];
-
     const QVector2D& uv1 = texcoords[a];
     const QVector2D& uv2 = texcoords[b];
     const QVector2D& uv3 = texcoords[c];
 
-    // calculate its edges
-    QVector3D edge1 = pos2 - pos1;
-    QVector3D edge2 = pos3 - pos1;
-
-    // and delta uv coords
-    QVector2D duv1 = uv2 - uv1;
-    QVector2D duv2 = uv3 - uv1;
-
-    // finally compute with matrix magic the T and B vectors
-    // credit to https://learnopengl.com/Advanced-Lighting/Normal-Mapping for
-    // this
-    float f = 1.0f / (duv1.x() * duv2.y() - duv2.x() * duv1.y());
-
     QVector3D tangent;
-    tangent.setX(f * (duv2.y() * edge1.x() - duv1.y() * edge2.x()));
-    tangent.setY(f * (duv2.y() * edge1.y() - duv1.y() * edge2.y()));
-    tangent.setZ(f * (duv2.y() * edge1.z() - duv1.y() * edge2.z()));
-    tangent.normalize();
-
     QVector3D bitangent;
-    bitangent.setX(f * (-duv2.x() * edge1.x() + duv1.x() * edge2.x()));
-    bitangent.setY(f * (-duv2.x() * edge1.y() + duv1.x() * edge2.y()));
-    bitangent.setZ(f * (-duv2.x() * edge1.z() + duv1.x() * edge2.z()));
-    bitangent.normalize();
+    CalculateTangent(pos1, pos2, pos3, uv1, uv2, uv3, tangent, bitangent);
 
     out_tangents.push_back(tangent);
     out_bitangents.push_back(bitangent);
   }
-}
\ No newline at end of file
+}
+
+void Util::InterleaveVertices(const QVector<QVector3D>& positions,
+                              const QVector<QVector3D>& normals,
+                              const QVector<QVector2D>& texcoords,
+                              const QVector<QVector3D>& tangents,
+                              const QVector<QVector3D>& bitangents,
+                              const QVector<unsigned int>& indices,
+                              std::vector<float>& out)
+{
+  const int numVerts = positions.size();
+  const unsigned int numTris = indices.size() / 3;
+
+  out.assign(static_cast<size_t>(numVerts) * VERTEX_FLOATS, 0.0f);
+  float* data = out.data();
+
+  // fill the position, normal and uv parts
+  for (int i = 0; i < numVerts; ++i) {
+    float* v = data + static_cast<size_t>(i) * VERTEX_FLOATS;
+
+    v[0] = positions.at(i).x();
+    v[1] = positions.at(i).y();
+    v[2] = positions.at(i).z();
+
+    v[3] = normals.at(i).x();
+    v[4] = normals.at(i).y();
+    v[5] = normals.at(i).z();
+
+    v[6] = texcoords.at(i).x();
+    v[7] = texcoords.at(i).y();
+  }
+
+  // fill the TB parts (one per face, so each vertex takes them from the
+  // first face it shows up in, same as ObjStreamer)
+  std::vector<bool> filled(numVerts, false);
+
+  for (unsigned int i = 0; i < numTris; i++) {
+    const QVector3D& t = tangents.at(i);
+    const QVector3D& b = bitangents.at(i);
+
+    for (unsigned int k = 0; k < 3; k++) {
+      const size_t vert = indices.at(3 * i + k);
+      if (filled[vert]) {
+        continue;
+      }
+      filled[vert] = true;
+
+      float* v = data + vert * VERTEX_FLOATS;
+
+      v[8] = t.x();
+      v[9] = t.y();
+      v[10] = t.z();
+      v[11] = b.x();
+      v[12] = b.y();
+      v[13] = b.z();
+    }
+  }
+}
+
+void Util::InterleaveMesh(const MeshData& mesh, std::vector<float>& out)
+{
+  assert(mesh.positions.size() == mesh.normals.size() &&
+         mesh.positions.size() == mesh.texCoords.size());
+
+  const int numVerts = mesh.positions.size();
+  const QVector3D* positions = mesh.positions.constData();
+  const QVector3D* normals = mesh.normals.constData();
+  const QVector2D* texcoords = mesh.texCoords.constData();
+  const unsigned int* indices = mesh.indices.constData();
+  const int numIndices = mesh.indices.size() - mesh.indices.size() % 3;
+
+  out.resize(static_cast<size_t>(numVerts) * VERTEX_FLOATS);
+  float* data = out.data();
+
+  for (int i = 0; i < numVerts; ++i) {
+    float* v = data + static_cast<size_t>(i) * VERTEX_FLOATS;
+
+    v[0] = positions[i].x();
+    v[1] = positions[i].y();
+    v[2] = positions[i].z();
+
+    v[3] = normals[i].x();
+    v[4] = normals[i].y();
+    v[5] = normals[i].z();
+
+    v[6] = texcoords[i].x();
+    v[7] = texcoords[i].y();
+  }
+
+  // each vertex takes the TB of the first face it shows up in
+  std::vector<bool> filled(numVerts, false);
+
+  for (int i = 0; i < numIndices; i += 3) {
+    const unsigned int a = indices[i];
+    const unsigned int b = indices[i + 1];
+    const unsigned int c = indices[i + 2];
+
+    if (filled[a] && filled[b] && filled[c]) {
+      continue;
+    }
+
+    QVector3D t;
+    QVector3D bt;
+    CalculateTangent(positions[a], positions[b], positions[c], texcoords[a],
+                     texcoords[b], texcoords[c], t, bt);
+
+    for (unsigned int vert : {a, b, c}) {
+      if (filled[vert]) {
+        continue;
+      }
+      filled[vert] = true;
+
+      float* v = data + static_cast<size_t>(vert) * VERTEX_FLOATS;
+
+      v[8] = t.x();
+      v[9] = t.y();
+      v[10] = t.z();
+      v[11] = bt.x();
+      v[12] = bt.y();
+      v[13] = bt.z();
+    }
+  }
+
+  // vertices no face uses get zero TB, like InterleaveVertices gives them
+  for (int i = 0; i < numVerts; ++i) {
+    if (!filled[i]) {
+      std::fill_n(data + static_cast<size_t>(i) * VERTEX_FLOATS + 8, 6, 0.0f);
+    }
+  }
+}
+
+uint16_t Util::FloatToHalf(float f)
+{
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+
+  const uint32_t sign = (x >> 16) & 0x8000u;
+  const uint32_t bits = x & 0x7FFFFFFFu;
+
+  if (bits >= 0x7F800000u) {  // inf or NaN (kept quiet)
+    return sign | 0x7C00u | (bits > 0x7F800000u ? 0x200u : 0u);
+  }
+  if (bits >= 0x477FF000u) {  // rounds past the largest half, 65504
+    return sign | 0x7C00u;
+  }
+
+  uint32_t half;
+  uint32_t rest;
+  uint32_t tie;
+
+  if (bits >= 0x38800000u) {  // normal: rebias the exponent, drop 13 bits
+    half = (bits - 0x38000000u) >> 13;
+    rest = bits & 0x1FFFu;
+    tie = 0x1000u;
+  }
+  else if (bits >= 0x33000000u) {  // subnormal half, in steps of 2^-24
+    const uint32_t mantissa = (bits & 0x7FFFFFu) | 0x800000u;
+    const uint32_t shift = 126 - (bits >> 23);
+    half = mantissa >> shift;
+    rest = mantissa & ((1u << shift) - 1);
+    tie = 1u << (shift - 1);
+  }
+  else {  // at most half of the smallest subnormal
+    return static_cast<uint16_t>(sign);
+  }
+
+  // (a carry out of the mantissa moves on to the next exponent, as it should)
+  if (rest > tie || (rest == tie && (half & 1))) {
+    half++;
+  }
+
+  return static_cast<uint16_t>(sign | half);
+}
+
+float Util::HalfToFloat(uint16_t h)
+{
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1Fu;
+  const uint32_t mantissa = h & 0x3FFu;
+
+  if (exponent == 0) {  // zero or subnormal
+    const float f = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -f : f;
+  }
+
+  uint32_t x;
+  if (exponent == 0x1Fu) {
+    x = sign | 0x7F800000u | (mantissa << 13);
+  }
+  else {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+// -1 or 1, with 0 counting as positive
+static float signNotZero(float f) { return f < 0.0f ? -1.0f : 1.0f; }
+
+static int16_t toSnorm16(float f)
+{
+  return static_cast<int16_t>(
+      std::lround(std::max(-1.0f, std::min(1.0f, f)) * SNORM16_MAX));
+}
+
+// the octahedral coordinates of v, in [-1, 1]
+static void octCoords(const QVector3D& v, float& x, float& y)
+{
+  const float l1 = std::fabs(v.x()) + std::fabs(v.y()) + std::fabs(v.z());
+
+  // zero and NaN both fail this
+  if (!(l1 > 0.0f) || std::isinf(l1)) {
+    x = 0.0f;
+    y = 0.0f;
+    return;
+  }
+
+  x = v.x() / l1;
+  y = v.y() / l1;
+
+  // the lower half folds out over the corners
+  if (v.z() < 0.0f) {
+    const float fx = (1.0f - std::fabs(y)) * signNotZero(x);
+    const float fy = (1.0f - std::fabs(x)) * signNotZero(y);
+    x = fx;
+    y = fy;
+  }
+}
+
+void Util::OctEncode(const QVector3D& v, int16_t out[2])
+{
+  float x;
+  float y;
+  octCoords(v, x, y);
+
+  out[0] = toSnorm16(x);
+  out[1] = toSnorm16(y);
+}
+
+QVector3D Util::OctDecode(float x, float y)
+{
+  QVector3D v(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+
+  if (v.z() < 0.0f) {
+    const float fx = (1.0f - std::fabs(y)) * signNotZero(x);
+    const float fy = (1.0f - std::fabs(x)) * signNotZero(y);
+    v.setX(fx);
+    v.setY(fy);
+  }
+
+  return v.normalized();
+}
+
+void Util::PackVertices(const float* vertices, int numVerts,
+                        CompactVertex* out)
+{
+  for (int i = 0; i < numVerts; ++i) {
+    const float* v = vertices + static_cast<size_t>(i) * VERTEX_FLOATS;
+    CompactVertex& c = out[i];
+
+    c.position[0] = v[0];
+    c.position[1] = v[1];
+    c.position[2] = v[2];
+
+    c.texCoord[0] = FloatToHalf(v[6]);
+    c.texCoord[1] = FloatToHalf(v[7]);
+
+    const QVector3D normal(v[3], v[4], v[5]);
+    const QVector3D tangent(v[8], v[9], v[10]);
+    const QVector3D bitangent(v[11], v[12], v[13]);
+
+    OctEncode(normal, c.normal);
+
+    // the tangent's y goes from [-1, 1] to [SIGN_OFFSET, 1], then takes the
+    // bitangent's side as its sign (never 0, so that always comes back)
+    const float side = signNotZero(QVector3D::dotProduct(
+        QVector3D::crossProduct(normal, tangent), bitangent));
+
+    float x;
+    float y;
+    octCoords(tangent, x, y);
+
+    c.tangent[0] = toSnorm16(x);
+    c.tangent[1] =
+        toSnorm16(side * (SIGN_OFFSET + (1.0f - SIGN_OFFSET) * (y + 1) / 2));
+  }
+}
+
+void Util::UnpackVertex(const CompactVertex& v, QVector3D& position,
+                        QVector3D& normal, QVector2D& texCoord,
+                        QVector3D& tangent, QVector3D& bitangent)
+{
+  position = QVector3D(v.position[0], v.position[1], v.position[2]);
+  texCoord = QVector2D(HalfToFloat(v.texCoord[0]), HalfToFloat(v.texCoord[1]));
+
+  // what glVertexAttribPointer makes of normalized shorts (since GL 4.2;
+  // before that it could be half a step off, which the shader shrugs off)
+  auto snorm = [](int16_t s) { return std::max(-1.0f, s / SNORM16_MAX); };
+
+  normal = OctDecode(snorm(v.normal[0]), snorm(v.normal[1]));
+
+  const float y = snorm(v.tangent[1]);
+  const float side = signNotZero(y);
+  tangent = OctDecode(snorm(v.tangent[0]),
+                      (std::fabs(y) - SIGN_OFFSET) / (1.0f - SIGN_OFFSET) * 2 -
+                          1);
+
+  bitangent = side * QVector3D::crossProduct(normal, tangent);
+}
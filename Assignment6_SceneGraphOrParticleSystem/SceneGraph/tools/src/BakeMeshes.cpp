@@ -0,0 +1,137 @@
+/**
+ * Pre-bakes the .herbmesh cache for every .obj under a directory (the bundled
+ * objects/ directory by default), so the app never pays for parsing at
+ * startup. For each mesh, prints how long a cold load (parse, weld, tangents
+ * and interleave) took next to a warm load out of the fresh cache.
+ *
+ * The triangles and vertices are reordered for the post-transform cache on
+ * the way (see optimize_mesh), and the simulated ACMR/ATVR before and after
+ * are printed too. --no-optimize bakes them in file order.
+ *
+ * usage: BakeMeshes [--no-optimize] [directory ...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+
+#define OBJECTS_DIR "@OBJECTS_DIR@"  // CMAKE: OBJECTS_DIR
+
+const int WARM_RUNS = 10;
+
+typedef std::chrono::duration<double, std::milli> Millis;
+
+// every .obj under dir, sorted so the output is stable
+std::vector<std::string> find_objs(const std::string& dir)
+{
+  std::vector<std::string> objs;
+
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(dir)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".obj") {
+      objs.push_back(entry.path().string());
+    }
+  }
+
+  std::sort(objs.begin(), objs.end());
+  return objs;
+}
+
+// best wall time of WARM_RUNS cache opens, in milliseconds (< 0 on failure)
+double time_warm(const std::string& source)
+{
+  double best = 1e300;
+
+  for (int i = 0; i < WARM_RUNS; i++) {
+    MeshCache cache;
+
+    auto start = std::chrono::steady_clock::now();
+    if (cache.open(source) != EXIT_SUCCESS) {
+      return -1;
+    }
+    Millis ms = std::chrono::steady_clock::now() - start;
+
+    best = std::min(best, ms.count());
+  }
+
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> dirs;
+  bool optimize = true;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--no-optimize") {
+      optimize = false;
+    }
+    else {
+      dirs.push_back(arg);
+    }
+  }
+  if (dirs.empty()) {
+    dirs.push_back(OBJECTS_DIR);
+  }
+
+  bool ok = true;
+
+  for (const std::string& dir : dirs) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+      std::cout << "Not a directory: " << dir << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    for (const std::string& source : find_objs(dir)) {
+      BakedMesh mesh;
+      MeshOptimizeStats stats;
+
+      auto start = std::chrono::steady_clock::now();
+      if (MeshCache::bake(source, mesh, optimize, &stats) != EXIT_SUCCESS) {
+        std::cout << "Could not read file " << source << std::endl;
+        ok = false;
+        continue;
+      }
+      Millis cold = std::chrono::steady_clock::now() - start;
+
+      if (MeshCache::write(source, mesh) != EXIT_SUCCESS) {
+        std::cout << "Could not write " << MeshCache::cache_path(source)
+                  << std::endl;
+        ok = false;
+        continue;
+      }
+
+      const double warm = time_warm(source);
+      if (warm < 0) {
+        std::cout << "Could not open " << MeshCache::cache_path(source)
+                  << std::endl;
+        ok = false;
+        continue;
+      }
+
+      std::cout << source << '\n'
+                << "  " << std::setw(8) << mesh.indices.size() / 3
+                << " triangles  cold " << std::fixed << std::setprecision(3)
+                << std::setw(9) << cold.count() << " ms  warm "
+                << std::setw(7) << warm << " ms\n";
+
+      if (optimize) {
+        std::cout << "  ACMR " << std::setprecision(3) << stats.before.acmr
+                  << " -> " << stats.after.acmr << "  ATVR "
+                  << stats.before.atvr << " -> " << stats.after.atvr << '\n';
+      }
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}